@@ -0,0 +1,351 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Microbenchmarks of the lexer, the parser, row storage, the catalog and
+ *  the ingest queue.
+ *  Every benchmark is timed over RUNS runs of a fixed number of operations
+ *  and reported as one JSON object per line:
+ *
+ *      {"benchmark": "lexNextToken", "ops": 1000000, "ns_per_op": 12.3,
+ *       "ns_per_op_min": 12.1, "ns_per_op_max": 13.0, "ops_per_sec": ...}
+ *
+ *  ns_per_op is the median of the runs.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "db.h"
+#include "eval.h"
+#include "ingest.h"
+#include "lex.h"
+#include "parser.h"
+#include "prof.h"
+
+#define RUNS 11
+
+/* Threads submitting to the ingest queue and rows of each of their
+ * batches */
+#define INGEST_PRODUCERS 8
+#define INGEST_BATCH_ROWS 64
+
+/* Statements lexed and parsed, one of each kind the planner handles */
+static const char *queries[] = {
+    "SELECT id, name, age FROM users WHERE age >= 18 AND name != 'root';",
+    "INSERT INTO users (id, name, age) VALUES (42, 'Marco', 23);",
+    "UPDATE users SET age = 24 WHERE id = 42 OR name = 'Marco';",
+    "DELETE FROM users WHERE id BETWEEN 10 AND 20;",
+    "CREATE TABLE users (id INT, name TEXT, age INT) ROW_FORMAT = PACKED;",
+};
+
+#define QUERY_COUNT (sizeof(queries) / sizeof(queries[0]))
+
+/* Runs 'ops' operations of a benchmark and returns the ticks it took */
+typedef uint64_t (*bench_fn)(void *state, size_t ops);
+
+static int benchCompare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void benchRun(const char *name, bench_fn fn, void *state, size_t ops) {
+    double ns[RUNS];
+
+    fn(state, ops); /* warm up caches and allocator */
+    for (int i = 0; i < RUNS; i++)
+        ns[i] = profMicros(fn(state, ops)) * 1000.0 / (double)ops;
+    qsort(ns, RUNS, sizeof(ns[0]), benchCompare);
+
+    double median = ns[RUNS / 2];
+    printf("{\"benchmark\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.2f, "
+           "\"ns_per_op_min\": %.2f, \"ns_per_op_max\": %.2f, "
+           "\"ops_per_sec\": %.0f}\n",
+           name, ops, median, ns[0], ns[RUNS - 1],
+           median > 0 ? 1e9 / median : 0.0);
+}
+
+/* Tokens of the queries, 'ops' counts tokens */
+static uint64_t benchLex(void *state, size_t ops) {
+    struct lexer_t lexer;
+    size_t done = 0, q = 0;
+    (void)state;
+
+    uint64_t start = profNow();
+    while (done < ops) {
+        lexInitialize(&lexer, queries[q++ % QUERY_COUNT]);
+        do {
+            lexNextToken(&lexer);
+            done++;
+        } while (lexer.current_token.type != RSQL_EOF && done < ops);
+    }
+    return profNow() - start;
+}
+
+/* Whole statements, lexing included, into a reused arena */
+static uint64_t benchParse(void *state, size_t ops) {
+    struct arena_t *arena = state;
+    struct lexer_t lexer;
+
+    uint64_t start = profNow();
+    for (size_t i = 0; i < ops; i++) {
+        arenaReset(arena);
+        lexInitialize(&lexer, queries[i % QUERY_COUNT]);
+
+        struct parser_t *parser = parserCreate(&lexer, arena);
+        if (!parser || !parserParse(parser)) {
+            fprintf(stderr, "bench: unable to parse '%s'\n",
+                    queries[i % QUERY_COUNT]);
+            exit(1);
+        }
+    }
+    return profNow() - start;
+}
+
+struct bench_table_t {
+    struct table_t *table;
+    size_t rows; /* rows the table holds between runs */
+};
+
+/* Table (id INT, name TEXT, age INT) */
+static struct table_t *benchTable(struct database_t *db,
+                                  const char name[64], int row_format) {
+    static const char columns[][64] = {"id", "name", "age"};
+    static const int types[] = {DB_TYPE_INT, DB_TYPE_TEXT, DB_TYPE_INT};
+    const int constraints[MAX_CONSTRAINTS_NUM] = {0};
+
+    struct table_t *table = dbTableNew(db, name);
+    if (!table)
+        return NULL;
+
+    table->row_format = row_format;
+    for (size_t i = 0; i < 3; i++) {
+        if (!dbColumnCreate(table, columns[i], types[i], constraints, NULL))
+            return NULL;
+    }
+    return table;
+}
+
+/* Appends 'ops' rows with every cell set, then drops them untimed */
+static uint64_t benchRowNew(void *state, size_t ops) {
+    struct bench_table_t *bench = state;
+    struct table_t *table = bench->table;
+    union cell_value_t id, name, age;
+
+    strcpy(name.s, "Marco");
+    age.i = 23;
+
+    uint64_t start = profNow();
+    for (size_t i = 0; i < ops; i++) {
+        struct row_t *row = dbRowNew(table);
+        id.i = (int)i;
+        if (!row || !dbCellPut(row, table->columns[0], &id) ||
+            !dbCellPut(row, table->columns[1], &name) ||
+            !dbCellPut(row, table->columns[2], &age)) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+    }
+    uint64_t ticks = profNow() - start;
+
+    dbRowTruncate(table, bench->rows);
+    return ticks;
+}
+
+/* Deletes the last of the rows appended untimed on top of bench->rows,
+ * dbRowDelete() looks the row up before removing it */
+static uint64_t benchRowDelete(void *state, size_t ops) {
+    struct bench_table_t *bench = state;
+    struct table_t *table = bench->table;
+
+    for (size_t i = 0; i < ops; i++) {
+        if (!dbRowNew(table)) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+    }
+
+    uint64_t start = profNow();
+    for (size_t i = 0; i < ops; i++)
+        dbRowDelete(table, table->rows[table->row_count - 1]);
+    return profNow() - start;
+}
+
+struct bench_catalog_t {
+    struct ctx_t *ctx;
+    char names[MAX_TABLE_NUM][64];
+};
+
+/* A database, table and column lookup by name, as done when a statement
+ * is planned */
+static uint64_t benchCatalog(void *state, size_t ops) {
+    struct bench_catalog_t *catalog = state;
+    size_t found = 0;
+
+    uint64_t start = profNow();
+    for (size_t i = 0; i < ops; i++) {
+        struct database_t *db = dbFind(catalog->ctx, "bench");
+        struct table_t *table =
+            dbTableFind(db, catalog->names[i % MAX_TABLE_NUM]);
+        found += table && dbColumnFind(table, "age") >= 0;
+    }
+    uint64_t ticks = profNow() - start;
+
+    if (found != ops) {
+        fprintf(stderr, "bench: catalog lookup failed\n");
+        exit(1);
+    }
+    return ticks;
+}
+
+struct bench_ingest_t {
+    struct ingest_t *queue;
+    size_t rows; /* rows submitted by each producer */
+};
+
+static void *benchProducer(void *data) {
+    const struct bench_ingest_t *bench = data;
+    struct ingest_batch_t *batches[1024];
+    size_t count = 0;
+
+    for (size_t done = 0; done < bench->rows; done += INGEST_BATCH_ROWS) {
+        size_t rows = bench->rows - done < INGEST_BATCH_ROWS
+                          ? bench->rows - done
+                          : INGEST_BATCH_ROWS;
+        struct ingest_batch_t *batch = ingestBatchNew(bench->queue, rows);
+        if (!batch) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+
+        for (size_t r = 0; r < rows; r++) {
+            ingestSetInt(batch, r, 0, (int)(done + r));
+            ingestSetText(batch, r, 1, "Marco");
+            ingestSetInt(batch, r, 2, 23);
+        }
+        ingestSubmit(batch);
+
+        if (count == sizeof(batches) / sizeof(batches[0])) {
+            for (size_t i = 0; i < count; i++)
+                ingestWait(batches[i]);
+            count = 0;
+        }
+        batches[count++] = batch;
+    }
+
+    int ok = 1;
+    for (size_t i = 0; i < count; i++)
+        ok &= ingestWait(batches[i]);
+    if (!ok) {
+        fprintf(stderr, "bench: ingest failed\n");
+        exit(1);
+    }
+    return NULL;
+}
+
+/* 'ops' rows submitted by INGEST_PRODUCERS threads at once, timed until
+ * every batch was applied */
+static uint64_t benchIngest(void *state, size_t ops) {
+    struct bench_ingest_t *bench = state;
+    pthread_t threads[INGEST_PRODUCERS];
+
+    bench->rows = ops / INGEST_PRODUCERS;
+
+    uint64_t start = profNow();
+    for (size_t i = 0; i < INGEST_PRODUCERS; i++)
+        pthread_create(&threads[i], NULL, benchProducer, bench);
+    for (size_t i = 0; i < INGEST_PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t ticks = profNow() - start;
+
+    evLock();
+    struct database_t *db = dbFind(evGetContext(), "ingest");
+    dbRowTruncate(dbTableFind(db, "ingest"), 0);
+    evUnlock();
+    return ticks;
+}
+
+int main(void) {
+    static const char db_name[64] = "bench";
+    struct arena_t arena;
+    struct bench_catalog_t catalog;
+    struct bench_table_t dynamic = {NULL, 1000}, packed = {NULL, 1000};
+
+    arenaInit(&arena);
+    catalog.ctx = dbCreateCtx();
+    struct database_t *db = catalog.ctx ? dbCreateNew(catalog.ctx, db_name)
+                                        : NULL;
+    strcpy(catalog.names[0], "dynamic");
+    strcpy(catalog.names[1], "packed");
+    if (db) {
+        dynamic.table = benchTable(db, catalog.names[0], DB_ROW_DYNAMIC);
+        packed.table = benchTable(db, catalog.names[1], DB_ROW_PACKED);
+    }
+    if (!dynamic.table || !packed.table) {
+        fprintf(stderr, "bench: unable to create the tables\n");
+        return 1;
+    }
+
+    /* Tables other than the two above fill the catalog up to its limit */
+    for (size_t i = 2; i < MAX_TABLE_NUM; i++) {
+        snprintf(catalog.names[i], sizeof(catalog.names[i]), "table_%zu", i);
+        if (!benchTable(db, catalog.names[i], DB_ROW_DYNAMIC)) {
+            fprintf(stderr, "bench: unable to create the tables\n");
+            return 1;
+        }
+    }
+
+    benchRun("lexNextToken", benchLex, NULL, 1000000);
+    benchRun("parserParse", benchParse, &arena, 100000);
+
+    if (!dbRowReserve(dynamic.table, dynamic.rows) ||
+        !dbRowReserve(packed.table, packed.rows)) {
+        fprintf(stderr, "bench: out of memory\n");
+        return 1;
+    }
+    while (dynamic.table->row_count < dynamic.rows)
+        dbRowNew(dynamic.table);
+    while (packed.table->row_count < packed.rows)
+        dbRowNew(packed.table);
+    benchRun("dbRowNew", benchRowNew, &dynamic, 100000);
+    benchRun("dbRowNew_packed", benchRowNew, &packed, 100000);
+    benchRun("dbRowDelete", benchRowDelete, &dynamic, 1000);
+    benchRun("dbRowDelete_packed", benchRowDelete, &packed, 1000);
+
+    benchRun("catalogLookup", benchCatalog, &catalog, 1000000);
+
+    /* The queue resolves its table in the context of the evaluator */
+    static const char ingest_db[64] = "ingest";
+    struct database_t *target = dbCreateNew(evGetContext(), ingest_db);
+    if (!target || !benchTable(target, ingest_db, DB_ROW_PACKED)) {
+        fprintf(stderr, "bench: unable to create the tables\n");
+        return 1;
+    }
+
+    struct bench_ingest_t ingest = {ingestOpen(ingest_db, "ingest"), 0};
+    if (!ingest.queue) {
+        fprintf(stderr, "bench: unable to open the ingest queue\n");
+        return 1;
+    }
+    benchRun("ingestSubmit", benchIngest, &ingest, 100000);
+    ingestClose(ingest.queue);
+
+    dbDelete(catalog.ctx, db);
+    free(catalog.ctx);
+    arenaRelease(&arena);
+    return 0;
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Synthetic workload run end to end through evExecute(): tables of a
+ *  given size are loaded, then a mix of point SELECT, UPDATE, INSERT and
+ *  DELETE statements picks its keys uniformly or with a Zipfian skew.
+ *  Latencies are read from the metrics registry and the report is a JSON
+ *  object on one line of stdout, what the statements print is discarded:
+ *
+ *      workload -n 100000 -o 200000 -m 80:15:5:0 -s 0.99 -i SORTED
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "db.h"
+#include "eval.h"
+#include "logs.h"
+#include "metrics.h"
+#include "prof.h"
+
+#define LOAD_BATCH 1000 /* rows of each INSERT while loading */
+
+#define OP_SELECT 0
+#define OP_UPDATE 1
+#define OP_INSERT 2
+#define OP_DELETE 3
+#define OPS 4
+
+struct workload_t {
+    size_t tables;
+    size_t rows; /* loaded in each table */
+    size_t ops;
+    unsigned mix[OPS]; /* weights of the statement kinds */
+    double skew;       /* Zipf theta, 0 for uniform keys */
+    const char *index; /* index type on 'id', NULL for none */
+    const char *row_format;
+    size_t budget; /* memory of the PACKED pages, 0 for unlimited */
+    uint64_t seed;
+};
+
+/* Keys drawn from [0, n) with P(k) proportional to 1 / (k + 1)^theta,
+ * the approximation of Gray et al. (also used by YCSB). 'n' grows with
+ * the inserts, zeta is only computed for the loaded rows */
+struct zipf_t {
+    double theta;
+    double alpha;
+    double zeta2;
+    double zetan;
+    double eta;
+};
+
+static uint64_t rng_state;
+
+/* xorshift64* */
+static uint64_t workloadRandom(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double workloadUniform(void) {
+    return (double)(workloadRandom() >> 11) / (double)(1ULL << 53);
+}
+
+static void zipfInit(struct zipf_t *zipf, double theta, size_t n) {
+    memset(zipf, 0, sizeof(*zipf));
+    zipf->theta = theta;
+    if (theta <= 0)
+        return;
+
+    for (size_t i = 1; i <= n; i++)
+        zipf->zetan += 1.0 / pow((double)i, theta);
+    zipf->zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) /
+                (1.0 - zipf->zeta2 / zipf->zetan);
+}
+
+static size_t zipfNext(const struct zipf_t *zipf, size_t n) {
+    double u = workloadUniform();
+
+    if (zipf->theta <= 0 || n < 2)
+        return (size_t)(u * (double)n);
+
+    double uz = u * zipf->zetan;
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + pow(0.5, zipf->theta))
+        return 1;
+
+    size_t key = (size_t)((double)n *
+                          pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return key < n ? key : n - 1;
+}
+
+static void workloadUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-t tables] [-n rows] [-o ops] [-m select:update:"
+            "insert:delete]\n"
+            "       [-s skew] [-i index_type|none] [-f DYNAMIC|PACKED] "
+            "[-b budget_bytes] [-r seed]\n",
+            program);
+}
+
+static int workloadParseMix(const char *text, unsigned mix[OPS]) {
+    char *end;
+
+    for (int i = 0; i < OPS; i++) {
+        mix[i] = (unsigned)strtoul(text, &end, 10);
+        if (end == text || (*end != (i == OPS - 1 ? '\0' : ':')))
+            return 0;
+        text = end + 1;
+    }
+    return mix[0] + mix[1] + mix[2] + mix[3] > 0;
+}
+
+static int workloadParse(struct workload_t *w, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        const char *flag = argv[i++];
+
+        if (!value || flag[0] != '-' || flag[2] != '\0')
+            return 0;
+
+        switch (flag[1]) {
+        case 't':
+            w->tables = strtoul(value, NULL, 10);
+            break;
+        case 'n':
+            w->rows = strtoul(value, NULL, 10);
+            break;
+        case 'o':
+            w->ops = strtoul(value, NULL, 10);
+            break;
+        case 'm':
+            if (!workloadParseMix(value, w->mix))
+                return 0;
+            break;
+        case 's':
+            w->skew = strtod(value, NULL);
+            break;
+        case 'i':
+            w->index = strcasecmp(value, "none") == 0 ? NULL : value;
+            break;
+        case 'f':
+            w->row_format = value;
+            break;
+        case 'b':
+            w->budget = strtoull(value, NULL, 10);
+            break;
+        case 'r':
+            w->seed = strtoull(value, NULL, 10);
+            break;
+        default:
+            return 0;
+        }
+    }
+    return w->tables >= 1 && w->tables <= MAX_TABLE_NUM && w->rows >= 1 &&
+           w->skew >= 0 && w->skew < 1;
+}
+
+/* Creates and fills the tables t0, t1... (id INT, k INT, v TEXT) */
+static int workloadLoad(const struct workload_t *w, char *sql, size_t size) {
+    snprintf(sql, size, "CREATE DATABASE bench;");
+    evExecute(sql);
+    snprintf(sql, size, "USE bench;");
+    evExecute(sql);
+
+    for (size_t t = 0; t < w->tables; t++) {
+        snprintf(sql, size,
+                 "CREATE TABLE t%zu (id INT, k INT, v TEXT) ROW_FORMAT = %s;",
+                 t, w->row_format);
+        evExecute(sql);
+
+        for (size_t first = 0; first < w->rows; first += LOAD_BATCH) {
+            size_t len = (size_t)snprintf(
+                sql, size, "INSERT INTO t%zu (id, k, v) VALUES ", t);
+
+            for (size_t id = first; id < w->rows && id < first + LOAD_BATCH;
+                 id++)
+                len += (size_t)snprintf(sql + len, size - len,
+                                        "%s(%zu, %zu, 'row %zu')",
+                                        id > first ? ", " : "", id, id % 1000,
+                                        id);
+            evExecute(sql);
+        }
+
+        if (w->index) {
+            snprintf(sql, size, "CREATE INDEX t%zu_id ON t%zu (id) USING %s;",
+                     t, t, w->index);
+            evExecute(sql);
+        }
+    }
+
+    struct database_t *db = evGetDatabase();
+    return db && db->table_count == w->tables &&
+           db->tables[w->tables - 1]->row_count == w->rows;
+}
+
+/* Draws the next statement of the mix */
+static int workloadNextOp(const struct workload_t *w, unsigned total) {
+    unsigned pick = (unsigned)(workloadRandom() % total);
+
+    for (int op = 0; op < OPS - 1; op++) {
+        if (pick < w->mix[op])
+            return op;
+        pick -= w->mix[op];
+    }
+    return OP_DELETE;
+}
+
+static void workloadRun(const struct workload_t *w, char *sql, size_t size) {
+    struct zipf_t zipf;
+    size_t next_id[MAX_TABLE_NUM];
+    unsigned total = w->mix[0] + w->mix[1] + w->mix[2] + w->mix[3];
+
+    zipfInit(&zipf, w->skew, w->rows);
+    for (size_t t = 0; t < w->tables; t++)
+        next_id[t] = w->rows;
+
+    for (size_t i = 0; i < w->ops; i++) {
+        size_t t = (size_t)(workloadRandom() % w->tables);
+        size_t id = zipfNext(&zipf, next_id[t]);
+
+        switch (workloadNextOp(w, total)) {
+        case OP_SELECT:
+            snprintf(sql, size, "SELECT id, k, v FROM t%zu WHERE id = %zu;",
+                     t, id);
+            break;
+        case OP_UPDATE:
+            snprintf(sql, size, "UPDATE t%zu SET k = %zu WHERE id = %zu;", t,
+                     i % 1000, id);
+            break;
+        case OP_INSERT:
+            id = next_id[t]++;
+            snprintf(sql, size,
+                     "INSERT INTO t%zu (id, k, v) VALUES (%zu, %zu, "
+                     "'row %zu');",
+                     t, id, id % 1000, id);
+            break;
+        default:
+            snprintf(sql, size, "DELETE FROM t%zu WHERE id = %zu;", t, id);
+            break;
+        }
+        evExecute(sql);
+    }
+}
+
+/* 'after' - 'before', the statements of the run alone */
+static void workloadDelta(struct metrics_snapshot_t *after,
+                          const struct metrics_snapshot_t *before) {
+    for (int i = 0; i < METRIC_COUNTERS; i++)
+        after->counters[i] -= before->counters[i];
+
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        after->count[t] -= before->count[t];
+        after->sum[t] -= before->sum[t];
+        for (size_t b = 0; b < METRICS_BUCKETS; b++)
+            after->buckets[t][b] -= before->buckets[t][b];
+    }
+}
+
+static void workloadReport(FILE *out, const struct workload_t *w,
+                           const struct metrics_snapshot_t *run,
+                           struct metrics_snapshot_t *all, uint64_t load,
+                           uint64_t elapsed) {
+    double seconds = profMicros(elapsed) / 1e6;
+
+    /* Every statement type merged in the histogram of the first one */
+    memset(all, 0, sizeof(*all));
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        all->count[0] += run->count[t];
+        for (size_t b = 0; b < METRICS_BUCKETS; b++)
+            all->buckets[0][b] += run->buckets[t][b];
+    }
+
+    fprintf(out,
+            "{\"workload\": {\"tables\": %zu, \"rows\": %zu, \"ops\": %zu, "
+            "\"mix\": \"%u:%u:%u:%u\", \"skew\": %.3f, \"index\": \"%s\", "
+            "\"row_format\": \"%s\", \"budget\": %zu, \"seed\": %llu}, ",
+            w->tables, w->rows, w->ops, w->mix[0], w->mix[1], w->mix[2],
+            w->mix[3], w->skew, w->index ? w->index : "none", w->row_format,
+            w->budget, (unsigned long long)w->seed);
+
+    fprintf(out,
+            "\"load_seconds\": %.3f, \"run_seconds\": %.3f, "
+            "\"throughput_ops_per_sec\": %.0f, ",
+            profMicros(load) / 1e6, seconds,
+            seconds > 0 ? (double)w->ops / seconds : 0.0);
+    fprintf(out,
+            "\"latency_us\": {\"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f}, ",
+            profMicros(metricsQuantile(all, 0, 0.5)),
+            profMicros(metricsQuantile(all, 0, 0.99)),
+            profMicros(metricsQuantile(all, 0, 1.0)));
+
+    fprintf(out, "\"statements\": {");
+    const char *separator = "";
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        if (!run->count[t])
+            continue;
+        fprintf(out,
+                "%s\"%s\": {\"count\": %llu, \"p50_us\": %.2f, "
+                "\"p99_us\": %.2f}",
+                separator, metricsStatementName(t),
+                (unsigned long long)run->count[t],
+                profMicros(metricsQuantile(run, t, 0.5)),
+                profMicros(metricsQuantile(run, t, 0.99)));
+        separator = ", ";
+    }
+
+    uint64_t hits = run->counters[METRIC_CACHE_HITS];
+    uint64_t lookups = hits + run->counters[METRIC_CACHE_MISSES];
+    fprintf(out,
+            "}, \"rows_scanned\": %llu, \"plan_cache_hit_rate\": %.3f, "
+            "\"pages_faulted\": %llu, \"database_bytes\": %zu}\n",
+            (unsigned long long)run->counters[METRIC_ROWS_SCANNED],
+            lookups ? (double)hits / (double)lookups : 0.0,
+            (unsigned long long)run->counters[METRIC_PAGES_FAULTED],
+            dbDatabaseBytes(evGetDatabase()));
+}
+
+int main(int argc, char **argv) {
+    struct workload_t w = {
+        .tables = 1,
+        .rows = 100000,
+        .ops = 100000,
+        .mix = {80, 15, 5, 0},
+        .skew = 0.99,
+        .index = "SORTED",
+        .row_format = "DYNAMIC",
+        .seed = 1,
+    };
+
+    if (!workloadParse(&w, argc, argv)) {
+        workloadUsage(argv[0]);
+        return 1;
+    }
+    rng_state = w.seed ? w.seed : 1;
+    if (w.budget && !bufferConfigure(w.budget, NULL))
+        return 1;
+
+    /* The report keeps the real stdout, the rows and the log lines the
+     * statements print go to /dev/null */
+    int fd = dup(STDOUT_FILENO);
+    FILE *out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "workload: unable to redirect stdout\n");
+        return 1;
+    }
+
+    size_t size = LOAD_BATCH * 64 + 256;
+    char *sql = malloc(size);
+    struct metrics_snapshot_t *before = malloc(sizeof(*before));
+    struct metrics_snapshot_t *after = malloc(sizeof(*after));
+    struct metrics_snapshot_t *all = malloc(sizeof(*all));
+    if (!sql || !before || !after || !all) {
+        fprintf(stderr, "workload: out of memory\n");
+        return 1;
+    }
+
+    uint64_t start = profNow();
+    if (!workloadLoad(&w, sql, size)) {
+        logFlush();
+        fprintf(stderr, "workload: unable to load the tables\n");
+        return 1;
+    }
+    uint64_t load = profNow() - start;
+
+    metricsSnapshot(before);
+    start = profNow();
+    workloadRun(&w, sql, size);
+    uint64_t elapsed = profNow() - start;
+    metricsSnapshot(after);
+    workloadDelta(after, before);
+
+    logFlush();
+    workloadReport(out, &w, after, all, load, elapsed);
+    fclose(out);
+
+    free(all);
+    free(after);
+    free(before);
+    free(sql);
+    return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "api.h"
+#include "buffer.h"
+#include "cache.h"
+#include "eval.h"
+#include "logs.h"
+#include "plan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct rsql_stmt {
+    struct arena_t arena;    /* statement text and fingerprint */
+    char *sql;               /* private copy, literal parameters point here */
+    struct fingerprint_t fp; /* normalized text and its parameters */
+    struct plan_t *plan;
+
+    /* Index in fp.params of every '?' written by the user, the literals
+     * of the statement text fill the other parameters */
+    size_t *slots;
+    size_t slot_count;
+
+    char **texts; /* owned copy of the text bound to each slot */
+
+    /* Rows of the last execution of a SELECT, 'row' of them were handed
+     * out so far while 'pending' */
+    struct ev_result_t result;
+    size_t row;
+    int pending;
+    char number[16]; /* rsql_column_text() of an INT value */
+};
+
+/* (Re)compile the statement, needed after a catalog change */
+static int rsqlCompile(rsql_stmt *stmt) {
+    planFree(stmt->plan);
+    stmt->plan = evCompile(stmt->fp.text);
+    return stmt->plan ? RSQL_OK : RSQL_ERR;
+}
+
+int rsql_prepare(const char *sql, rsql_stmt **stmt) {
+    if (!sql || !stmt)
+        return RSQL_ERR;
+
+    *stmt = NULL;
+
+    rsql_stmt *new_stmt = malloc(sizeof(rsql_stmt));
+    if (!new_stmt)
+        return RSQL_ERR;
+
+    memset(new_stmt, 0, sizeof(rsql_stmt));
+    arenaInit(&new_stmt->arena);
+    new_stmt->sql = arenaStrdup(&new_stmt->arena, sql);
+    if (!new_stmt->sql ||
+        !cacheFingerprint(new_stmt->sql, &new_stmt->fp, &new_stmt->arena))
+        goto cleanup;
+
+    struct fingerprint_t *fp = &new_stmt->fp;
+    for (size_t i = 0; i < fp->param_count; i++) {
+        if (fp->params[i].type == PLAN_PARAM_UNBOUND)
+            new_stmt->slot_count++;
+    }
+
+    if (new_stmt->slot_count) {
+        new_stmt->slots =
+            arenaAlloc(&new_stmt->arena, new_stmt->slot_count * sizeof(size_t));
+        new_stmt->texts = calloc(new_stmt->slot_count, sizeof(char *));
+        if (!new_stmt->slots || !new_stmt->texts)
+            goto cleanup;
+
+        size_t slot = 0;
+        for (size_t i = 0; i < fp->param_count; i++) {
+            if (fp->params[i].type == PLAN_PARAM_UNBOUND)
+                new_stmt->slots[slot++] = i;
+        }
+    }
+
+    evLock();
+    int compiled = rsqlCompile(new_stmt);
+    evUnlock();
+    if (compiled != RSQL_OK)
+        goto cleanup;
+
+    *stmt = new_stmt;
+    return RSQL_OK;
+
+cleanup:
+    rsql_finalize(new_stmt);
+    return RSQL_ERR;
+}
+
+/* Returns the parameter behind the 1-based placeholder 'index' */
+static struct plan_param_t *rsqlSlot(rsql_stmt *stmt, int index) {
+    if (!stmt || index < 1 || (size_t)index > stmt->slot_count) {
+        LOG_ERROR("Parameter index %d out of range", index);
+        return NULL;
+    }
+    return &stmt->fp.params[stmt->slots[index - 1]];
+}
+
+int rsql_bind_int(rsql_stmt *stmt, int index, int value) {
+    struct plan_param_t *param = rsqlSlot(stmt, index);
+    if (!param)
+        return RSQL_ERR;
+
+    stmt->pending = 0;
+    param->type = PLAN_PARAM_INT;
+    param->i = value;
+    param->s = NULL;
+    param->len = 0;
+    param->escaped = 0;
+    return RSQL_OK;
+}
+
+/* The text is copied, a negative 'len' means it is NUL terminated */
+int rsql_bind_text(rsql_stmt *stmt, int index, const char *text, int len) {
+    struct plan_param_t *param = rsqlSlot(stmt, index);
+    if (!param || !text)
+        return RSQL_ERR;
+
+    size_t n = len < 0 ? strlen(text) : (size_t)len;
+    char **copy = &stmt->texts[index - 1];
+    char *buffer = realloc(*copy, n + 1);
+    if (!buffer)
+        return RSQL_ERR;
+
+    memcpy(buffer, text, n);
+    buffer[n] = '\0';
+    *copy = buffer;
+
+    stmt->pending = 0;
+    param->type = PLAN_PARAM_TEXT;
+    param->i = 0;
+    param->s = buffer;
+    param->len = n;
+    param->escaped = 0;
+    return RSQL_OK;
+}
+
+/* Hands out the next row of a SELECT, or executes the statement with the
+ * current bindings, which are kept for the next execution until they are
+ * bound again. Binding a parameter drops the rows not read yet */
+int rsql_step(rsql_stmt *stmt) {
+    if (!stmt)
+        return RSQL_ERR;
+
+    if (stmt->pending) {
+        if (stmt->row < stmt->result.row_count) {
+            stmt->row++;
+            return RSQL_ROW;
+        }
+        stmt->pending = 0;
+        evQueryDone(&stmt->result);
+        return RSQL_DONE;
+    }
+
+    evLock();
+    int ok = 0, select = 0;
+    if ((stmt->plan && stmt->plan->catalog_version == dbCatalogVersion()) ||
+        rsqlCompile(stmt) == RSQL_OK) {
+        select = stmt->plan->kind == PLAN_SELECT;
+        ok = select ? evQuery(stmt->plan, stmt->fp.params,
+                              stmt->fp.param_count, &stmt->result)
+                    : evExecutePlan(stmt->plan, stmt->fp.params,
+                                    stmt->fp.param_count);
+    }
+
+    bufferStatementEnd();
+    evUnlock();
+    if (!ok)
+        return RSQL_ERR;
+    if (!select)
+        return RSQL_DONE;
+
+    stmt->pending = 1;
+    stmt->row = 0;
+    return rsql_step(stmt);
+}
+
+int rsql_param_count(rsql_stmt *stmt) {
+    return stmt ? (int)stmt->slot_count : 0;
+}
+
+int rsql_column_count(rsql_stmt *stmt) {
+    return stmt ? (int)stmt->result.column_count : 0;
+}
+
+const char *rsql_column_name(rsql_stmt *stmt, int column) {
+    if (!stmt || column < 0 || column >= rsql_column_count(stmt)) {
+        LOG_ERROR("Column index %d out of range", column);
+        return NULL;
+    }
+    return stmt->result.names[column];
+}
+
+/* Value of 'column' in the row handed out by the last step */
+static const union ev_value_t *rsqlValue(rsql_stmt *stmt, int column) {
+    if (!stmt || !stmt->pending || !stmt->row) {
+        LOG_ERROR("No row to read");
+        return NULL;
+    }
+    if (column < 0 || column >= rsql_column_count(stmt)) {
+        LOG_ERROR("Column index %d out of range", column);
+        return NULL;
+    }
+    return &stmt->result
+                .values[(stmt->row - 1) * stmt->result.column_count + column];
+}
+
+int rsql_column_int(rsql_stmt *stmt, int column) {
+    const union ev_value_t *value = rsqlValue(stmt, column);
+    if (!value || stmt->result.types[column] != DB_TYPE_INT)
+        return 0;
+    return value->i;
+}
+
+/* Valid until the next step, the text of an INT value only until the
+ * next call */
+const char *rsql_column_text(rsql_stmt *stmt, int column) {
+    const union ev_value_t *value = rsqlValue(stmt, column);
+    if (!value)
+        return NULL;
+
+    if (stmt->result.types[column] == DB_TYPE_INT) {
+        snprintf(stmt->number, sizeof(stmt->number), "%d", value->i);
+        return stmt->number;
+    }
+    return stmt->result.text + value->text;
+}
+
+void rsql_finalize(rsql_stmt *stmt) {
+    if (!stmt)
+        return;
+
+    for (size_t i = 0; stmt->texts && i < stmt->slot_count; i++)
+        free(stmt->texts[i]);
+
+    free(stmt->texts);
+    evResultRelease(&stmt->result);
+    planFree(stmt->plan);
+    arenaRelease(&stmt->arena);
+    free(stmt);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Prepared statement API. A statement is compiled once by rsql_prepare(),
+ *  its '?' placeholders (numbered from 1) are bound with typed values and
+ *  rsql_step() runs the compiled plan, so repeated executions only pay
+ *  for execution:
+ *
+ *      rsql_stmt *stmt;
+ *      rsql_prepare("INSERT INTO users (id, name) VALUES (?, ?);", &stmt);
+ *      rsql_bind_int(stmt, 1, 42);
+ *      rsql_bind_text(stmt, 2, "Marco", -1);
+ *      rsql_step(stmt);
+ *      rsql_finalize(stmt);
+ *
+ *  A SELECT returns its rows one per step, the columns (numbered from 0)
+ *  of the current one are read until the next step:
+ *
+ *      rsql_prepare("SELECT id, name FROM users WHERE id < ?;", &stmt);
+ *      rsql_bind_int(stmt, 1, 100);
+ *      while (rsql_step(stmt) == RSQL_ROW)
+ *          printf("%d %s\n", rsql_column_int(stmt, 0),
+ *                 rsql_column_text(stmt, 1));
+ *
+ *  Functions return RSQL_OK or RSQL_ERR (see lex.h). Statements resolve
+ *  their tables in the database selected with 'USE' and are compiled again
+ *  transparently when the catalog changes.
+ */
+#ifndef _API_H
+#define _API_H
+
+#include "lex.h"
+
+/* What rsql_step() returns besides RSQL_ERR */
+#define RSQL_ROW 2  /* a row of the SELECT is ready */
+#define RSQL_DONE 3 /* the statement ran, or the SELECT has no more rows */
+
+typedef struct rsql_stmt rsql_stmt;
+
+int rsql_prepare(const char *sql, rsql_stmt **stmt);
+int rsql_bind_int(rsql_stmt *stmt, int index, int value);
+int rsql_bind_text(rsql_stmt *stmt, int index, const char *text, int len);
+int rsql_step(rsql_stmt *stmt);
+int rsql_param_count(rsql_stmt *stmt);
+void rsql_finalize(rsql_stmt *stmt);
+
+/* Columns of the rows of a SELECT once it was stepped, 0 otherwise */
+int rsql_column_count(rsql_stmt *stmt);
+const char *rsql_column_name(rsql_stmt *stmt, int column);
+
+/* Value of the current row. An INT column is also read as text, a TEXT
+ * column reads as 0 */
+int rsql_column_int(rsql_stmt *stmt, int column);
+const char *rsql_column_text(rsql_stmt *stmt, int column);
+
+#endif /* _API_H */
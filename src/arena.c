@@ -0,0 +1,95 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN(size) (((size) + 15) & ~(size_t)15)
+
+void arenaInit(struct arena_t *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+/* Blocks after 'current' belong to a previous statement, they are
+ * recycled in order and a new block is appended only when none fits */
+void *arenaAlloc(struct arena_t *arena, size_t size) {
+    size = ARENA_ALIGN(size ? size : 1);
+
+    struct arena_block_t *block = arena->current;
+    struct arena_block_t *last = block;
+
+    while (block && block->used + size > block->size) {
+        last = block;
+        block = block->next;
+        if (block)
+            block->used = 0;
+    }
+
+    if (!block) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(struct arena_block_t) + capacity);
+        if (!block)
+            return NULL;
+
+        block->next = NULL;
+        block->size = capacity;
+        block->used = 0;
+
+        if (last)
+            last->next = block;
+        else
+            arena->first = block;
+    }
+
+    arena->current = block;
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char *arenaStrndup(struct arena_t *arena, const char *text, size_t len) {
+    char *copy = arenaAlloc(arena, len + 1);
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *arenaStrdup(struct arena_t *arena, const char *text) {
+    return arenaStrndup(arena, text, strlen(text));
+}
+
+void arenaReset(struct arena_t *arena) {
+    arena->current = arena->first;
+    if (arena->first)
+        arena->first->used = 0;
+}
+
+void arenaRelease(struct arena_t *arena) {
+    struct arena_block_t *block = arena->first;
+
+    while (block) {
+        struct arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arenaInit(arena);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Bump allocator for memory that lives as long as a statement: the AST,
+ *  the parser state and the executor scratch space. Nothing is released
+ *  individually, arenaReset() makes the whole arena available again in
+ *  O(1) while keeping its blocks for the next statement.
+ */
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/* Default size of a block, bigger requests get a block of their own */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct arena_block_t {
+    struct arena_block_t *next;
+    size_t size;
+    size_t used;
+    _Alignas(16) unsigned char data[];
+};
+
+/* A zero initialized arena is valid and empty */
+struct arena_t {
+    struct arena_block_t *first;
+    struct arena_block_t *current;
+};
+
+void arenaInit(struct arena_t *arena);
+void *arenaAlloc(struct arena_t *arena, size_t size);
+char *arenaStrdup(struct arena_t *arena, const char *text);
+char *arenaStrndup(struct arena_t *arena, const char *text, size_t len);
+void arenaReset(struct arena_t *arena);
+void arenaRelease(struct arena_t *arena);
+
+#endif /* _ARENA_H */
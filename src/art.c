@@ -0,0 +1,680 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "art.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define ART_IS_LEAF(p) ((uintptr_t)(p) & 1)
+#define ART_LEAF(p) ((struct art_leaf_t *)((uintptr_t)(p) & ~(uintptr_t)1))
+#define ART_TAG(leaf) ((void *)((uintptr_t)(leaf) | 1))
+
+/* State of a range scan, a prefix scan has 'hi' as its prefix */
+struct art_walk_t {
+    const struct art_bound_t *lo;
+    const struct art_bound_t *hi;
+    int hi_prefix;
+    art_visit_t visit;
+    void *data;
+};
+
+static size_t artMin(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+static struct art_leaf_t *artNewLeaf(const unsigned char *key, size_t len,
+                                     uint32_t row) {
+    struct art_leaf_t *leaf = malloc(sizeof(struct art_leaf_t) + len);
+    if (!leaf)
+        return NULL;
+
+    leaf->rows = malloc(4 * sizeof(uint32_t));
+    if (!leaf->rows) {
+        free(leaf);
+        return NULL;
+    }
+
+    leaf->rows[0] = row;
+    leaf->count = 1;
+    leaf->capacity = 4;
+    leaf->key_len = len;
+    memcpy(leaf->key, key, len);
+    return leaf;
+}
+
+/* Rows mostly come in increasing order, the others are inserted where
+ * they belong */
+static int artLeafAdd(struct art_leaf_t *leaf, uint32_t row) {
+    size_t at = leaf->count;
+
+    if (at && leaf->rows[at - 1] >= row) {
+        size_t lo = 0;
+        while (lo < at) {
+            size_t mid = lo + (at - lo) / 2;
+            if (leaf->rows[mid] < row)
+                lo = mid + 1;
+            else
+                at = mid;
+        }
+        if (leaf->rows[at] == row)
+            return 1;
+    }
+
+    if (leaf->count == leaf->capacity) {
+        uint32_t capacity = leaf->capacity * 2;
+        uint32_t *rows = realloc(leaf->rows, capacity * sizeof(uint32_t));
+        if (!rows)
+            return 0;
+        leaf->rows = rows;
+        leaf->capacity = capacity;
+    }
+    memmove(leaf->rows + at + 1, leaf->rows + at,
+            (leaf->count - at) * sizeof(uint32_t));
+    leaf->rows[at] = row;
+    leaf->count++;
+    return 1;
+}
+
+static int artLeafMatches(const struct art_leaf_t *leaf,
+                          const unsigned char *key, size_t len) {
+    return leaf->key_len == len && memcmp(leaf->key, key, len) == 0;
+}
+
+static struct art_node_t *artNewNode(uint8_t type) {
+    size_t size;
+
+    switch (type) {
+    case ART_NODE4:
+        size = sizeof(struct art_node4_t);
+        break;
+    case ART_NODE16:
+        size = sizeof(struct art_node16_t);
+        break;
+    case ART_NODE48:
+        size = sizeof(struct art_node48_t);
+        break;
+    default:
+        size = sizeof(struct art_node256_t);
+        break;
+    }
+
+    struct art_node_t *node = calloc(1, size);
+    if (node)
+        node->type = type;
+    return node;
+}
+
+static void artFree(void *node) {
+    if (!node)
+        return;
+
+    if (ART_IS_LEAF(node)) {
+        free(ART_LEAF(node)->rows);
+        free(ART_LEAF(node));
+        return;
+    }
+
+    struct art_node_t *n = node;
+    switch (n->type) {
+    case ART_NODE4:
+        for (size_t i = 0; i < n->child_count; i++)
+            artFree(((struct art_node4_t *)n)->children[i]);
+        break;
+    case ART_NODE16:
+        for (size_t i = 0; i < n->child_count; i++)
+            artFree(((struct art_node16_t *)n)->children[i]);
+        break;
+    case ART_NODE48:
+        for (size_t i = 0; i < n->child_count; i++)
+            artFree(((struct art_node48_t *)n)->children[i]);
+        break;
+    default:
+        for (size_t i = 0; i < 256; i++)
+            artFree(((struct art_node256_t *)n)->children[i]);
+        break;
+    }
+    free(n);
+}
+
+void artRelease(struct art_t *tree) {
+    artFree(tree->root);
+    tree->root = NULL;
+    tree->leaf_count = 0;
+}
+
+static void artEach(void *node, art_update_t update, void *data) {
+    if (!node)
+        return;
+
+    if (ART_IS_LEAF(node)) {
+        update(ART_LEAF(node), data);
+        return;
+    }
+
+    struct art_node_t *n = node;
+    switch (n->type) {
+    case ART_NODE4:
+        for (size_t i = 0; i < n->child_count; i++)
+            artEach(((struct art_node4_t *)n)->children[i], update, data);
+        break;
+    case ART_NODE16:
+        for (size_t i = 0; i < n->child_count; i++)
+            artEach(((struct art_node16_t *)n)->children[i], update, data);
+        break;
+    case ART_NODE48:
+        for (size_t i = 0; i < n->child_count; i++)
+            artEach(((struct art_node48_t *)n)->children[i], update, data);
+        break;
+    default:
+        for (size_t i = 0; i < 256; i++)
+            artEach(((struct art_node256_t *)n)->children[i], update, data);
+        break;
+    }
+}
+
+void artUpdate(struct art_t *tree, art_update_t update, void *data) {
+    artEach(tree->root, update, data);
+}
+
+/* Slot of the child for 'byte', NULL when there is none */
+static void **artFindChild(struct art_node_t *n, unsigned char byte) {
+    switch (n->type) {
+    case ART_NODE4: {
+        struct art_node4_t *n4 = (struct art_node4_t *)n;
+        for (size_t i = 0; i < n->child_count; i++) {
+            if (n4->keys[i] == byte)
+                return &n4->children[i];
+        }
+        return NULL;
+    }
+    case ART_NODE16: {
+        struct art_node16_t *n16 = (struct art_node16_t *)n;
+#if defined(__SSE2__)
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte),
+                                     _mm_loadu_si128((__m128i *)n16->keys));
+        int mask = _mm_movemask_epi8(cmp) & ((1 << n->child_count) - 1);
+        return mask ? &n16->children[__builtin_ctz((unsigned)mask)] : NULL;
+#else
+        for (size_t i = 0; i < n->child_count; i++) {
+            if (n16->keys[i] == byte)
+                return &n16->children[i];
+        }
+        return NULL;
+#endif
+    }
+    case ART_NODE48: {
+        struct art_node48_t *n48 = (struct art_node48_t *)n;
+        return n48->index[byte] ? &n48->children[n48->index[byte] - 1] : NULL;
+    }
+    default: {
+        struct art_node256_t *n256 = (struct art_node256_t *)n;
+        return n256->children[byte] ? &n256->children[byte] : NULL;
+    }
+    }
+}
+
+/* Position of 'byte' among the sorted keys of a small node */
+static size_t artInsertPosition(const unsigned char *keys, size_t count,
+                                unsigned char byte) {
+#if defined(__SSE2__)
+    if (count > 4) {
+        /* Unsigned compare through the signed one, flipping the sign bit */
+        __m128i flip = _mm_set1_epi8((char)0x80);
+        __m128i lt = _mm_cmplt_epi8(
+            _mm_xor_si128(_mm_set1_epi8((char)byte), flip),
+            _mm_xor_si128(_mm_loadu_si128((const __m128i *)keys), flip));
+        int mask = _mm_movemask_epi8(lt) & ((1 << count) - 1);
+        return mask ? (size_t)__builtin_ctz((unsigned)mask) : count;
+    }
+#endif
+    size_t i = 0;
+    while (i < count && keys[i] < byte)
+        i++;
+    return i;
+}
+
+static void artInsertSorted(unsigned char *keys, void **children,
+                            size_t count, unsigned char byte, void *child) {
+    size_t at = artInsertPosition(keys, count, byte);
+
+    memmove(keys + at + 1, keys + at, count - at);
+    memmove(children + at + 1, children + at, (count - at) * sizeof(void *));
+    keys[at] = byte;
+    children[at] = child;
+}
+
+/* Replace the full node '*ref' by the next larger node type */
+static struct art_node_t *artGrow(void **ref) {
+    struct art_node_t *n = *ref;
+    struct art_node_t *bigger = artNewNode(n->type + 1);
+    if (!bigger)
+        return NULL;
+
+    memcpy(bigger, n, sizeof(struct art_node_t));
+    bigger->type = n->type + 1;
+
+    switch (n->type) {
+    case ART_NODE4: {
+        struct art_node4_t *from = (struct art_node4_t *)n;
+        struct art_node16_t *to = (struct art_node16_t *)bigger;
+        memcpy(to->keys, from->keys, sizeof(from->keys));
+        memcpy(to->children, from->children, sizeof(from->children));
+        break;
+    }
+    case ART_NODE16: {
+        struct art_node16_t *from = (struct art_node16_t *)n;
+        struct art_node48_t *to = (struct art_node48_t *)bigger;
+        for (size_t i = 0; i < n->child_count; i++) {
+            to->index[from->keys[i]] = (unsigned char)(i + 1);
+            to->children[i] = from->children[i];
+        }
+        break;
+    }
+    default: {
+        struct art_node48_t *from = (struct art_node48_t *)n;
+        struct art_node256_t *to = (struct art_node256_t *)bigger;
+        for (size_t b = 0; b < 256; b++) {
+            if (from->index[b])
+                to->children[b] = from->children[from->index[b] - 1];
+        }
+        break;
+    }
+    }
+
+    free(n);
+    *ref = bigger;
+    return bigger;
+}
+
+static int artAddChild(void **ref, unsigned char byte, void *child) {
+    struct art_node_t *n = *ref;
+
+    if ((n->type == ART_NODE4 && n->child_count == 4) ||
+        (n->type == ART_NODE16 && n->child_count == 16) ||
+        (n->type == ART_NODE48 && n->child_count == 48)) {
+        if (!(n = artGrow(ref)))
+            return 0;
+    }
+
+    switch (n->type) {
+    case ART_NODE4: {
+        struct art_node4_t *n4 = (struct art_node4_t *)n;
+        artInsertSorted(n4->keys, n4->children, n->child_count, byte, child);
+        break;
+    }
+    case ART_NODE16: {
+        struct art_node16_t *n16 = (struct art_node16_t *)n;
+        artInsertSorted(n16->keys, n16->children, n->child_count, byte,
+                        child);
+        break;
+    }
+    case ART_NODE48: {
+        struct art_node48_t *n48 = (struct art_node48_t *)n;
+        n48->children[n->child_count] = child;
+        n48->index[byte] = (unsigned char)(n->child_count + 1);
+        break;
+    }
+    default:
+        ((struct art_node256_t *)n)->children[byte] = child;
+        break;
+    }
+    n->child_count++;
+    return 1;
+}
+
+/* First child in key order */
+static void *artFirstChild(const struct art_node_t *n) {
+    switch (n->type) {
+    case ART_NODE4:
+        return ((const struct art_node4_t *)n)->children[0];
+    case ART_NODE16:
+        return ((const struct art_node16_t *)n)->children[0];
+    case ART_NODE48: {
+        const struct art_node48_t *n48 = (const struct art_node48_t *)n;
+        size_t b = 0;
+        while (!n48->index[b])
+            b++;
+        return n48->children[n48->index[b] - 1];
+    }
+    default: {
+        const struct art_node256_t *n256 = (const struct art_node256_t *)n;
+        size_t b = 0;
+        while (!n256->children[b])
+            b++;
+        return n256->children[b];
+    }
+    }
+}
+
+/* Smallest leaf below 'node', it holds the full prefix of every node on
+ * the way */
+static const struct art_leaf_t *artMinLeaf(const void *node) {
+    while (!ART_IS_LEAF(node))
+        node = artFirstChild(node);
+    return ART_LEAF(node);
+}
+
+/* Prefix of 'n' at 'depth', read from a leaf when it is not all stored */
+static const unsigned char *artPrefixBytes(const struct art_node_t *n,
+                                           size_t depth) {
+    if (n->prefix_len <= ART_MAX_PREFIX)
+        return n->prefix;
+    return artMinLeaf(n)->key + depth;
+}
+
+/* Length of the common part of the prefix of 'n' and 'key' at 'depth' */
+static size_t artPrefixMismatch(const struct art_node_t *n,
+                                const unsigned char *key, size_t len,
+                                size_t depth) {
+    size_t max = artMin(n->prefix_len, len - depth);
+    const unsigned char *prefix = artPrefixBytes(n, depth);
+    size_t i = 0;
+
+    while (i < max && prefix[i] == key[depth + i])
+        i++;
+    return i;
+}
+
+/* Split the leaf '*ref' into a node holding it and a new leaf for 'key',
+ * at the first byte where the keys differ */
+static int artSplitLeaf(void **ref, const unsigned char *key, size_t len,
+                        size_t depth, struct art_leaf_t *leaf) {
+    const struct art_leaf_t *old = ART_LEAF(*ref);
+    struct art_node_t *n = artNewNode(ART_NODE4);
+    if (!n)
+        return 0;
+
+    size_t common = 0;
+    size_t max = artMin(old->key_len, len) - depth;
+    while (common < max && old->key[depth + common] == key[depth + common])
+        common++;
+
+    n->prefix_len = (uint32_t)common;
+    memcpy(n->prefix, key + depth, artMin(common, ART_MAX_PREFIX));
+
+    /* Keys are never prefixes of each other, both have a next byte. A
+     * node with room for its children never fails to add them */
+    void *node = n;
+    artAddChild(&node, old->key[depth + common], *ref);
+    artAddChild(&node, key[depth + common], ART_TAG(leaf));
+    *ref = node;
+    return 1;
+}
+
+/* Split the prefix of the node '*ref' after its first 'common' bytes */
+static int artSplitPrefix(void **ref, const unsigned char *key, size_t depth,
+                          size_t common, struct art_leaf_t *leaf) {
+    struct art_node_t *old = *ref;
+    struct art_node_t *n = artNewNode(ART_NODE4);
+    if (!n)
+        return 0;
+
+    n->prefix_len = (uint32_t)common;
+    memcpy(n->prefix, old->prefix, artMin(common, ART_MAX_PREFIX));
+
+    /* The old node keeps what follows its branching byte */
+    const unsigned char *prefix = artPrefixBytes(old, depth);
+    unsigned char byte = prefix[common];
+    size_t rest = old->prefix_len - common - 1;
+    memmove(old->prefix, prefix + common + 1, artMin(rest, ART_MAX_PREFIX));
+    old->prefix_len = (uint32_t)rest;
+
+    void *node = n;
+    artAddChild(&node, byte, old);
+    artAddChild(&node, key[depth + common], ART_TAG(leaf));
+    *ref = node;
+    return 1;
+}
+
+int artInsert(struct art_t *tree, const unsigned char *key, size_t len,
+              uint32_t row) {
+    void **ref = &tree->root;
+    size_t depth = 0, common = 0;
+
+    /* Find where the key belongs, leaving 'depth' at '*ref' and 'common'
+     * at the prefix bytes of '*ref' it shares */
+    while (*ref && !ART_IS_LEAF(*ref)) {
+        struct art_node_t *n = *ref;
+
+        common = artPrefixMismatch(n, key, len, depth);
+        if (common < n->prefix_len)
+            break;
+
+        void **child = artFindChild(n, key[depth + n->prefix_len]);
+        if (!child)
+            break;
+        ref = child;
+        depth += n->prefix_len + 1;
+    }
+
+    if (*ref && ART_IS_LEAF(*ref) && artLeafMatches(ART_LEAF(*ref), key, len))
+        return artLeafAdd(ART_LEAF(*ref), row);
+
+    struct art_leaf_t *leaf = artNewLeaf(key, len, row);
+    if (!leaf)
+        return 0;
+
+    int ok;
+    if (!*ref) {
+        *ref = ART_TAG(leaf);
+        ok = 1;
+    } else if (ART_IS_LEAF(*ref)) {
+        ok = artSplitLeaf(ref, key, len, depth, leaf);
+    } else {
+        struct art_node_t *n = *ref;
+        if (common < n->prefix_len)
+            ok = artSplitPrefix(ref, key, depth, common, leaf);
+        else
+            ok = artAddChild(ref, key[depth + n->prefix_len], ART_TAG(leaf));
+    }
+
+    if (!ok) {
+        free(leaf->rows);
+        free(leaf);
+        return 0;
+    }
+    tree->leaf_count++;
+    return 1;
+}
+
+const struct art_leaf_t *artSearch(const struct art_t *tree,
+                                   const unsigned char *key, size_t len) {
+    void *node = tree->root;
+    size_t depth = 0;
+
+    while (node) {
+        if (ART_IS_LEAF(node)) {
+            const struct art_leaf_t *leaf = ART_LEAF(node);
+            return artLeafMatches(leaf, key, len) ? leaf : NULL;
+        }
+
+        /* Only the stored part of the prefix is checked, the leaf
+         * comparison catches a mismatch in the rest */
+        struct art_node_t *n = node;
+        size_t stored = artMin(n->prefix_len, ART_MAX_PREFIX);
+        if (n->prefix_len >= len - depth ||
+            memcmp(n->prefix, key + depth, stored) != 0)
+            return NULL;
+        depth += n->prefix_len;
+
+        void **child = artFindChild(n, key[depth]);
+        node = child ? *child : NULL;
+        depth++;
+    }
+    return NULL;
+}
+
+static int artCompareKeys(const unsigned char *a, size_t a_len,
+                          const unsigned char *b, size_t b_len) {
+    int cmp = memcmp(a, b, artMin(a_len, b_len));
+    if (cmp)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/* Compare 'len' key bytes at 'depth' with the same bytes of a bound. A
+ * bound ending in between is a prefix of the keys below, which come
+ * after it unless it is the prefix of a prefix scan */
+static int artCompareBound(const unsigned char *bytes, size_t len,
+                           const struct art_bound_t *bound, size_t depth,
+                           int prefix) {
+    size_t n = bound->len > depth ? artMin(len, bound->len - depth) : 0;
+    int cmp = memcmp(bytes, bound->key + depth, n);
+
+    if (cmp || n == len)
+        return cmp;
+    return prefix ? -1 : 1;
+}
+
+/* Visit a leaf lying between the bounds, returns 0 once past 'hi' */
+static int artVisitLeaf(const struct art_walk_t *w,
+                        const struct art_leaf_t *leaf) {
+    if (w->lo) {
+        int cmp = artCompareKeys(leaf->key, leaf->key_len, w->lo->key,
+                                 w->lo->len);
+        if (cmp < 0 || (cmp == 0 && !w->lo->inclusive))
+            return 1;
+    }
+
+    if (w->hi && w->hi_prefix) {
+        if (leaf->key_len < w->hi->len ||
+            memcmp(leaf->key, w->hi->key, w->hi->len) != 0)
+            return 0;
+    } else if (w->hi) {
+        int cmp = artCompareKeys(leaf->key, leaf->key_len, w->hi->key,
+                                 w->hi->len);
+        if (cmp > 0 || (cmp == 0 && !w->hi->inclusive))
+            return 0;
+    }
+    return w->visit(leaf, w->data);
+}
+
+static int artWalk(const struct art_walk_t *w, const void *node, size_t depth,
+                   int tie_lo, int tie_hi);
+
+/* Walk the child reached through 'byte' at 'depth' unless the bounds
+ * exclude it. Returns 0 to stop */
+static int artWalkChild(const struct art_walk_t *w, const void *child,
+                        unsigned char byte, size_t depth, int tie_lo,
+                        int tie_hi) {
+    if (tie_lo) {
+        if (depth >= w->lo->len)
+            tie_lo = 0; /* longer keys come after the bound */
+        else if (byte < w->lo->key[depth])
+            return 1;
+        else
+            tie_lo = byte == w->lo->key[depth];
+    }
+
+    if (tie_hi) {
+        if (depth >= w->hi->len) {
+            if (!w->hi_prefix)
+                return 0;
+            tie_hi = 0;
+        } else if (byte > w->hi->key[depth]) {
+            return 0;
+        } else {
+            tie_hi = byte == w->hi->key[depth];
+        }
+    }
+    return artWalk(w, child, depth + 1, tie_lo, tie_hi);
+}
+
+/* Visit the leaves below 'node' in key order. 'tie_lo' and 'tie_hi' tell
+ * whether the path so far equals the start of each bound, once it
+ * differs the whole subtree lies on one side of it. Returns 0 to stop */
+static int artWalk(const struct art_walk_t *w, const void *node, size_t depth,
+                   int tie_lo, int tie_hi) {
+    if (ART_IS_LEAF(node))
+        return artVisitLeaf(w, ART_LEAF(node));
+
+    const struct art_node_t *n = node;
+    if (n->prefix_len) {
+        const unsigned char *prefix = artPrefixBytes(n, depth);
+        if (tie_lo) {
+            int cmp = artCompareBound(prefix, n->prefix_len, w->lo, depth, 0);
+            if (cmp < 0)
+                return 1;
+            tie_lo = cmp == 0;
+        }
+        if (tie_hi) {
+            int cmp = artCompareBound(prefix, n->prefix_len, w->hi, depth,
+                                      w->hi_prefix);
+            if (cmp > 0)
+                return 0;
+            tie_hi = cmp == 0;
+        }
+        depth += n->prefix_len;
+    }
+
+    switch (n->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        const unsigned char *keys =
+            n->type == ART_NODE4 ? ((const struct art_node4_t *)n)->keys
+                                 : ((const struct art_node16_t *)n)->keys;
+        void *const *children =
+            n->type == ART_NODE4 ? ((const struct art_node4_t *)n)->children
+                                 : ((const struct art_node16_t *)n)->children;
+        for (size_t i = 0; i < n->child_count; i++) {
+            if (!artWalkChild(w, children[i], keys[i], depth, tie_lo, tie_hi))
+                return 0;
+        }
+        return 1;
+    }
+    case ART_NODE48: {
+        const struct art_node48_t *n48 = (const struct art_node48_t *)n;
+        for (size_t b = 0; b < 256; b++) {
+            if (n48->index[b] &&
+                !artWalkChild(w, n48->children[n48->index[b] - 1],
+                              (unsigned char)b, depth, tie_lo, tie_hi))
+                return 0;
+        }
+        return 1;
+    }
+    default: {
+        const struct art_node256_t *n256 = (const struct art_node256_t *)n;
+        for (size_t b = 0; b < 256; b++) {
+            if (n256->children[b] &&
+                !artWalkChild(w, n256->children[b], (unsigned char)b, depth,
+                              tie_lo, tie_hi))
+                return 0;
+        }
+        return 1;
+    }
+    }
+}
+
+void artScan(const struct art_t *tree, const struct art_bound_t *lo,
+             const struct art_bound_t *hi, art_visit_t visit, void *data) {
+    struct art_walk_t w = {lo, hi, 0, visit, data};
+
+    if (tree->root)
+        artWalk(&w, tree->root, 0, lo != NULL, hi != NULL);
+}
+
+void artPrefix(const struct art_t *tree, const unsigned char *prefix,
+               size_t len, art_visit_t visit, void *data) {
+    struct art_bound_t bound = {prefix, len, 1};
+    struct art_walk_t w = {&bound, &bound, 1, visit, data};
+
+    if (tree->root)
+        artWalk(&w, tree->root, 0, 1, 1);
+}
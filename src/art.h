@@ -0,0 +1,121 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Adaptive radix tree mapping binary keys to lists of row positions.
+ *  Inner nodes grow from 4 to 16, 48 and 256 children as they fill up, and
+ *  chains of single-child nodes are collapsed into a prefix stored in the
+ *  node below them (only its first ART_MAX_PREFIX bytes are kept, the rest
+ *  is read from a leaf). Keys are compared byte by byte, so no key may be
+ *  a prefix of another one: callers use fixed-size or NUL-terminated keys.
+ */
+#ifndef _ART_H
+#define _ART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ART_NODE4 0x01
+#define ART_NODE16 0x02
+#define ART_NODE48 0x03
+#define ART_NODE256 0x04
+
+/* Prefix bytes stored in an inner node */
+#define ART_MAX_PREFIX 8
+
+/* A key and the rows holding it, in ascending order */
+struct art_leaf_t {
+    uint32_t *rows;
+    uint32_t count;
+    uint32_t capacity;
+    size_t key_len;
+    unsigned char key[];
+};
+
+struct art_node_t {
+    uint8_t type;
+    uint16_t child_count;
+    uint32_t prefix_len;
+    unsigned char prefix[ART_MAX_PREFIX];
+};
+
+/* Children of the small nodes are sorted by key byte */
+struct art_node4_t {
+    struct art_node_t node;
+    unsigned char keys[4];
+    void *children[4];
+};
+
+struct art_node16_t {
+    struct art_node_t node;
+    unsigned char keys[16];
+    void *children[16];
+};
+
+/* 'index' maps a key byte to its child slot plus one, 0 when absent */
+struct art_node48_t {
+    struct art_node_t node;
+    unsigned char index[256];
+    void *children[48];
+};
+
+struct art_node256_t {
+    struct art_node_t node;
+    void *children[256];
+};
+
+/* A zero initialized tree is empty. Children are tagged pointers, the
+ * lowest bit set for a leaf */
+struct art_t {
+    void *root;
+    size_t leaf_count; /* distinct keys */
+};
+
+/* One end of a range scan */
+struct art_bound_t {
+    const unsigned char *key;
+    size_t len;
+    int inclusive;
+};
+
+/* Called for each leaf of a scan in key order, return 0 to stop */
+typedef int (*art_visit_t)(const struct art_leaf_t *leaf, void *data);
+
+/* Called for each leaf in no particular order, it may change the rows
+ * of the leaf but not its key */
+typedef void (*art_update_t)(struct art_leaf_t *leaf, void *data);
+
+void artRelease(struct art_t *tree);
+
+/* Add 'row' to the rows of 'key', 0 when out of memory */
+int artInsert(struct art_t *tree, const unsigned char *key, size_t len,
+              uint32_t row);
+
+/* Visit every leaf. A leaf whose rows all went stays in the tree */
+void artUpdate(struct art_t *tree, art_update_t update, void *data);
+
+/* Leaf of 'key', NULL when absent */
+const struct art_leaf_t *artSearch(const struct art_t *tree,
+                                   const unsigned char *key, size_t len);
+
+/* Visit the keys between 'lo' and 'hi' (NULL for no bound) */
+void artScan(const struct art_t *tree, const struct art_bound_t *lo,
+             const struct art_bound_t *hi, art_visit_t visit, void *data);
+
+/* Visit the keys starting with 'prefix' */
+void artPrefix(const struct art_t *tree, const unsigned char *prefix,
+               size_t len, art_visit_t visit, void *data);
+
+#endif /* _ART_H */
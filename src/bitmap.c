@@ -0,0 +1,427 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "bitmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void bitmapFreeContainer(struct bitmap_container_t *c) {
+    free(c->array);
+    free(c->words);
+}
+
+void bitmapRelease(struct bitmap_t *bitmap) {
+    for (size_t i = 0; i < bitmap->count; i++)
+        bitmapFreeContainer(&bitmap->containers[i]);
+    free(bitmap->containers);
+    memset(bitmap, 0, sizeof(struct bitmap_t));
+}
+
+/* Index of the container 'key', or -1 with its insertion point in 'at' */
+static long bitmapFind(const struct bitmap_t *bitmap, uint16_t key,
+                       size_t *at) {
+    size_t lo = 0, hi = bitmap->count;
+
+    /* Appends hit the last container */
+    if (hi && bitmap->containers[hi - 1].key <= key)
+        lo = hi - 1;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (bitmap->containers[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *at = lo;
+    return lo < bitmap->count && bitmap->containers[lo].key == key ? (long)lo
+                                                                   : -1;
+}
+
+/* Insert an empty array container at 'at' */
+static struct bitmap_container_t *
+bitmapInsertContainer(struct bitmap_t *bitmap, size_t at, uint16_t key) {
+    if (bitmap->count == bitmap->capacity) {
+        size_t capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+        struct bitmap_container_t *containers = realloc(
+            bitmap->containers, capacity * sizeof(struct bitmap_container_t));
+        if (!containers)
+            return NULL;
+        bitmap->containers = containers;
+        bitmap->capacity = capacity;
+    }
+
+    memmove(&bitmap->containers[at + 1], &bitmap->containers[at],
+            (bitmap->count - at) * sizeof(struct bitmap_container_t));
+    bitmap->count++;
+
+    struct bitmap_container_t *c = &bitmap->containers[at];
+    memset(c, 0, sizeof(struct bitmap_container_t));
+    c->key = key;
+    return c;
+}
+
+static int bitmapHasBit(const uint64_t *words, uint16_t low) {
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+static void bitmapToWords(const struct bitmap_container_t *c,
+                          uint64_t *words) {
+    if (c->words) {
+        memcpy(words, c->words, BITMAP_WORDS * sizeof(uint64_t));
+        return;
+    }
+
+    memset(words, 0, BITMAP_WORDS * sizeof(uint64_t));
+    for (uint32_t i = 0; i < c->cardinality; i++)
+        words[c->array[i] >> 6] |= (uint64_t)1 << (c->array[i] & 63);
+}
+
+static int bitmapAddToContainer(struct bitmap_container_t *c, uint16_t low) {
+    if (c->words) {
+        uint64_t bit = (uint64_t)1 << (low & 63);
+        c->cardinality += !(c->words[low >> 6] & bit);
+        c->words[low >> 6] |= bit;
+        return 1;
+    }
+
+    uint32_t at = c->cardinality;
+    if (at && c->array[at - 1] >= low) {
+        uint32_t lo = 0, hi = at;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (c->array[mid] < low)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (c->array[lo] == low)
+            return 1;
+        at = lo;
+    }
+
+    /* A full array turns into a bit map */
+    if (c->cardinality == BITMAP_ARRAY_MAX) {
+        uint64_t *words = malloc(BITMAP_WORDS * sizeof(uint64_t));
+        if (!words)
+            return 0;
+        bitmapToWords(c, words);
+        free(c->array);
+        c->array = NULL;
+        c->capacity = 0;
+        c->words = words;
+        return bitmapAddToContainer(c, low);
+    }
+
+    if (c->cardinality == c->capacity) {
+        uint32_t capacity = c->capacity ? c->capacity * 2 : 4;
+        uint16_t *array = realloc(c->array, capacity * sizeof(uint16_t));
+        if (!array)
+            return 0;
+        c->array = array;
+        c->capacity = capacity;
+    }
+
+    memmove(&c->array[at + 1], &c->array[at],
+            (c->cardinality - at) * sizeof(uint16_t));
+    c->array[at] = low;
+    c->cardinality++;
+    return 1;
+}
+
+int bitmapAdd(struct bitmap_t *bitmap, uint32_t value) {
+    uint16_t key = (uint16_t)(value >> 16);
+    size_t at;
+    long found = bitmapFind(bitmap, key, &at);
+
+    struct bitmap_container_t *c =
+        found >= 0 ? &bitmap->containers[found]
+                   : bitmapInsertContainer(bitmap, at, key);
+    return c && bitmapAddToContainer(c, (uint16_t)value);
+}
+
+int bitmapContains(const struct bitmap_t *bitmap, uint32_t value) {
+    size_t at;
+    long found = bitmapFind(bitmap, (uint16_t)(value >> 16), &at);
+    if (found < 0)
+        return 0;
+
+    const struct bitmap_container_t *c = &bitmap->containers[found];
+    uint16_t low = (uint16_t)value;
+    if (c->words)
+        return bitmapHasBit(c->words, low);
+
+    for (uint32_t lo = 0, hi = c->cardinality; lo < hi;) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (c->array[mid] == low)
+            return 1;
+        if (c->array[mid] < low)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return 0;
+}
+
+size_t bitmapCardinality(const struct bitmap_t *bitmap) {
+    size_t total = 0;
+    for (size_t i = 0; i < bitmap->count; i++)
+        total += bitmap->containers[i].cardinality;
+    return total;
+}
+
+/* Append a container to 'out' (keys arrive in increasing order) */
+static struct bitmap_container_t *bitmapPush(struct bitmap_t *out,
+                                             uint16_t key) {
+    return bitmapInsertContainer(out, out->count, key);
+}
+
+/* Append the positions set in 'words' as a container of 'out', packed as
+ * an array when they are few */
+static int bitmapPushWords(struct bitmap_t *out, uint16_t key,
+                           const uint64_t *words) {
+    uint32_t cardinality = 0;
+    for (size_t i = 0; i < BITMAP_WORDS; i++)
+        cardinality += (uint32_t)__builtin_popcountll(words[i]);
+    if (!cardinality)
+        return 1;
+
+    struct bitmap_container_t *c = bitmapPush(out, key);
+    if (!c)
+        return 0;
+
+    if (cardinality > BITMAP_ARRAY_MAX) {
+        c->words = malloc(BITMAP_WORDS * sizeof(uint64_t));
+        if (!c->words)
+            return 0;
+        memcpy(c->words, words, BITMAP_WORDS * sizeof(uint64_t));
+        c->cardinality = cardinality;
+        return 1;
+    }
+
+    c->array = malloc(cardinality * sizeof(uint16_t));
+    if (!c->array)
+        return 0;
+    c->capacity = cardinality;
+
+    for (size_t i = 0; i < BITMAP_WORDS; i++) {
+        for (uint64_t w = words[i]; w; w &= w - 1)
+            c->array[c->cardinality++] =
+                (uint16_t)(i * 64 + (size_t)__builtin_ctzll(w));
+    }
+    return 1;
+}
+
+static int bitmapPushArray(struct bitmap_t *out, uint16_t key,
+                           const uint16_t *values, uint32_t count) {
+    if (!count)
+        return 1;
+
+    struct bitmap_container_t *c = bitmapPush(out, key);
+    if (!c || !(c->array = malloc(count * sizeof(uint16_t))))
+        return 0;
+
+    memcpy(c->array, values, count * sizeof(uint16_t));
+    c->cardinality = c->capacity = count;
+    return 1;
+}
+
+static int bitmapPushCopy(struct bitmap_t *out,
+                          const struct bitmap_container_t *c) {
+    if (c->array)
+        return bitmapPushArray(out, c->key, c->array, c->cardinality);
+    return bitmapPushWords(out, c->key, c->words);
+}
+
+static int bitmapAndContainers(struct bitmap_t *out,
+                               const struct bitmap_container_t *a,
+                               const struct bitmap_container_t *b) {
+    uint64_t words[BITMAP_WORDS];
+
+    if (a->words && b->words) {
+        for (size_t i = 0; i < BITMAP_WORDS; i++)
+            words[i] = a->words[i] & b->words[i];
+        return bitmapPushWords(out, a->key, words);
+    }
+
+    /* At least one side is an array, the result is at most that big */
+    if (a->words) {
+        const struct bitmap_container_t *t = a;
+        a = b;
+        b = t;
+    }
+
+    uint16_t values[BITMAP_ARRAY_MAX];
+    uint32_t n = 0;
+
+    if (b->words) {
+        for (uint32_t i = 0; i < a->cardinality; i++) {
+            if (bitmapHasBit(b->words, a->array[i]))
+                values[n++] = a->array[i];
+        }
+    } else {
+        for (uint32_t i = 0, j = 0; i < a->cardinality && j < b->cardinality;) {
+            if (a->array[i] < b->array[j])
+                i++;
+            else if (a->array[i] > b->array[j])
+                j++;
+            else {
+                values[n++] = a->array[i];
+                i++;
+                j++;
+            }
+        }
+    }
+    return bitmapPushArray(out, a->key, values, n);
+}
+
+static int bitmapOrContainers(struct bitmap_t *out,
+                              const struct bitmap_container_t *a,
+                              const struct bitmap_container_t *b) {
+    if (a->array && b->array &&
+        a->cardinality + b->cardinality <= BITMAP_ARRAY_MAX) {
+        uint16_t values[BITMAP_ARRAY_MAX];
+        uint32_t i = 0, j = 0, n = 0;
+
+        while (i < a->cardinality || j < b->cardinality) {
+            if (j == b->cardinality ||
+                (i < a->cardinality && a->array[i] < b->array[j]))
+                values[n++] = a->array[i++];
+            else if (i == a->cardinality || b->array[j] < a->array[i])
+                values[n++] = b->array[j++];
+            else {
+                values[n++] = a->array[i++];
+                j++;
+            }
+        }
+        return bitmapPushArray(out, a->key, values, n);
+    }
+
+    uint64_t words[BITMAP_WORDS];
+    bitmapToWords(a, words);
+    if (b->words) {
+        for (size_t i = 0; i < BITMAP_WORDS; i++)
+            words[i] |= b->words[i];
+    } else {
+        for (uint32_t i = 0; i < b->cardinality; i++)
+            words[b->array[i] >> 6] |= (uint64_t)1 << (b->array[i] & 63);
+    }
+    return bitmapPushWords(out, a->key, words);
+}
+
+int bitmapAnd(const struct bitmap_t *a, const struct bitmap_t *b,
+              struct bitmap_t *out) {
+    size_t i = 0, j = 0;
+
+    bitmapRelease(out);
+    while (i < a->count && j < b->count) {
+        uint16_t ka = a->containers[i].key, kb = b->containers[j].key;
+        if (ka < kb) {
+            i++;
+        } else if (ka > kb) {
+            j++;
+        } else {
+            if (!bitmapAndContainers(out, &a->containers[i++],
+                                     &b->containers[j++]))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+int bitmapOr(const struct bitmap_t *a, const struct bitmap_t *b,
+             struct bitmap_t *out) {
+    size_t i = 0, j = 0;
+    int ok = 1;
+
+    bitmapRelease(out);
+    while (ok && (i < a->count || j < b->count)) {
+        if (j == b->count ||
+            (i < a->count && a->containers[i].key < b->containers[j].key))
+            ok = bitmapPushCopy(out, &a->containers[i++]);
+        else if (i == a->count ||
+                 b->containers[j].key < a->containers[i].key)
+            ok = bitmapPushCopy(out, &b->containers[j++]);
+        else
+            ok = bitmapOrContainers(out, &a->containers[i++],
+                                    &b->containers[j++]);
+    }
+    return ok;
+}
+
+int bitmapNot(const struct bitmap_t *a, uint32_t size, struct bitmap_t *out) {
+    uint64_t words[BITMAP_WORDS];
+    size_t i = 0;
+
+    bitmapRelease(out);
+    if (!size)
+        return 1;
+
+    uint32_t last = (size - 1) >> 16;
+    for (uint32_t key = 0; key <= last; key++) {
+        while (i < a->count && a->containers[i].key < key)
+            i++;
+
+        if (i < a->count && a->containers[i].key == key)
+            bitmapToWords(&a->containers[i], words);
+        else
+            memset(words, 0, sizeof(words));
+
+        for (size_t w = 0; w < BITMAP_WORDS; w++)
+            words[w] = ~words[w];
+
+        /* Clear the bits past the end of the last container */
+        if (key == last) {
+            uint32_t limit = size - (key << 16);
+            for (size_t w = limit / 64; w < BITMAP_WORDS; w++) {
+                uint32_t from = w == limit / 64 ? limit % 64 : 0;
+                words[w] &= from ? ((uint64_t)1 << from) - 1 : 0;
+            }
+        }
+
+        if (!bitmapPushWords(out, (uint16_t)key, words))
+            return 0;
+    }
+    return 1;
+}
+
+int bitmapCopy(const struct bitmap_t *a, struct bitmap_t *out) {
+    bitmapRelease(out);
+    for (size_t i = 0; i < a->count; i++) {
+        if (!bitmapPushCopy(out, &a->containers[i]))
+            return 0;
+    }
+    return 1;
+}
+
+void bitmapToArray(const struct bitmap_t *bitmap, uint32_t *out) {
+    for (size_t i = 0; i < bitmap->count; i++) {
+        const struct bitmap_container_t *c = &bitmap->containers[i];
+        uint32_t high = (uint32_t)c->key << 16;
+
+        if (c->array) {
+            for (uint32_t j = 0; j < c->cardinality; j++)
+                *out++ = high | c->array[j];
+            continue;
+        }
+
+        for (size_t w = 0; w < BITMAP_WORDS; w++) {
+            for (uint64_t bits = c->words[w]; bits; bits &= bits - 1)
+                *out++ = high | (uint32_t)(w * 64 + __builtin_ctzll(bits));
+        }
+    }
+}
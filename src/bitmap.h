@@ -0,0 +1,70 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Compressed bitmaps of row positions, split in the same way as roaring
+ *  bitmaps: the high 16 bits of a position select a container and the
+ *  low 16 bits are stored either as a sorted array (sparse containers)
+ *  or as a 65536-bit map (dense ones). Combining two bitmaps works a
+ *  container at a time, 64 rows at a time for dense containers.
+ */
+#ifndef _BITMAP_H
+#define _BITMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Containers with more values than this are stored as bit maps */
+#define BITMAP_ARRAY_MAX 4096
+#define BITMAP_WORDS (65536 / 64)
+
+struct bitmap_container_t {
+    uint16_t key;         /* high 16 bits of the positions */
+    uint32_t cardinality; /* number of positions in the container */
+    uint32_t capacity;    /* allocated entries of 'array' */
+    uint16_t *array;      /* sorted low bits, NULL for a bit map */
+    uint64_t *words;      /* BITMAP_WORDS words, NULL for an array */
+};
+
+/* Containers are sorted by key, a zero initialized bitmap is empty */
+struct bitmap_t {
+    struct bitmap_container_t *containers;
+    size_t count;
+    size_t capacity;
+};
+
+void bitmapRelease(struct bitmap_t *bitmap);
+
+/* Add a position, fastest when positions are added in increasing order.
+ * Returns 0 when out of memory */
+int bitmapAdd(struct bitmap_t *bitmap, uint32_t value);
+int bitmapContains(const struct bitmap_t *bitmap, uint32_t value);
+size_t bitmapCardinality(const struct bitmap_t *bitmap);
+
+/* 'out' receives the result and must not be one of the operands, its
+ * previous content is released. Return 0 when out of memory */
+int bitmapAnd(const struct bitmap_t *a, const struct bitmap_t *b,
+              struct bitmap_t *out);
+int bitmapOr(const struct bitmap_t *a, const struct bitmap_t *b,
+             struct bitmap_t *out);
+/* Positions in [0, size) missing from 'a' */
+int bitmapNot(const struct bitmap_t *a, uint32_t size, struct bitmap_t *out);
+int bitmapCopy(const struct bitmap_t *a, struct bitmap_t *out);
+
+/* Store the positions in increasing order in 'out', which has room for
+ * bitmapCardinality() entries */
+void bitmapToArray(const struct bitmap_t *bitmap, uint32_t *out);
+
+#endif /* _BITMAP_H */
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "buffer.h"
+#include "logs.h"
+#include "metrics.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* A resident page, the hand of the clock goes round these */
+struct buffer_frame_t {
+    struct table_t *table;
+    size_t page;
+};
+
+int buffer_enabled = 0;
+uint64_t buffer_epoch = 1;
+
+static size_t budget;
+static size_t resident;
+
+static struct buffer_frame_t *frames;
+static size_t frame_count;
+static size_t frame_capacity;
+static size_t hand;
+
+/* Spill file: pages are written at multiples of DB_PAGE_SIZE, the slots
+ * of the pages released are reused */
+static FILE *spill;
+static int64_t spill_end;
+static int64_t *free_slots;
+static size_t free_count;
+static size_t free_capacity;
+
+int bufferConfigure(size_t bytes, const char *path) {
+    spill = path ? fopen(path, "w+b") : tmpfile();
+    if (!spill) {
+        LOG_ERROR("Unable to open the spill file '%s'",
+                  path ? path : "(temporary)");
+        return 0;
+    }
+
+    budget = bytes;
+    buffer_enabled = 1;
+    return 1;
+}
+
+size_t bufferResident(void) { return resident; }
+
+size_t bufferBudget(void) { return budget; }
+
+static int bufferSealed(const struct table_t *table, size_t page) {
+    return (page + 1) * table->page_rows <= table->row_count;
+}
+
+static int bufferFrameAdd(struct table_t *table, size_t page) {
+    if (frame_count == frame_capacity) {
+        size_t capacity = frame_capacity ? frame_capacity * 2 : 256;
+        struct buffer_frame_t *grown =
+            realloc(frames, capacity * sizeof(*frames));
+        if (!grown)
+            return 0;
+        frames = grown;
+        frame_capacity = capacity;
+    }
+
+    table->pages[page].frame = frame_count;
+    frames[frame_count++] = (struct buffer_frame_t){table, page};
+    resident += DB_PAGE_SIZE;
+    return 1;
+}
+
+/* The last frame takes the place of the one removed */
+static void bufferFrameRemove(size_t frame) {
+    frames[frame] = frames[--frame_count];
+    if (frame < frame_count)
+        frames[frame].table->pages[frames[frame].page].frame = frame;
+    resident -= DB_PAGE_SIZE;
+}
+
+static int64_t bufferSlot(void) {
+    if (free_count)
+        return free_slots[--free_count];
+
+    int64_t slot = spill_end;
+    spill_end += DB_PAGE_SIZE;
+    return slot;
+}
+
+static void bufferSlotRelease(int64_t slot) {
+    if (free_count == free_capacity) {
+        size_t capacity = free_capacity ? free_capacity * 2 : 64;
+        int64_t *grown = realloc(free_slots, capacity * sizeof(*free_slots));
+        if (!grown)
+            return; /* the slot is leaked in the file */
+        free_slots = grown;
+        free_capacity = capacity;
+    }
+    free_slots[free_count++] = slot;
+}
+
+/* Writes the page out unless its copy in the spill file is current, then
+ * releases its memory. The tuples of the page lose their address */
+static int bufferEvict(struct table_t *table, size_t index) {
+    struct db_page_t *page = &table->pages[index];
+
+    if (page->spill < 0 || page->dirty) {
+        int64_t slot = page->spill < 0 ? bufferSlot() : page->spill;
+        if (pwrite(fileno(spill), page->data, DB_PAGE_SIZE, (off_t)slot) !=
+            DB_PAGE_SIZE) {
+            if (page->spill < 0)
+                bufferSlotRelease(slot);
+            return 0;
+        }
+        page->spill = slot;
+        page->dirty = 0;
+    }
+
+    size_t first = index * table->page_rows;
+    for (size_t i = 0; i < table->page_rows; i++)
+        table->rows[first + i] = NULL;
+
+    table->bytes -= malloc_usable_size(page->data);
+    free(page->data);
+    page->data = NULL;
+
+    bufferFrameRemove(page->frame);
+    metricsAdd(METRIC_PAGES_EVICTED, 1);
+    return 1;
+}
+
+/* CLOCK: a page referenced since the hand last passed gets a second
+ * chance, pinned and unsealed pages are skipped. Two turns at most */
+static int bufferEvictOne(void) {
+    for (size_t n = 0; n < 2 * frame_count; n++) {
+        if (hand >= frame_count)
+            hand = 0;
+
+        struct buffer_frame_t *frame = &frames[hand];
+        struct db_page_t *page = &frame->table->pages[frame->page];
+
+        if (page->epoch == buffer_epoch ||
+            !bufferSealed(frame->table, frame->page)) {
+            hand++;
+        } else if (page->referenced) {
+            page->referenced = 0;
+            hand++;
+        } else if (bufferEvict(frame->table, frame->page)) {
+            return 1; /* 'hand' now holds the frame moved in its place */
+        } else {
+            hand++;
+        }
+    }
+    return 0;
+}
+
+int bufferReserve(void) {
+    if (!buffer_enabled)
+        return 1;
+
+    while (resident + DB_PAGE_SIZE > budget) {
+        if (!bufferEvictOne())
+            return 0;
+    }
+    return 1;
+}
+
+struct row_t *bufferFault(struct table_t *table, size_t row, int mode) {
+    size_t index = row / table->page_rows;
+    struct db_page_t *page = &table->pages[index];
+
+    bufferReserve();
+    char *data = aligned_alloc(64, DB_PAGE_SIZE);
+    if (!data || pread(fileno(spill), data, DB_PAGE_SIZE,
+                       (off_t)page->spill) != DB_PAGE_SIZE) {
+        /* The callers hold no error path for reading a row */
+        LOG_ERROR("Unable to read page %zu of table '%s' back", index,
+                  table->name);
+        logFlush();
+        abort();
+    }
+
+    size_t first = index * table->page_rows;
+    for (size_t i = 0; i < table->page_rows; i++)
+        table->rows[first + i] = (struct row_t *)(data + i * table->tuple_size);
+
+    page->data = data;
+    page->referenced = 1;
+    page->epoch = mode & BUFFER_PIN ? buffer_epoch : 0;
+    page->dirty = (mode & BUFFER_DIRTY) != 0;
+    page->frame = SIZE_MAX;
+    table->bytes += malloc_usable_size(data);
+
+    if (!bufferFrameAdd(table, index)) {
+        /* Untracked, the page stays resident for good */
+        LOG_WARN("Out of memory, page %zu of '%s' cannot be evicted", index,
+                 table->name);
+    }
+    metricsAdd(METRIC_PAGES_FAULTED, 1);
+    return table->rows[row];
+}
+
+void bufferPageAdd(struct table_t *table, size_t page) {
+    if (!buffer_enabled)
+        return;
+
+    table->pages[page].frame = SIZE_MAX;
+    if (!bufferFrameAdd(table, page))
+        LOG_WARN("Out of memory, page %zu of '%s' cannot be evicted", page,
+                 table->name);
+}
+
+void bufferPageDrop(struct table_t *table, size_t index) {
+    struct db_page_t *page = &table->pages[index];
+
+    if (!buffer_enabled)
+        return;
+
+    if (page->data && page->frame != SIZE_MAX)
+        bufferFrameRemove(page->frame);
+    if (page->spill >= 0)
+        bufferSlotRelease(page->spill);
+    page->spill = -1;
+}
+
+void bufferPageMove(struct table_t *from, struct table_t *to) {
+    for (size_t i = 0; i < frame_count; i++) {
+        if (frames[i].table == from)
+            frames[i].table = to;
+    }
+}
+
+void bufferStatementEnd(void) {
+    if (!buffer_enabled)
+        return;
+
+    buffer_epoch++;
+    while (resident > budget && bufferEvictOne())
+        ;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Buffer pool over the pages of PACKED tables. With a memory budget set,
+ *  pages beyond it are written to a spill file and read back when a row
+ *  of theirs is accessed. Victims are chosen with the CLOCK algorithm
+ *  among the sealed pages (every tuple of the page is below row_count,
+ *  appends never go to them) that no running statement has pinned.
+ *
+ *  Rows of PACKED tables must be reached through bufferRow() and
+ *  bufferRowWrite() instead of table->rows[]. Both pin the page of the row
+ *  until bufferStatementEnd(), so the pointers they return stay valid for
+ *  the whole statement; bufferRowScan() does not pin and its pointer is
+ *  only valid until the next access. DYNAMIC tables are never paged.
+ */
+#ifndef _BUFFER_H
+#define _BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "db.h"
+
+#define BUFFER_PIN 0x01   /* keep the page until the statement ends */
+#define BUFFER_DIRTY 0x02 /* the row is about to be written */
+
+/* A budget is configured, see bufferConfigure() */
+extern int buffer_enabled;
+
+/* Statement the pages being used are pinned for */
+extern uint64_t buffer_epoch;
+
+/* Sets the memory budget of the pages in bytes and the spill file (a
+ * temporary file when NULL). Called once before any table is created,
+ * returns 0 if the spill file cannot be opened */
+int bufferConfigure(size_t budget, const char *path);
+
+/* Reads a spilled page back, evicting others to make room */
+struct row_t *bufferFault(struct table_t *table, size_t row, int mode);
+
+/* Rows of 'table' go through the buffer pool */
+static inline int bufferPaged(const struct table_t *table) {
+    return buffer_enabled && table->row_format == DB_ROW_PACKED;
+}
+
+/* Paging does not change what a table holds, readers of a const table
+ * may fault its pages in */
+static inline struct row_t *bufferAccess(const struct table_t *table,
+                                         size_t row, int mode) {
+    if (!bufferPaged(table))
+        return table->rows[row];
+
+    struct db_page_t *page = &table->pages[row / table->page_rows];
+    if (!page->data)
+        return bufferFault((struct table_t *)table, row, mode);
+
+    page->referenced = 1;
+    if (mode & BUFFER_PIN)
+        page->epoch = buffer_epoch;
+    if (mode & BUFFER_DIRTY)
+        page->dirty = 1;
+    return table->rows[row];
+}
+
+static inline struct row_t *bufferRow(const struct table_t *table,
+                                      size_t row) {
+    return bufferAccess(table, row, BUFFER_PIN);
+}
+
+static inline struct row_t *bufferRowWrite(const struct table_t *table,
+                                           size_t row) {
+    return bufferAccess(table, row, BUFFER_PIN | BUFFER_DIRTY);
+}
+
+static inline struct row_t *bufferRowScan(const struct table_t *table,
+                                          size_t row) {
+    return bufferAccess(table, row, 0);
+}
+
+/* Called by db.c when a page is allocated, before it is added to the
+ * table: evicts pages until there is room for one more. Returns 0 when
+ * every page is pinned and the budget is exceeded */
+int bufferReserve(void);
+
+/* A page of 'table' was allocated or released by db.c */
+void bufferPageAdd(struct table_t *table, size_t page);
+void bufferPageDrop(struct table_t *table, size_t page);
+
+/* The pages of 'from' now belong to 'to' */
+void bufferPageMove(struct table_t *from, struct table_t *to);
+
+/* Unpins every page and evicts down to the budget */
+void bufferStatementEnd(void);
+
+/* Bytes of resident pages and the configured budget */
+size_t bufferResident(void);
+size_t bufferBudget(void);
+
+#endif /* _BUFFER_H */
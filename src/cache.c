@@ -0,0 +1,263 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cache.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct cache_entry_t {
+    char *text;
+    size_t len;
+    uint64_t hash;
+    const struct database_t *db;
+    struct plan_t *plan;
+
+    struct cache_entry_t *next; /* next entry in the same bucket */
+
+    /* LRU list, the head is the most recently used entry */
+    struct cache_entry_t *lru_prev;
+    struct cache_entry_t *lru_next;
+};
+
+static struct cache_entry_t *buckets[CACHE_BUCKETS];
+static struct cache_entry_t *lru_head = NULL;
+static struct cache_entry_t *lru_tail = NULL;
+static size_t entry_count = 0;
+
+static uint64_t cacheHash(const char *text, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int cachePushParam(struct fingerprint_t *fp, struct arena_t *arena,
+                          int type, int i, const char *s, size_t len) {
+    if (fp->param_count >= fp->param_capacity) {
+        size_t capacity = fp->param_capacity ? fp->param_capacity * 2 : 8;
+        struct plan_param_t *params =
+            arenaAlloc(arena, capacity * sizeof(struct plan_param_t));
+        if (!params)
+            return 0;
+
+        if (fp->param_count)
+            memcpy(params, fp->params,
+                   fp->param_count * sizeof(struct plan_param_t));
+        fp->params = params;
+        fp->param_capacity = capacity;
+    }
+
+    struct plan_param_t *param = &fp->params[fp->param_count++];
+    param->type = type;
+    param->i = i;
+    param->s = s;
+    param->len = len;
+    param->escaped = 0;
+    return 1;
+}
+
+/* The scan follows the lexer rules for strings, numbers and identifiers
+ * so that digits inside an identifier (e.g. 'table1') are kept and a
+ * literal becomes exactly one '?' */
+int cacheFingerprint(const char *sql, struct fingerprint_t *fp,
+                     struct arena_t *arena) {
+    memset(fp, 0, sizeof(struct fingerprint_t));
+
+    fp->text = arenaAlloc(arena, strlen(sql) + 1);
+    if (!fp->text)
+        return 0;
+
+    const char *p = sql;
+    size_t out = 0;
+
+    while (*p) {
+        unsigned char c = (unsigned char)*p;
+
+        if (isspace(c)) {
+            while (isspace((unsigned char)*p))
+                p++;
+            if (out && *p)
+                fp->text[out++] = ' ';
+            continue;
+        }
+
+        if (c == '\'') {
+            const char *start = ++p;
+            int escaped = 0;
+            while (*p && (*p != '\'' || p[1] == '\'')) {
+                if (*p == '\'') {
+                    escaped = 1;
+                    p++;
+                }
+                p++;
+            }
+            if (!cachePushParam(fp, arena, PLAN_PARAM_TEXT, 0, start,
+                                (size_t)(p - start)))
+                return 0;
+            fp->params[fp->param_count - 1].escaped = escaped;
+            if (*p)
+                p++; /* closing quote */
+            fp->text[out++] = '?';
+            continue;
+        }
+
+        if (isdigit(c)) {
+            const char *start = p;
+            int dot_seen = 0;
+            long value = 0;
+
+            while (isdigit((unsigned char)*p) || (!dot_seen && *p == '.')) {
+                if (*p == '.')
+                    dot_seen = 1;
+                else
+                    value = value * 10 + (*p - '0');
+                p++;
+            }
+
+            /* Decimals and integers that may overflow stay textual and are
+             * converted by the column they are assigned to */
+            size_t len = (size_t)(p - start);
+            int type = !dot_seen && len <= 9 ? PLAN_PARAM_INT : PLAN_PARAM_TEXT;
+            if (!cachePushParam(fp, arena, type, (int)value, start, len))
+                return 0;
+            fp->text[out++] = '?';
+            continue;
+        }
+
+        if (c == '?') {
+            if (!cachePushParam(fp, arena, PLAN_PARAM_UNBOUND, 0, NULL, 0))
+                return 0;
+            fp->text[out++] = *p++;
+            continue;
+        }
+
+        if (isalpha(c) || c == '_') {
+            while (isalnum((unsigned char)*p) || *p == '_')
+                fp->text[out++] = *p++;
+            continue;
+        }
+
+        fp->text[out++] = *p++;
+    }
+
+    fp->text[out] = '\0';
+    fp->len = out;
+    fp->hash = cacheHash(fp->text, out);
+    return 1;
+}
+
+static void cacheUnlink(struct cache_entry_t *entry) {
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        lru_head = entry->lru_next;
+
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        lru_tail = entry->lru_prev;
+
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void cachePushFront(struct cache_entry_t *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+
+    if (lru_head)
+        lru_head->lru_prev = entry;
+    lru_head = entry;
+
+    if (!lru_tail)
+        lru_tail = entry;
+}
+
+static void cacheRemove(struct cache_entry_t *entry) {
+    struct cache_entry_t **link = &buckets[entry->hash % CACHE_BUCKETS];
+
+    while (*link && *link != entry)
+        link = &(*link)->next;
+    if (*link)
+        *link = entry->next;
+
+    cacheUnlink(entry);
+    planFree(entry->plan);
+    free(entry->text);
+    free(entry);
+    entry_count--;
+}
+
+struct plan_t *cacheLookup(const struct fingerprint_t *fp,
+                           const struct database_t *db) {
+    struct cache_entry_t *entry = buckets[fp->hash % CACHE_BUCKETS];
+
+    while (entry) {
+        if (entry->hash == fp->hash && entry->len == fp->len &&
+            entry->db == db && memcmp(entry->text, fp->text, fp->len) == 0)
+            break;
+        entry = entry->next;
+    }
+
+    if (!entry)
+        return NULL;
+
+    if (entry->plan->catalog_version != dbCatalogVersion()) {
+        cacheRemove(entry);
+        return NULL;
+    }
+
+    cacheUnlink(entry);
+    cachePushFront(entry);
+    return entry->plan;
+}
+
+int cacheInsert(const struct fingerprint_t *fp, const struct database_t *db,
+                struct plan_t *plan) {
+    struct cache_entry_t *entry = malloc(sizeof(struct cache_entry_t));
+    if (!entry)
+        return 0;
+
+    entry->text = malloc(fp->len + 1);
+    if (!entry->text) {
+        free(entry);
+        return 0;
+    }
+
+    memcpy(entry->text, fp->text, fp->len + 1);
+    entry->len = fp->len;
+    entry->hash = fp->hash;
+    entry->db = db;
+    entry->plan = plan;
+
+    size_t bucket = fp->hash % CACHE_BUCKETS;
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    cachePushFront(entry);
+    entry_count++;
+
+    if (entry_count > CACHE_MAX_ENTRIES)
+        cacheRemove(lru_tail);
+    return 1;
+}
+
+void cacheClear(void) {
+    while (lru_head)
+        cacheRemove(lru_head);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Plan cache keyed on the normalized text of a statement. Normalization
+ *  replaces every literal with a '?' placeholder and collapses whitespace,
+ *  so 'SELECT * FROM t WHERE id > 5' and 'SELECT * FROM t WHERE id > 9'
+ *  share the fingerprint 'SELECT * FROM t WHERE id > ?' and a single plan,
+ *  the literals become the parameters of the execution.
+ */
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "db.h"
+#include "plan.h"
+
+/* Maximum number of plans kept, the least recently used is evicted */
+#define CACHE_MAX_ENTRIES 128
+#define CACHE_BUCKETS 256
+
+struct fingerprint_t {
+    char *text; /* normalized statement */
+    size_t len;
+    uint64_t hash;
+
+    /* literals found in the statement, in order of appearance */
+    struct plan_param_t *params;
+    size_t param_count;
+    size_t param_capacity;
+};
+
+/* Normalize 'sql' into 'fp', the text and the parameter array are
+ * allocated in 'arena' while text parameters point into 'sql' */
+int cacheFingerprint(const char *sql, struct fingerprint_t *fp,
+                     struct arena_t *arena);
+
+/* Returns the cached plan for the fingerprint, NULL on a miss or when the
+ * plan was made for another database or before a catalog change */
+struct plan_t *cacheLookup(const struct fingerprint_t *fp,
+                           const struct database_t *db);
+
+/* Stores a plan, the cache takes ownership of it */
+int cacheInsert(const struct fingerprint_t *fp, const struct database_t *db,
+                struct plan_t *plan);
+
+void cacheClear(void);
+
+#endif /* _CACHE_H */
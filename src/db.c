@@ -14,11 +14,61 @@
  * limitations under the License.
  */
 #include "db.h"
+#include "buffer.h"
+#include "index.h"
+#include "part.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <strings.h>
 
 void dbReleaseColumns(struct table_t *table);
 void dbReleaseRows(struct table_t *table);
 void dbReleaseTables(struct database_t *db);
 
+/* Bumped on every schema change (databases, tables, columns, indexes)
+ * and after statistics are refreshed, cached plans compare it to detect
+ * that they may reference dropped objects or were costed on outdated
+ * statistics */
+static size_t catalog_version = 0;
+
+size_t dbCatalogVersion(void) { return catalog_version; }
+
+void dbCatalogChanged(void) { catalog_version++; }
+
+/* Rows and pages record the generation they were allocated in, each
+ * snapshot starts a new one and shares everything born before it */
+static uint32_t db_generation = 1;
+
+uint32_t dbGeneration(void) { return db_generation; }
+
+uint32_t dbGenerationNext(void) { return ++db_generation; }
+
+/* Every block owned by a table is allocated and released through these,
+ * so that table->bytes follows what the table really holds on the heap */
+static void *dbAlloc(struct table_t *table, size_t size) {
+    void *p = malloc(size);
+    if (p)
+        table->bytes += malloc_usable_size(p);
+    return p;
+}
+
+static void *dbRealloc(struct table_t *table, void *p, size_t size) {
+    size_t old = p ? malloc_usable_size(p) : 0;
+    void *q = realloc(p, size);
+    if (q)
+        table->bytes = table->bytes - old + malloc_usable_size(q);
+    return q;
+}
+
+static void dbFree(struct table_t *table, void *p) {
+    if (p)
+        table->bytes -= malloc_usable_size(p);
+    free(p);
+}
+
 struct ctx_t *dbCreateCtx(void) {
     struct ctx_t *context = malloc(sizeof(struct ctx_t));
     if (!context)
@@ -42,6 +92,7 @@ struct database_t *dbCreateNew(struct ctx_t *ctx, const char db_name[64]) {
 
     ctx->databases[ctx->database_count] = new_db;
     ctx->database_count++;
+    dbCatalogChanged();
     return new_db;
 }
 
@@ -51,7 +102,7 @@ void dbReleaseColumns(struct table_t *table) {
 
     for (size_t i = 0; i < table->column_count; i++) {
         if (table->columns[i]) {
-            free(table->columns[i]);
+            dbFree(table, table->columns[i]);
             table->columns[i] = NULL;
         }
     }
@@ -59,27 +110,28 @@ void dbReleaseColumns(struct table_t *table) {
     table->column_count = 0;
 }
 
+/* Pages of a PACKED table, resident or spilled */
+static void dbPagesRelease(struct table_t *table) {
+    for (size_t i = 0; i < table->page_count; i++) {
+        bufferPageDrop(table, i);
+        dbFree(table, table->pages[i].data);
+    }
+    dbFree(table, table->pages);
+    table->pages = NULL;
+    table->page_count = 0;
+    table->page_capacity = 0;
+}
+
 void dbReleaseRows(struct table_t *table) {
     if (!table)
         return;
 
-    for (size_t i = 0; i < table->row_count; i++) {
-        struct row_t *row = table->rows[i];
-        if (!row)
-            continue;
+    dbRowTruncate(table, 0);
+    dbFree(table, table->rows);
+    table->rows = NULL;
+    table->row_capacity = 0;
 
-        for (size_t c = 0; c < table->column_count; c++) {
-            if (row->cells[c]) {
-                free(row->cells[c]);
-                row->cells[c] = NULL;
-            }
-        }
-
-        free(row);
-        table->rows[i] = NULL;
-    }
-
-    table->row_count = 0;
+    dbPagesRelease(table);
 }
 
 void dbReleaseTables(struct database_t *db) {
@@ -87,13 +139,7 @@ void dbReleaseTables(struct database_t *db) {
         return;
 
     for (size_t i = 0; i < db->table_count; i++) {
-        struct table_t *table = db->tables[i];
-        if (!table)
-            continue;
-
-        dbReleaseColumns(table);
-        dbReleaseRows(table);
-        free(table);
+        dbTableFree(db->tables[i]);
         db->tables[i] = NULL;
     }
 
@@ -115,6 +161,12 @@ int dbDelete(struct ctx_t *ctx, struct database_t *db) {
     if (idx == MAX_DB_NUM)
         return 0;
 
+    /* Snapshots still read the rows of frozen tables */
+    for (size_t i = 0; i < db->table_count; i++) {
+        if (db->tables[i]->frozen)
+            return 0;
+    }
+
     dbReleaseTables(db);
     free(db);
 
@@ -124,6 +176,7 @@ int dbDelete(struct ctx_t *ctx, struct database_t *db) {
 
     ctx->databases[ctx->database_count - 1] = NULL;
     ctx->database_count--;
+    dbCatalogChanged();
     return 1;
 }
 
@@ -138,9 +191,12 @@ struct table_t *dbTableNew(struct database_t *db, const char table_name[64]) {
     memset(new_table, 0, sizeof(struct table_t));
     strncpy(new_table->name, table_name, 63);
     new_table->name[63] = '\0';
+    new_table->row_format = DB_ROW_DYNAMIC;
+    new_table->bytes = malloc_usable_size(new_table);
 
     db->tables[db->table_count] = new_table;
     db->table_count++;
+    dbCatalogChanged();
     return new_table;
 }
 
@@ -156,12 +212,10 @@ int dbTableDelete(struct database_t *db, struct table_t *table) {
         }
     }
 
-    if (idx == MAX_TABLE_NUM)
+    if (idx == MAX_TABLE_NUM || table->frozen)
         return 0;
 
-    dbReleaseColumns(table);
-    dbReleaseRows(table);
-    free(table);
+    dbTableFree(table);
 
     for (size_t i = idx; i + 1 < db->table_count; i++) {
         db->tables[i] = db->tables[i + 1];
@@ -169,16 +223,385 @@ int dbTableDelete(struct database_t *db, struct table_t *table) {
 
     db->tables[db->table_count - 1] = NULL;
     db->table_count--;
+    dbCatalogChanged();
+    return 1;
+}
+
+/* An empty table that is not part of any database, with the columns,
+ * cell slots and tuple layout of 'table': cells of one are read with the
+ * column definitions of the other. Used for partitions, see part.h */
+struct table_t *dbTableClone(const struct table_t *table,
+                             const char table_name[64]) {
+    struct table_t *clone = malloc(sizeof(struct table_t));
+    if (!clone)
+        return NULL;
+
+    memset(clone, 0, sizeof(struct table_t));
+    strncpy(clone->name, table_name, 63);
+    clone->name[63] = '\0';
+    clone->row_format = table->row_format;
+    clone->slot_count = table->slot_count;
+    clone->tuple_size = table->tuple_size;
+    clone->page_rows = table->page_rows;
+    clone->bytes = malloc_usable_size(clone);
+
+    for (size_t i = 0; i < table->column_count; i++) {
+        struct column_t *col = dbAlloc(clone, sizeof(struct column_t));
+        if (!col) {
+            dbTableFree(clone);
+            return NULL;
+        }
+        *col = *table->columns[i];
+        col->table = clone;
+        clone->columns[clone->column_count++] = col;
+    }
+    return clone;
+}
+
+/* Releases a table with its rows, columns, indexes and partitions */
+void dbTableFree(struct table_t *table) {
+    if (!table)
+        return;
+
+    dbTableUnfreeze(table, NULL, 0);
+    dbFree(table, table->graves);
+    partRelease(table);
+    dbReleaseRows(table);
+    dbReleaseColumns(table);
+    indexReleaseAll(table);
+    free(table->stats);
+    free(table);
+}
+
+static int dbRowShared(const struct table_t *table, const struct row_t *row) {
+    return row->born < table->frozen;
+}
+
+static int dbPageShared(const struct table_t *table, size_t page) {
+    return table->pages[page].born < table->frozen;
+}
+
+/* Room for one more grave, a copy is only made once its original is
+ * sure to be kept */
+static int dbGraveReserve(struct table_t *table) {
+    if (table->grave_count < table->grave_capacity)
+        return 1;
+
+    size_t capacity = table->grave_capacity ? table->grave_capacity * 2 : 16;
+    struct db_grave_t *graves =
+        dbRealloc(table, table->graves, capacity * sizeof(*graves));
+    if (!graves)
+        return 0;
+
+    table->graves = graves;
+    table->grave_capacity = capacity;
+    return 1;
+}
+
+static void dbGraveFree(struct table_t *table, const struct db_grave_t *grave) {
+    for (size_t t = 0; t < grave->tuples; t++) {
+        char **texts = (char **)((char *)grave->data + t * grave->tuple_size);
+        for (size_t i = 0; i < grave->texts; i++)
+            dbFree(table, texts[i]);
+    }
+    dbFree(table, grave->data);
+}
+
+/* Frees a DYNAMIC row the table no longer holds, unless a snapshot still
+ * does. Out of memory, such a row is leaked rather than freed */
+static void dbRowRelease(struct table_t *table, struct row_t *row) {
+    if (!dbRowShared(table, row)) {
+        dbFree(table, row);
+        return;
+    }
+    if (dbGraveReserve(table))
+        table->graves[table->grave_count++] = (struct db_grave_t){
+            .data = row, .born = row->born, .died = db_generation};
+}
+
+/* Gives the table its own copy of a page shared with a snapshot, TEXT
+ * values included, before one of its tuples is written. Returns 0 when
+ * out of memory, nothing changes then */
+static int dbPageThaw(struct table_t *table, size_t page) {
+    if (!dbPageShared(table, page))
+        return 1;
+
+    struct db_page_t *shared = &table->pages[page];
+    size_t first = page * table->page_rows;
+    size_t tuples = table->row_count > first ? table->row_count - first : 0;
+    size_t texts = 0;
+
+    if (tuples > table->page_rows)
+        tuples = table->page_rows;
+    for (size_t i = 0; i < table->column_count; i++)
+        texts += table->columns[i]->type == DB_TYPE_TEXT;
+
+    char *data = dbGraveReserve(table) ? aligned_alloc(64, DB_PAGE_SIZE) : NULL;
+    if (!data)
+        return 0;
+    table->bytes += malloc_usable_size(data);
+    memcpy(data, shared->data, DB_PAGE_SIZE);
+
+    for (size_t n = 0; n < tuples * texts; n++) {
+        char **text = (char **)(data + n / texts * table->tuple_size) +
+                      n % texts;
+        char *copy = *text ? dbAlloc(table, strlen(*text) + 1) : NULL;
+
+        if (*text && !copy) {
+            while (n--) {
+                text = (char **)(data + n / texts * table->tuple_size) +
+                       n % texts;
+                dbFree(table, *text);
+            }
+            dbFree(table, data);
+            return 0;
+        }
+        if (copy)
+            *text = strcpy(copy, *text);
+    }
+
+    table->graves[table->grave_count++] = (struct db_grave_t){
+        .data = shared->data,
+        .born = shared->born,
+        .died = db_generation,
+        .tuples = tuples,
+        .tuple_size = table->tuple_size,
+        .texts = texts,
+    };
+    shared->data = data;
+    shared->born = db_generation;
+    for (size_t i = 0; i < table->page_rows; i++)
+        table->rows[first + i] = (struct row_t *)(data + i * table->tuple_size);
+    return 1;
+}
+
+/* A PACKED tuple about to be written, its page is copied first when a
+ * snapshot shares it. NULL when out of memory */
+static struct row_t *dbTupleWrite(struct table_t *table, size_t row) {
+    if (table->frozen && !dbPageThaw(table, row / table->page_rows))
+        return NULL;
+    return bufferRowWrite(table, row);
+}
+
+/* A table of a snapshot: the columns of 'table' and its rows as they are
+ * now, shared rather than copied. From then on 'table' copies the rows
+ * and pages born before 'generation' before writing them */
+struct table_t *dbTableFreeze(struct table_t *table, uint32_t generation) {
+    struct table_t *frozen = dbTableClone(table, table->name);
+    if (!frozen)
+        return NULL;
+
+    if (table->row_count) {
+        frozen->rows =
+            dbAlloc(frozen, table->row_count * sizeof(struct row_t *));
+        if (!frozen->rows) {
+            dbTableFreeFrozen(frozen);
+            return NULL;
+        }
+        memcpy(frozen->rows, table->rows,
+               table->row_count * sizeof(struct row_t *));
+    }
+
+    frozen->row_count = frozen->row_capacity = table->row_count;
+    frozen->capped = table->capped;
+    frozen->ring_head = table->ring_head;
+    table->frozen = generation;
+    return frozen;
+}
+
+/* Called when a snapshot holding 'table' goes away, 'generations' are
+ * the ones of the snapshots still holding it. Frees what none of them
+ * needs anymore */
+void dbTableUnfreeze(struct table_t *table, const uint32_t *generations,
+                     size_t count) {
+    size_t kept = 0;
+
+    table->frozen = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (generations[i] > table->frozen)
+            table->frozen = generations[i];
+    }
+
+    for (size_t g = 0; g < table->grave_count; g++) {
+        const struct db_grave_t *grave = &table->graves[g];
+        int held = 0;
+
+        for (size_t i = 0; i < count && !held; i++)
+            held = grave->born < generations[i] &&
+                   generations[i] <= grave->died;
+
+        if (held)
+            table->graves[kept++] = *grave;
+        else
+            dbGraveFree(table, grave);
+    }
+    table->grave_count = kept;
+}
+
+/* Releases a table made by dbTableFreeze(), the rows stay with the live
+ * table */
+void dbTableFreeFrozen(struct table_t *frozen) {
+    if (!frozen)
+        return;
+
+    dbFree(frozen, frozen->rows);
+    dbReleaseColumns(frozen);
+    free(frozen);
+}
+
+/* Bytes of the field of 'col' in a PACKED tuple */
+static size_t dbFieldSize(const struct column_t *col) {
+    return col->type == DB_TYPE_INT ? sizeof(int) : sizeof(char *);
+}
+
+/* Frees the out of line TEXT values of a PACKED tuple */
+static void dbTupleRelease(struct table_t *table, struct row_t *row) {
+    for (size_t i = 0; i < table->column_count; i++) {
+        const struct column_t *col = table->columns[i];
+        if (col->type == DB_TYPE_TEXT)
+            dbFree(table, *(char **)((char *)row + col->offset));
+    }
+}
+
+/* Lays out the columns of a PACKED table, except 'dropped', in
+ * 'offsets': TEXT references first so that every field is aligned.
+ * Returns the size of the tuple */
+static size_t dbTupleLayout(const struct table_t *table,
+                            const struct column_t *dropped, size_t *offsets) {
+    size_t size = 0;
+
+    for (int type = DB_TYPE_TEXT; type >= DB_TYPE_INT; type--) {
+        for (size_t i = 0; i < table->column_count; i++) {
+            const struct column_t *col = table->columns[i];
+            if (col == dropped || col->type != type)
+                continue;
+            offsets[i] = size;
+            size += dbFieldSize(col);
+        }
+    }
+
+    size = (size + sizeof(char *) - 1) & ~(sizeof(char *) - 1);
+    return size ? size : sizeof(char *);
+}
+
+/* Adds pages until the PACKED table has room for 'row_count' rows, the
+ * tuples of every page get their entry in the rows array. The arrays grow
+ * geometrically, the pages only as needed */
+static int dbPageReserve(struct table_t *table, size_t row_count) {
+    size_t page_count = (row_count + table->page_rows - 1) / table->page_rows;
+
+    if (page_count > table->page_capacity) {
+        size_t capacity = table->page_capacity ? table->page_capacity : 1;
+        while (capacity < page_count)
+            capacity *= 2;
+
+        struct db_page_t *pages =
+            dbRealloc(table, table->pages, capacity * sizeof(*pages));
+        if (!pages)
+            return 0;
+        table->pages = pages;
+
+        struct row_t **rows = dbRealloc(
+            table, table->rows, capacity * table->page_rows * sizeof(*rows));
+        if (!rows)
+            return 0;
+        table->rows = rows;
+        table->page_capacity = capacity;
+    }
+
+    while (table->page_count < page_count) {
+        bufferReserve();
+        char *data = aligned_alloc(64, DB_PAGE_SIZE);
+        if (!data)
+            return 0;
+        table->bytes += malloc_usable_size(data);
+
+        size_t first = table->page_count * table->page_rows;
+        for (size_t i = 0; i < table->page_rows; i++)
+            table->rows[first + i] =
+                (struct row_t *)(data + i * table->tuple_size);
+
+        table->pages[table->page_count] = (struct db_page_t){
+            .data = data, .spill = -1, .referenced = 1, .born = db_generation};
+        bufferPageAdd(table, table->page_count++);
+        table->row_capacity = table->page_count * table->page_rows;
+    }
     return 1;
 }
 
+/* Moves the rows of a PACKED table to new pages of tuples laid out with
+ * 'offsets': the fields of 'added' get its default value and the TEXT
+ * values of 'dropped' are freed. Nothing changes when out of memory */
+static int dbTableRepack(struct table_t *table, const size_t *offsets,
+                         size_t tuple_size, const struct column_t *added,
+                         const struct column_t *dropped) {
+    /* The TEXT values move to the new tuples, they must be the table's */
+    for (size_t p = 0; table->frozen && p < table->page_count; p++) {
+        if (!dbPageThaw(table, p))
+            return 0;
+    }
+
+    struct table_t packed;
+    memset(&packed, 0, sizeof(packed));
+    packed.tuple_size = tuple_size;
+    packed.page_rows = DB_PAGE_SIZE / tuple_size;
+
+    if (table->row_count && !dbPageReserve(&packed, table->row_count)) {
+        dbReleaseRows(&packed);
+        return 0;
+    }
+
+    for (size_t r = 0; r < table->row_count; r++) {
+        const char *from = (const char *)bufferRow(table, r);
+        char *to = (char *)packed.rows[r];
+
+        memset(to, 0, tuple_size);
+        for (size_t i = 0; i < table->column_count; i++) {
+            const struct column_t *col = table->columns[i];
+            if (col == dropped && col->type == DB_TYPE_TEXT)
+                dbFree(table, *(char **)(from + col->offset));
+            else if (col == added && col->type == DB_TYPE_INT)
+                memcpy(to + offsets[i], &col->default_value.i, sizeof(int));
+            else if (col != dropped && col != added)
+                memcpy(to + offsets[i], from + col->offset, dbFieldSize(col));
+        }
+    }
+    packed.row_count = table->row_count;
+
+    dbPagesRelease(table);
+    dbFree(table, table->rows);
+    table->bytes += packed.bytes;
+    bufferPageMove(&packed, table);
+
+    for (size_t i = 0; i < table->column_count; i++) {
+        if (table->columns[i] != dropped)
+            table->columns[i]->offset = offsets[i];
+    }
+    table->rows = packed.rows;
+    table->row_capacity = packed.row_capacity;
+    table->tuple_size = tuple_size;
+    table->page_rows = packed.page_rows;
+    table->pages = packed.pages;
+    table->page_count = packed.page_count;
+    table->page_capacity = packed.page_capacity;
+    return 1;
+}
+
+/* Adding a column only hands out a new cell slot: the rows already
+ * stored have no cell for it and read 'default_value' (zero when NULL)
+ * until they are rewritten, so it takes the same time on any table.
+ * PACKED tables are rewritten with the new tuple layout instead, the
+ * evaluator only lets that happen while they are empty */
 struct column_t *dbColumnCreate(struct table_t *table, const char col_name[64],
                                 int col_type,
-                                const int constraints[MAX_CONSTRAINTS_NUM]) {
+                                const int constraints[MAX_CONSTRAINTS_NUM],
+                                const union cell_value_t *default_value) {
     if (table->column_count >= MAX_COLUMNS_NUM)
         return NULL;
+    if (table->slot_count >= MAX_COLUMNS_NUM && !dbTableCompact(table))
+        return NULL;
 
-    struct column_t *new_col = malloc(sizeof(struct column_t));
+    struct column_t *new_col = dbAlloc(table, sizeof(struct column_t));
     if (!new_col)
         return NULL;
 
@@ -186,6 +609,11 @@ struct column_t *dbColumnCreate(struct table_t *table, const char col_name[64],
     strncpy(new_col->name, col_name, 63);
     new_col->name[63] = '\0';
     new_col->type = col_type;
+    new_col->slot = table->slot_count;
+    new_col->packed = table->row_format == DB_ROW_PACKED;
+    new_col->table = table;
+    if (default_value)
+        new_col->default_value = *default_value;
 
     if (constraints) {
         memcpy(new_col->constraints, constraints,
@@ -196,9 +624,26 @@ struct column_t *dbColumnCreate(struct table_t *table, const char col_name[64],
 
     table->columns[table->column_count] = new_col;
     table->column_count++;
+
+    if (new_col->packed) {
+        size_t offsets[MAX_COLUMNS_NUM];
+        size_t size = dbTupleLayout(table, NULL, offsets);
+        if (!dbTableRepack(table, offsets, size, new_col, NULL)) {
+            table->column_count--;
+            table->columns[table->column_count] = NULL;
+            dbFree(table, new_col);
+            return NULL;
+        }
+    }
+
+    table->slot_count++;
+    dbCatalogChanged();
     return new_col;
 }
 
+/* Dropping a column leaves its cells in the rows, they are no longer
+ * referenced and go away when the rows are rewritten. PACKED tables are
+ * rewritten without the field right away, see dbColumnCreate() */
 int dbColumnDelete(struct table_t *table, struct column_t *col) {
     if (!table || !col)
         return 0;
@@ -214,7 +659,16 @@ int dbColumnDelete(struct table_t *table, struct column_t *col) {
     if (idx == MAX_COLUMNS_NUM)
         return 0;
 
-    free(col);
+    if (col->packed) {
+        size_t offsets[MAX_COLUMNS_NUM];
+        size_t size = dbTupleLayout(table, col, offsets);
+        if (!dbTableRepack(table, offsets, size, NULL, col))
+            return 0;
+    }
+
+    dbFree(table, col);
+    indexColumnDeleted(table, (int)idx);
+    statsColumnDeleted(table, (int)idx);
 
     for (size_t i = idx; i + 1 < table->column_count; i++) {
         table->columns[i] = table->columns[i + 1];
@@ -222,67 +676,483 @@ int dbColumnDelete(struct table_t *table, struct column_t *col) {
 
     table->columns[table->column_count - 1] = NULL;
     table->column_count--;
+    dbCatalogChanged();
     return 1;
 }
 
-struct row_t *dbRowNew(struct table_t *table) {
-    if (!table || table->row_count >= MAX_ROWS_NUM)
+/* A row holding a cell for every column at slots 'slots', with the
+ * values 'row' has for them */
+static struct row_t *dbRowBuild(struct table_t *table,
+                                const struct row_t *row,
+                                const size_t *slots) {
+    size_t size = sizeof(struct row_t) +
+                  table->column_count * sizeof(union cell_value_t);
+    struct row_t *new_row = dbAlloc(table, size);
+    if (!new_row)
         return NULL;
 
-    struct row_t *new_row = malloc(sizeof(struct row_t));
+    memset(new_row, 0, sizeof(struct row_t));
+    new_row->born = db_generation;
+
+    union cell_value_t *cells = (union cell_value_t *)(new_row + 1);
+    for (size_t i = 0; i < table->column_count; i++) {
+        const struct column_t *col = table->columns[i];
+        const union cell_value_t *cell = row->cells[col->slot];
+        cells[i] = cell ? *cell : col->default_value;
+        new_row->cells[slots[i]] = &cells[i];
+    }
+    return new_row;
+}
+
+/* Rewrites every row of a DYNAMIC table with a cell for every column at
+ * 'slots', nothing changes when out of memory */
+static int dbRowRebuildAll(struct table_t *table, const size_t *slots) {
+    struct row_t **rows = malloc((table->row_count + 1) * sizeof(*rows));
+    if (!rows)
+        return 0;
+
+    for (size_t r = 0; r < table->row_count; r++) {
+        rows[r] = dbRowBuild(table, table->rows[r], slots);
+        if (!rows[r]) {
+            while (r--)
+                dbFree(table, rows[r]);
+            free(rows);
+            return 0;
+        }
+    }
+
+    for (size_t r = 0; r < table->row_count; r++) {
+        dbRowRelease(table, table->rows[r]);
+        table->rows[r] = rows[r];
+    }
+    free(rows);
+    return 1;
+}
+
+/* Gives the columns the slots 0..column_count-1, rewriting the rows of
+ * DYNAMIC tables: this materializes the default values and frees the
+ * cells of the dropped columns. Only needed when the slots run out,
+ * returns 0 (nothing changed) when out of memory */
+int dbTableCompact(struct table_t *table) {
+    if (!table)
+        return 0;
+
+    size_t slots[MAX_COLUMNS_NUM];
+    for (size_t i = 0; i < table->column_count; i++)
+        slots[i] = i;
+
+    if (table->row_format == DB_ROW_DYNAMIC && !dbRowRebuildAll(table, slots))
+        return 0;
+
+    for (size_t i = 0; i < table->column_count; i++)
+        table->columns[i]->slot = i;
+    table->slot_count = table->column_count;
+    return 1;
+}
+
+/* Makes room for 'row_count' rows so that inserting them does not
+ * reallocate the row array */
+int dbRowReserve(struct table_t *table, size_t row_count) {
+    if (!table)
+        return 0;
+    if (row_count <= table->row_capacity)
+        return 1;
+    if (table->row_format == DB_ROW_PACKED)
+        return dbPageReserve(table, row_count);
+
+    size_t capacity = table->row_capacity ? table->row_capacity : 16;
+    while (capacity < row_count)
+        capacity *= 2;
+
+    struct row_t **rows =
+        dbRealloc(table, table->rows, capacity * sizeof(*rows));
+    if (!rows)
+        return 0;
+
+    table->rows = rows;
+    table->row_capacity = capacity;
+    return 1;
+}
+
+/* Makes 'table' a CAPPED table of 'row_count' rows. The row array, and
+ * the pages of a PACKED table, are allocated up front for all of them */
+int dbTableCap(struct table_t *table, size_t row_count) {
+    if (!table || !row_count || !dbRowReserve(table, row_count))
+        return 0;
+
+    table->capped = row_count;
+    return 1;
+}
+
+/* Default values in every field of a PACKED tuple */
+static void dbTupleInit(const struct table_t *table, char *tuple) {
+    memset(tuple, 0, table->tuple_size);
+    for (size_t i = 0; i < table->column_count; i++) {
+        const struct column_t *col = table->columns[i];
+        if (col->type == DB_TYPE_INT)
+            memcpy(tuple + col->offset, &col->default_value.i, sizeof(int));
+    }
+}
+
+/* A DYNAMIC row holding the default value of every column */
+static struct row_t *dbRowAlloc(struct table_t *table) {
+    size_t size = sizeof(struct row_t) +
+                  table->column_count * sizeof(union cell_value_t);
+    struct row_t *new_row = dbAlloc(table, size);
     if (!new_row)
         return NULL;
 
     memset(new_row, 0, sizeof(struct row_t));
+    new_row->born = db_generation;
 
+    union cell_value_t *cells = (union cell_value_t *)(new_row + 1);
     for (size_t i = 0; i < table->column_count; i++) {
-        new_row->cells[i] = malloc(sizeof(union cell_value_t));
+        cells[i] = table->columns[i]->default_value;
+        new_row->cells[table->columns[i]->slot] = &cells[i];
+    }
+    return new_row;
+}
 
-        if (!new_row->cells[i]) {
-            for (size_t j = 0; j < i; j++) {
-                free(new_row->cells[j]);
-            }
+/* The oldest row of a full CAPPED table becomes the new one: its cells
+ * are reset to the default values where they are, so nothing is moved
+ * or allocated. Rows stored before a column was added, or shared with a
+ * snapshot, are the exception and are allocated again */
+static struct row_t *dbRowRecycle(struct table_t *table) {
+    size_t position = table->ring_head;
+    struct row_t *row;
 
-            free(new_row);
+    if (table->row_format == DB_ROW_PACKED) {
+        row = dbTupleWrite(table, position);
+        if (!row)
             return NULL;
+        dbTupleRelease(table, row);
+        dbTupleInit(table, (char *)row);
+    } else {
+        row = table->rows[position];
+
+        int complete = !dbRowShared(table, row);
+        for (size_t i = 0; complete && i < table->column_count; i++)
+            complete = row->cells[table->columns[i]->slot] != NULL;
+
+        if (complete) {
+            for (size_t i = 0; i < table->column_count; i++) {
+                const struct column_t *col = table->columns[i];
+                *row->cells[col->slot] = col->default_value;
+            }
+        } else {
+            struct row_t *new_row = dbRowAlloc(table);
+            if (!new_row)
+                return NULL;
+            dbRowRelease(table, row);
+            table->rows[position] = row = new_row;
         }
+    }
 
-        memset(new_row->cells[i], 0, sizeof(union cell_value_t));
+    table->ring_head = position + 1 < table->capped ? position + 1 : 0;
+    table->rewrite_count++;
+    return row;
+}
+
+/* A row and its cells are a single allocation, there is a cell for every
+ * column of the table, holding its default value, and none for the
+ * dropped ones. PACKED rows take the next tuple of the pages */
+struct row_t *dbRowNew(struct table_t *table) {
+    if (table && table->capped && table->row_count >= table->capped)
+        return dbRowRecycle(table);
+    if (!table || !dbRowReserve(table, table->row_count + 1))
+        return NULL;
+
+    /* The page of the next tuple is not sealed yet, it stays resident */
+    if (table->row_format == DB_ROW_PACKED) {
+        if (table->frozen &&
+            !dbPageThaw(table, table->row_count / table->page_rows))
+            return NULL;
+        dbTupleInit(table, (char *)bufferAccess(table, table->row_count,
+                                                BUFFER_DIRTY));
+        return table->rows[table->row_count++];
     }
 
+    struct row_t *new_row = dbRowAlloc(table);
+    if (!new_row)
+        return NULL;
+
     table->rows[table->row_count] = new_row;
     table->row_count++;
     return new_row;
 }
 
+/* Rewrites the row at position 'row' with a cell for every column so
+ * that it can be written, a no-op for rows stored after the last column
+ * was added and not shared with a snapshot. The row moves: pointers to
+ * it are invalidated. Returns NULL when out of memory, the row is left
+ * unchanged */
+struct row_t *dbRowMaterialize(struct table_t *table, size_t row) {
+    if (table->row_format == DB_ROW_PACKED)
+        return dbTupleWrite(table, row);
+
+    struct row_t *old = table->rows[row];
+    size_t slots[MAX_COLUMNS_NUM];
+    int complete = !dbRowShared(table, old);
+
+    for (size_t i = 0; i < table->column_count; i++) {
+        slots[i] = table->columns[i]->slot;
+        complete &= old->cells[slots[i]] != NULL;
+    }
+    if (complete)
+        return old;
+
+    struct row_t *new_row = dbRowBuild(table, old, slots);
+    if (!new_row)
+        return NULL;
+
+    dbRowRelease(table, old);
+    table->rows[row] = new_row;
+    return new_row;
+}
+
+/* Writes 'value' into the cell of 'col' in 'row', which must have one
+ * (see dbCellStored()). TEXT values of PACKED rows are reallocated to
+ * their length, returns 0 when out of memory */
+int dbCellPut(struct row_t *row, const struct column_t *col,
+              const union cell_value_t *value) {
+    if (!col->packed) {
+        union cell_value_t *cell = row->cells[col->slot];
+        if (col->type == DB_TYPE_INT)
+            cell->i = value->i;
+        else
+            memcpy(cell->s, value->s, strlen(value->s) + 1);
+        return 1;
+    }
+
+    char *field = (char *)row + col->offset;
+    if (col->type == DB_TYPE_INT) {
+        memcpy(field, &value->i, sizeof(int));
+        return 1;
+    }
+
+    size_t len = strlen(value->s) + 1;
+    char *text = dbRealloc(col->table, *(char **)field, len);
+    if (!text)
+        return 0;
+
+    memcpy(text, value->s, len);
+    *(char **)field = text;
+    return 1;
+}
+
 int dbRowDelete(struct table_t *table, struct row_t *row) {
     if (!table || !row)
         return 0;
 
-    size_t idx = MAX_ROWS_NUM;
     for (size_t i = 0; i < table->row_count; i++) {
         if (table->rows[i] == row) {
-            idx = i;
-            break;
+            uint32_t position = (uint32_t)i;
+            return dbRowDeleteMany(table, &position, 1) == 1;
         }
     }
+    return 0;
+}
 
-    if (idx == MAX_ROWS_NUM)
+/* Removes the rows at the positions 'rows' (ascending, no duplicates) in
+ * a single sweep compacting the remaining ones, returns how many were
+ * removed */
+size_t dbRowDeleteMany(struct table_t *table, const uint32_t *rows,
+                       size_t count) {
+    if (!table || !count)
         return 0;
-    for (size_t c = 0; c < table->column_count; c++) {
-        if (row->cells[c]) {
-            free(row->cells[c]);
-            row->cells[c] = NULL;
+
+    size_t kept = rows[0], next = 0;
+
+    /* PACKED tuples move down within the pages, one copy per row. The
+     * pages they move in are copied first when a snapshot shares them */
+    if (table->row_format == DB_ROW_PACKED) {
+        for (size_t p = rows[0] / table->page_rows;
+             table->frozen && p < table->page_count; p++) {
+            if (!dbPageThaw(table, p))
+                return 0;
+        }
+
+        for (size_t r = rows[0]; r < table->row_count; r++) {
+            if (next < count && rows[next] == r) {
+                dbTupleRelease(table, bufferRow(table, r));
+                next++;
+                continue;
+            }
+            memcpy(bufferRowWrite(table, kept++), bufferRow(table, r),
+                   table->tuple_size);
         }
+        table->row_count = kept;
+        indexRowsDeleted(table, rows, next);
+        statsRowsDeleted(table, rows, next);
+        return next;
+    }
+
+    for (size_t r = rows[0]; r < table->row_count; r++) {
+        if (next < count && rows[next] == r) {
+            dbRowRelease(table, table->rows[r]);
+            next++;
+            continue;
+        }
+        table->rows[kept++] = table->rows[r];
+    }
+
+    memset(&table->rows[kept], 0,
+           (table->row_count - kept) * sizeof(struct row_t *));
+    table->row_count = kept;
+    indexRowsDeleted(table, rows, next);
+    statsRowsDeleted(table, rows, next);
+    return next;
+}
+
+/* Drops the rows after the first 'row_count', used to undo the rows
+ * appended by a statement. The remaining rows keep their position so
+ * statistics stay valid */
+void dbRowTruncate(struct table_t *table, size_t row_count) {
+    if (!table)
+        return;
+
+    while (table->row_count > row_count) {
+        size_t last = table->row_count - 1;
+
+        if (table->row_format == DB_ROW_PACKED) {
+            struct row_t *tuple = dbTupleWrite(table, last);
+            if (tuple)
+                dbTupleRelease(table, tuple);
+            table->row_count = last;
+            continue;
+        }
+        table->row_count = last;
+        dbRowRelease(table, table->rows[last]);
+        table->rows[last] = NULL;
+    }
+}
+
+/* Undoes the dbRowNew() of 'row' when its values could not all be
+ * written. The row is dropped, unless it took the place of the oldest
+ * row of a full CAPPED table: it keeps the default values then, since
+ * dropping it would break the ring order */
+void dbRowDiscard(struct table_t *table, struct row_t *row) {
+    size_t last = table->row_count - 1;
+    size_t position =
+        table->capped ? (table->ring_head + last) % table->row_count : last;
+
+    if (position == last) {
+        dbRowTruncate(table, last);
+        return;
+    }
+
+    if (table->row_format == DB_ROW_PACKED) {
+        dbTupleRelease(table, row);
+        dbTupleInit(table, (char *)row);
+        return;
+    }
+    for (size_t i = 0; i < table->column_count; i++) {
+        const struct column_t *col = table->columns[i];
+        *row->cells[col->slot] = col->default_value;
     }
+}
 
-    free(row);
+/* Bytes of a row of 'table': its tuple for PACKED tables, the row with
+ * its cells for DYNAMIC ones. Out-of-line TEXT values are not counted */
+size_t dbRowSize(const struct table_t *table) {
+    if (table->row_format == DB_ROW_PACKED)
+        return table->tuple_size;
+    return sizeof(struct row_t) +
+           table->column_count * sizeof(union cell_value_t);
+}
 
-    for (size_t i = idx; i + 1 < table->row_count; i++) {
-        table->rows[i] = table->rows[i + 1];
+/* Memory held by a database: its own and the one of its tables */
+size_t dbDatabaseBytes(const struct database_t *db) {
+    size_t bytes = malloc_usable_size((void *)db);
+
+    for (size_t i = 0; i < db->table_count; i++)
+        bytes += partBytes(db->tables[i]);
+    return bytes;
+}
+
+struct database_t *dbFind(struct ctx_t *ctx, const char *db_name) {
+    if (!ctx || !db_name)
+        return NULL;
+
+    for (size_t i = 0; i < ctx->database_count; i++) {
+        if (strcmp(ctx->databases[i]->name, db_name) == 0)
+            return ctx->databases[i];
     }
+    return NULL;
+}
 
-    table->rows[table->row_count - 1] = NULL;
-    table->row_count--;
+struct table_t *dbTableFind(struct database_t *db, const char *table_name) {
+    if (!db || !table_name)
+        return NULL;
+
+    for (size_t i = 0; i < db->table_count; i++) {
+        if (strcmp(db->tables[i]->name, table_name) == 0)
+            return db->tables[i];
+    }
+    return NULL;
+}
+
+/* Column names are case insensitive like in MySQL, returns the column
+ * index or -1 when the table has no such column */
+int dbColumnFind(struct table_t *table, const char *col_name) {
+    if (!table || !col_name)
+        return -1;
+
+    for (size_t i = 0; i < table->column_count; i++) {
+        if (strcasecmp(table->columns[i]->name, col_name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/* Maps the type name of a column definition to a DB_TYPE_* code,
+ * anything that is not an integer type is stored as text */
+int dbColumnType(const char *type_name) {
+    if (type_name && (strcasecmp(type_name, "INT") == 0 ||
+                      strcasecmp(type_name, "INTEGER") == 0))
+        return DB_TYPE_INT;
+    return DB_TYPE_TEXT;
+}
+
+/* Maps the name given to ROW_FORMAT to a DB_ROW_* code, 0 when unknown */
+int dbRowFormat(const char *format_name) {
+    if (format_name && strcasecmp(format_name, "DYNAMIC") == 0)
+        return DB_ROW_DYNAMIC;
+    if (format_name && strcasecmp(format_name, "PACKED") == 0)
+        return DB_ROW_PACKED;
+    return 0;
+}
+
+/* Converts the textual representation of a value into a cell according
+ * to the column type, returns 0 if the text is not a valid value */
+int dbCellSet(const struct column_t *col, union cell_value_t *cell,
+              const char *text) {
+    if (!col || !cell || !text)
+        return 0;
+
+    /* Out of range integers are invalid, they are not wrapped */
+    if (col->type == DB_TYPE_INT) {
+        char *end;
+        errno = 0;
+        long value = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || errno == ERANGE ||
+            value < INT_MIN || value > INT_MAX)
+            return 0;
+        cell->i = (int)value;
+        return 1;
+    }
+
+    /* Texts that do not fit a cell are not truncated either */
+    size_t len = strlen(text);
+    if (len > sizeof(cell->s) - 1)
+        return 0;
+    memcpy(cell->s, text, len + 1);
     return 1;
 }
+
+int dbCellCompare(const struct column_t *col, const union cell_value_t *a,
+                  const union cell_value_t *b) {
+    if (col->type == DB_TYPE_INT)
+        return (a->i > b->i) - (a->i < b->i);
+    return strcmp(a->s, b->s);
+}
@@ -18,42 +18,143 @@
 
 #include <ctype.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define MAX_TABLE_NUM 64
 #define MAX_COLUMNS_NUM 64
 #define MAX_CONSTRAINTS_NUM 4
-#define MAX_ROWS_NUM 2048
 #define MAX_DB_NUM 32
 
-struct column_t {
-    char name[64];
-    int type;
-    int constraints[MAX_CONSTRAINTS_NUM];
+/* Column data types */
+#define DB_TYPE_INT 0x01
+#define DB_TYPE_TEXT 0x02
+
+/* Row formats, see 'CREATE TABLE ... ROW_FORMAT = PACKED' */
+#define DB_ROW_DYNAMIC 0x01 /* a cell per column, columns change in O(1) */
+#define DB_ROW_PACKED 0x02  /* fixed width tuples stored inline in pages */
+
+/* Bytes of a page of PACKED tuples */
+#define DB_PAGE_SIZE 16384
+
+/* A page of tuples of a PACKED table, see buffer.h */
+struct db_page_t {
+    char *data;               /* NULL while the page is spilled */
+    int64_t spill;            /* offset of its copy in the spill file or -1 */
+    uint64_t epoch;           /* pinned while buffer_epoch is the same */
+    size_t frame;             /* slot in the buffer pool while resident */
+    unsigned char referenced; /* CLOCK reference bit */
+    unsigned char dirty;      /* changed since written to the spill file */
+    uint32_t born;            /* dbGeneration() when allocated */
 };
 
+struct table_stats_t; /* see stats.h */
+struct index_t;       /* see index.h */
+struct part_t;        /* see part.h */
+struct snap_t;        /* see snap.h */
+
 union cell_value_t {
     int i;
     char s[256];
 };
 
+/* Columns of DYNAMIC tables keep the cell slot they were given when
+ * added, so adding or dropping a column never moves the cells of the rows
+ * already stored. Columns of PACKED tables are a field of the tuple */
+struct column_t {
+    char name[64];
+    int type;
+    int constraints[MAX_CONSTRAINTS_NUM];
+    size_t slot;                      /* cell of the column in the rows */
+    union cell_value_t default_value; /* read from rows without the cell */
+    int packed;                       /* the table is ROW_FORMAT = PACKED */
+    size_t offset;                    /* PACKED: field in the tuple */
+    struct table_t *table; /* charged for the TEXT values of PACKED rows */
+};
+
+/* Indexed by column slot. Rows stored before a column was added have no
+ * cell for it (NULL) and the cells of dropped columns are left in place
+ * unreferenced, see dbCellInt() and dbTableCompact().
+ *
+ * Rows of PACKED tables are tuples instead, 'struct row_t *' is only a
+ * handle to them: INT fields hold the value, TEXT fields a reference to a
+ * string allocated out of line (NULL for the default value) */
 struct row_t {
     union cell_value_t *cells[MAX_COLUMNS_NUM];
+    uint32_t born; /* dbGeneration() when allocated */
+};
+
+/* A row or a page the live table replaced while a snapshot still held
+ * it, freed once no snapshot taken in (born, died] is left. The TEXT
+ * values of the first 'tuples' tuples of a page go with it */
+struct db_grave_t {
+    void *data;
+    uint32_t born;
+    uint32_t died;
+    size_t tuples;
+    size_t tuple_size;
+    size_t texts; /* TEXT fields, they come first in a tuple */
 };
 
 struct table_t {
     char name[64];
     struct column_t *columns[MAX_COLUMNS_NUM];
     size_t column_count;
-    struct row_t *rows[MAX_ROWS_NUM];
+    size_t slot_count; /* slots handed out, dropped columns included */
+    struct row_t **rows; /* grows on demand, see dbRowReserve() */
     size_t row_count;
+    size_t row_capacity;
+
+    /* PACKED tables store row 'r' in page r / page_rows, the rows array
+     * holds the address of every tuple of the resident pages. Pages are
+     * added one at a time, page_capacity is the length of the arrays */
+    int row_format;
+    size_t tuple_size;
+    size_t page_rows;
+    struct db_page_t *pages;
+    size_t page_count;
+    size_t page_capacity;
+
+    /* Statistics gathered by ANALYZE TABLE (NULL until analyzed) and the
+     * number of rows a CAPPED table recycled so far, used to detect when
+     * zone maps and indexes no longer line up with the rows. DELETE and
+     * UPDATE fix them instead */
+    struct table_stats_t *stats;
+    size_t rewrite_count;
+
+    struct index_t *indexes; /* list of the indexes of the table */
+
+    /* 'PARTITION BY', the rows are stored in the partitions instead of
+     * the table itself, NULL for a table that is not partitioned */
+    struct part_t *partitioning;
+
+    /* 'CAPPED (n ROWS)' tables hold at most 'capped' rows (0 when not
+     * capped). Once full, a new row overwrites the oldest one in place,
+     * at position ring_head, so the rows read from ring_head on are the
+     * oldest ones */
+    size_t capped;
+    size_t ring_head;
+
+    /* Snapshots (see snap.h) share the rows and pages born before
+     * generation 'frozen' (0 when none does): they are copied before
+     * being written and the originals kept in 'graves' for them. Such
+     * a table can't be deleted until the snapshots are dropped */
+    uint32_t frozen;
+    struct db_grave_t *graves;
+    size_t grave_count;
+    size_t grave_capacity;
+
+    /* Heap memory held by the table, its columns and its rows. Indexes
+     * and statistics are not counted */
+    size_t bytes;
 };
 
 struct database_t {
     char name[64];
     struct table_t *tables[MAX_TABLE_NUM];
     size_t table_count;
+    struct snap_t *snapshot; /* read only view of another database */
 };
 
 struct ctx_t {
@@ -69,11 +170,79 @@ void dbReleaseTables(struct database_t *db);
 int dbDelete(struct ctx_t *ctx, struct database_t *db);
 struct table_t *dbTableNew(struct database_t *db, const char table_name[64]);
 int dbTableDelete(struct database_t *db, struct table_t *table);
+struct table_t *dbTableClone(const struct table_t *table,
+                             const char table_name[64]);
+void dbTableFree(struct table_t *table);
+struct table_t *dbTableFreeze(struct table_t *table, uint32_t generation);
+void dbTableUnfreeze(struct table_t *table, const uint32_t *generations,
+                     size_t count);
+void dbTableFreeFrozen(struct table_t *frozen);
 struct column_t *dbColumnCreate(struct table_t *table, const char col_name[64],
                                 int col_type,
-                                const int constraints[MAX_CONSTRAINTS_NUM]);
+                                const int constraints[MAX_CONSTRAINTS_NUM],
+                                const union cell_value_t *default_value);
 int dbColumnDelete(struct table_t *table, struct column_t *col);
+int dbTableCompact(struct table_t *table);
+int dbRowReserve(struct table_t *table, size_t row_count);
+int dbTableCap(struct table_t *table, size_t row_count);
 struct row_t *dbRowNew(struct table_t *table);
+struct row_t *dbRowMaterialize(struct table_t *table, size_t row);
+int dbCellPut(struct row_t *row, const struct column_t *col,
+              const union cell_value_t *value);
 int dbRowDelete(struct table_t *table, struct row_t *row);
+size_t dbRowDeleteMany(struct table_t *table, const uint32_t *rows,
+                       size_t count);
+void dbRowTruncate(struct table_t *table, size_t row_count);
+void dbRowDiscard(struct table_t *table, struct row_t *row);
+size_t dbRowSize(const struct table_t *table);
+size_t dbDatabaseBytes(const struct database_t *db);
+
+size_t dbCatalogVersion(void);
+void dbCatalogChanged(void);
+uint32_t dbGeneration(void);
+uint32_t dbGenerationNext(void);
+
+struct database_t *dbFind(struct ctx_t *ctx, const char *db_name);
+struct table_t *dbTableFind(struct database_t *db, const char *table_name);
+int dbColumnFind(struct table_t *table, const char *col_name);
+int dbColumnType(const char *type_name);
+int dbRowFormat(const char *format_name);
+int dbCellSet(const struct column_t *col, union cell_value_t *cell,
+              const char *text);
+int dbCellCompare(const struct column_t *col, const union cell_value_t *a,
+                  const union cell_value_t *b);
+
+/* Value of the INT or TEXT column 'col' in 'row', the default value of
+ * the column when the row was stored before the column was added */
+static inline int dbCellInt(const struct row_t *row,
+                            const struct column_t *col) {
+    if (col->packed) {
+        int value;
+        memcpy(&value, (const char *)row + col->offset, sizeof(int));
+        return value;
+    }
+
+    const union cell_value_t *cell = row->cells[col->slot];
+    return cell ? cell->i : col->default_value.i;
+}
+
+static inline const char *dbCellText(const struct row_t *row,
+                                     const struct column_t *col) {
+    if (col->packed) {
+        const char *text = *(const char *const *)((const char *)row +
+                                                  col->offset);
+        return text ? text : col->default_value.s;
+    }
+
+    const union cell_value_t *cell = row->cells[col->slot];
+    return cell ? cell->s : col->default_value.s;
+}
+
+/* Whether 'row' has a cell of its own for 'col', dbCellPut() needs one
+ * (see dbRowMaterialize()) */
+static inline int dbCellStored(const struct row_t *row,
+                               const struct column_t *col) {
+    return col->packed || row->cells[col->slot];
+}
 
 #endif /* _DB_H */
@@ -27,15 +27,44 @@
  *  Originally-authored-by: Davide Usberti <usbertibox@gmail.com>
  */
 #include "eval.h"
+#include "api.h"
+#include "arena.h"
+#include "buffer.h"
+#include "cache.h"
 #include "db.h"
+#include "index.h"
+#include "insert.h"
 #include "lex.h"
 #include "logs.h"
+#include "metrics.h"
 #include "parser.h"
+#include "part.h"
+#include "plan.h"
+#include "prof.h"
+#include "snap.h"
+#include "stats.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 struct ctx_t *context = NULL;
 
+/* Database selected with 'USE db_name;', tables are resolved here */
+struct database_t *current_db = NULL;
+
+/* Storage latch, held by the thread running a statement and by ingest
+ * appliers while they append (see ingest.h). Recursive since PREPARE
+ * and EXECUTE go through the prepared statement API, which takes it */
+static pthread_mutex_t ev_latch;
+static pthread_once_t ev_latch_once = PTHREAD_ONCE_INIT;
+
+/* Memory of the statement being executed, reset by every evExecute() */
+struct arena_t statement_arena;
+
 /* Basic function to handle the global variable context,
  * if the context exists returns it, else creates it*/
 struct ctx_t *evGetContext() {
@@ -44,19 +73,26 @@ struct ctx_t *evGetContext() {
     return context;
 }
 
-/* Evaluator initialization */
-evaluator_t *evCreateEvaluator(char *input) {
+/* Evaluator initialization, the evaluator, the lexer, the parser and
+ * the AST all live in 'arena' and are released when it is reset */
+evaluator_t *evCreateEvaluator(char *input, struct arena_t *arena) {
 
     /* Lexer initialization */
-    struct lexer_t lexer;
-    lexInitialize(&lexer, input);
+    struct lexer_t *lexer = arenaAlloc(arena, sizeof(struct lexer_t));
+    if (!lexer)
+        return NULL;
+    lexInitialize(lexer, input);
 
     /* Parser initialization */
-    struct parser_t *parser = parserCreate(&lexer);
+    struct parser_t *parser = parserCreate(lexer, arena);
+    if (!parser)
+        return NULL;
     struct ast_node_t *ast = parserParse(parser);
 
     /* Evaluator initialization */
-    evaluator_t *eval = malloc(sizeof(evaluator_t));
+    evaluator_t *eval = arenaAlloc(arena, sizeof(evaluator_t));
+    if (!eval)
+        return NULL;
     memset(eval, 0, sizeof(evaluator_t));
 
     eval->parser = parser;
@@ -65,7 +101,7 @@ evaluator_t *evCreateEvaluator(char *input) {
     if (!ast) {
         const char *err = parserGetError(parser);
         if (err) {
-            eval->errors = strdup(err);
+            eval->errors = arenaStrdup(arena, err);
             LOG_ERROR("Failed to parse: %s", err);
         }
     }
@@ -73,49 +109,2038 @@ evaluator_t *evCreateEvaluator(char *input) {
     return eval;
 }
 
-void evEvaluateNode(struct ast_node_t *node) {
+static void evLatchInit(void) {
+    pthread_mutexattr_t attr;
 
-    if (!node)
-        LOG_ERROR("Falied to parse node (NULL)");
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ev_latch, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
 
-    struct ctx_t *ctx = evGetContext();
+void evLock(void) {
+    pthread_once(&ev_latch_once, evLatchInit);
+    pthread_mutex_lock(&ev_latch);
+}
 
-    switch (node->type) {
-    case AST_CREATE_DATABASE:
-        if (node->child_count != 1) {
-            LOG_ERROR(
-                "CRATE DATABASE only accepts 1 identifier (database_name).");
+void evUnlock(void) {
+    pthread_mutex_unlock(&ev_latch);
+}
+
+/* Returns the database selected by USE, logging an error if none is */
+struct database_t *evGetDatabase(void) {
+    if (!current_db)
+        LOG_ERROR("No database selected");
+    return current_db;
+}
+
+void evForgetDatabase(const struct database_t *db) {
+    if (current_db == db)
+        current_db = NULL;
+}
+
+/* The current database for a statement changing it, snapshots are read
+ * only */
+static struct database_t *evWritableDatabase(void) {
+    struct database_t *db = evGetDatabase();
+
+    if (db && db->snapshot) {
+        LOG_ERROR("Snapshot '%s' is read only", db->name);
+        return NULL;
+    }
+    return db;
+}
+
+/* Resolve a table of the current database by its identifier node, for
+ * statements changing it */
+static struct table_t *evGetTable(struct ast_node_t *name_node) {
+    struct database_t *db = evWritableDatabase();
+    if (!db)
+        return NULL;
+
+    struct table_t *table = dbTableFind(db, name_node->value);
+    if (!table)
+        LOG_ERROR("Table '%s' doesn't exist", name_node->value);
+    return table;
+}
+
+/* Value of a literal or placeholder node, placeholders are taken from
+ * the parameters extracted by evExecute() */
+static int evNodeParam(struct ast_node_t *node,
+                       const struct plan_param_t *params, size_t param_count,
+                       struct plan_param_t *out) {
+    if (node->type == AST_LITERAL) {
+        out->type = PLAN_PARAM_TEXT;
+        out->i = 0;
+        out->s = node->value;
+        out->len = strlen(node->value);
+        out->escaped = 0;
+        return 1;
+    }
+
+    size_t idx = (size_t)atoi(node->value);
+    if (node->type != AST_PARAM || idx >= param_count ||
+        params[idx].type == PLAN_PARAM_UNBOUND) {
+        LOG_ERROR("Expected a value");
+        return 0;
+    }
+
+    *out = params[idx];
+    return 1;
+}
+
+/* Integer literal or placeholder optionally negated, the partition
+ * bounds and counts of CREATE TABLE */
+static int evNodeInt(struct ast_node_t *node,
+                     const struct plan_param_t *params, size_t param_count,
+                     int *out) {
+    int negate = node->type == AST_UNARY_OP && node->child_count == 1 &&
+                 strcmp(node->value, "-") == 0;
+    if (negate)
+        node = node->children[0];
+
+    struct plan_param_t value;
+    if ((node->type != AST_LITERAL && node->type != AST_PARAM) ||
+        !evNodeParam(node, params, param_count, &value)) {
+        LOG_ERROR("Expected an integer");
+        return 0;
+    }
+
+    long number = value.i;
+    if (value.type == PLAN_PARAM_TEXT) {
+        char text[32], *end;
+        size_t len = value.len < sizeof(text) ? value.len : 0;
+
+        memcpy(text, value.s, len);
+        text[len] = '\0';
+        errno = 0;
+        number = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || errno == ERANGE ||
+            number == LONG_MIN) {
+            LOG_ERROR("Expected an integer");
+            return 0;
+        }
+    }
+
+    /* Negated first, -2147483648 fits */
+    if (negate)
+        number = -number;
+    if (number < INT_MIN || number > INT_MAX) {
+        LOG_ERROR("Expected an integer");
+        return 0;
+    }
+    *out = (int)number;
+    return 1;
+}
+
+/* 'PARTITION name VALUES LESS THAN (value | MAXVALUE)' */
+static int evAddPartition(struct table_t *table, struct ast_node_t *node,
+                          const struct plan_param_t *params,
+                          size_t param_count) {
+    int64_t bound = PART_MAXVALUE;
+    int value;
+
+    if (node->child_count > 1) {
+        if (!evNodeInt(node->children[1], params, param_count, &value))
+            return 0;
+        bound = value;
+    }
+    return partAdd(table, node->children[0]->value, bound) != NULL;
+}
+
+/* PARTITION BY of CREATE TABLE, applied once the table has its columns.
+ * HASH partitions are named p0, p1... */
+static int evPartitionTable(struct table_t *table, struct ast_node_t *node,
+                            const struct plan_param_t *params,
+                            size_t param_count) {
+    int method = strcmp(node->value, "HASH") == 0 ? PART_HASH : PART_RANGE;
+    const char *col_name = node->children[0]->value;
+    int column = dbColumnFind(table, col_name);
+
+    if (column < 0) {
+        LOG_ERROR("Unknown column '%s'", col_name);
+        return 0;
+    }
+    if (!partCreate(table, method, column))
+        return 0;
+
+    if (method == PART_RANGE) {
+        for (size_t i = 1; i < node->child_count; i++) {
+            if (!evAddPartition(table, node->children[i], params,
+                                param_count))
+                return 0;
+        }
+        return 1;
+    }
+
+    int count;
+    if (!evNodeInt(node->children[1], params, param_count, &count))
+        return 0;
+    if (count < 1 || count > PART_MAX) {
+        LOG_ERROR("Number of partitions must be between 1 and %d", PART_MAX);
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "p%d", i);
+        if (!partAdd(table, name, 0))
+            return 0;
+    }
+    return 1;
+}
+
+/* CAPPED option of CREATE TABLE, a limit in bytes is turned into rows
+ * of the size the table has once created */
+static int evCapTable(struct table_t *table, struct ast_node_t *node,
+                      const struct plan_param_t *params, size_t param_count) {
+    int limit;
+
+    if (table->partitioning) {
+        LOG_ERROR("A partitioned table can't be CAPPED");
+        return 0;
+    }
+    if (!evNodeInt(node->children[0], params, param_count, &limit))
+        return 0;
+    if (limit < 1) {
+        LOG_ERROR("CAPPED expects a positive limit");
+        return 0;
+    }
+
+    size_t rows = (size_t)limit;
+    if (strcmp(node->value, "BYTES") == 0) {
+        rows /= dbRowSize(table);
+        rows = rows ? rows : 1;
+    }
+
+    if (!dbTableCap(table, rows)) {
+        LOG_ERROR("Unable to allocate %zu rows for table '%s'", rows,
+                  table->name);
+        return 0;
+    }
+    return 1;
+}
+
+/* Converts the DEFAULT of a column of CREATE TABLE or of 'ALTER TABLE
+ * ... ADD' into a cell of 'col', a literal or a placeholder optionally
+ * negated */
+static int evDefaultValue(struct ast_node_t *node,
+                          const struct plan_param_t *params,
+                          size_t param_count, const struct column_t *col,
+                          union cell_value_t *cell) {
+    int negate = node->type == AST_UNARY_OP && node->child_count == 1 &&
+                 strcmp(node->value, "-") == 0;
+    if (negate)
+        node = node->children[0];
+
+    struct plan_param_t value;
+    if ((node->type == AST_LITERAL && node->op == NULL_KW) ||
+        (node->type != AST_LITERAL && node->type != AST_PARAM)) {
+        LOG_ERROR("DEFAULT expects a literal value");
+        return 0;
+    }
+    if (!evNodeParam(node, params, param_count, &value))
+        return 0;
+
+    char text[sizeof(cell->s) + 1];
+    if (value.type == PLAN_PARAM_INT) {
+        snprintf(text, sizeof(text), "%s%d", negate ? "-" : "", value.i);
+    } else {
+        size_t len = value.len;
+        if ((value.escaped ? lexUnescapedLength(value.s, len) : len) >
+            sizeof(cell->s) - 1) {
+            LOG_ERROR("Invalid default value for column '%s'", col->name);
+            return 0;
+        }
+        text[0] = '-';
+        char *out = text + negate;
+        if (value.escaped)
+            len = lexUnescape(value.s, len, out);
+        else
+            memcpy(out, value.s, len);
+        out[len] = '\0';
+    }
+
+    if ((negate && col->type != DB_TYPE_INT) || !dbCellSet(col, cell, text)) {
+        LOG_ERROR("Invalid default value for column '%s'", col->name);
+        return 0;
+    }
+    return 1;
+}
+
+/* CREATE TABLE: children are the table name, the column definitions,
+ * the optional table options and the optional partitioning */
+static void evCreateTable(struct ast_node_t *node,
+                          const struct plan_param_t *params,
+                          size_t param_count) {
+    struct database_t *db = evWritableDatabase();
+    if (!db)
+        return;
+
+    const char *name = node->children[0]->value;
+    if (dbTableFind(db, name)) {
+        LOG_ERROR("Table '%s' already exists", name);
+        return;
+    }
+
+    int format = DB_ROW_DYNAMIC;
+    struct ast_node_t *partitioning = NULL, *capped = NULL;
+    for (size_t i = 2; i < node->child_count; i++) {
+        struct ast_node_t *option = node->children[i];
+        if (option->type == AST_PARTITION_BY) {
+            partitioning = option;
+            continue;
+        }
+        if (option->type == AST_CAPPED) {
+            capped = option;
+            continue;
+        }
+
+        const char *format_name = option->children[0]->value;
+        if (!(format = dbRowFormat(format_name))) {
+            LOG_ERROR("Unknown row format '%s'", format_name);
             return;
         }
-        struct ast_node_t *db_name_node = node->children[0];
-        char *db_name =
-            db_name_node->type == AST_IDENTIFIER ? db_name_node->value : NULL;
+    }
 
-        if (!db_name) {
-            LOG_ERROR("Invalid db_name provided");
+    struct table_t *table = dbTableNew(db, name);
+    if (!table) {
+        LOG_ERROR("Unable to create table '%s'", name);
+        return;
+    }
+    table->row_format = format;
+
+    struct ast_node_t *columns = node->children[1];
+    for (size_t i = 0; i < columns->child_count; i++) {
+        struct ast_node_t *def = columns->children[i];
+        const char *type_name =
+            def->child_count > 1 ? def->children[1]->value : NULL;
+        struct column_t col = {.type = dbColumnType(type_name)};
+        union cell_value_t value;
+
+        strncpy(col.name, def->children[0]->value, sizeof(col.name) - 1);
+        memset(&value, 0, sizeof(value));
+        if (def->child_count > 2 &&
+            !evDefaultValue(def->children[2], params, param_count, &col,
+                            &value)) {
+            dbTableDelete(db, table);
+            return;
         }
 
-        struct database_t *new_database = dbCreateNew(ctx, db_name);
-        LOG_INFO("New Database %s created successfully", new_database->name);
-        break;
+        if (!dbColumnCreate(table, def->children[0]->value, col.type, NULL,
+                            &value)) {
+            LOG_ERROR("Unable to create column '%s'",
+                      def->children[0]->value);
+            dbTableDelete(db, table);
+            return;
+        }
+    }
+
+    if (partitioning &&
+        !evPartitionTable(table, partitioning, params, param_count)) {
+        dbTableDelete(db, table);
+        return;
+    }
+    if (capped && !evCapTable(table, capped, params, param_count)) {
+        dbTableDelete(db, table);
+        return;
+    }
+
+    LOG_INFO("New Table %s created successfully", table->name);
+}
+
+/* CREATE INDEX: children are the index, table and column names and the
+ * optional index type */
+static void evCreateIndex(struct ast_node_t *node) {
+    struct table_t *table = evGetTable(node->children[1]);
+    if (!table)
+        return;
+    if (table->partitioning || table->capped) {
+        LOG_ERROR("Indexes on %s table '%s' are not supported",
+                  table->capped ? "capped" : "partitioned", table->name);
+        return;
+    }
+
+    const char *col_name = node->children[2]->value;
+    int column = dbColumnFind(table, col_name);
+    if (column < 0) {
+        LOG_ERROR("Unknown column '%s'", col_name);
+        return;
+    }
+
+    int type = INDEX_SORTED;
+    if (node->child_count > 3 &&
+        !(type = indexTypeFromName(node->children[3]->value))) {
+        LOG_ERROR("Unknown index type '%s'", node->children[3]->value);
+        return;
+    }
+
+    struct index_t *index =
+        indexCreate(table, node->children[0]->value, column, type);
+    if (!index)
+        return;
+
+    LOG_INFO("Index %s created on %s (%s) using %s", index->name,
+             table->name, col_name, indexTypeName(type));
+}
+
+/* Partition the r-th row of an INSERT goes to, by the value given to
+ * the partitioning column or its default value */
+static struct table_t *evInsertPartition(const struct plan_t *plan, size_t r,
+                                         const struct plan_param_t *params) {
+    const struct table_t *table = plan->table;
+    const struct column_t *col = table->columns[table->partitioning->column];
+    union cell_value_t cell = col->default_value;
+
+    for (size_t i = 0; i < plan->target_count; i++) {
+        if (plan->targets[i] == table->partitioning->column &&
+            !planSetCell(plan, col, &plan->values[r * plan->target_count + i],
+                         params, NULL, &cell)) {
+            LOG_ERROR("Invalid value for column '%s'", col->name);
+            return NULL;
+        }
+    }
+
+    struct table_t *partition = partRoute(table, cell.i);
+    if (!partition)
+        LOG_ERROR("Table '%s' has no partition for value %d", table->name,
+                  cell.i);
+    return partition;
+}
+
+/* Append one row per value list, values are converted straight into
+ * the new cells */
+static int evExecuteInsert(struct plan_t *plan,
+                           const struct plan_param_t *params) {
+    struct table_t *table = plan->table;
+    size_t inserted = 0;
+
+    union cell_value_t cells[MAX_COLUMNS_NUM];
+
+    for (size_t r = 0; r < plan->value_rows; r++) {
+        struct table_t *target = table;
+        if (table->partitioning &&
+            !(target = evInsertPartition(plan, r, params)))
+            break;
+
+        /* Values are all converted before the row is taken, a CAPPED
+         * table overwrites its oldest row with it */
+        for (size_t i = 0; i < plan->target_count; i++) {
+            struct column_t *col = target->columns[plan->targets[i]];
+            const struct plan_value_t *value =
+                &plan->values[r * plan->target_count + i];
+
+            if (!planSetCell(plan, col, value, params, NULL, &cells[i])) {
+                LOG_ERROR("Invalid value for column '%s'", col->name);
+                goto done;
+            }
+        }
+
+        struct row_t *row = dbRowNew(target);
+        if (!row) {
+            LOG_ERROR("Unable to insert into table '%s'", table->name);
+            break;
+        }
+
+        for (size_t i = 0; i < plan->target_count; i++) {
+            if (!dbCellPut(row, target->columns[plan->targets[i]],
+                           &cells[i])) {
+                LOG_ERROR("Unable to insert into table '%s'", table->name);
+                dbRowDiscard(target, row);
+                goto done;
+            }
+        }
+        inserted++;
+    }
+
+done:
+    metricsAdd(METRIC_ROWS_INSERTED, inserted);
+    if (plan->profile)
+        plan->profile->output.rows_out = inserted;
+    LOG_INFO("%zu row(s) inserted into %s", inserted, table->name);
+    return inserted == plan->value_rows;
+}
+
+static int evPredicateMatches(const struct plan_t *plan,
+                              const struct row_t *row) {
+    if (plan->pred.column < 0)
+        return 1;
+
+    const struct column_t *col = plan->table->columns[plan->pred.column];
+    const union cell_value_t *value = &plan->pred.value.cell;
+    int cmp;
+    if (col->type == DB_TYPE_INT) {
+        int v = dbCellInt(row, col);
+        cmp = (v > value->i) - (v < value->i);
+    } else {
+        cmp = strcmp(dbCellText(row, col), value->s);
+    }
+
+    switch (plan->pred.op) {
+    case RSQL_ET_OP:
+        return cmp == 0;
+    case RSQL_NE_OP:
+        return cmp != 0;
+    case RSQL_LT_OP:
+        return cmp < 0;
+    case RSQL_LE_OP:
+        return cmp <= 0;
+    case RSQL_GT_OP:
+        return cmp > 0;
+    case RSQL_GE_OP:
+        return cmp >= 0;
     default:
-        LOG_ERROR("Invalid AST type");
+        return 0;
+    }
+}
+
+/* The access predicate is checked first, it is the most selective */
+static int evRowMatches(const struct plan_t *plan, const struct row_t *row) {
+    return evPredicateMatches(plan, row) &&
+           (!plan->filter || exprMatches(plan->filter, row, plan->bound));
+}
+
+static void evPrintRow(const struct plan_t *plan, const struct row_t *row) {
+    for (size_t i = 0; i < plan->projection_count; i++) {
+        const struct column_t *col = plan->table->columns[plan->projection[i]];
+        if (i)
+            printf(" | ");
+        if (col->type == DB_TYPE_INT)
+            printf("%d", dbCellInt(row, col));
+        else
+            printf("%s", dbCellText(row, col));
+    }
+    printf("\n");
+}
+
+/* Called with the position of every row matching the WHERE condition of
+ * a plan, in ascending order */
+typedef void (*ev_visit_t)(const struct plan_t *plan, size_t row, void *data);
+
+/* Scan rows [from, to) visiting the ones matching the predicate */
+static size_t evScanRange(const struct plan_t *plan, size_t from, size_t to,
+                          ev_visit_t visit, void *data) {
+    size_t matched = 0;
+
+    metricsAdd(METRIC_ROWS_SCANNED, to - from);
+    if (plan->profile && to > from) {
+        plan->profile->scan.rows_in += to - from;
+        plan->profile->scan.batches++;
+    }
+
+    /* Tables held in memory are read without going through the pool */
+    struct row_t *const *rows = plan->table->rows;
+    int paged = bufferPaged(plan->table);
+
+    for (size_t r = from; r < to; r++) {
+        if (evRowMatches(plan, paged ? bufferRowScan(plan->table, r)
+                                     : rows[r])) {
+            visit(plan, r, data);
+            matched++;
+        }
+    }
+    return matched;
+}
+
+/* Visit only the candidate rows returned by the index of the plan */
+static size_t evScanIndex(const struct plan_t *plan, ev_visit_t visit,
+                          void *data) {
+    struct index_rows_t candidates;
+    size_t matched = 0;
+
+    if (!indexLookup(plan->index, &plan->probe, &candidates)) {
+        LOG_ERROR("Unable to read index '%s'", plan->index->name);
+        return 0;
+    }
+
+    metricsAdd(METRIC_INDEX_SCANS, 1);
+    metricsAdd(METRIC_ROWS_SCANNED, candidates.count);
+    if (plan->profile) {
+        plan->profile->scan.rows_in += candidates.count;
+        plan->profile->scan.batches++;
+    }
+
+    for (size_t i = 0; i < candidates.count; i++) {
+        const struct row_t *row =
+            bufferRowScan(plan->table, candidates.rows[i]);
+        if (evRowMatches(plan, row)) {
+            visit(plan, candidates.rows[i], data);
+            matched++;
+        }
+    }
+
+    free(candidates.rows);
+    return matched;
+}
+
+/* Visit the rows left by the bitmap indexes of the plan */
+static size_t evScanBitmap(const struct plan_t *plan, ev_visit_t visit,
+                           void *data) {
+    size_t count = bitmapCardinality(&plan->bitmap), matched = 0;
+    uint32_t *rows = malloc(count * sizeof(uint32_t) + 1);
+
+    if (!rows) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+
+    bitmapToArray(&plan->bitmap, rows);
+    metricsAdd(METRIC_BITMAP_SCANS, 1);
+    metricsAdd(METRIC_ROWS_SCANNED, count);
+    if (plan->profile) {
+        plan->profile->scan.rows_in += count;
+        plan->profile->scan.batches++;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const struct row_t *row = bufferRowScan(plan->table, rows[i]);
+        if (evRowMatches(plan, row)) {
+            visit(plan, rows[i], data);
+            matched++;
+        }
+    }
+
+    free(rows);
+    return matched;
+}
+
+/* Visit the rows matching the WHERE condition through the access path of
+ * the plan, returns how many there are */
+static size_t evScanAccess(const struct plan_t *plan, ev_visit_t visit,
+                           void *data) {
+    const struct table_t *table = plan->table;
+    size_t matched = 0, from = 0;
+
+    if (plan->access == PLAN_INDEX_SCAN)
+        return evScanIndex(plan, visit, data);
+    if (plan->access == PLAN_BITMAP_SCAN)
+        return evScanBitmap(plan, visit, data);
+
+    /* Oldest rows first once a CAPPED table went around */
+    if (plan->access == PLAN_FULL_SCAN && table->ring_head)
+        return evScanRange(plan, table->ring_head, table->row_count, visit,
+                           data) +
+               evScanRange(plan, 0, table->ring_head, visit, data);
+
+    if (plan->access == PLAN_ZONE_MAP_SCAN) {
+        size_t zones = statsUsableZones(table);
+        for (size_t z = 0; z < zones; z++) {
+            if (statsZoneMayMatch(table, plan->pred.column, z, plan->pred.op,
+                                  &plan->pred.value.cell))
+                matched += evScanRange(plan, z * STATS_ZONE_ROWS,
+                                       (z + 1) * STATS_ZONE_ROWS, visit, data);
+        }
+        from = zones * STATS_ZONE_ROWS;
+    }
+
+    return matched + evScanRange(plan, from, table->row_count, visit, data);
+}
+
+/* Visitor of a profiled scan, the time spent in the visitor belongs to
+ * the operator consuming the rows rather than to the scan */
+struct ev_profiled_t {
+    ev_visit_t visit;
+    void *data;
+    uint64_t ticks;
+};
+
+static void evVisitProfiled(const struct plan_t *plan, size_t row,
+                            void *data) {
+    struct ev_profiled_t *inner = data;
+    uint64_t start = profNow();
+
+    inner->visit(plan, row, inner->data);
+    inner->ticks += profNow() - start;
+}
+
+static size_t evScan(const struct plan_t *plan, ev_visit_t visit,
+                     void *data) {
+    if (!plan->profile)
+        return evScanAccess(plan, visit, data);
+
+    struct ev_profiled_t inner = {visit, data, 0};
+    uint64_t start = profNow();
+    size_t matched = evScanAccess(plan, evVisitProfiled, &inner);
+
+    plan->profile->scan.ticks += profNow() - start - inner.ticks;
+    plan->profile->scan.rows_out += matched;
+    return matched;
+}
+
+static void evVisitPrint(const struct plan_t *plan, size_t row, void *data) {
+    (void)data;
+    evPrintRow(plan, bufferRowScan(plan->table, row));
+}
+
+/* EXPLAIN ANALYZE, the projected cells are read but not printed */
+static void evVisitProduce(const struct plan_t *plan, size_t row,
+                           void *data) {
+    const struct row_t *cells = bufferRowScan(plan->table, row);
+    struct prof_op_t *output = &plan->profile->output;
+    (void)data;
+
+    for (size_t i = 0; i < plan->projection_count; i++) {
+        const struct column_t *col = plan->table->columns[plan->projection[i]];
+        output->bytes += col->type == DB_TYPE_INT
+                             ? sizeof(int)
+                             : strlen(dbCellText(cells, col)) + 1;
+    }
+    output->rows_out++;
+}
+
+/* Work of a statement on the rows of one table, adds the rows it went
+ * through to '*rows' */
+typedef int (*ev_run_t)(struct plan_t *plan, void *data, size_t *rows);
+
+/* Runs 'run' on the table of the plan, or on each partition left by
+ * partPrune() with the plan pointed at the partition meanwhile */
+static int evRunTables(struct plan_t *plan, ev_run_t run, void *data,
+                       size_t *rows) {
+    struct table_t *table = plan->table;
+    const struct part_t *part = table->partitioning;
+    unsigned char keep[PART_MAX];
+    int ok = 1;
+
+    *rows = 0;
+    if (!part)
+        return run(plan, data, rows);
+
+    partPrune(plan, keep);
+    for (size_t i = 0; i < part->count && ok; i++) {
+        if (!keep[i])
+            continue;
+        plan->table = part->tables[i];
+        ok = run(plan, data, rows);
+    }
+    plan->table = table;
+    return ok;
+}
+
+static int evSelectRows(struct plan_t *plan, void *data, size_t *rows) {
+    (void)data;
+    *rows += evScan(plan, plan->profile ? evVisitProduce : evVisitPrint, NULL);
+    return 1;
+}
+
+static void evLogRows(size_t matched, enum plan_access_t access,
+                      const char *index) {
+    metricsAdd(METRIC_ROWS_RETURNED, matched);
+    if (access == PLAN_INDEX_SCAN)
+        LOG_INFO("%zu row(s) in set (%s %s)", matched,
+                 planAccessName(access), index);
+    else
+        LOG_INFO("%zu row(s) in set (%s)", matched, planAccessName(access));
+}
+
+static void evExecuteSelect(struct plan_t *plan) {
+    struct table_t *table = plan->table;
+    size_t matched;
+
+    if (plan->profile) {
+        evRunTables(plan, evSelectRows, NULL, &matched);
         return;
     }
+
+    logFlush();
+    for (size_t i = 0; i < plan->projection_count; i++)
+        printf("%s%s", i ? " | " : "",
+               table->columns[plan->projection[i]]->name);
+    printf("\n");
+
+    evRunTables(plan, evSelectRows, NULL, &matched);
+    evLogRows(matched, plan->access,
+              plan->access == PLAN_INDEX_SCAN ? plan->index->name : NULL);
+}
+
+static int evResultGrow(struct ev_result_t *result, size_t text_len) {
+    if (result->row_count == result->row_capacity) {
+        size_t capacity = result->row_capacity ? result->row_capacity * 2 : 64;
+        union ev_value_t *values =
+            realloc(result->values,
+                    capacity * result->column_count * sizeof(*values));
+        if (!values)
+            return 0;
+        result->values = values;
+        result->row_capacity = capacity;
+    }
+
+    if (result->text_len + text_len > result->text_capacity) {
+        size_t capacity = result->text_capacity ? result->text_capacity : 4096;
+        while (capacity < result->text_len + text_len)
+            capacity *= 2;
+        char *text = realloc(result->text, capacity);
+        if (!text)
+            return 0;
+        result->text = text;
+        result->text_capacity = capacity;
+    }
+    return 1;
 }
 
-/* Frees an evaluator and all associated resources */
-void evReleaseEvaluator(evaluator_t *evaluator) {
-    if (!evaluator)
+static void evVisitFetch(const struct plan_t *plan, size_t row, void *data) {
+    const struct row_t *cells = bufferRowScan(plan->table, row);
+    struct ev_result_t *result = data;
+    size_t text_len = 0;
+
+    for (size_t i = 0; i < result->column_count; i++) {
+        const struct column_t *col = plan->table->columns[plan->projection[i]];
+        if (col->type == DB_TYPE_TEXT)
+            text_len += strlen(dbCellText(cells, col)) + 1;
+    }
+    if (result->failed || !evResultGrow(result, text_len)) {
+        result->failed = 1;
         return;
+    }
+
+    union ev_value_t *values =
+        &result->values[result->row_count++ * result->column_count];
+    for (size_t i = 0; i < result->column_count; i++) {
+        const struct column_t *col = plan->table->columns[plan->projection[i]];
+        if (col->type == DB_TYPE_INT) {
+            values[i].i = dbCellInt(cells, col);
+            continue;
+        }
+        const char *text = dbCellText(cells, col);
+        size_t len = strlen(text) + 1;
+        memcpy(result->text + result->text_len, text, len);
+        values[i].text = result->text_len;
+        result->text_len += len;
+    }
+}
+
+static int evFetchRows(struct plan_t *plan, void *data, size_t *rows) {
+    struct ev_result_t *result = data;
+    *rows += evScan(plan, evVisitFetch, result);
+    return !result->failed;
+}
+
+int evQuery(struct plan_t *plan, const struct plan_param_t *params,
+            size_t param_count, struct ev_result_t *result) {
+    const struct table_t *table = plan->table;
+    size_t matched;
+
+    evResultRelease(result);
+    if (!planBind(plan, params, param_count))
+        return 0;
+
+    result->column_count = plan->projection_count;
+    for (size_t i = 0; i < plan->projection_count; i++) {
+        const struct column_t *col = table->columns[plan->projection[i]];
+        memcpy(result->names[i], col->name, sizeof(result->names[i]));
+        result->types[i] = col->type;
+    }
+    result->access = plan->access;
+    if (plan->access == PLAN_INDEX_SCAN)
+        memcpy(result->index, plan->index->name, sizeof(result->index));
+
+    if (!evRunTables(plan, evFetchRows, result, &matched)) {
+        LOG_ERROR("Out of memory");
+        evResultRelease(result);
+        return 0;
+    }
+    return 1;
+}
+
+void evQueryDone(const struct ev_result_t *result) {
+    evLogRows(result->row_count, result->access, result->index);
+}
+
+void evResultRelease(struct ev_result_t *result) {
+    free(result->values);
+    free(result->text);
+    memset(result, 0, sizeof(struct ev_result_t));
+}
+
+/* Positions of the rows an UPDATE or DELETE applies to */
+struct ev_rows_t {
+    uint32_t *rows;
+    size_t count;
+    size_t capacity;
+    int failed;
+};
+
+static void evVisitCollect(const struct plan_t *plan, size_t row,
+                           void *data) {
+    struct ev_rows_t *set = data;
+    (void)plan;
+
+    if (set->count == set->capacity && !set->failed) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 256;
+        uint32_t *rows = realloc(set->rows, capacity * sizeof(uint32_t));
+        if (!rows) {
+            set->failed = 1;
+            return;
+        }
+        set->rows = rows;
+        set->capacity = capacity;
+    }
+    if (!set->failed)
+        set->rows[set->count++] = (uint32_t)row;
+}
+
+/* The whole set of rows is computed before anything changes, so the
+ * statement never sees its own writes */
+static int evCollectRows(const struct plan_t *plan, struct ev_rows_t *set) {
+    memset(set, 0, sizeof(struct ev_rows_t));
+    evScan(plan, evVisitCollect, set);
+
+    if (set->failed) {
+        LOG_ERROR("Out of memory");
+        free(set->rows);
+        return 0;
+    }
+    return 1;
+}
+
+/* Rows stored before a target column was added have no cell for it and
+ * are rewritten first, so that a failure leaves every row untouched */
+static int evMaterializeRows(struct plan_t *plan, const struct ev_rows_t *set) {
+    struct table_t *table = plan->table;
+
+    for (size_t i = 0; i < set->count; i++) {
+        const struct row_t *row = bufferRow(table, set->rows[i]);
+
+        /* Rows a snapshot shares are copied whatever the targets */
+        for (size_t t = 0; t < plan->target_count; t++) {
+            if (!table->frozen &&
+                dbCellStored(row, table->columns[plan->targets[t]]))
+                continue;
+            if (!dbRowMaterialize(table, set->rows[i])) {
+                LOG_ERROR("Out of memory");
+                return 0;
+            }
+            break;
+        }
+    }
+    return 1;
+}
+
+/* Write 'cell' into column 'col' of every row of the set, returns 0
+ * when out of memory */
+static int evUpdateColumn(struct table_t *table, int col,
+                          const struct ev_rows_t *set,
+                          const union cell_value_t *cell) {
+    const struct column_t *def = table->columns[col];
+
+    if (def->packed) {
+        for (size_t i = 0; i < set->count; i++) {
+            if (!dbCellPut(bufferRowWrite(table, set->rows[i]), def, cell))
+                return 0;
+        }
+        return 1;
+    }
+
+    if (def->type == DB_TYPE_INT) {
+        for (size_t i = 0; i < set->count; i++)
+            table->rows[set->rows[i]]->cells[def->slot]->i = cell->i;
+        return 1;
+    }
+
+    size_t len = strlen(cell->s) + 1;
+    for (size_t i = 0; i < set->count; i++)
+        memcpy(table->rows[set->rows[i]]->cells[def->slot]->s, cell->s, len);
+    return 1;
+}
+
+/* Rows of one table an UPDATE changes and the values computed from
+ * them, 'computed' holds target_count entries per row: the INT itself
+ * or the offset of a TEXT in 'text' */
+union ev_computed_t {
+    int i;
+    size_t text;
+};
+
+struct ev_update_rows_t {
+    struct ev_rows_t set;
+    union ev_computed_t *computed;
+    char *text;
+    size_t text_len;
+    size_t text_capacity;
+};
+
+/* Values of an UPDATE that do not depend on the row, converted once for
+ * every partition, and the rows of each table it runs on */
+struct ev_update_t {
+    const struct plan_param_t *params;
+    union cell_value_t constants[MAX_COLUMNS_NUM];
+    struct ev_update_rows_t tables[PART_MAX];
+    size_t table_count;
+    size_t written;
+};
+
+/* Appends a computed TEXT to the values of the table */
+static int evUpdateText(struct ev_update_rows_t *state, const char *text,
+                        size_t *offset) {
+    size_t len = strlen(text) + 1;
+
+    if (state->text_len + len > state->text_capacity) {
+        size_t capacity = state->text_capacity ? state->text_capacity : 4096;
+        while (capacity < state->text_len + len)
+            capacity *= 2;
+        char *grown = realloc(state->text, capacity);
+        if (!grown)
+            return 0;
+        state->text = grown;
+        state->text_capacity = capacity;
+    }
+    memcpy(state->text + state->text_len, text, len);
+    *offset = state->text_len;
+    state->text_len += len;
+    return 1;
+}
+
+/* First pass of an UPDATE: collects the rows of the table and computes
+ * every value read from them, nothing is written but copies of the rows
+ * a snapshot shares */
+static int evUpdatePrepare(struct plan_t *plan, void *data, size_t *rows) {
+    (void)rows;
+    struct ev_update_t *update = data;
+    struct ev_update_rows_t *state = &update->tables[update->table_count];
+    struct table_t *table = plan->table;
+    size_t targets = plan->target_count;
+    int reads_row = 0;
+
+    memset(state, 0, sizeof(struct ev_update_rows_t));
+    if (!evCollectRows(plan, &state->set))
+        return 0;
+    update->table_count++;
+    if (!evMaterializeRows(plan, &state->set))
+        return 0;
+
+    for (size_t t = 0; t < targets; t++)
+        reads_row |= plan->values[t].reads_row;
+    if (!reads_row || !state->set.count)
+        return 1;
+
+    state->computed =
+        malloc(state->set.count * targets * sizeof(union ev_computed_t));
+    if (!state->computed) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+
+    for (size_t i = 0; i < state->set.count; i++) {
+        const struct row_t *row = bufferRow(table, state->set.rows[i]);
+        union ev_computed_t *computed = &state->computed[i * targets];
+
+        for (size_t t = 0; t < targets; t++) {
+            const struct column_t *col = table->columns[plan->targets[t]];
+            union cell_value_t cell;
+
+            if (!plan->values[t].reads_row)
+                continue;
+            if (!planSetCell(plan, col, &plan->values[t], update->params, row,
+                             &cell)) {
+                LOG_ERROR("Invalid value for column '%s'", col->name);
+                return 0;
+            }
+            if (col->type == DB_TYPE_INT) {
+                computed[t].i = cell.i;
+            } else if (!evUpdateText(state, cell.s, &computed[t].text)) {
+                LOG_ERROR("Out of memory");
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Second pass: values computed from the rows are written row by row,
+ * the ones that do not depend on the row a column at a time. Only
+ * running out of memory can stop it halfway */
+static int evUpdateWrite(struct plan_t *plan, void *data, size_t *rows) {
+    struct ev_update_t *update = data;
+    struct ev_update_rows_t *state = &update->tables[update->written++];
+    struct table_t *table = plan->table;
+    struct ev_rows_t set = state->set;
+    size_t targets = plan->target_count;
+    size_t updated = 0;
+    int ok = 1;
+
+    for (; state->computed && updated < set.count && ok; updated++) {
+        struct row_t *row = bufferRowWrite(table, set.rows[updated]);
+        const union ev_computed_t *computed =
+            &state->computed[updated * targets];
+
+        for (size_t t = 0; t < targets && ok; t++) {
+            const struct column_t *col = table->columns[plan->targets[t]];
+            union cell_value_t cell;
+
+            if (!plan->values[t].reads_row)
+                continue;
+            if (col->type == DB_TYPE_INT)
+                cell.i = computed[t].i;
+            else
+                strcpy(cell.s, state->text + computed[t].text);
+            if (!dbCellPut(row, col, &cell)) {
+                LOG_ERROR("Out of memory");
+                ok = 0;
+            }
+        }
+        if (!ok)
+            break;
+    }
+    if (!state->computed)
+        updated = set.count;
+
+    /* Rows after a failed one are left untouched */
+    set.count = updated;
+    for (size_t t = 0; t < targets && ok; t++) {
+        if (!plan->values[t].reads_row &&
+            !evUpdateColumn(table, plan->targets[t], &set,
+                            &update->constants[t])) {
+            LOG_ERROR("Out of memory");
+            ok = 0;
+        }
+    }
+
+    /* Only the indexes and zone maps of the assigned columns change. A
+     * row that failed halfway may have some of its columns written */
+    size_t touched = updated < state->set.count ? updated + 1 : updated;
+    for (size_t t = 0; t < targets; t++) {
+        indexRowsUpdated(table, plan->targets[t], set.rows, touched);
+        statsRowsUpdated(table, plan->targets[t], set.rows, touched);
+    }
+
+    *rows += updated;
+    return ok;
+}
+
+static void evUpdateRelease(struct ev_update_t *update) {
+    for (size_t i = 0; i < update->table_count; i++) {
+        free(update->tables[i].set.rows);
+        free(update->tables[i].computed);
+        free(update->tables[i].text);
+    }
+}
+
+/* Every value is computed and checked before the first row is written,
+ * in every partition, so that a failed UPDATE changes nothing */
+static int evExecuteUpdate(struct plan_t *plan,
+                           const struct plan_param_t *params) {
+    struct ev_update_t update = {.params = params};
+    size_t updated;
+
+    for (size_t t = 0; t < plan->target_count; t++) {
+        const struct column_t *col = plan->table->columns[plan->targets[t]];
+        if (!plan->values[t].reads_row &&
+            !planSetCell(plan, col, &plan->values[t], params, NULL,
+                         &update.constants[t])) {
+            LOG_ERROR("Invalid value for column '%s'", col->name);
+            return 0;
+        }
+    }
+
+    if (!evRunTables(plan, evUpdatePrepare, &update, &updated)) {
+        evUpdateRelease(&update);
+        return 0;
+    }
+    int ok = evRunTables(plan, evUpdateWrite, &update, &updated);
+    evUpdateRelease(&update);
+
+    metricsAdd(METRIC_ROWS_UPDATED, updated);
+    if (plan->profile)
+        plan->profile->output.rows_out = updated;
+    LOG_INFO("%zu row(s) updated in %s", updated, plan->table->name);
+    return ok;
+}
+
+static int evDeleteRows(struct plan_t *plan, void *data, size_t *rows) {
+    struct ev_rows_t set;
+    (void)data;
+
+    if (!evCollectRows(plan, &set))
+        return 0;
+
+    *rows += dbRowDeleteMany(plan->table, set.rows, set.count);
+    free(set.rows);
+    return 1;
+}
+
+static int evExecuteDelete(struct plan_t *plan) {
+    size_t deleted;
+    int ok = evRunTables(plan, evDeleteRows, NULL, &deleted);
+
+    metricsAdd(METRIC_ROWS_DELETED, deleted);
+    if (plan->profile)
+        plan->profile->output.rows_out = deleted;
+    LOG_INFO("%zu row(s) deleted from %s", deleted, plan->table->name);
+    return ok;
+}
+
+/* Run a plan already bound to the parameters of this execution */
+static int evRunPlan(struct plan_t *plan, const struct plan_param_t *params) {
+    switch (plan->kind) {
+    case PLAN_INSERT:
+        return evExecuteInsert(plan, params);
+    case PLAN_UPDATE:
+        return evExecuteUpdate(plan, params);
+    case PLAN_DELETE:
+        return evExecuteDelete(plan);
+    default:
+        evExecuteSelect(plan);
+        return 1;
+    }
+}
+
+/* Run a plan with the parameters of this execution */
+int evExecutePlan(struct plan_t *plan, const struct plan_param_t *params,
+                  size_t param_count) {
+    return planBind(plan, params, param_count) && evRunPlan(plan, params);
+}
+
+/* SELECT, INSERT, UPDATE and DELETE nodes evaluated directly are
+ * planned, run and discarded, statements coming from evExecute() keep
+ * their plan cached */
+static void evPlanAndExecute(struct ast_node_t *node) {
+    struct database_t *db = evGetDatabase();
+    if (!db)
+        return;
+
+    struct plan_t *plan = planCreate(db, node);
+    if (!plan)
+        return;
+
+    evExecutePlan(plan, NULL, 0);
+    planFree(plan);
+}
+
+static void evAnalyzeTable(struct ast_node_t *node) {
+    struct table_t *table = evGetTable(node->children[0]);
+    if (!table)
+        return;
+
+    if (!statsAnalyzeTable(table)) {
+        LOG_ERROR("Unable to analyze table '%s'", table->name);
+        return;
+    }
+    LOG_INFO("Table %s analyzed (%zu rows)", table->name, table->row_count);
+}
+
+/* Named statements created with 'PREPARE name FROM ...' */
+struct prepared_t {
+    char name[64];
+    rsql_stmt *stmt;
+    struct prepared_t *next;
+};
+
+struct prepared_t *prepared = NULL;
+
+static struct prepared_t **evFindPrepared(const char *name) {
+    struct prepared_t **link = &prepared;
+
+    while (*link && strcmp((*link)->name, name) != 0)
+        link = &(*link)->next;
+    return link;
+}
+
+/* ALTER TABLE ... ADD | DROP PARTITION, only RANGE partitions can be
+ * added or dropped, the other partitions are left untouched */
+static void evAlterPartition(struct table_t *table,
+                             struct ast_node_t *action,
+                             const struct plan_param_t *params,
+                             size_t param_count) {
+    struct ast_node_t *partition = action->children[0];
+
+    if (!table->partitioning || table->partitioning->method != PART_RANGE) {
+        LOG_ERROR("Table '%s' is not partitioned by RANGE", table->name);
+        return;
+    }
+
+    if (action->type == AST_DROP_PARTITION) {
+        if (partDrop(table, partition->value))
+            LOG_INFO("Partition %s dropped from %s", partition->value,
+                     table->name);
+        return;
+    }
+
+    if (evAddPartition(table, partition, params, param_count))
+        LOG_INFO("Partition %s added to %s", partition->children[0]->value,
+                 table->name);
+}
+
+/* ALTER TABLE: neither adding nor dropping a column touches the rows,
+ * see dbColumnCreate() and dbColumnDelete(). PACKED tuples have a field
+ * for every column, so their columns only change while they are empty */
+static void evAlterTable(struct ast_node_t *node,
+                         const struct plan_param_t *params,
+                         size_t param_count) {
+    struct table_t *table = evGetTable(node->children[0]);
+    if (!table)
+        return;
+
+    struct ast_node_t *action = node->children[1];
+    struct ast_node_t *def = action->children[0];
+
+    if (action->type == AST_ADD_PARTITION ||
+        action->type == AST_DROP_PARTITION) {
+        evAlterPartition(table, action, params, param_count);
+        return;
+    }
+
+    if (table->row_format == DB_ROW_PACKED && partRows(table)) {
+        LOG_ERROR("Can't add or drop columns of PACKED table '%s' while it "
+                  "holds rows",
+                  table->name);
+        return;
+    }
+
+    if (action->type == AST_DROP_COLUMN) {
+        int column = dbColumnFind(table, def->value);
+        if (column < 0) {
+            LOG_ERROR("Unknown column '%s'", def->value);
+            return;
+        }
+        if (table->column_count == 1) {
+            LOG_ERROR("Can't drop the only column of '%s', use DROP TABLE",
+                      table->name);
+            return;
+        }
+
+        if (table->partitioning) {
+            if (!partColumnDelete(table, column))
+                return;
+        } else {
+            dbColumnDelete(table, table->columns[column]);
+        }
+        LOG_INFO("Column %s dropped from %s", def->value, table->name);
+        return;
+    }
+
+    const char *name = def->children[0]->value;
+    const char *type_name =
+        def->child_count > 1 ? def->children[1]->value : NULL;
+    struct column_t col = {.type = dbColumnType(type_name)};
+    union cell_value_t value;
+
+    strncpy(col.name, name, sizeof(col.name) - 1);
+    memset(&value, 0, sizeof(value));
+    if (dbColumnFind(table, name) >= 0) {
+        LOG_ERROR("Column '%s' already exists", name);
+        return;
+    }
+    if (action->child_count > 1 &&
+        !evDefaultValue(action->children[1], params, param_count, &col,
+                        &value))
+        return;
+
+    if (!(table->partitioning
+              ? partColumnCreate(table, name, col.type, &value)
+              : dbColumnCreate(table, name, col.type, NULL, &value))) {
+        LOG_ERROR("Unable to create column '%s'", name);
+        return;
+    }
+    LOG_INFO("Column %s added to %s", name, table->name);
+}
+
+/* DROP TABLE: tables a snapshot still reads stay until it is dropped */
+static void evDropTable(struct ast_node_t *node) {
+    struct table_t *table = evGetTable(node->children[0]);
+    if (!table)
+        return;
+
+    if (table->frozen) {
+        LOG_ERROR("Table '%s' is held by a snapshot, drop it first",
+                  table->name);
+        return;
+    }
+    if (!dbTableDelete(evGetDatabase(), table)) {
+        LOG_ERROR("Unable to drop table '%s'", node->children[0]->value);
+        return;
+    }
+    LOG_INFO("Table %s dropped", node->children[0]->value);
+}
+
+static void evPrepare(struct ast_node_t *node,
+                      const struct plan_param_t *params, size_t param_count) {
+    struct plan_param_t text;
+    if (!evNodeParam(node->children[1], params, param_count, &text))
+        return;
+
+    char *sql = strndup(text.s, text.len);
+    if (sql && text.escaped)
+        sql[lexUnescape(sql, text.len, sql)] = '\0';
+
+    rsql_stmt *stmt = NULL;
+    int rc = sql ? rsql_prepare(sql, &stmt) : RSQL_ERR;
+    free(sql);
+
+    if (rc != RSQL_OK) {
+        LOG_ERROR("Unable to prepare statement '%s'", node->children[0]->value);
+        return;
+    }
+
+    const char *name = node->children[0]->value;
+    struct prepared_t **link = evFindPrepared(name);
+    if (!*link) {
+        *link = malloc(sizeof(struct prepared_t));
+        if (!*link) {
+            rsql_finalize(stmt);
+            return;
+        }
+        strncpy((*link)->name, name, sizeof((*link)->name) - 1);
+        (*link)->name[sizeof((*link)->name) - 1] = '\0';
+        (*link)->next = NULL;
+    } else {
+        rsql_finalize((*link)->stmt);
+    }
+
+    (*link)->stmt = stmt;
+    LOG_INFO("Statement %s prepared", name);
+}
+
+static void evExecutePrepared(struct ast_node_t *node,
+                              const struct plan_param_t *params,
+                              size_t param_count) {
+    struct prepared_t *entry = *evFindPrepared(node->children[0]->value);
+    if (!entry) {
+        LOG_ERROR("Unknown prepared statement '%s'", node->children[0]->value);
+        return;
+    }
+
+    if ((size_t)rsql_param_count(entry->stmt) != node->child_count - 1) {
+        LOG_ERROR("Statement %s expects %d parameter(s)", entry->name,
+                  rsql_param_count(entry->stmt));
+        return;
+    }
+
+    for (size_t i = 1; i < node->child_count; i++) {
+        struct plan_param_t value;
+        if (!evNodeParam(node->children[i], params, param_count, &value))
+            return;
+
+        if (value.escaped) {
+            char *text = arenaAlloc(&statement_arena, value.len + 1);
+            if (!text)
+                return;
+            value.len = lexUnescape(value.s, value.len, text);
+            value.s = text;
+        }
+
+        int rc = value.type == PLAN_PARAM_INT
+                     ? rsql_bind_int(entry->stmt, (int)i, value.i)
+                     : rsql_bind_text(entry->stmt, (int)i, value.s,
+                                      (int)value.len);
+        if (rc != RSQL_OK)
+            return;
+    }
+
+    /* A SELECT prints its rows as they come out of the statement */
+    int rc = rsql_step(entry->stmt);
+    int columns = rsql_column_count(entry->stmt);
+    if (rc == RSQL_ERR || !columns)
+        return;
+
+    logFlush();
+    for (int c = 0; c < columns; c++)
+        printf("%s%s", c ? " | " : "", rsql_column_name(entry->stmt, c));
+    printf("\n");
+
+    for (; rc == RSQL_ROW; rc = rsql_step(entry->stmt)) {
+        for (int c = 0; c < columns; c++)
+            printf("%s%s", c ? " | " : "", rsql_column_text(entry->stmt, c));
+        printf("\n");
+    }
+}
+
+static void evDeallocate(struct ast_node_t *node) {
+    struct prepared_t **link = evFindPrepared(node->children[0]->value);
+    if (!*link) {
+        LOG_ERROR("Unknown prepared statement '%s'", node->children[0]->value);
+        return;
+    }
+
+    struct prepared_t *entry = *link;
+    *link = entry->next;
+    rsql_finalize(entry->stmt);
+    free(entry);
+}
+
+/* Appends 'text' to the detail column of EXPLAIN, truncating at 'cap' */
+static size_t evAppend(char *out, size_t cap, size_t len, const char *text) {
+    size_t n = strlen(text);
+
+    if (n > cap - len - 1)
+        n = cap - len - 1;
+    memcpy(out + len, text, n);
+    out[len + n] = '\0';
+    return len + n;
+}
+
+/* What is done with the rows: projected columns, target columns or the
+ * table rows are deleted from */
+static void evExplainOutput(const struct plan_t *plan, char *out,
+                            size_t cap) {
+    const struct table_t *table = plan->table;
+    size_t len = 0;
+
+    out[0] = '\0';
+    if (plan->kind == PLAN_SELECT) {
+        for (size_t i = 0; i < plan->projection_count; i++) {
+            len = evAppend(out, cap, len, i ? ", " : "");
+            len = evAppend(out, cap, len,
+                           table->columns[plan->projection[i]]->name);
+        }
+        return;
+    }
+
+    len = evAppend(out, cap, len, table->name);
+    if (plan->kind == PLAN_DELETE)
+        return;
+
+    len = evAppend(out, cap, len, plan->kind == PLAN_INSERT ? " (" : " SET ");
+    for (size_t i = 0; i < plan->target_count; i++) {
+        len = evAppend(out, cap, len, i ? ", " : "");
+        len = evAppend(out, cap, len, table->columns[plan->targets[i]]->name);
+    }
+    if (plan->kind == PLAN_INSERT)
+        evAppend(out, cap, len, ")");
+}
+
+/* Table, partitions, index, access predicate and residual filter of the
+ * scan, with the values of the parameters */
+static void evExplainScan(const struct plan_t *plan, char *out, size_t cap) {
+    const struct part_t *part = plan->table->partitioning;
+    size_t len = evAppend(out, cap, 0, plan->table->name);
+
+    if (part) {
+        unsigned char keep[PART_MAX];
+        const char *sep = " PARTITIONS ";
+
+        if (!partPrune(plan, keep))
+            len = evAppend(out, cap, len, " PARTITIONS none");
+        for (size_t i = 0; i < part->count; i++) {
+            if (!keep[i])
+                continue;
+            len = evAppend(out, cap, len, sep);
+            len = evAppend(out, cap, len, part->tables[i]->name);
+            sep = ", ";
+        }
+    }
+
+    if (plan->access == PLAN_INDEX_SCAN) {
+        len = evAppend(out, cap, len, " USING ");
+        len = evAppend(out, cap, len, plan->index->name);
+    } else if (plan->access == PLAN_BITMAP_SCAN) {
+        len = evAppend(out, cap, len, " USING bitmap indexes");
+    }
+
+    if (plan->pred.column >= 0) {
+        const struct column_t *col = plan->table->columns[plan->pred.column];
+        char value[sizeof(union cell_value_t) + 2];
+
+        if (col->type == DB_TYPE_INT)
+            snprintf(value, sizeof(value), "%d", plan->pred.value.cell.i);
+        else
+            snprintf(value, sizeof(value), "'%s'", plan->pred.value.cell.s);
+
+        len = evAppend(out, cap, len, " WHERE ");
+        len = evAppend(out, cap, len, col->name);
+        len = evAppend(out, cap, len, " ");
+        len = evAppend(out, cap, len, exprOpName(plan->pred.op));
+        len = evAppend(out, cap, len, " ");
+        len = evAppend(out, cap, len, value);
+    }
+
+    if (plan->filter) {
+        len = evAppend(out, cap, len, " FILTER ");
+        exprFormat(plan->filter, plan->bound, out + len, cap - len);
+    }
+}
+
+static void evExplainRow(const char *name, const char *detail,
+                         const struct plan_t *plan,
+                         const struct prof_op_t *op) {
+    printf("%s | %s | %.0f | %.2f", name, detail, plan->est_rows, plan->cost);
+    if (op)
+        printf(" | %zu | %zu | %zu | %zu | %.1f", op->rows_in, op->rows_out,
+               op->batches, op->bytes, profMicros(op->ticks));
+    printf("\n");
+}
+
+/* One row per operator, from the one producing the result down to the
+ * scan. 'profile' adds the counters of an EXPLAIN ANALYZE run */
+static void evExplainPlan(const struct plan_t *plan,
+                          const struct prof_plan_t *profile) {
+    static const char *outputs[] = {
+        [PLAN_SELECT] = "PROJECT",
+        [PLAN_INSERT] = "INSERT",
+        [PLAN_UPDATE] = "UPDATE",
+        [PLAN_DELETE] = "DELETE",
+    };
+    char detail[1024];
+
+    logFlush();
+    printf("operator | detail | est_rows | cost%s\n",
+           profile ? " | rows_in | rows_out | batches | bytes | time_us" : "");
+
+    evExplainOutput(plan, detail, sizeof(detail));
+    evExplainRow(outputs[plan->kind], detail, plan,
+                 profile ? &profile->output : NULL);
+
+    if (plan->kind != PLAN_INSERT) {
+        evExplainScan(plan, detail, sizeof(detail));
+        evExplainRow(planAccessName(plan->access), detail, plan,
+                     profile ? &profile->scan : NULL);
+    }
+}
+
+static void evExplainStages(void) {
+    static const char *stages[PROF_STAGES] = {
+        [PROF_LEX] = "lex",
+        [PROF_PARSE] = "parse",
+        [PROF_PLAN] = "plan",
+        [PROF_EXECUTE] = "execute",
+    };
+    uint64_t total = 0;
+
+    printf("\nstage | time_us\n");
+    for (int i = 0; i < PROF_STAGES; i++) {
+        printf("%s | %.1f\n", stages[i], profMicros(prof_statement.stage[i]));
+        total += prof_statement.stage[i];
+    }
+    printf("total | %.1f\n", profMicros(total));
+}
+
+/* EXPLAIN [ANALYZE] statement. The plan is made for the literals of the
+ * statement, ANALYZE runs it for real (its changes are kept) and reports
+ * what each operator did and the time of each stage */
+static void evExplain(struct ast_node_t *node,
+                      const struct plan_param_t *params,
+                      size_t param_count) {
+    struct database_t *db = evGetDatabase();
+    if (!db || node->child_count != 1)
+        return;
+
+    uint64_t start = profNow();
+    struct plan_t *plan = planCreate(db, node->children[0]);
+    if (!plan)
+        return;
+    if (!planBind(plan, params, param_count)) {
+        planFree(plan);
+        return;
+    }
+    profAdd(PROF_PLAN, start);
+
+    if (!node->value) {
+        evExplainPlan(plan, NULL);
+        planFree(plan);
+        return;
+    }
+
+    struct prof_plan_t profile;
+    memset(&profile, 0, sizeof(profile));
+    plan->profile = &profile;
+
+    start = profNow();
+    int ok = evRunPlan(plan, params);
+    uint64_t elapsed = profNow() - start;
+    prof_statement.stage[PROF_EXECUTE] += elapsed;
+    plan->profile = NULL;
+
+    /* The output operator gets whatever the scan did not use */
+    size_t row_size = dbRowSize(plan->table);
+    profile.scan.bytes = profile.scan.rows_in * row_size;
+    profile.output.ticks = elapsed - profile.scan.ticks;
+    profile.output.batches = 1;
+    profile.output.rows_in = plan->kind == PLAN_INSERT ? plan->value_rows
+                                                       : profile.scan.rows_out;
+    if (plan->kind != PLAN_SELECT)
+        profile.output.bytes = profile.output.rows_out * row_size;
+
+    if (ok) {
+        evExplainPlan(plan, &profile);
+        evExplainStages();
+    }
+    planFree(plan);
+}
+
+/* SHOW STATUS, one row per metric */
+static void evShowStatus(void) {
+    struct metrics_snapshot_t *snapshot = malloc(sizeof(*snapshot));
+    if (!snapshot) {
+        LOG_ERROR("Out of memory");
+        return;
+    }
+    metricsSnapshot(snapshot);
+
+    logFlush();
+    printf("name | value\n");
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        const char *type = metricsStatementName(t);
+        uint64_t count = snapshot->count[t];
+
+        printf("%s_statements | %llu\n", type, (unsigned long long)count);
+        printf("%s_latency_avg_us | %.1f\n", type,
+               count ? profMicros(snapshot->sum[t]) / (double)count : 0.0);
+        printf("%s_latency_p50_us | %.1f\n", type,
+               profMicros(metricsQuantile(snapshot, t, 0.5)));
+        printf("%s_latency_p99_us | %.1f\n", type,
+               profMicros(metricsQuantile(snapshot, t, 0.99)));
+        printf("%s_latency_max_us | %.1f\n", type,
+               profMicros(metricsQuantile(snapshot, t, 1.0)));
+    }
+
+    for (int i = 0; i < METRIC_COUNTERS; i++)
+        printf("%s | %llu\n", metricsCounterName(i),
+               (unsigned long long)snapshot->counters[i]);
+
+    uint64_t hits = snapshot->counters[METRIC_CACHE_HITS];
+    uint64_t lookups = hits + snapshot->counters[METRIC_CACHE_MISSES];
+    printf("plan_cache_hit_rate | %.3f\n",
+           lookups ? (double)hits / (double)lookups : 0.0);
+
+    if (current_db)
+        printf("database_bytes | %zu\n", dbDatabaseBytes(current_db));
+    if (buffer_enabled) {
+        printf("buffer_pool_budget_bytes | %zu\n", bufferBudget());
+        printf("buffer_pool_resident_bytes | %zu\n", bufferResident());
+    }
+    free(snapshot);
+}
+
+/* SHOW STATUS INTO 'file', the metrics in the Prometheus text format */
+static void evDumpStatus(struct ast_node_t *node,
+                         const struct plan_param_t *params,
+                         size_t param_count) {
+    struct plan_param_t text;
+    if (!evNodeParam(node, params, param_count, &text))
+        return;
+
+    char *path = strndup(text.s, text.len);
+    if (!path) {
+        LOG_ERROR("Out of memory");
+        return;
+    }
+    if (text.escaped)
+        path[lexUnescape(path, text.len, path)] = '\0';
+
+    FILE *out = fopen(path, "w");
+    int ok = out && metricsDump(evGetContext(), out);
+    if (out && fclose(out) != 0)
+        ok = 0;
+
+    if (ok)
+        LOG_INFO("Metrics written to %s", path);
+    else
+        LOG_ERROR("Unable to write '%s'", path);
+    free(path);
+}
+
+/* BACKUP SNAPSHOT name INTO 'file' */
+static void evBackupSnapshot(struct ast_node_t *node,
+                             const struct plan_param_t *params,
+                             size_t param_count) {
+    struct plan_param_t text;
+    if (!evNodeParam(node->children[1], params, param_count, &text))
+        return;
+
+    char *path = strndup(text.s, text.len);
+    if (!path) {
+        LOG_ERROR("Out of memory");
+        return;
+    }
+    if (text.escaped)
+        path[lexUnescape(path, text.len, path)] = '\0';
+
+    if (snapBackup(node->children[0]->value, path))
+        LOG_INFO("Snapshot %s written to %s", node->children[0]->value, path);
+    free(path);
+}
+
+/* SHOW TABLE STATUS, the tables of the current database and the memory
+ * they hold */
+static void evShowTableStatus(void) {
+    struct database_t *db = evGetDatabase();
+    if (!db)
+        return;
+
+    logFlush();
+    printf("name | row_format | rows | columns | indexes | data_bytes | "
+           "avg_row_bytes\n");
+    for (size_t i = 0; i < db->table_count; i++) {
+        const struct table_t *table = db->tables[i];
+        size_t indexes = 0;
+
+        for (const struct index_t *index = table->indexes; index;
+             index = index->next)
+            indexes++;
+
+        size_t rows = partRows(table), bytes = partBytes(table);
+        printf("%s | %s | %zu | %zu | %zu | %zu | %zu\n", table->name,
+               table->row_format == DB_ROW_PACKED ? "PACKED" : "DYNAMIC",
+               rows, table->column_count, indexes, bytes,
+               rows ? bytes / rows : 0);
+
+        /* Then one row per partition, named 'table.partition' */
+        const struct part_t *part = table->partitioning;
+        for (size_t p = 0; part && p < part->count; p++) {
+            const struct table_t *partition = part->tables[p];
+            printf("%s.%s | %s | %zu | %zu | 0 | %zu | %zu\n", table->name,
+                   partition->name,
+                   table->row_format == DB_ROW_PACKED ? "PACKED" : "DYNAMIC",
+                   partition->row_count, partition->column_count,
+                   partition->bytes,
+                   partition->row_count
+                       ? partition->bytes / partition->row_count
+                       : 0);
+        }
+    }
+    LOG_INFO("%zu table(s) in %s (%zu bytes)", db->table_count, db->name,
+             dbDatabaseBytes(db));
+}
+
+/* Evaluates a node, 'params' are the literals of the statement text when
+ * it went through the plan cache normalization (see evExecute) */
+static void evEvaluateStatement(struct ast_node_t *node,
+                                const struct plan_param_t *params,
+                                size_t param_count) {
+    switch (node->type) {
+    case AST_PREPARE:
+        evPrepare(node, params, param_count);
+        break;
+    case AST_EXECUTE:
+        evExecutePrepared(node, params, param_count);
+        break;
+    case AST_DEALLOCATE:
+        evDeallocate(node);
+        break;
+    case AST_CREATE_TABLE:
+        evCreateTable(node, params, param_count);
+        break;
+    case AST_ALTER_TABLE:
+        evAlterTable(node, params, param_count);
+        break;
+    case AST_EXPLAIN:
+        evExplain(node, params, param_count);
+        break;
+    case AST_SHOW_STATUS:
+        if (node->child_count)
+            evDumpStatus(node->children[0], params, param_count);
+        else
+            evShowStatus();
+        break;
+    case AST_BACKUP_SNAPSHOT:
+        evBackupSnapshot(node, params, param_count);
+        break;
+    default:
+        evEvaluateNode(node);
+        break;
+    }
+}
+
+void evEvaluateNode(struct ast_node_t *node) {
+
+    if (!node) {
+        LOG_ERROR("Falied to parse node (NULL)");
+        return;
+    }
+
+    struct ctx_t *ctx = evGetContext();
+
+    switch (node->type) {
+    case AST_CREATE_DATABASE:
+        if (node->child_count != 1) {
+            LOG_ERROR(
+                "CRATE DATABASE only accepts 1 identifier (database_name).");
+            return;
+        }
+        struct ast_node_t *db_name_node = node->children[0];
+        char *db_name =
+            db_name_node->type == AST_IDENTIFIER ? db_name_node->value : NULL;
+
+        if (!db_name) {
+            LOG_ERROR("Invalid db_name provided");
+        }
+
+        struct database_t *new_database = dbCreateNew(ctx, db_name);
+        if (!new_database) {
+            LOG_ERROR("Unable to create database '%s'", db_name);
+            return;
+        }
+        LOG_INFO("New Database %s created successfully", new_database->name);
+        break;
+    case AST_USE_DATABASE: {
+        struct database_t *db = dbFind(ctx, node->children[0]->value);
+        if (!db) {
+            LOG_ERROR("Unknown database '%s'", node->children[0]->value);
+            return;
+        }
+        current_db = db;
+        LOG_INFO("Database changed to %s", db->name);
+        break;
+    }
+    case AST_CREATE_TABLE:
+        evCreateTable(node, NULL, 0);
+        break;
+    case AST_CREATE_INDEX:
+        evCreateIndex(node);
+        break;
+    case AST_DROP_TABLE:
+        evDropTable(node);
+        break;
+    case AST_INSERT:
+    case AST_SELECT:
+    case AST_UPDATE:
+    case AST_DELETE:
+        evPlanAndExecute(node);
+        break;
+    case AST_ANALYZE_TABLE:
+        evAnalyzeTable(node);
+        break;
+    case AST_SHOW_TABLE_STATUS:
+        evShowTableStatus();
+        break;
+    case AST_CREATE_SNAPSHOT:
+        if (snapCreate(NULL, node->children[0]->value))
+            LOG_INFO("Snapshot %s created", node->children[0]->value);
+        break;
+    case AST_DROP_SNAPSHOT:
+        if (snapDrop(node->children[0]->value))
+            LOG_INFO("Snapshot %s dropped", node->children[0]->value);
+        break;
+    case AST_ALTER_TABLE:
+    case AST_PREPARE:
+    case AST_EXECUTE:
+    case AST_DEALLOCATE:
+    case AST_EXPLAIN:
+    case AST_SHOW_STATUS:
+    case AST_BACKUP_SNAPSHOT:
+        evEvaluateStatement(node, NULL, 0);
+        break;
+    default:
+        LOG_ERROR("Invalid AST type");
+        return;
+    }
+}
+
+/* Statements that are run through a plan */
+static int evPlannable(const struct ast_node_t *node) {
+    return node->type == AST_SELECT || node->type == AST_INSERT ||
+           node->type == AST_UPDATE || node->type == AST_DELETE;
+}
+
+/* Statement type a plan or a statement node is recorded under */
+static int evPlanMetric(const struct plan_t *plan) {
+    switch (plan->kind) {
+    case PLAN_INSERT:
+        return METRIC_STMT_INSERT;
+    case PLAN_UPDATE:
+        return METRIC_STMT_UPDATE;
+    case PLAN_DELETE:
+        return METRIC_STMT_DELETE;
+    default:
+        return METRIC_STMT_SELECT;
+    }
+}
+
+static int evNodeMetric(const struct ast_node_t *node) {
+    switch (node ? node->type : AST_STATEMENT) {
+    case AST_SELECT:
+        return METRIC_STMT_SELECT;
+    case AST_INSERT:
+        return METRIC_STMT_INSERT;
+    case AST_UPDATE:
+        return METRIC_STMT_UPDATE;
+    case AST_DELETE:
+        return METRIC_STMT_DELETE;
+    case AST_CREATE_DATABASE:
+    case AST_CREATE_TABLE:
+    case AST_CREATE_INDEX:
+    case AST_DROP_TABLE:
+    case AST_ALTER_TABLE:
+        return METRIC_STMT_DDL;
+    default:
+        return METRIC_STMT_OTHER;
+    }
+}
+
+/* Executes one SQL statement going through the plan cache: the text is
+ * normalized first and, when a valid plan for the same fingerprint is
+ * cached, it is run with the literals of this statement as parameters
+ * without lexing, parsing or planning again. Returns the METRIC_STMT_*
+ * type of the statement */
+static int evExecuteStatement(char *input, uint64_t start) {
+    struct fingerprint_t fp;
+
+    arenaReset(&statement_arena);
+
+    /* Literal INSERT batches go straight to storage */
+    if (insertExecute(current_db, input) != INSERT_FALLBACK)
+        return METRIC_STMT_INSERT;
+
+    profReset(0);
+    if (!cacheFingerprint(input, &fp, &statement_arena)) {
+        LOG_ERROR("Out of memory");
+        return METRIC_STMT_OTHER;
+    }
+    profAdd(PROF_LEX, start);
+
+    struct plan_t *plan = cacheLookup(&fp, current_db);
+    if (plan) {
+        metricsAdd(METRIC_CACHE_HITS, 1);
+        evExecutePlan(plan, fp.params, fp.param_count);
+        return evPlanMetric(plan);
+    }
+    metricsAdd(METRIC_CACHE_MISSES, 1);
+
+    /* The parser pulls its tokens from the lexer, for EXPLAIN they are
+     * timed one by one to tell the two apart */
+    uint64_t lexed = prof_statement.stage[PROF_LEX];
+    prof_statement.tokens = strncasecmp(fp.text, "EXPLAIN", 7) == 0;
+    start = profNow();
+
+    evaluator_t *eval = evCreateEvaluator(fp.text, &statement_arena);
+    struct ast_node_t *node = eval ? eval->current_node : NULL;
+
+    profAdd(PROF_PARSE, start);
+    prof_statement.stage[PROF_PARSE] -= prof_statement.stage[PROF_LEX] - lexed;
+    prof_statement.tokens = 0;
+
+    if (node && evPlannable(node)) {
+        if (evGetDatabase())
+            plan = planCreate(current_db, node);
+
+        if (plan) {
+            evExecutePlan(plan, fp.params, fp.param_count);
+            if (!cacheInsert(&fp, current_db, plan))
+                planFree(plan);
+        }
+    } else if (node) {
+        evEvaluateStatement(node, fp.params, fp.param_count);
+    }
+    return evNodeMetric(node);
+}
+
+/* Runs one statement and records its latency */
+void evExecute(char *input) {
+    uint64_t start = profNow();
+
+    evLock();
+    int type = evExecuteStatement(input, start);
+    bufferStatementEnd();
+    evUnlock();
+
+    metricsStatement(type, profNow() - start);
+}
 
-    if (evaluator->parser)
-        parserFree(evaluator->parser);
+/* Compiles a SELECT, INSERT, UPDATE or DELETE statement into a plan for
+ * the current database, used by prepared statements. It may run in the
+ * middle of a statement (PREPARE), so it parses in an arena of its own */
+struct plan_t *evCompile(const char *input) {
+    struct arena_t arena;
+    arenaInit(&arena);
 
-    /* Lexer is not allocated, so we don't need to release it */
+    evaluator_t *eval = evCreateEvaluator((char *)input, &arena);
+    struct ast_node_t *node = eval ? eval->current_node : NULL;
+    struct plan_t *plan = NULL;
 
-    if (evaluator->errors)
-        free(evaluator->errors);
+    if (node && !evPlannable(node))
+        LOG_ERROR("Only SELECT, INSERT, UPDATE and DELETE statements can be "
+                  "prepared");
+    else if (node && evGetDatabase())
+        plan = planCreate(current_db, node);
 
-    free(evaluator);
+    arenaRelease(&arena);
+    return plan;
 }
@@ -22,8 +22,10 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
+#include "arena.h"
 #include "db.h"
 #include "parser.h"
+#include "plan.h"
 
 typedef struct {
     struct parser_t *parser; /* contains lexer and AST  */
@@ -32,8 +34,57 @@ typedef struct {
 } evaluator_t;
 
 struct ctx_t *evGetContext(void);
-evaluator_t *evCreateEvaluator(char *input);
+
+/* Serializes the threads reading or writing storage: evExecute() holds
+ * the latch for the whole statement, other entry points take it */
+void evLock(void);
+void evUnlock(void);
+struct database_t *evGetDatabase(void);
+
+/* Deselects 'db' if it is the current database, before it is released */
+void evForgetDatabase(const struct database_t *db);
+evaluator_t *evCreateEvaluator(char *input, struct arena_t *arena);
 void evEvaluateNode(struct ast_node_t *node);
-void evReleaseEvaluator(evaluator_t *evaluator);
+void evExecute(char *input);
+struct plan_t *evCompile(const char *input);
+int evExecutePlan(struct plan_t *plan, const struct plan_param_t *params,
+                  size_t param_count);
+
+/* A value of a row of an ev_result_t, TEXT values are the offset of
+ * their string in 'text' */
+union ev_value_t {
+    int i;
+    size_t text;
+};
+
+/* Projected values of the rows of a SELECT, 'column_count' per row. It
+ * holds copies, so it stays valid whatever happens to the tables */
+struct ev_result_t {
+    size_t column_count;
+    char names[MAX_COLUMNS_NUM][64];
+    int types[MAX_COLUMNS_NUM];
+
+    union ev_value_t *values;
+    size_t row_count;
+    size_t row_capacity;
+
+    char *text;
+    size_t text_len;
+    size_t text_capacity;
+
+    /* What the rows are logged as once they were all read */
+    enum plan_access_t access;
+    char index[64];
+    int failed;
+};
+
+/* Runs a SELECT plan keeping its rows in 'result' (zero initialized or
+ * released) instead of printing them, 0 on error */
+int evQuery(struct plan_t *plan, const struct plan_param_t *params,
+            size_t param_count, struct ev_result_t *result);
+
+/* Logs the rows of the result as returned */
+void evQueryDone(const struct ev_result_t *result);
+void evResultRelease(struct ev_result_t *result);
 
 #endif /* EVALUATOR_H */
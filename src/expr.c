@@ -0,0 +1,1225 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "expr.h"
+#include "buffer.h"
+#include "lex.h"
+#include "logs.h"
+#include "part.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static struct expr_t *exprNew(struct arena_t *arena, enum expr_kind_t kind,
+                              int type, size_t arg_count) {
+    struct expr_t *expr = arenaAlloc(arena, sizeof(struct expr_t));
+    if (!expr)
+        return NULL;
+
+    memset(expr, 0, sizeof(struct expr_t));
+    expr->kind = kind;
+    expr->type = type;
+    expr->column = -1;
+
+    if (arg_count) {
+        expr->args = arenaAlloc(arena, arg_count * sizeof(struct expr_t *));
+        if (!expr->args)
+            return NULL;
+        expr->arg_count = arg_count;
+    }
+    return expr;
+}
+
+/* Integer a whole text reads as, 0 beyond 64 bits */
+static int exprTextToInt64(const char *text, int64_t *out) {
+    char *end;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+
+    if (end == text || *end != '\0' || errno == ERANGE)
+        return 0;
+    *out = value;
+    return 1;
+}
+
+/* Same rules as dbCellSet() for INT columns */
+static int exprTextToInt(const char *text, int *out) {
+    int64_t value;
+
+    if (!exprTextToInt64(text, &value) || value < INT_MIN || value > INT_MAX)
+        return 0;
+    *out = (int)value;
+    return 1;
+}
+
+static int exprIsTrue(const struct expr_value_t *value) {
+    int64_t i;
+
+    switch (value->type) {
+    case EXPR_TYPE_INT:
+    case EXPR_TYPE_BOOL:
+        return value->i != 0;
+    case EXPR_TYPE_TEXT:
+        return exprTextToInt64(value->s, &i) && i != 0;
+    default:
+        return 0;
+    }
+}
+
+static void exprSetBool(struct expr_value_t *out, int value) {
+    out->type = EXPR_TYPE_BOOL;
+    out->i = value;
+    out->s = NULL;
+}
+
+static void exprSetNull(struct expr_value_t *out) {
+    out->type = EXPR_TYPE_NULL;
+    out->i = 0;
+    out->s = NULL;
+}
+
+/* Three way comparison, values of different types are compared as
+ * integers when the text converts and as text otherwise. Returns 0 in
+ * '*known' when one side is NULL */
+static int exprCompare(const struct expr_value_t *a,
+                       const struct expr_value_t *b, int *known) {
+    *known = a->type != EXPR_TYPE_NULL && b->type != EXPR_TYPE_NULL;
+    if (!*known)
+        return 0;
+
+    int a_text = a->type == EXPR_TYPE_TEXT, b_text = b->type == EXPR_TYPE_TEXT;
+    if (a_text && b_text)
+        return strcmp(a->s, b->s);
+
+    int64_t x = a->i, y = b->i;
+    if ((a_text && !exprTextToInt64(a->s, &x)) ||
+        (b_text && !exprTextToInt64(b->s, &y))) {
+        char buffer[24];
+        if (a_text) {
+            snprintf(buffer, sizeof(buffer), "%" PRId64, b->i);
+            return strcmp(a->s, buffer);
+        }
+        snprintf(buffer, sizeof(buffer), "%" PRId64, a->i);
+        return strcmp(buffer, b->s);
+    }
+    return (x > y) - (x < y);
+}
+
+static int exprCompareHolds(int op, int cmp) {
+    switch (op) {
+    case RSQL_ET_OP:
+        return cmp == 0;
+    case RSQL_NE_OP:
+        return cmp != 0;
+    case RSQL_LT_OP:
+        return cmp < 0;
+    case RSQL_LE_OP:
+        return cmp <= 0;
+    case RSQL_GT_OP:
+        return cmp > 0;
+    case RSQL_GE_OP:
+        return cmp >= 0;
+    default:
+        return 0;
+    }
+}
+
+/* '%' matches any run of characters and '_' a single one, on a mismatch
+ * the last '%' absorbs one more character and matching resumes */
+static int exprLike(const char *s, const char *p) {
+    const char *star = NULL, *retry = NULL;
+
+    while (*s) {
+        if (*p == '%') {
+            star = ++p;
+            retry = s;
+        } else if (*p && (*p == '_' || *p == *s)) {
+            p++;
+            s++;
+        } else if (star) {
+            p = star;
+            s = ++retry;
+        } else {
+            return 0;
+        }
+    }
+
+    while (*p == '%')
+        p++;
+    return *p == '\0';
+}
+
+/* First occurrence of needle[0..n) in text[0..len), NULL if none. With
+ * SSE2, 16 positions are tested at once on their first and last byte and
+ * only the positions where both match are compared in full */
+static const char *exprFind(const char *text, size_t len, const char *needle,
+                            size_t n) {
+    size_t i = 0;
+
+    if (n == 0)
+        return text;
+    if (n > len)
+        return NULL;
+
+#if defined(__SSE2__)
+    if (n >= 2) {
+        __m128i first = _mm_set1_epi8(needle[0]);
+        __m128i last = _mm_set1_epi8(needle[n - 1]);
+
+        /* Both loads stay inside the text */
+        for (; i + n - 1 + 16 <= len; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(text + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(text + i + n - 1));
+            unsigned mask = (unsigned)_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, first),
+                              _mm_cmpeq_epi8(b, last)));
+
+            while (mask) {
+                size_t at = i + (size_t)__builtin_ctz(mask);
+                if (memcmp(text + at + 1, needle + 1, n - 2) == 0)
+                    return text + at;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    while (i + n <= len) {
+        const char *p = memchr(text + i, needle[0], len - n + 1 - i);
+        if (!p)
+            return NULL;
+        if (memcmp(p, needle, n) == 0)
+            return p;
+        i = (size_t)(p - text) + 1;
+    }
+    return NULL;
+}
+
+/* Split 'pattern' into the pieces between its '%' */
+static void exprLikeCompile(struct expr_like_t *like, const char *pattern) {
+    size_t len = strlen(pattern);
+
+    like->built = 0;
+    if (len >= sizeof(like->pattern))
+        return;
+
+    memcpy(like->pattern, pattern, len + 1);
+    like->exact = strchr(pattern, '%') == NULL;
+    like->generic = strchr(pattern, '_') != NULL;
+    like->anchored_start = pattern[0] != '%';
+    like->anchored_end = len == 0 || pattern[len - 1] != '%';
+    like->segment_count = 0;
+    like->built = 1;
+
+    for (size_t i = 0; i < len && !like->generic;) {
+        size_t piece = strcspn(pattern + i, "%");
+        if (piece) {
+            if (like->segment_count == EXPR_LIKE_SEGMENTS) {
+                like->generic = 1;
+                break;
+            }
+            like->starts[like->segment_count] = i;
+            like->lengths[like->segment_count++] = piece;
+        }
+        i += piece + 1;
+    }
+}
+
+/* Compile the pattern 'value' of a LIKE, NULL leaves it uncompiled */
+static void exprLikeCompileValue(struct expr_like_t *like,
+                                 const struct expr_value_t *value) {
+    char text[24];
+
+    if (value->type == EXPR_TYPE_TEXT) {
+        exprLikeCompile(like, value->s);
+    } else if (value->type != EXPR_TYPE_NULL) {
+        snprintf(text, sizeof(text), "%" PRId64, value->i);
+        exprLikeCompile(like, text);
+    } else {
+        like->built = 0;
+    }
+}
+
+static int exprLikeMatch(const struct expr_like_t *like, const char *text) {
+    if (like->generic)
+        return exprLike(text, like->pattern);
+    if (like->exact)
+        return strcmp(text, like->pattern) == 0;
+
+    const char *p = like->pattern;
+    size_t len = strlen(text), pos = 0, end = len;
+    size_t first = 0, last = like->segment_count;
+
+    if (like->anchored_start && first < last) {
+        size_t n = like->lengths[first];
+        if (n > len || memcmp(text, p + like->starts[first], n) != 0)
+            return 0;
+        pos = n;
+        first++;
+    }
+
+    if (like->anchored_end && first < last) {
+        size_t n = like->lengths[last - 1];
+        if (n > end - pos ||
+            memcmp(text + len - n, p + like->starts[last - 1], n) != 0)
+            return 0;
+        end = len - n;
+        last--;
+    }
+
+    /* The leftmost match of each piece leaves the most room for the
+     * next ones */
+    for (size_t i = first; i < last; i++) {
+        const char *found = exprFind(text + pos, end - pos,
+                                     p + like->starts[i], like->lengths[i]);
+        if (!found)
+            return 0;
+        pos = (size_t)(found - text) + like->lengths[i];
+    }
+    return 1;
+}
+
+/* Integer operand of an arithmetic operator, 0 when it is NULL or a text
+ * that does not convert */
+static int exprIntOperand(const struct expr_value_t *value, int64_t *out) {
+    switch (value->type) {
+    case EXPR_TYPE_INT:
+    case EXPR_TYPE_BOOL:
+        *out = value->i;
+        return 1;
+    case EXPR_TYPE_TEXT:
+        return exprTextToInt64(value->s, out);
+    default:
+        return 0;
+    }
+}
+
+static void exprSetInt(struct expr_value_t *out, int64_t value) {
+    out->type = EXPR_TYPE_INT;
+    out->i = value;
+    out->s = NULL;
+}
+
+static void exprEvalArith(const struct expr_t *expr, const struct row_t *row,
+                          const struct expr_value_t *params,
+                          struct expr_value_t *out) {
+    struct expr_value_t a, b;
+    int64_t x, y, r;
+    int overflow;
+
+    exprEval(expr->args[0], row, params, &a);
+    exprEval(expr->args[1], row, params, &b);
+    if (!exprIntOperand(&a, &x) || !exprIntOperand(&b, &y)) {
+        exprSetNull(out);
+        return;
+    }
+
+    /* NULL when the result does not fit 64 bits */
+    switch (expr->op) {
+    case RSQL_ADD_OP:
+        overflow = __builtin_add_overflow(x, y, &r);
+        break;
+    case RSQL_SUB_OP:
+        overflow = __builtin_sub_overflow(x, y, &r);
+        break;
+    case RSQL_MUL_OP:
+        overflow = __builtin_mul_overflow(x, y, &r);
+        break;
+    default: /* RSQL_DIV_OP */
+        overflow = y == 0 || (x == INT64_MIN && y == -1);
+        r = overflow ? 0 : x / y;
+        break;
+    }
+
+    if (overflow)
+        exprSetNull(out);
+    else
+        exprSetInt(out, r);
+}
+
+/* Whether 'value' equals one of the candidates, NULL when it does not but
+ * a candidate is NULL. Same conversions as exprCompare(): an integer
+ * matches the text candidates that read as that integer and the other
+ * way round */
+static void exprProbeIn(const struct expr_in_t *in,
+                        const struct expr_value_t *value,
+                        struct expr_value_t *out) {
+    int found = 0, i;
+
+    switch (value->type) {
+    case EXPR_TYPE_NULL:
+        exprSetNull(out);
+        return;
+    case EXPR_TYPE_TEXT:
+        found = setHasText(&in->texts, value->s) ||
+                (in->ints.count && exprTextToInt(value->s, &i) &&
+                 setHasInt(&in->ints, i));
+        break;
+    default:
+        if (value->i < INT_MIN || value->i > INT_MAX)
+            break;
+        found = setHasInt(&in->ints, (int)value->i) ||
+                (in->text_ints.count &&
+                 setHasInt(&in->text_ints, (int)value->i));
+        break;
+    }
+
+    if (!found && in->has_null)
+        exprSetNull(out);
+    else
+        exprSetBool(out, found);
+}
+
+static void exprEvalIn(const struct expr_t *expr, const struct row_t *row,
+                       const struct expr_value_t *params,
+                       struct expr_value_t *out) {
+    struct expr_value_t value, candidate;
+    int known, saw_null = 0;
+
+    exprEval(expr->args[0], row, params, &value);
+    if (expr->in && expr->in->built) {
+        exprProbeIn(expr->in, &value, out);
+        return;
+    }
+
+    /* A subquery has no candidates until it is bound */
+    if (value.type == EXPR_TYPE_NULL || (expr->in && expr->in->table)) {
+        exprSetNull(out);
+        return;
+    }
+
+    for (size_t i = 1; i < expr->arg_count; i++) {
+        exprEval(expr->args[i], row, params, &candidate);
+        int cmp = exprCompare(&value, &candidate, &known);
+        if (known && cmp == 0) {
+            exprSetBool(out, 1);
+            return;
+        }
+        saw_null |= !known;
+    }
+
+    if (saw_null)
+        exprSetNull(out);
+    else
+        exprSetBool(out, 0);
+}
+
+static void exprEvalLike(const struct expr_t *expr, const struct row_t *row,
+                         const struct expr_value_t *params,
+                         struct expr_value_t *out) {
+    struct expr_value_t value, pattern;
+    char value_text[24], pattern_text[24];
+
+    exprEval(expr->args[0], row, params, &value);
+    exprEval(expr->args[1], row, params, &pattern);
+    if (value.type == EXPR_TYPE_NULL || pattern.type == EXPR_TYPE_NULL) {
+        exprSetNull(out);
+        return;
+    }
+
+    /* Integers are matched through their decimal text */
+    if (value.type != EXPR_TYPE_TEXT) {
+        snprintf(value_text, sizeof(value_text), "%" PRId64, value.i);
+        value.s = value_text;
+    }
+
+    if (expr->like && expr->like->built) {
+        exprSetBool(out, exprLikeMatch(expr->like, value.s));
+        return;
+    }
+
+    if (pattern.type != EXPR_TYPE_TEXT) {
+        snprintf(pattern_text, sizeof(pattern_text), "%" PRId64, pattern.i);
+        pattern.s = pattern_text;
+    }
+
+    exprSetBool(out, exprLike(value.s, pattern.s));
+}
+
+void exprEval(const struct expr_t *expr, const struct row_t *row,
+              const struct expr_value_t *params, struct expr_value_t *out) {
+    struct expr_value_t a, b, c;
+    int known, cmp;
+
+    switch (expr->kind) {
+    case EXPR_CONST:
+        *out = expr->value;
+        return;
+
+    case EXPR_COLUMN:
+        out->type = expr->type;
+        out->i = expr->type == EXPR_TYPE_INT ? dbCellInt(row, expr->def) : 0;
+        out->s = expr->type == EXPR_TYPE_INT ? NULL
+                                             : dbCellText(row, expr->def);
+        return;
+
+    case EXPR_PARAM:
+        *out = params[expr->param];
+        return;
+
+    case EXPR_NOT:
+        exprEval(expr->args[0], row, params, &a);
+        if (a.type == EXPR_TYPE_NULL)
+            exprSetNull(out);
+        else
+            exprSetBool(out, !exprIsTrue(&a));
+        return;
+
+    case EXPR_NEG: {
+        int64_t x;
+        exprEval(expr->args[0], row, params, &a);
+        if (!exprIntOperand(&a, &x) || x == INT64_MIN) {
+            exprSetNull(out);
+            return;
+        }
+        exprSetInt(out, -x);
+        return;
+    }
+
+    /* AND and OR only evaluate the right side when the left one does not
+     * decide the result, NULL follows the SQL three valued logic */
+    case EXPR_AND:
+    case EXPR_OR: {
+        int stop = expr->kind == EXPR_OR;
+        exprEval(expr->args[0], row, params, &a);
+        if (a.type != EXPR_TYPE_NULL && exprIsTrue(&a) == stop) {
+            exprSetBool(out, stop);
+            return;
+        }
+
+        exprEval(expr->args[1], row, params, &b);
+        if (b.type != EXPR_TYPE_NULL && exprIsTrue(&b) == stop)
+            exprSetBool(out, stop);
+        else if (a.type == EXPR_TYPE_NULL || b.type == EXPR_TYPE_NULL)
+            exprSetNull(out);
+        else
+            exprSetBool(out, !stop);
+        return;
+    }
+
+    case EXPR_COMPARE:
+        exprEval(expr->args[0], row, params, &a);
+        exprEval(expr->args[1], row, params, &b);
+        cmp = exprCompare(&a, &b, &known);
+        if (known)
+            exprSetBool(out, exprCompareHolds(expr->op, cmp));
+        else
+            exprSetNull(out);
+        return;
+
+    case EXPR_ARITH:
+        exprEvalArith(expr, row, params, out);
+        return;
+
+    case EXPR_BETWEEN: {
+        exprEval(expr->args[0], row, params, &a);
+        exprEval(expr->args[1], row, params, &b);
+        exprEval(expr->args[2], row, params, &c);
+
+        int known_low, known_high;
+        int low = exprCompare(&a, &b, &known_low) >= 0;
+        int high = exprCompare(&a, &c, &known_high) <= 0;
+
+        if ((known_low && !low) || (known_high && !high))
+            exprSetBool(out, 0);
+        else if (!known_low || !known_high)
+            exprSetNull(out);
+        else
+            exprSetBool(out, 1);
+        return;
+    }
+
+    case EXPR_IN:
+        exprEvalIn(expr, row, params, out);
+        return;
+
+    case EXPR_LIKE:
+        exprEvalLike(expr, row, params, out);
+        return;
+
+    case EXPR_IS_NULL:
+        exprEval(expr->args[0], row, params, &a);
+        exprSetBool(out, a.type == EXPR_TYPE_NULL);
+        return;
+    }
+
+    exprSetNull(out);
+}
+
+/* Whether the sets can hold 'value': integers beyond the int range, as
+ * numbers or as text, are left to exprCompare() */
+static int exprSetsHold(const struct expr_value_t *value) {
+    int64_t i;
+
+    if (value->type == EXPR_TYPE_TEXT)
+        return !exprTextToInt64(value->s, &i) || (i >= INT_MIN && i <= INT_MAX);
+    return value->type == EXPR_TYPE_NULL ||
+           (value->i >= INT_MIN && value->i <= INT_MAX);
+}
+
+static int exprAddCandidate(struct expr_in_t *in,
+                            const struct expr_value_t *value) {
+    int i;
+
+    switch (value->type) {
+    case EXPR_TYPE_NULL:
+        in->has_null = 1;
+        return 1;
+    case EXPR_TYPE_TEXT:
+        if (exprTextToInt(value->s, &i) && !setAddInt(&in->text_ints, i))
+            return 0;
+        return setAddText(&in->texts, value->s);
+    default:
+        return setAddInt(&in->ints, (int)value->i);
+    }
+}
+
+static int exprBuildIn(struct expr_t *expr, const struct expr_value_t *params) {
+    struct expr_in_t *in = expr->in;
+    struct expr_value_t value;
+
+    setClear(&in->ints);
+    setClear(&in->texts);
+    setClear(&in->text_ints);
+    in->has_null = 0;
+    in->built = 0;
+
+    if (!in->table) {
+        for (size_t i = 1; i < expr->arg_count; i++) {
+            exprEval(expr->args[i], NULL, params, &value);
+            if (!exprSetsHold(&value))
+                return 1;
+            if (!exprAddCandidate(in, &value))
+                return 0;
+        }
+        in->built = 1;
+        return 1;
+    }
+
+    /* The rows of a partitioned table are those of its partitions */
+    const struct part_t *part = in->table->partitioning;
+    const struct column_t *col = in->table->columns[in->column];
+    value.type = col->type;
+    for (size_t p = 0; p < (part ? part->count : 1); p++) {
+        const struct table_t *table = part ? part->tables[p] : in->table;
+
+        for (size_t r = 0; r < table->row_count; r++) {
+            const struct row_t *row = bufferRowScan(table, r);
+            if (in->filter && !exprMatches(in->filter, row, params))
+                continue;
+
+            value.i = col->type == DB_TYPE_INT ? dbCellInt(row, col) : 0;
+            value.s = col->type == DB_TYPE_INT ? NULL : dbCellText(row, col);
+            if (!exprAddCandidate(in, &value))
+                return 0;
+        }
+    }
+    in->built = 1;
+    return 1;
+}
+
+int exprBind(struct expr_t *expr, const struct expr_value_t *params) {
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        if (!exprBind(expr->args[i], params))
+            return 0;
+    }
+
+    if (expr->like && expr->like->dynamic) {
+        struct expr_value_t pattern;
+        exprEval(expr->args[1], NULL, params, &pattern);
+        exprLikeCompileValue(expr->like, &pattern);
+    }
+
+    if (!expr->in)
+        return 1;
+    if (expr->in->filter && !exprBind(expr->in->filter, params))
+        return 0;
+    if (expr->in->built && !expr->in->dynamic)
+        return 1;
+    return exprBuildIn(expr, params);
+}
+
+void exprRelease(struct expr_t *expr) {
+    for (size_t i = 0; i < expr->arg_count; i++)
+        exprRelease(expr->args[i]);
+
+    if (!expr->in)
+        return;
+    if (expr->in->filter)
+        exprRelease(expr->in->filter);
+    setRelease(&expr->in->ints);
+    setRelease(&expr->in->texts);
+    setRelease(&expr->in->text_ints);
+    expr->in->built = 0;
+}
+
+int exprMatches(const struct expr_t *expr, const struct row_t *row,
+                const struct expr_value_t *params) {
+    struct expr_value_t value;
+
+    exprEval(expr, row, params, &value);
+    return exprIsTrue(&value);
+}
+
+int exprToCell(const struct expr_value_t *value, const struct column_t *col,
+               union cell_value_t *cell) {
+    if (value->type == EXPR_TYPE_NULL)
+        return 0;
+
+    if (col->type == DB_TYPE_INT) {
+        if (value->type == EXPR_TYPE_TEXT)
+            return exprTextToInt(value->s, &cell->i);
+        if (value->i < INT_MIN || value->i > INT_MAX)
+            return 0;
+        cell->i = (int)value->i;
+        return 1;
+    }
+
+    if (value->type == EXPR_TYPE_TEXT) {
+        size_t len = strlen(value->s);
+        if (len > sizeof(cell->s) - 1)
+            return 0;
+        memcpy(cell->s, value->s, len + 1);
+    } else {
+        snprintf(cell->s, sizeof(cell->s), "%" PRId64, value->i);
+    }
+    return 1;
+}
+
+/* Constants compared with a column take the type of the column once at
+ * compile time instead of being converted for every row */
+static int exprCoerce(struct arena_t *arena, const struct table_t *table,
+                      const struct expr_t *column, struct expr_t *value) {
+    if (column->kind != EXPR_COLUMN || value->kind != EXPR_CONST ||
+        value->type == EXPR_TYPE_NULL || value->type == column->type)
+        return 1;
+
+    if (column->type == EXPR_TYPE_INT) {
+        if (value->type == EXPR_TYPE_TEXT &&
+            !exprTextToInt64(value->value.s, &value->value.i)) {
+            LOG_ERROR("Invalid value '%s' for column '%s'", value->value.s,
+                      table->columns[column->column]->name);
+            return 0;
+        }
+        value->value.s = NULL;
+        value->type = value->value.type = EXPR_TYPE_INT;
+        return 1;
+    }
+
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%" PRId64, value->value.i);
+    value->value.s = arenaStrdup(arena, buffer);
+    value->type = value->value.type = EXPR_TYPE_TEXT;
+    return value->value.s != NULL;
+}
+
+/* Replace a subtree whose operands are all constants by its value. AND
+ * and OR are also simplified when one constant operand decides them */
+static struct expr_t *exprFold(struct expr_t *expr) {
+    if (expr->kind == EXPR_CONST || expr->kind == EXPR_COLUMN ||
+        expr->kind == EXPR_PARAM || expr->in)
+        return expr;
+
+    if (expr->kind == EXPR_AND || expr->kind == EXPR_OR) {
+        int stop = expr->kind == EXPR_OR;
+        for (size_t i = 0; i < 2; i++) {
+            struct expr_t *arg = expr->args[i];
+            if (arg->kind != EXPR_CONST || arg->type == EXPR_TYPE_NULL)
+                continue;
+            if (exprIsTrue(&arg->value) == stop)
+                return arg;
+            if (expr->args[1 - i]->type == EXPR_TYPE_BOOL)
+                return expr->args[1 - i];
+        }
+    }
+
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        if (expr->args[i]->kind != EXPR_CONST)
+            return expr;
+    }
+
+    exprEval(expr, NULL, NULL, &expr->value);
+    expr->kind = EXPR_CONST;
+    expr->type = expr->value.type;
+    expr->arg_count = 0;
+    return expr;
+}
+
+static struct expr_t *exprCompileLiteral(struct arena_t *arena,
+                                         const struct ast_node_t *node) {
+    struct expr_t *expr = exprNew(arena, EXPR_CONST, EXPR_TYPE_TEXT, 0);
+    if (!expr)
+        return NULL;
+
+    if (node->op == NULL_KW) {
+        expr->type = EXPR_TYPE_NULL;
+        exprSetNull(&expr->value);
+        return expr;
+    }
+
+    /* Decimals and integers beyond 64 bits stay textual */
+    if (node->op == RSQL_NUMERIC_LITERAL &&
+        exprTextToInt64(node->value, &expr->value.i)) {
+        expr->type = EXPR_TYPE_INT;
+        expr->value.type = EXPR_TYPE_INT;
+        return expr;
+    }
+
+    expr->value.type = EXPR_TYPE_TEXT;
+    expr->value.s = arenaStrdup(arena, node->value);
+    return expr->value.s ? expr : NULL;
+}
+
+static enum expr_kind_t exprBinaryKind(int op) {
+    switch (op) {
+    case AND_KW:
+        return EXPR_AND;
+    case OR_KW:
+        return EXPR_OR;
+    case RSQL_ADD_OP:
+    case RSQL_SUB_OP:
+    case RSQL_MUL_OP:
+    case RSQL_DIV_OP:
+        return EXPR_ARITH;
+    default:
+        return EXPR_COMPARE;
+    }
+}
+
+static struct expr_in_t *exprNewIn(struct arena_t *arena) {
+    struct expr_in_t *in = arenaAlloc(arena, sizeof(struct expr_in_t));
+    if (!in)
+        return NULL;
+
+    memset(in, 0, sizeof(struct expr_in_t));
+    setInit(&in->ints, DB_TYPE_INT);
+    setInit(&in->texts, DB_TYPE_TEXT);
+    setInit(&in->text_ints, DB_TYPE_INT);
+    in->column = -1;
+    return in;
+}
+
+/* An IN list whose candidates are all constants or parameters is probed
+ * through sets, built once for constants and at every bind otherwise */
+static int exprPrepareIn(struct arena_t *arena, struct expr_t *expr) {
+    int dynamic = 0;
+
+    for (size_t i = 1; i < expr->arg_count; i++) {
+        if (expr->args[i]->kind == EXPR_PARAM)
+            dynamic = 1;
+        else if (expr->args[i]->kind != EXPR_CONST)
+            return 1;
+    }
+
+    expr->in = exprNewIn(arena);
+    if (!expr->in)
+        return 0;
+    expr->in->dynamic = dynamic;
+    return 1;
+}
+
+/* A constant pattern is compiled once, a parameter at every bind */
+static int exprPrepareLike(struct arena_t *arena, struct expr_t *expr) {
+    const struct expr_t *pattern = expr->args[1];
+    if (pattern->kind != EXPR_CONST && pattern->kind != EXPR_PARAM)
+        return 1;
+
+    expr->like = arenaAlloc(arena, sizeof(struct expr_like_t));
+    if (!expr->like)
+        return 0;
+
+    memset(expr->like, 0, sizeof(struct expr_like_t));
+    expr->like->dynamic = pattern->kind == EXPR_PARAM;
+    if (!expr->like->dynamic)
+        exprLikeCompileValue(expr->like, &pattern->value);
+    return 1;
+}
+
+/* 'value IN (SELECT column FROM table [WHERE ...])', the subquery cannot
+ * reference the columns of the outer statement */
+static struct expr_t *exprCompileSubquery(struct arena_t *arena,
+                                          struct database_t *db,
+                                          const struct table_t *table,
+                                          const struct ast_node_t *node,
+                                          size_t *param_count) {
+    const struct ast_node_t *select = node->children[1];
+    const struct ast_node_t *where = NULL;
+    size_t n = select->child_count;
+
+    if (!db) {
+        LOG_ERROR("Subquery not allowed here");
+        return NULL;
+    }
+
+    if (n && select->children[n - 1]->type == AST_WHERE_CLAUSE)
+        where = select->children[--n];
+
+    struct table_t *source =
+        n == 2 ? dbTableFind(db, select->children[1]->value) : NULL;
+    if (n == 2 && !source) {
+        LOG_ERROR("Table '%s' doesn't exist", select->children[1]->value);
+        return NULL;
+    }
+
+    const char *name = n == 2 ? select->children[0]->value : NULL;
+    int column = -1;
+    if (name && strcmp(name, "*") == 0)
+        column = source->column_count == 1 ? 0 : -1;
+    else if (name && (column = dbColumnFind(source, name)) < 0) {
+        LOG_ERROR("Unknown column '%s'", name);
+        return NULL;
+    }
+
+    if (column < 0) {
+        LOG_ERROR("Subquery must select a single column");
+        return NULL;
+    }
+
+    struct expr_t *expr = exprNew(arena, EXPR_IN, EXPR_TYPE_BOOL, 1);
+    if (!expr || !(expr->in = exprNewIn(arena)))
+        return NULL;
+
+    expr->op = node->op;
+    expr->in->table = source;
+    expr->in->column = column;
+    expr->in->dynamic = 1;
+
+    expr->args[0] =
+        exprCompile(arena, db, table, node->children[0], param_count);
+    if (!expr->args[0])
+        return NULL;
+
+    if (where) {
+        expr->in->filter = where->child_count == 1
+                               ? exprCompile(arena, db, source,
+                                             where->children[0], param_count)
+                               : NULL;
+        if (!expr->in->filter)
+            return NULL;
+    }
+    return expr;
+}
+
+struct expr_t *exprCompile(struct arena_t *arena, struct database_t *db,
+                           const struct table_t *table,
+                           const struct ast_node_t *node, size_t *param_count) {
+    struct expr_t *expr = NULL;
+
+    switch (node->type) {
+    case AST_LITERAL:
+        return exprCompileLiteral(arena, node);
+
+    case AST_IDENTIFIER: {
+        int column = table ? dbColumnFind((struct table_t *)table, node->value)
+                           : -1;
+        if (column < 0) {
+            LOG_ERROR("Unknown column '%s'", node->value);
+            return NULL;
+        }
+
+        expr = exprNew(arena, EXPR_COLUMN, table->columns[column]->type, 0);
+        if (expr) {
+            expr->column = column;
+            expr->def = table->columns[column];
+        }
+        return expr;
+    }
+
+    case AST_PARAM:
+        expr = exprNew(arena, EXPR_PARAM, EXPR_TYPE_ANY, 0);
+        if (!expr)
+            return NULL;
+        expr->param = (size_t)atoi(node->value);
+        if (expr->param >= *param_count)
+            *param_count = expr->param + 1;
+        return expr;
+
+    case AST_UNARY_OP:
+        expr = node->op == NOT_KW
+                   ? exprNew(arena, EXPR_NOT, EXPR_TYPE_BOOL, 1)
+                   : exprNew(arena, EXPR_NEG, EXPR_TYPE_INT, 1);
+        break;
+
+    case AST_BINARY_OP: {
+        enum expr_kind_t kind = exprBinaryKind(node->op);
+        expr = exprNew(arena, kind,
+                       kind == EXPR_ARITH ? EXPR_TYPE_INT : EXPR_TYPE_BOOL, 2);
+        break;
+    }
+
+    case AST_BETWEEN:
+        expr = exprNew(arena, EXPR_BETWEEN, EXPR_TYPE_BOOL, 3);
+        break;
+
+    case AST_IN_LIST:
+        expr = exprNew(arena, EXPR_IN, EXPR_TYPE_BOOL, node->child_count);
+        break;
+
+    case AST_IN_SUBQUERY:
+        if (node->child_count != 2)
+            return NULL;
+        return exprCompileSubquery(arena, db, table, node, param_count);
+
+    case AST_LIKE:
+        expr = exprNew(arena, EXPR_LIKE, EXPR_TYPE_BOOL, 2);
+        break;
+
+    case AST_IS_NULL:
+        expr = exprNew(arena, EXPR_IS_NULL, EXPR_TYPE_BOOL, 1);
+        break;
+
+    default:
+        LOG_ERROR("Unsupported expression");
+        return NULL;
+    }
+
+    if (!expr || node->child_count != expr->arg_count)
+        return NULL;
+
+    expr->op = node->op;
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        expr->args[i] = exprCompile(arena, db, table, node->children[i],
+                                    param_count);
+        if (!expr->args[i])
+            return NULL;
+    }
+
+    /* Arithmetic is on integers, a TEXT column cannot be an operand */
+    if (expr->kind == EXPR_ARITH || expr->kind == EXPR_NEG) {
+        for (size_t i = 0; i < expr->arg_count; i++) {
+            if (expr->args[i]->type == EXPR_TYPE_TEXT &&
+                expr->args[i]->kind == EXPR_COLUMN) {
+                LOG_ERROR("Arithmetic on TEXT column '%s'",
+                          table->columns[expr->args[i]->column]->name);
+                return NULL;
+            }
+        }
+    }
+
+    /* Comparisons, BETWEEN and IN convert their constants to the column
+     * type, 'value <op> column' works both ways */
+    if (expr->kind == EXPR_COMPARE &&
+        !exprCoerce(arena, table, expr->args[1], expr->args[0]))
+        return NULL;
+    if (expr->kind == EXPR_COMPARE || expr->kind == EXPR_BETWEEN ||
+        expr->kind == EXPR_IN) {
+        for (size_t i = 1; i < expr->arg_count; i++) {
+            if (!exprCoerce(arena, table, expr->args[0], expr->args[i]))
+                return NULL;
+        }
+    }
+
+    expr = exprFold(expr);
+    if (expr->kind == EXPR_IN && !exprPrepareIn(arena, expr))
+        return NULL;
+    if (expr->kind == EXPR_LIKE && !exprPrepareLike(arena, expr))
+        return NULL;
+    return expr;
+}
+
+struct expr_t *exprAnd(struct arena_t *arena, struct expr_t *left,
+                       struct expr_t *right) {
+    struct expr_t *expr = exprNew(arena, EXPR_AND, EXPR_TYPE_BOOL, 2);
+    if (!expr)
+        return NULL;
+
+    expr->op = AND_KW;
+    expr->args[0] = left;
+    expr->args[1] = right;
+    return expr;
+}
+
+size_t exprConjuncts(struct expr_t *expr, struct expr_t **out, size_t max) {
+    if (expr->kind != EXPR_AND) {
+        if (max)
+            out[0] = expr;
+        return 1;
+    }
+
+    size_t n = exprConjuncts(expr->args[0], out, max);
+    return n + exprConjuncts(expr->args[1], out + (n < max ? n : max),
+                             n < max ? max - n : 0);
+}
+
+/* Appends to the text of exprFormat(), truncating at the end of 'out' */
+struct expr_text_t {
+    char *out;
+    size_t cap;
+    size_t len;
+};
+
+static void exprPut(struct expr_text_t *text, const char *format, ...) {
+    va_list args;
+
+    if (text->len + 1 >= text->cap)
+        return;
+
+    va_start(args, format);
+    int n = vsnprintf(text->out + text->len, text->cap - text->len, format,
+                      args);
+    va_end(args);
+
+    if (n > 0)
+        text->len += (size_t)n < text->cap - text->len
+                         ? (size_t)n
+                         : text->cap - text->len - 1;
+}
+
+const char *exprOpName(int op) {
+    switch (op) {
+    case RSQL_ET_OP:
+        return "=";
+    case RSQL_NE_OP:
+        return "!=";
+    case RSQL_GT_OP:
+        return ">";
+    case RSQL_GE_OP:
+        return ">=";
+    case RSQL_LT_OP:
+        return "<";
+    case RSQL_LE_OP:
+        return "<=";
+    case RSQL_ADD_OP:
+        return "+";
+    case RSQL_SUB_OP:
+        return "-";
+    case RSQL_MUL_OP:
+        return "*";
+    case RSQL_DIV_OP:
+        return "/";
+    default:
+        return "?";
+    }
+}
+
+static void exprPutValue(struct expr_text_t *text,
+                         const struct expr_value_t *value) {
+    switch (value->type) {
+    case EXPR_TYPE_INT:
+        exprPut(text, "%" PRId64, value->i);
+        break;
+    case EXPR_TYPE_TEXT:
+        exprPut(text, "'%s'", value->s);
+        break;
+    case EXPR_TYPE_BOOL:
+        exprPut(text, "%s", value->i ? "TRUE" : "FALSE");
+        break;
+    default:
+        exprPut(text, "NULL");
+        break;
+    }
+}
+
+static void exprPutExpr(struct expr_text_t *text, const struct expr_t *expr,
+                        const struct expr_value_t *params, int nested) {
+    switch (expr->kind) {
+    case EXPR_CONST:
+        exprPutValue(text, &expr->value);
+        return;
+
+    case EXPR_COLUMN:
+        exprPut(text, "%s", expr->def->name);
+        return;
+
+    case EXPR_PARAM:
+        if (params)
+            exprPutValue(text, &params[expr->param]);
+        else
+            exprPut(text, "?");
+        return;
+
+    case EXPR_NOT:
+    case EXPR_NEG:
+        exprPut(text, "%s", expr->kind == EXPR_NOT ? "NOT " : "-");
+        exprPutExpr(text, expr->args[0], params, 1);
+        return;
+
+    case EXPR_AND:
+    case EXPR_OR:
+        exprPut(text, "%s", nested ? "(" : "");
+        exprPutExpr(text, expr->args[0], params, 1);
+        exprPut(text, " %s ", expr->kind == EXPR_AND ? "AND" : "OR");
+        exprPutExpr(text, expr->args[1], params, 1);
+        exprPut(text, "%s", nested ? ")" : "");
+        return;
+
+    case EXPR_COMPARE:
+    case EXPR_ARITH:
+        exprPutExpr(text, expr->args[0], params, 1);
+        exprPut(text, " %s ", exprOpName(expr->op));
+        exprPutExpr(text, expr->args[1], params, 1);
+        return;
+
+    case EXPR_BETWEEN:
+        exprPutExpr(text, expr->args[0], params, 1);
+        exprPut(text, " BETWEEN ");
+        exprPutExpr(text, expr->args[1], params, 1);
+        exprPut(text, " AND ");
+        exprPutExpr(text, expr->args[2], params, 1);
+        return;
+
+    case EXPR_IN:
+        exprPutExpr(text, expr->args[0], params, 1);
+        if (expr->in && expr->in->table) {
+            exprPut(text, " IN (SELECT %s FROM %s",
+                    expr->in->table->columns[expr->in->column]->name,
+                    expr->in->table->name);
+            if (expr->in->filter) {
+                exprPut(text, " WHERE ");
+                exprPutExpr(text, expr->in->filter, params, 0);
+            }
+            exprPut(text, ")");
+            return;
+        }
+        exprPut(text, " IN (");
+        for (size_t i = 1; i < expr->arg_count; i++) {
+            exprPut(text, "%s", i > 1 ? ", " : "");
+            exprPutExpr(text, expr->args[i], params, 1);
+        }
+        exprPut(text, ")");
+        return;
+
+    case EXPR_LIKE:
+        exprPutExpr(text, expr->args[0], params, 1);
+        exprPut(text, " LIKE ");
+        exprPutExpr(text, expr->args[1], params, 1);
+        return;
+
+    case EXPR_IS_NULL:
+        exprPutExpr(text, expr->args[0], params, 1);
+        exprPut(text, " IS NULL");
+        return;
+    }
+}
+
+size_t exprFormat(const struct expr_t *expr,
+                  const struct expr_value_t *params, char *out, size_t cap) {
+    struct expr_text_t text = {out, cap, 0};
+
+    if (!cap)
+        return 0;
+    out[0] = '\0';
+    exprPutExpr(&text, expr, params, 0);
+    return text.len;
+}
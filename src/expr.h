@@ -0,0 +1,167 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Typed expression trees. The AST of an expression is compiled once per
+ *  plan: column names become column indexes, every node gets its result
+ *  type, constants are converted to the type of the column they are
+ *  compared with and constant subtrees are folded. The executor then
+ *  evaluates the tree against each row.
+ */
+#ifndef _EXPR_H
+#define _EXPR_H
+
+#include "arena.h"
+#include "db.h"
+#include "parser.h"
+#include "set.h"
+
+#include <stdint.h>
+
+/* Value types, NULL only comes from the NULL literal since cells are
+ * never NULL */
+#define EXPR_TYPE_NULL 0x00
+#define EXPR_TYPE_INT DB_TYPE_INT
+#define EXPR_TYPE_TEXT DB_TYPE_TEXT
+#define EXPR_TYPE_BOOL 0x03
+#define EXPR_TYPE_ANY 0x04 /* parameters, known at execution time */
+
+enum expr_kind_t {
+    EXPR_CONST,
+    EXPR_COLUMN,
+    EXPR_PARAM,
+    EXPR_NOT,
+    EXPR_NEG,
+    EXPR_AND,
+    EXPR_OR,
+    EXPR_COMPARE, /* args: left, right, op: RSQL_*_OP */
+    EXPR_ARITH,   /* args: left, right, op: RSQL_ADD_OP... */
+    EXPR_BETWEEN, /* args: value, low, high */
+    EXPR_IN,      /* args: value, candidates... (only value for a subquery) */
+    EXPR_LIKE,    /* args: value, pattern */
+    EXPR_IS_NULL,
+};
+
+/* Text values are not owned, they point into a cell or a constant.
+ * Integers are computed and compared in 64 bits, they only have to fit
+ * an int to be stored in a cell */
+struct expr_value_t {
+    int type;
+    int64_t i; /* INT value, 0/1 for BOOL */
+    const char *s;
+};
+
+/* Candidates of an IN probed through sets instead of being compared one
+ * by one. They are collected by exprBind() before the scan, either from
+ * the constants and parameters of the list or from the rows of a
+ * subquery. Values of each type are kept apart so that a probe follows
+ * the same conversion rules as '=' */
+struct expr_in_t {
+    struct set_t ints;      /* INT candidates */
+    struct set_t texts;     /* TEXT candidates */
+    struct set_t text_ints; /* TEXT candidates that read as integers */
+    int has_null;           /* a miss is NULL rather than FALSE */
+    int built;              /* the sets hold the current candidates */
+    int dynamic;            /* candidates change between executions */
+
+    /* 'IN (SELECT column FROM table WHERE filter)' */
+    struct table_t *table;
+    int column;
+    struct expr_t *filter;
+};
+
+/* Maximum '%'-separated pieces of a compiled LIKE pattern */
+#define EXPR_LIKE_SEGMENTS 16
+
+/* A LIKE pattern without '_' compiled into its literal pieces: the first
+ * one must start the text unless the pattern starts with '%', the last
+ * one must end it unless the pattern ends with '%' and the others are
+ * searched in order in between. Other patterns use the generic matcher */
+struct expr_like_t {
+    char pattern[256];
+    int exact;   /* no '%', plain comparison */
+    int generic; /* '_' or too many pieces */
+    int anchored_start;
+    int anchored_end;
+    size_t starts[EXPR_LIKE_SEGMENTS];
+    size_t lengths[EXPR_LIKE_SEGMENTS];
+    size_t segment_count;
+    int built;   /* holds the current pattern */
+    int dynamic; /* the pattern is a parameter */
+};
+
+struct expr_t {
+    enum expr_kind_t kind;
+    int type; /* EXPR_TYPE_* of the result */
+    int op;
+
+    int column;                 /* EXPR_COLUMN */
+    const struct column_t *def; /* EXPR_COLUMN, read from each row */
+    size_t param;               /* EXPR_PARAM */
+    struct expr_value_t value;  /* EXPR_CONST */
+    struct expr_in_t *in;       /* EXPR_IN with a set, NULL otherwise */
+    struct expr_like_t *like;   /* EXPR_LIKE with a compiled pattern */
+
+    struct expr_t **args;
+    size_t arg_count;
+};
+
+/* Compile the expression 'node' in 'arena'. Columns are looked up in
+ * 'table' (NULL when the expression cannot reference columns), subquery
+ * tables in 'db' (NULL when subqueries are not allowed) and
+ * '*param_count' is raised to cover the placeholders found */
+struct expr_t *exprCompile(struct arena_t *arena, struct database_t *db,
+                           const struct table_t *table,
+                           const struct ast_node_t *node, size_t *param_count);
+
+/* 'left AND right', used to rebuild conjunctions */
+struct expr_t *exprAnd(struct arena_t *arena, struct expr_t *left,
+                       struct expr_t *right);
+
+/* Store the operands of the top level AND chain of 'expr' in 'out',
+ * returns how many there are (at most 'max' are stored) */
+size_t exprConjuncts(struct expr_t *expr, struct expr_t **out, size_t max);
+
+/* Collect the IN candidates and compile the LIKE patterns of 'expr' for
+ * an execution with 'params', before any row is evaluated. Returns 0
+ * when out of memory */
+int exprBind(struct expr_t *expr, const struct expr_value_t *params);
+
+/* Free the memory held by the IN sets of 'expr', the nodes themselves
+ * belong to the arena */
+void exprRelease(struct expr_t *expr);
+
+/* Evaluate 'expr' against 'row' (NULL for expressions without columns)
+ * with the parameters 'params' */
+void exprEval(const struct expr_t *expr, const struct row_t *row,
+              const struct expr_value_t *params, struct expr_value_t *out);
+
+/* Whether a WHERE condition holds, NULL counts as false */
+int exprMatches(const struct expr_t *expr, const struct row_t *row,
+                const struct expr_value_t *params);
+
+/* Convert a value into a cell of 'col', 0 if it does not convert */
+int exprToCell(const struct expr_value_t *value, const struct column_t *col,
+               union cell_value_t *cell);
+
+/* SQL text of a comparison or arithmetic operator (RSQL_*_OP) */
+const char *exprOpName(int op);
+
+/* Write 'expr' as SQL text into 'out', parameters are shown with their
+ * value when 'params' is not NULL. Returns the length of the text */
+size_t exprFormat(const struct expr_t *expr,
+                  const struct expr_value_t *params, char *out, size_t cap);
+
+#endif /* _EXPR_H */
@@ -0,0 +1,1060 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "index.h"
+#include "buffer.h"
+#include "lex.h"
+#include "logs.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Smallest trigram table, it is kept at most half full */
+#define INDEX_MIN_POSTING_SLOTS 1024
+
+/* Trigrams of a pattern intersected by a lookup, more barely prune */
+#define INDEX_MAX_TRIGRAMS 32
+
+/* Smallest table of distinct values of a bitmap index */
+#define INDEX_MIN_VALUE_SLOTS 64
+
+/* Value of a row, or of a probe with no row, read as the type of the
+ * column: 'i' for INT and 's' for TEXT. Sorted indexes sort rows on it */
+struct index_key_t {
+    int i;
+    const char *s;
+    uint32_t row;
+};
+
+/* Rows a statement changed, ascending. The rows after deleted ones move
+ * down, updated ones keep their position */
+struct index_change_t {
+    const uint32_t *rows;
+    size_t count;
+    int deleted;
+};
+
+int indexTypeFromName(const char *name) {
+    if (strcasecmp(name, "SORTED") == 0)
+        return INDEX_SORTED;
+    if (strcasecmp(name, "TRIGRAM") == 0)
+        return INDEX_TRIGRAM;
+    if (strcasecmp(name, "BITMAP") == 0)
+        return INDEX_BITMAP;
+    if (strcasecmp(name, "ART") == 0)
+        return INDEX_ART;
+    return 0;
+}
+
+const char *indexTypeName(int type) {
+    switch (type) {
+    case INDEX_SORTED:
+        return "SORTED";
+    case INDEX_TRIGRAM:
+        return "TRIGRAM";
+    case INDEX_BITMAP:
+        return "BITMAP";
+    case INDEX_ART:
+        return "ART";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static struct index_key_t indexKey(const struct index_t *index, uint32_t r) {
+    const struct row_t *row = bufferRow(index->table, r);
+    const struct column_t *col = index->table->columns[index->column];
+    struct index_key_t key = {0, NULL, r};
+
+    if (col->type == DB_TYPE_INT)
+        key.i = dbCellInt(row, col);
+    else
+        key.s = dbCellText(row, col);
+    return key;
+}
+
+static struct index_key_t indexProbeKey(const struct index_t *index,
+                                        const union cell_value_t *operand) {
+    struct index_key_t key = {operand->i, operand->s, 0};
+
+    if (index->table->columns[index->column]->type == DB_TYPE_INT)
+        key.s = NULL;
+    else
+        key.i = 0;
+    return key;
+}
+
+static int indexCompareValues(const struct index_t *index,
+                              const struct index_key_t *x,
+                              const struct index_key_t *y) {
+    if (index->table->columns[index->column]->type == DB_TYPE_INT)
+        return (x->i > y->i) - (x->i < y->i);
+    return strcmp(x->s, y->s);
+}
+
+/* Equal values keep the row order, so a scan of a range of the index
+ * visits the rows in table order once they are sorted again */
+static int indexCompareIntKeys(const void *a, const void *b) {
+    const struct index_key_t *x = a, *y = b;
+    if (x->i != y->i)
+        return x->i < y->i ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+static int indexCompareTextKeys(const void *a, const void *b) {
+    const struct index_key_t *x = a, *y = b;
+    int cmp = strcmp(x->s, y->s);
+    if (cmp)
+        return cmp;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+static int indexCompareRows(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort the keys and merge them with the first 'count' entries of the
+ * order, which are in order already */
+static int indexMergeSorted(struct index_t *index, size_t count,
+                            struct index_key_t *keys, size_t key_count) {
+    int (*compare)(const void *, const void *) =
+        index->table->columns[index->column]->type == DB_TYPE_INT
+            ? indexCompareIntKeys
+            : indexCompareTextKeys;
+
+    uint32_t *order = malloc((count + key_count) * sizeof(uint32_t) + 1);
+    if (!order)
+        return 0;
+    qsort(keys, key_count, sizeof(*keys), compare);
+
+    size_t i = 0, j = 0, n = 0;
+    while (i < count && j < key_count) {
+        struct index_key_t key = indexKey(index, index->order[i]);
+        if (compare(&key, &keys[j]) <= 0)
+            order[n++] = index->order[i++];
+        else
+            order[n++] = keys[j++].row;
+    }
+    while (i < count)
+        order[n++] = index->order[i++];
+    while (j < key_count)
+        order[n++] = keys[j++].row;
+
+    free(index->order);
+    index->order = order;
+    return 1;
+}
+
+/* The rows appended since the last sync come after the indexed ones */
+static int indexSyncSorted(struct index_t *index) {
+    size_t from = index->row_count, to = index->table->row_count;
+
+    struct index_key_t *keys = malloc((to - from) * sizeof(*keys));
+    if (!keys)
+        return 0;
+
+    for (size_t r = from; r < to; r++)
+        keys[r - from] = indexKey(index, (uint32_t)r);
+
+    int ok = indexMergeSorted(index, from, keys, to - from);
+    free(keys);
+    return ok;
+}
+
+static uint32_t indexTrigram(const char *text) {
+    return (uint32_t)(unsigned char)text[0] << 16 |
+           (uint32_t)(unsigned char)text[1] << 8 |
+           (uint32_t)(unsigned char)text[2];
+}
+
+static size_t indexPostingSlot(const struct index_t *index, uint32_t trigram) {
+    size_t mask = index->posting_slots - 1;
+    size_t slot = (trigram * 0x9e3779b1u) >> 8 & mask;
+
+    while (index->postings[slot].trigram &&
+           index->postings[slot].trigram != trigram)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static struct posting_t *indexFindPosting(const struct index_t *index,
+                                          uint32_t trigram) {
+    if (!index->posting_slots)
+        return NULL;
+
+    struct posting_t *posting =
+        &index->postings[indexPostingSlot(index, trigram)];
+    return posting->trigram ? posting : NULL;
+}
+
+static int indexGrowPostings(struct index_t *index) {
+    size_t slots = index->posting_slots ? index->posting_slots * 2
+                                        : INDEX_MIN_POSTING_SLOTS;
+    struct posting_t *old = index->postings;
+    size_t old_slots = index->posting_slots;
+
+    index->postings = calloc(slots, sizeof(struct posting_t));
+    if (!index->postings) {
+        index->postings = old;
+        return 0;
+    }
+
+    index->posting_slots = slots;
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i].trigram)
+            index->postings[indexPostingSlot(index, old[i].trigram)] = old[i];
+    }
+    free(old);
+    return 1;
+}
+
+/* Trigrams are NUL free, so a 0 trigram marks a free slot */
+static int indexAddTrigram(struct index_t *index, uint32_t trigram,
+                           uint32_t row) {
+    if ((index->posting_count + 1) * 2 > index->posting_slots &&
+        !indexGrowPostings(index))
+        return 0;
+
+    struct posting_t *posting =
+        &index->postings[indexPostingSlot(index, trigram)];
+    if (!posting->trigram) {
+        posting->trigram = trigram;
+        index->posting_count++;
+    }
+
+    /* Rows are mostly added in order, a repeated trigram is already
+     * there. The rows an UPDATE changed go where they belong */
+    uint32_t at = posting->count;
+    if (at && posting->rows[at - 1] >= row) {
+        uint32_t lo = 0;
+        while (lo < at) {
+            uint32_t mid = lo + (at - lo) / 2;
+            if (posting->rows[mid] < row)
+                lo = mid + 1;
+            else
+                at = mid;
+        }
+        if (posting->rows[at] == row)
+            return 1;
+    }
+
+    if (posting->count == posting->capacity) {
+        uint32_t capacity = posting->capacity ? posting->capacity * 2 : 4;
+        uint32_t *rows = realloc(posting->rows, capacity * sizeof(uint32_t));
+        if (!rows)
+            return 0;
+        posting->rows = rows;
+        posting->capacity = capacity;
+    }
+    memmove(posting->rows + at + 1, posting->rows + at,
+            (posting->count - at) * sizeof(uint32_t));
+    posting->rows[at] = row;
+    posting->count++;
+    return 1;
+}
+
+static int indexAddTrigrams(struct index_t *index, const char *text,
+                            uint32_t row) {
+    size_t len = strlen(text);
+
+    for (size_t i = 0; i + 3 <= len; i++) {
+        if (!indexAddTrigram(index, indexTrigram(text + i), row))
+            return 0;
+    }
+    return 1;
+}
+
+static int indexSyncTrigram(struct index_t *index) {
+    const struct table_t *table = index->table;
+    const struct column_t *col = table->columns[index->column];
+
+    for (size_t r = index->row_count; r < table->row_count; r++) {
+        const char *text = dbCellText(bufferRowScan(table, r), col);
+        if (!indexAddTrigrams(index, text, (uint32_t)r))
+            return 0;
+    }
+    return 1;
+}
+
+static uint32_t indexHashKey(const struct index_t *index,
+                             const struct index_key_t *key) {
+    if (index->table->columns[index->column]->type == DB_TYPE_INT) {
+        uint32_t h = (uint32_t)key->i * 0x9e3779b1u;
+        return h ^ (h >> 16);
+    }
+
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    for (const char *s = key->s; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Slot of the value of 'key' or the free slot where it belongs */
+static size_t indexValueSlot(const struct index_t *index,
+                             const struct index_key_t *key, uint32_t hash) {
+    size_t mask = index->value_slots - 1;
+    size_t slot = hash & mask;
+
+    while (index->values[slot].rows.count) {
+        const struct index_value_t *value = &index->values[slot];
+        if (value->hash != hash) {
+            slot = (slot + 1) & mask;
+            continue;
+        }
+        struct index_key_t held = indexKey(index, value->row);
+        if (indexCompareValues(index, &held, key) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Move the values to a table of 'slots' slots, which also clears the
+ * slots of the values no row holds anymore */
+static int indexRehashValues(struct index_t *index, size_t slots) {
+    struct index_value_t *old = index->values;
+    size_t old_slots = index->value_slots;
+
+    index->values = calloc(slots, sizeof(struct index_value_t));
+    if (!index->values) {
+        index->values = old;
+        return 0;
+    }
+
+    /* Distinct values, so the first free slot of the probe is theirs */
+    index->value_slots = slots;
+    for (size_t i = 0; i < old_slots; i++) {
+        if (!old[i].rows.count)
+            continue;
+        size_t slot = old[i].hash & (slots - 1);
+        while (index->values[slot].rows.count)
+            slot = (slot + 1) & (slots - 1);
+        index->values[slot] = old[i];
+    }
+    free(old);
+    return 1;
+}
+
+static int indexGrowValues(struct index_t *index) {
+    return indexRehashValues(index, index->value_slots
+                                        ? index->value_slots * 2
+                                        : INDEX_MIN_VALUE_SLOTS);
+}
+
+static int indexAddValue(struct index_t *index, uint32_t row) {
+    struct index_key_t key = indexKey(index, row);
+    uint32_t hash = indexHashKey(index, &key);
+
+    if ((index->value_count + 1) * 2 > index->value_slots &&
+        !indexGrowValues(index))
+        return 0;
+
+    struct index_value_t *value =
+        &index->values[indexValueSlot(index, &key, hash)];
+    if (!value->rows.count) {
+        value->row = row;
+        value->hash = hash;
+        index->value_count++;
+    }
+    return bitmapAdd(&value->rows, row);
+}
+
+static int indexSyncBitmap(struct index_t *index) {
+    for (size_t r = index->row_count; r < index->table->row_count; r++) {
+        if (!indexAddValue(index, (uint32_t)r))
+            return 0;
+    }
+    return 1;
+}
+
+/* Bytes of 'value' in the radix tree, returns their length */
+static size_t indexArtKey(const struct index_t *index,
+                          const struct index_key_t *value,
+                          unsigned char *key) {
+    if (index->table->columns[index->column]->type == DB_TYPE_INT) {
+        uint32_t bits = (uint32_t)value->i ^ 0x80000000u;
+        key[0] = (unsigned char)(bits >> 24);
+        key[1] = (unsigned char)(bits >> 16);
+        key[2] = (unsigned char)(bits >> 8);
+        key[3] = (unsigned char)bits;
+        return 4;
+    }
+
+    size_t len = strlen(value->s) + 1;
+    memcpy(key, value->s, len);
+    return len;
+}
+
+static int indexAddKey(struct index_t *index, uint32_t row) {
+    unsigned char key[sizeof(union cell_value_t)];
+    struct index_key_t value = indexKey(index, row);
+    size_t len = indexArtKey(index, &value, key);
+    return artInsert(&index->tree, key, len, row);
+}
+
+static int indexSyncArt(struct index_t *index) {
+    for (size_t r = index->row_count; r < index->table->row_count; r++) {
+        if (!indexAddKey(index, (uint32_t)r))
+            return 0;
+    }
+    return 1;
+}
+
+const struct bitmap_t *indexBitmap(const struct index_t *index,
+                                   const union cell_value_t *cell) {
+    if (!index->value_count)
+        return NULL;
+
+    struct index_key_t key = indexProbeKey(index, cell);
+    const struct index_value_t *value =
+        &index->values[indexValueSlot(index, &key, indexHashKey(index, &key))];
+    return value->rows.count ? &value->rows : NULL;
+}
+
+static void indexClear(struct index_t *index) {
+    free(index->order);
+    index->order = NULL;
+
+    for (size_t i = 0; i < index->posting_slots; i++)
+        free(index->postings[i].rows);
+    free(index->postings);
+    index->postings = NULL;
+    index->posting_slots = index->posting_count = 0;
+
+    for (size_t i = 0; i < index->value_slots; i++)
+        bitmapRelease(&index->values[i].rows);
+    free(index->values);
+    index->values = NULL;
+    index->value_slots = index->value_count = 0;
+
+    artRelease(&index->tree);
+    index->row_count = 0;
+}
+
+int indexSync(struct index_t *index) {
+    const struct table_t *table = index->table;
+
+    if (index->rewrite_count != table->rewrite_count ||
+        index->row_count > table->row_count) {
+        indexClear(index);
+        index->rewrite_count = table->rewrite_count;
+    }
+
+    if (index->row_count == table->row_count)
+        return 1;
+
+    int ok;
+    switch (index->type) {
+    case INDEX_SORTED:
+        ok = indexSyncSorted(index);
+        break;
+    case INDEX_TRIGRAM:
+        ok = indexSyncTrigram(index);
+        break;
+    case INDEX_BITMAP:
+        ok = indexSyncBitmap(index);
+        break;
+    default:
+        ok = indexSyncArt(index);
+        break;
+    }
+    if (!ok) {
+        indexClear(index); /* start over on the next use */
+        return 0;
+    }
+
+    index->row_count = table->row_count;
+    return 1;
+}
+
+/* Number of the changed rows before 'row', '*found' tells whether 'row'
+ * is one of them */
+static size_t indexRank(const struct index_change_t *change, uint32_t row,
+                        int *found) {
+    size_t lo = 0, hi = change->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (change->rows[mid] < row)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *found = lo < change->count && change->rows[lo] == row;
+    return lo;
+}
+
+/* Remove the changed rows from 'rows' and move the others down past the
+ * deleted ones, returns how many are left. The order is kept */
+static size_t indexDropRows(uint32_t *rows, size_t count,
+                            const struct index_change_t *change) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int found;
+        size_t below = indexRank(change, rows[i], &found);
+        if (!found)
+            rows[kept++] = change->deleted ? rows[i] - (uint32_t)below
+                                           : rows[i];
+    }
+    return kept;
+}
+
+static void indexDropLeafRows(struct art_leaf_t *leaf, void *data) {
+    leaf->count = (uint32_t)indexDropRows(leaf->rows, leaf->count, data);
+}
+
+/* Bitmaps are rebuilt from their positions, the values no row holds
+ * anymore leave the table */
+static int indexDropValues(struct index_t *index,
+                           const struct index_change_t *change) {
+    size_t emptied = 0;
+
+    for (size_t i = 0; i < index->value_slots; i++) {
+        struct index_value_t *value = &index->values[i];
+        if (!value->rows.count)
+            continue;
+
+        size_t count = bitmapCardinality(&value->rows);
+        uint32_t *rows = malloc(count * sizeof(uint32_t));
+        if (!rows)
+            return 0;
+        bitmapToArray(&value->rows, rows);
+
+        size_t kept = indexDropRows(rows, count, change);
+        if (kept == count &&
+            (!change->deleted || rows[count - 1] < change->rows[0])) {
+            free(rows);
+            continue;
+        }
+
+        struct bitmap_t bitmap = {0};
+        int ok = 1;
+        for (size_t r = 0; ok && r < kept; r++)
+            ok = bitmapAdd(&bitmap, rows[r]);
+        if (kept)
+            value->row = rows[0];
+        free(rows);
+
+        if (!ok) {
+            bitmapRelease(&bitmap);
+            return 0;
+        }
+        bitmapRelease(&value->rows);
+        value->rows = bitmap;
+        emptied += !kept;
+    }
+
+    index->value_count -= emptied;
+    return !emptied || indexRehashValues(index, index->value_slots);
+}
+
+/* Take the changed rows out of the index, then add the updated ones back
+ * under their new value. 0 when out of memory */
+static int indexApplyChange(struct index_t *index,
+                            struct index_change_t *change) {
+    switch (index->type) {
+    case INDEX_SORTED: {
+        size_t count = indexDropRows(index->order, index->row_count, change);
+        if (change->deleted)
+            return 1;
+
+        struct index_key_t *keys = malloc(change->count * sizeof(*keys));
+        if (!keys)
+            return 0;
+        for (size_t i = 0; i < change->count; i++)
+            keys[i] = indexKey(index, change->rows[i]);
+        int ok = indexMergeSorted(index, count, keys, change->count);
+        free(keys);
+        return ok;
+    }
+    case INDEX_TRIGRAM:
+        for (size_t i = 0; i < index->posting_slots; i++) {
+            struct posting_t *posting = &index->postings[i];
+            posting->count =
+                (uint32_t)indexDropRows(posting->rows, posting->count, change);
+        }
+        break;
+    case INDEX_BITMAP:
+        if (!indexDropValues(index, change))
+            return 0;
+        break;
+    default:
+        artUpdate(&index->tree, indexDropLeafRows, change);
+        break;
+    }
+
+    for (size_t i = 0; !change->deleted && i < change->count; i++) {
+        uint32_t row = change->rows[i];
+        int ok;
+
+        if (index->type == INDEX_TRIGRAM)
+            ok = indexAddTrigrams(index, indexKey(index, row).s, row);
+        else if (index->type == INDEX_BITMAP)
+            ok = indexAddValue(index, row);
+        else
+            ok = indexAddKey(index, row);
+        if (!ok)
+            return 0;
+    }
+    return 1;
+}
+
+void indexRowsDeleted(struct table_t *table, const uint32_t *rows,
+                      size_t count) {
+    struct index_change_t change = {rows, count, 1};
+
+    /* An index that is out of date is rebuilt on its next use anyway */
+    for (struct index_t *index = table->indexes; index; index = index->next) {
+        if (index->rewrite_count != table->rewrite_count)
+            continue;
+
+        int found;
+        size_t indexed = indexRank(&change, (uint32_t)index->row_count, &found);
+        if (!indexed)
+            continue;
+        if (!indexApplyChange(index, &change)) {
+            indexClear(index);
+            continue;
+        }
+        index->row_count -= indexed;
+    }
+}
+
+void indexRowsUpdated(struct table_t *table, int column, const uint32_t *rows,
+                      size_t count) {
+    for (struct index_t *index = table->indexes; index; index = index->next) {
+        if (index->column != column ||
+            index->rewrite_count != table->rewrite_count)
+            continue;
+
+        /* Rows past the indexed ones are added by the next sync */
+        struct index_change_t change = {rows, count, 0};
+        int found;
+        change.count = indexRank(&change, (uint32_t)index->row_count, &found);
+        if (change.count && !indexApplyChange(index, &change))
+            indexClear(index);
+    }
+}
+
+static void indexFree(struct index_t *index) {
+    indexClear(index);
+    free(index);
+}
+
+struct index_t *indexCreate(struct table_t *table, const char *name,
+                            int column, int type) {
+    if (indexFind(table, name)) {
+        LOG_ERROR("Index '%s' already exists on table '%s'", name,
+                  table->name);
+        return NULL;
+    }
+
+    if (type == INDEX_TRIGRAM &&
+        table->columns[column]->type != DB_TYPE_TEXT) {
+        LOG_ERROR("TRIGRAM index needs a TEXT column");
+        return NULL;
+    }
+
+    struct index_t *index = malloc(sizeof(struct index_t));
+    if (!index)
+        return NULL;
+
+    memset(index, 0, sizeof(struct index_t));
+    strncpy(index->name, name, sizeof(index->name) - 1);
+    index->type = type;
+    index->column = column;
+    index->table = table;
+    index->rewrite_count = table->rewrite_count;
+
+    if (!indexSync(index)) {
+        LOG_ERROR("Out of memory while building index '%s'", name);
+        indexFree(index);
+        return NULL;
+    }
+
+    index->next = table->indexes;
+    table->indexes = index;
+    dbCatalogChanged();
+    return index;
+}
+
+struct index_t *indexFind(const struct table_t *table, const char *name) {
+    for (struct index_t *index = table->indexes; index; index = index->next) {
+        if (strcmp(index->name, name) == 0)
+            return index;
+    }
+    return NULL;
+}
+
+struct index_t *indexFindColumn(const struct table_t *table, int column,
+                                int type) {
+    for (struct index_t *index = table->indexes; index; index = index->next) {
+        if (index->column == column && index->type == type)
+            return index;
+    }
+    return NULL;
+}
+
+void indexColumnDeleted(struct table_t *table, int column) {
+    struct index_t **link = &table->indexes;
+
+    while (*link) {
+        struct index_t *index = *link;
+        if (index->column == column) {
+            *link = index->next;
+            indexFree(index);
+            continue;
+        }
+        if (index->column > column)
+            index->column--;
+        link = &index->next;
+    }
+}
+
+void indexReleaseAll(struct table_t *table) {
+    while (table->indexes) {
+        struct index_t *next = table->indexes->next;
+        indexFree(table->indexes);
+        table->indexes = next;
+    }
+}
+
+/* First entry of the order whose value is >= the operand (> for 'upper') */
+static size_t indexBound(const struct index_t *index,
+                         const union cell_value_t *operand, int upper) {
+    struct index_key_t value = indexProbeKey(index, operand);
+    size_t lo = 0, hi = index->row_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        struct index_key_t key = indexKey(index, index->order[mid]);
+        int cmp = indexCompareValues(index, &key, &value);
+        if (cmp < 0 || (upper && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Same as indexBound() comparing only the first 'len' bytes */
+static size_t indexPrefixBound(const struct index_t *index,
+                               const char *prefix, size_t len, int upper) {
+    size_t lo = 0, hi = index->row_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strncmp(indexKey(index, index->order[mid]).s, prefix, len);
+        if (cmp < 0 || (upper && cmp == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Entries [first, last) of the order that satisfy the probe. A LIKE
+ * pattern is answered by the range of its literal prefix */
+static int indexSortedRange(const struct index_t *index,
+                            const struct index_probe_t *probe, size_t *first,
+                            size_t *last) {
+    const union cell_value_t *operand = &probe->operand;
+    size_t n = index->row_count;
+
+    switch (probe->op) {
+    case RSQL_ET_OP:
+        *first = indexBound(index, operand, 0);
+        *last = indexBound(index, operand, 1);
+        return 1;
+    case RSQL_LT_OP:
+        *first = 0;
+        *last = indexBound(index, operand, 0);
+        return 1;
+    case RSQL_LE_OP:
+        *first = 0;
+        *last = indexBound(index, operand, 1);
+        return 1;
+    case RSQL_GT_OP:
+        *first = indexBound(index, operand, 1);
+        *last = n;
+        return 1;
+    case RSQL_GE_OP:
+        *first = indexBound(index, operand, 0);
+        *last = n;
+        return 1;
+    case RSQL_LIKE_OP: {
+        size_t len = strcspn(operand->s, "%_");
+        if (!len || index->table->columns[index->column]->type != DB_TYPE_TEXT)
+            return 0;
+        *first = indexPrefixBound(index, operand->s, len, 0);
+        *last = indexPrefixBound(index, operand->s, len, 1);
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Postings of the trigrams of the literal runs of a LIKE pattern, NULL
+ * entries for trigrams that no row contains. Returns how many there are,
+ * 0 when no run is long enough to have one */
+static size_t indexPatternPostings(const struct index_t *index,
+                                   const char *pattern,
+                                   struct posting_t **out) {
+    size_t n = 0;
+
+    while (*pattern && n < INDEX_MAX_TRIGRAMS) {
+        size_t run = strcspn(pattern, "%_");
+        for (size_t i = 0; i + 3 <= run && n < INDEX_MAX_TRIGRAMS; i++)
+            out[n++] = indexFindPosting(index, indexTrigram(pattern + i));
+
+        pattern += run;
+        pattern += strspn(pattern, "%_");
+    }
+    return n;
+}
+
+/* Rows of the radix tree leaves visited by a scan, only counted up to
+ * 'limit' when 'rows' is not wanted */
+struct index_collect_t {
+    struct index_rows_t *out;
+    size_t capacity;
+    size_t count;
+    size_t limit;
+    int failed;
+};
+
+static int indexCollect(const struct art_leaf_t *leaf, void *data) {
+    struct index_collect_t *collect = data;
+
+    /* Keys whose rows were all deleted or updated stay in the tree */
+    if (!leaf->count)
+        return 1;
+
+    collect->count += leaf->count;
+    if (!collect->out)
+        return collect->count <= collect->limit;
+
+    struct index_rows_t *out = collect->out;
+    if (collect->count > collect->capacity) {
+        size_t capacity = collect->capacity ? collect->capacity * 2 : 64;
+        while (capacity < collect->count)
+            capacity *= 2;
+        uint32_t *rows = realloc(out->rows, capacity * sizeof(uint32_t));
+        if (!rows) {
+            collect->failed = 1;
+            return 0;
+        }
+        out->rows = rows;
+        collect->capacity = capacity;
+    }
+
+    memcpy(out->rows + out->count, leaf->rows, leaf->count * sizeof(uint32_t));
+    out->count += leaf->count;
+    return 1;
+}
+
+/* Visit the radix tree leaves satisfying the probe: a point lookup, a
+ * range scan or a prefix scan for the literal prefix of a LIKE pattern.
+ * Returns 0 when the probe cannot be answered */
+static int indexScanArt(const struct index_t *index,
+                        const struct index_probe_t *probe,
+                        struct index_collect_t *collect) {
+    unsigned char key[sizeof(union cell_value_t)];
+    struct art_bound_t bound = {key, 0, 1};
+
+    if (probe->op == RSQL_LIKE_OP) {
+        size_t len = strcspn(probe->operand.s, "%_");
+        if (!len || index->table->columns[index->column]->type != DB_TYPE_TEXT)
+            return 0;
+        artPrefix(&index->tree, (const unsigned char *)probe->operand.s, len,
+                  indexCollect, collect);
+        return 1;
+    }
+
+    struct index_key_t value = indexProbeKey(index, &probe->operand);
+    bound.len = indexArtKey(index, &value, key);
+    bound.inclusive = probe->op == RSQL_LE_OP || probe->op == RSQL_GE_OP;
+
+    switch (probe->op) {
+    case RSQL_ET_OP: {
+        const struct art_leaf_t *leaf =
+            artSearch(&index->tree, key, bound.len);
+        if (leaf)
+            indexCollect(leaf, collect);
+        return 1;
+    }
+    case RSQL_LT_OP:
+    case RSQL_LE_OP:
+        artScan(&index->tree, NULL, &bound, indexCollect, collect);
+        return 1;
+    case RSQL_GT_OP:
+    case RSQL_GE_OP:
+        artScan(&index->tree, &bound, NULL, indexCollect, collect);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+size_t indexEstimate(struct index_t *index, const struct index_probe_t *probe) {
+    if (!indexSync(index))
+        return SIZE_MAX;
+
+    if (index->type == INDEX_SORTED) {
+        size_t first, last;
+        return indexSortedRange(index, probe, &first, &last) ? last - first
+                                                              : SIZE_MAX;
+    }
+
+    if (index->type == INDEX_BITMAP) {
+        if (probe->op != RSQL_ET_OP)
+            return SIZE_MAX;
+        const struct bitmap_t *rows = indexBitmap(index, &probe->operand);
+        return rows ? bitmapCardinality(rows) : 0;
+    }
+
+    /* Counting stops past half of the table, a full scan is as good as
+     * an index scan from there */
+    if (index->type == INDEX_ART) {
+        struct index_collect_t collect = {0};
+        collect.limit = index->row_count / 2;
+        if (!indexScanArt(index, probe, &collect))
+            return SIZE_MAX;
+        return collect.count > collect.limit ? index->row_count
+                                             : collect.count;
+    }
+
+    struct posting_t *postings[INDEX_MAX_TRIGRAMS];
+    size_t n = probe->op == RSQL_LIKE_OP
+                   ? indexPatternPostings(index, probe->operand.s, postings)
+                   : 0;
+    if (!n)
+        return SIZE_MAX;
+
+    size_t best = SIZE_MAX;
+    for (size_t i = 0; i < n; i++) {
+        size_t count = postings[i] ? postings[i]->count : 0;
+        if (count < best)
+            best = count;
+    }
+    return best;
+}
+
+/* Keep the rows of 'rows' that are also in 'posting', both ascending */
+static size_t indexIntersect(uint32_t *rows, size_t count,
+                             const struct posting_t *posting) {
+    size_t kept = 0, lo = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t hi = posting->count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (posting->rows[mid] < rows[i])
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < posting->count && posting->rows[lo] == rows[i])
+            rows[kept++] = rows[i];
+    }
+    return kept;
+}
+
+static int indexLookupTrigram(struct index_t *index,
+                              const struct index_probe_t *probe,
+                              struct index_rows_t *out) {
+    struct posting_t *postings[INDEX_MAX_TRIGRAMS];
+    size_t n = indexPatternPostings(index, probe->operand.s, postings);
+    size_t smallest = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (!postings[i])
+            return 1; /* no row has this trigram */
+        if (postings[i]->count < postings[smallest]->count)
+            smallest = i;
+    }
+
+    out->rows = malloc(postings[smallest]->count * sizeof(uint32_t) + 1);
+    if (!out->rows)
+        return 0;
+
+    out->count = postings[smallest]->count;
+    memcpy(out->rows, postings[smallest]->rows,
+           out->count * sizeof(uint32_t));
+
+    for (size_t i = 0; i < n && out->count; i++) {
+        if (i != smallest)
+            out->count = indexIntersect(out->rows, out->count, postings[i]);
+    }
+    return 1;
+}
+
+int indexLookup(struct index_t *index, const struct index_probe_t *probe,
+                struct index_rows_t *out) {
+    out->rows = NULL;
+    out->count = 0;
+
+    if (indexEstimate(index, probe) == SIZE_MAX)
+        return 0;
+
+    if (index->type == INDEX_TRIGRAM)
+        return indexLookupTrigram(index, probe, out);
+
+    if (index->type == INDEX_ART) {
+        struct index_collect_t collect = {0};
+        collect.out = out;
+        indexScanArt(index, probe, &collect);
+        if (collect.failed) {
+            free(out->rows);
+            out->rows = NULL;
+            out->count = 0;
+            return 0;
+        }
+        if (out->count && probe->op != RSQL_ET_OP)
+            qsort(out->rows, out->count, sizeof(uint32_t), indexCompareRows);
+        return 1;
+    }
+
+    if (index->type == INDEX_BITMAP) {
+        const struct bitmap_t *rows = indexBitmap(index, &probe->operand);
+        if (!rows)
+            return 1;
+        out->count = bitmapCardinality(rows);
+        out->rows = malloc(out->count * sizeof(uint32_t));
+        if (!out->rows)
+            return 0;
+        bitmapToArray(rows, out->rows);
+        return 1;
+    }
+
+    size_t first, last;
+    indexSortedRange(index, probe, &first, &last);
+
+    out->rows = malloc((last - first) * sizeof(uint32_t) + 1);
+    if (!out->rows)
+        return 0;
+
+    out->count = last - first;
+    memcpy(out->rows, index->order + first, out->count * sizeof(uint32_t));
+    qsort(out->rows, out->count, sizeof(uint32_t), indexCompareRows);
+    return 1;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Secondary indexes created with 'CREATE INDEX name ON table (column)'.
+ *  An index only narrows a scan down to candidate rows, the executor
+ *  still checks the whole WHERE condition on each of them.
+ *
+ *  Rows appended to the table are added the next time the index is
+ *  used. A DELETE removes its rows from every index and shifts the
+ *  positions after them, an UPDATE moves its rows to their new value in
+ *  the indexes of the columns it assigns.
+ */
+#ifndef _INDEX_H
+#define _INDEX_H
+
+#include "art.h"
+#include "bitmap.h"
+#include "db.h"
+
+#include <stdint.h>
+
+/* Index types, picked with 'USING <type>' */
+#define INDEX_SORTED 0x01  /* row positions ordered by value (default) */
+#define INDEX_TRIGRAM 0x02 /* rows containing each 3-byte sequence */
+#define INDEX_BITMAP 0x03  /* rows holding each distinct value */
+#define INDEX_ART 0x04     /* adaptive radix tree over the value bytes */
+
+/* Positions of the rows holding one trigram, in ascending order */
+struct posting_t {
+    uint32_t trigram; /* 0 for a free slot */
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *rows;
+};
+
+/* A distinct value of a bitmap index and the rows holding it */
+struct index_value_t {
+    uint32_t row;         /* first row holding the value */
+    uint32_t hash;
+    struct bitmap_t rows; /* empty for a free slot */
+};
+
+struct index_t {
+    char name[64];
+    int type;
+    int column;
+    struct table_t *table;
+
+    size_t row_count;    /* rows [0, row_count) are indexed */
+    size_t rewrite_count; /* table->rewrite_count when built */
+
+    /* INDEX_SORTED, row_count entries */
+    uint32_t *order;
+
+    /* INDEX_TRIGRAM, open addressing table */
+    struct posting_t *postings;
+    size_t posting_slots;
+    size_t posting_count;
+
+    /* INDEX_BITMAP, open addressing table meant for few distinct values */
+    struct index_value_t *values;
+    size_t value_slots;
+    size_t value_count;
+
+    /* INDEX_ART, keys are big endian INTs with the sign bit flipped or
+     * NUL terminated TEXTs, so that byte order is value order */
+    struct art_t tree;
+
+    struct index_t *next; /* next index of the table */
+};
+
+/* What an access path asks an index: rows whose value satisfies
+ * 'value <op> operand', or for RSQL_LIKE_OP rows that may match the
+ * pattern in 'operand' */
+struct index_probe_t {
+    int op;
+    union cell_value_t operand;
+};
+
+/* Row positions in ascending order, 'rows' is owned by the caller */
+struct index_rows_t {
+    uint32_t *rows;
+    size_t count;
+};
+
+/* Index type named 'name' (case insensitive), 0 if unknown */
+int indexTypeFromName(const char *name);
+const char *indexTypeName(int type);
+
+/* Create and build an index, NULL on error (already logged) */
+struct index_t *indexCreate(struct table_t *table, const char *name,
+                            int column, int type);
+struct index_t *indexFind(const struct table_t *table, const char *name);
+struct index_t *indexFindColumn(const struct table_t *table, int column,
+                                int type);
+
+/* Fix the indexes after column 'column' was removed from the table */
+void indexColumnDeleted(struct table_t *table, int column);
+void indexReleaseAll(struct table_t *table);
+
+/* Bring the index up to date with the table rows */
+int indexSync(struct index_t *index);
+
+/* Fix the indexes of the table after the rows at the positions 'rows'
+ * (ascending) were deleted or had column 'column' updated. An index
+ * that runs out of memory is rebuilt on its next use */
+void indexRowsDeleted(struct table_t *table, const uint32_t *rows,
+                      size_t count);
+void indexRowsUpdated(struct table_t *table, int column, const uint32_t *rows,
+                      size_t count);
+
+/* Number of candidate rows a lookup would return (an upper bound for
+ * trigrams), SIZE_MAX when the index cannot answer the probe */
+size_t indexEstimate(struct index_t *index, const struct index_probe_t *probe);
+
+/* Candidate rows for the probe, 0 when out of memory */
+int indexLookup(struct index_t *index, const struct index_probe_t *probe,
+                struct index_rows_t *out);
+
+/* Rows of a synced INDEX_BITMAP holding 'cell', NULL when there are none */
+const struct bitmap_t *indexBitmap(const struct index_t *index,
+                                   const union cell_value_t *cell);
+
+#endif /* _INDEX_H */
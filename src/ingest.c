@@ -0,0 +1,367 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ingest.h"
+#include "buffer.h"
+#include "eval.h"
+#include "index.h"
+#include "logs.h"
+#include "metrics.h"
+#include "part.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Producers only swap the head, so pushes never wait on each other */
+static void ingestPush(struct ingest_t *queue, struct ingest_link_t *link) {
+    atomic_store_explicit(&link->next, NULL, memory_order_relaxed);
+    struct ingest_link_t *prev = atomic_exchange(&queue->head, link);
+    atomic_store_explicit(&prev->next, link, memory_order_release);
+}
+
+/* Oldest queued batch, NULL when there is none or when the next one is
+ * still being pushed. Only called by the applier */
+static struct ingest_batch_t *ingestPop(struct ingest_t *queue) {
+    struct ingest_link_t *tail = queue->tail;
+    struct ingest_link_t *next =
+        atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &queue->stub) {
+        if (!next)
+            return NULL;
+        queue->tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (!next) {
+        /* The last batch only leaves once the stub is queued behind it */
+        if (tail != atomic_load(&queue->head))
+            return NULL;
+        ingestPush(queue, &queue->stub);
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        if (!next)
+            return NULL;
+    }
+
+    queue->tail = next;
+    return (struct ingest_batch_t *)tail;
+}
+
+static int ingestPending(struct ingest_t *queue) {
+    return queue->tail != &queue->stub ||
+           atomic_load(&queue->head) != &queue->stub;
+}
+
+/* The table of the queue, NULL when it was dropped or its columns no
+ * longer match the batches. The caller holds the storage latch */
+static struct table_t *ingestTable(struct ingest_t *queue) {
+    struct database_t *db = dbFind(evGetContext(), queue->database);
+    struct table_t *table = db ? dbTableFind(db, queue->table) : NULL;
+
+    if (!table) {
+        LOG_ERROR("Table '%s' no longer exists", queue->table);
+        return NULL;
+    }
+    if (queue->catalog == dbCatalogVersion())
+        return table;
+
+    int same = table->column_count == queue->column_count;
+    for (size_t i = 0; same && i < table->column_count; i++)
+        same = table->columns[i] == queue->columns[i] &&
+               table->columns[i]->slot == queue->slots[i] &&
+               table->columns[i]->type == queue->types[i];
+
+    if (!same) {
+        LOG_ERROR("Columns of table '%s' changed while rows were queued",
+                  queue->table);
+        return NULL;
+    }
+    queue->catalog = dbCatalogVersion();
+    return table;
+}
+
+static int ingestAppend(struct table_t *table,
+                        const struct ingest_batch_t *batch,
+                        size_t column_count) {
+    const struct part_t *part = table->partitioning;
+    size_t first = table->row_count, firsts[PART_MAX];
+
+    /* Rows go at the end of their partition, each is cut back there */
+    for (size_t p = 0; part && p < part->count; p++)
+        firsts[p] = part->tables[p]->row_count;
+
+    /* Every row needs a partition before any is written */
+    for (size_t r = 0; part && r < batch->row_count; r++) {
+        int value = batch->cells[r * column_count + part->column].i;
+        if (!partRoute(table, value)) {
+            LOG_ERROR("No partition of table '%s' holds value %d",
+                      table->name, value);
+            return 0;
+        }
+    }
+
+    for (size_t r = 0; r < batch->row_count; r++) {
+        const union cell_value_t *cells = &batch->cells[r * column_count];
+        struct table_t *target =
+            part ? partRoute(table, cells[part->column].i) : table;
+
+        struct row_t *row = dbRowNew(target);
+        int ok = row != NULL;
+        for (size_t i = 0; ok && i < column_count; i++)
+            ok = dbCellPut(row, target->columns[i], &cells[i]);
+
+        if (!ok) {
+            LOG_ERROR("Unable to insert into table '%s'", table->name);
+            if (table->capped) {
+                if (row)
+                    dbRowDiscard(table, row);
+            } else if (part) {
+                for (size_t p = 0; p < part->count; p++)
+                    dbRowTruncate(part->tables[p], firsts[p]);
+            } else {
+                dbRowTruncate(table, first);
+            }
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Appends a group of batches under a single hold of the latch */
+static void ingestApply(struct ingest_t *queue,
+                        struct ingest_batch_t **group, size_t count) {
+    size_t rows = 0, inserted = 0;
+
+    for (size_t i = 0; i < count; i++)
+        rows += group[i]->row_count;
+
+    evLock();
+    struct table_t *table = ingestTable(queue);
+
+    if (table && !table->partitioning && !table->capped)
+        dbRowReserve(table, table->row_count + rows);
+
+    for (size_t i = 0; i < count; i++) {
+        int ok = table && ingestAppend(table, group[i], queue->column_count);
+        inserted += ok ? group[i]->row_count : 0;
+        atomic_store(&group[i]->state, ok ? INGEST_DONE : INGEST_FAILED);
+    }
+
+    for (struct index_t *index = table ? table->indexes : NULL; index;
+         index = index->next)
+        indexSync(index);
+
+    bufferStatementEnd();
+    evUnlock();
+
+    metricsAdd(METRIC_ROWS_INSERTED, inserted);
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_broadcast(&queue->done);
+    pthread_mutex_unlock(&queue->lock);
+
+    for (size_t i = 0; i < count; i++)
+        ingestRelease(group[i]);
+}
+
+static void *ingestApplier(void *data) {
+    struct ingest_t *queue = data;
+    struct ingest_batch_t *group[INGEST_GROUP];
+
+    for (;;) {
+        size_t count = 0;
+        while (count < INGEST_GROUP && (group[count] = ingestPop(queue)))
+            count++;
+
+        if (count) {
+            ingestApply(queue, group, count);
+            continue;
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        atomic_store(&queue->idle, 1);
+        if (!queue->stop && !ingestPending(queue)) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += INGEST_IDLE_INTERVAL * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&queue->wake, &queue->lock, &until);
+        }
+        atomic_store(&queue->idle, 0);
+        int stop = queue->stop && !ingestPending(queue);
+        pthread_mutex_unlock(&queue->lock);
+
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+struct ingest_t *ingestOpen(const char *database, const char *table) {
+    evLock();
+
+    struct database_t *db =
+        database ? dbFind(evGetContext(), database) : evGetDatabase();
+    if (db && db->snapshot) {
+        LOG_ERROR("Snapshot '%s' is read only", db->name);
+        db = NULL;
+    }
+    struct table_t *target = db ? dbTableFind(db, table) : NULL;
+    struct ingest_t *queue = target ? malloc(sizeof(struct ingest_t)) : NULL;
+
+    if (!queue) {
+        if (db && !target)
+            LOG_ERROR("Table '%s' doesn't exist", table);
+        evUnlock();
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(struct ingest_t));
+    memcpy(queue->database, db->name, sizeof(queue->database));
+    memcpy(queue->table, target->name, sizeof(queue->table));
+    queue->column_count = target->column_count;
+    for (size_t i = 0; i < target->column_count; i++) {
+        queue->columns[i] = target->columns[i];
+        queue->slots[i] = target->columns[i]->slot;
+        queue->types[i] = target->columns[i]->type;
+        queue->defaults[i] = target->columns[i]->default_value;
+    }
+    queue->catalog = dbCatalogVersion();
+    evUnlock();
+
+    atomic_init(&queue->head, &queue->stub);
+    queue->tail = &queue->stub;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wake, NULL);
+    pthread_cond_init(&queue->done, NULL);
+
+    if (pthread_create(&queue->thread, NULL, ingestApplier, queue) != 0) {
+        LOG_ERROR("Unable to start the ingest thread of '%s'", table);
+        pthread_mutex_destroy(&queue->lock);
+        pthread_cond_destroy(&queue->wake);
+        pthread_cond_destroy(&queue->done);
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void ingestClose(struct ingest_t *queue) {
+    if (!queue)
+        return;
+
+    pthread_mutex_lock(&queue->lock);
+    queue->stop = 1;
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->wake);
+    pthread_cond_destroy(&queue->done);
+    free(queue);
+}
+
+struct ingest_batch_t *ingestBatchNew(struct ingest_t *queue,
+                                      size_t row_count) {
+    size_t cells = row_count * queue->column_count;
+    struct ingest_batch_t *batch = malloc(
+        sizeof(struct ingest_batch_t) + cells * sizeof(union cell_value_t));
+    if (!batch)
+        return NULL;
+
+    batch->queue = queue;
+    atomic_init(&batch->state, INGEST_PENDING);
+    atomic_init(&batch->refs, 1);
+    batch->row_count = row_count;
+
+    for (size_t r = 0; r < row_count; r++)
+        memcpy(&batch->cells[r * queue->column_count], queue->defaults,
+               queue->column_count * sizeof(union cell_value_t));
+    return batch;
+}
+
+/* The cell of 'column' in 'row' when the column has type 'type' */
+static union cell_value_t *ingestCell(struct ingest_batch_t *batch,
+                                      size_t row, size_t column, int type) {
+    const struct ingest_t *queue = batch->queue;
+
+    if (row >= batch->row_count || column >= queue->column_count ||
+        queue->types[column] != type)
+        return NULL;
+    return &batch->cells[row * queue->column_count + column];
+}
+
+int ingestSetInt(struct ingest_batch_t *batch, size_t row, size_t column,
+                 int value) {
+    union cell_value_t *cell = ingestCell(batch, row, column, DB_TYPE_INT);
+    if (!cell)
+        return 0;
+
+    cell->i = value;
+    return 1;
+}
+
+int ingestSetText(struct ingest_batch_t *batch, size_t row, size_t column,
+                  const char *text) {
+    union cell_value_t *cell = ingestCell(batch, row, column, DB_TYPE_TEXT);
+    if (!cell || !text)
+        return 0;
+
+    size_t len = strlen(text);
+    if (len > sizeof(cell->s) - 1)
+        return 0;
+    memcpy(cell->s, text, len + 1);
+    return 1;
+}
+
+void ingestSubmit(struct ingest_batch_t *batch) {
+    struct ingest_t *queue = batch->queue;
+
+    atomic_fetch_add(&batch->refs, 1);
+    ingestPush(queue, &batch->link);
+
+    /* Pairs with the applier raising 'idle' before it checks the queue
+     * a last time, so either it sees the batch or it gets the signal */
+    if (atomic_load(&queue->idle)) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_signal(&queue->wake);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+int ingestWait(struct ingest_batch_t *batch) {
+    int state = atomic_load(&batch->state);
+
+    if (state == INGEST_PENDING) {
+        struct ingest_t *queue = batch->queue;
+
+        pthread_mutex_lock(&queue->lock);
+        while ((state = atomic_load(&batch->state)) == INGEST_PENDING)
+            pthread_cond_wait(&queue->done, &queue->lock);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    ingestRelease(batch);
+    return state == INGEST_DONE;
+}
+
+void ingestRelease(struct ingest_batch_t *batch) {
+    if (batch && atomic_fetch_sub(&batch->refs, 1) == 1)
+        free(batch);
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Ingest queues, concurrent INSERT into one table. Producer threads fill
+ *  batches of rows on their own and push them on the queue of the table
+ *  without taking any lock (an intrusive multi-producer single-consumer
+ *  list). A single applier thread per queue takes the storage latch (see
+ *  evLock()) once for all the batches it finds queued, appends their rows
+ *  and brings the indexes of the table up to date:
+ *
+ *      struct ingest_t *queue = ingestOpen(NULL, "events");
+ *      struct ingest_batch_t *batch = ingestBatchNew(queue, 100);
+ *      ingestSetInt(batch, 0, 0, 42);
+ *      ingestSetText(batch, 0, 1, "click");
+ *      ...
+ *      ingestSubmit(batch);
+ *      int ok = ingestWait(batch);
+ *      ingestClose(queue);
+ *
+ *  A batch holds a value for every column of the table, in column order,
+ *  starting with the column defaults. Its rows are all appended or none
+ *  is, unless memory runs out on a CAPPED table: the oldest rows it
+ *  already replaced are gone then. Once submitted, the batch is the
+ *  completion handle of the producer: it must be given back with
+ *  ingestWait() or ingestRelease().
+ */
+#ifndef _INGEST_H
+#define _INGEST_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "db.h"
+
+/* States of a batch */
+#define INGEST_PENDING 0
+#define INGEST_DONE 1
+#define INGEST_FAILED 2
+
+/* Most batches applied under one hold of the storage latch */
+#define INGEST_GROUP 64
+
+/* The applier checks for batches at least this often (ms) */
+#define INGEST_IDLE_INTERVAL 50
+
+struct ingest_link_t {
+    _Atomic(struct ingest_link_t *) next;
+};
+
+struct ingest_batch_t {
+    struct ingest_link_t link; /* first, batches are queued by their link */
+    struct ingest_t *queue;
+    atomic_int state; /* INGEST_* */
+    atomic_int refs;  /* the producer and, once submitted, the queue */
+    size_t row_count;
+    union cell_value_t cells[]; /* row_count rows of column_count cells */
+};
+
+struct ingest_t {
+    char database[64];
+    char table[64];
+
+    /* Columns the batches are built for, checked again by the applier
+     * whenever the catalog changed since: a column dropped and added
+     * back with the same type has another address or slot. The
+     * addresses are only compared, they may have been freed */
+    size_t column_count;
+    const struct column_t *columns[MAX_COLUMNS_NUM];
+    size_t slots[MAX_COLUMNS_NUM];
+    int types[MAX_COLUMNS_NUM];
+    union cell_value_t defaults[MAX_COLUMNS_NUM];
+    size_t catalog; /* dbCatalogVersion() they were read at */
+
+    /* Producers swap head, the applier pops from tail. The stub keeps
+     * the list from ever being empty */
+    _Atomic(struct ingest_link_t *) head;
+    struct ingest_link_t *tail;
+    struct ingest_link_t stub;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake; /* the applier has batches to apply */
+    pthread_cond_t done; /* some batches were applied */
+    atomic_int idle;     /* the applier waits on 'wake' */
+    int stop;            /* guarded by lock */
+};
+
+/* Queue of 'table' in 'database', the current database when NULL */
+struct ingest_t *ingestOpen(const char *database, const char *table);
+
+/* Applies the batches still queued and stops the applier. The batches
+ * can still be waited for, nothing may be submitted anymore */
+void ingestClose(struct ingest_t *queue);
+
+/* Batch of 'row_count' rows holding the column defaults */
+struct ingest_batch_t *ingestBatchNew(struct ingest_t *queue,
+                                      size_t row_count);
+
+/* Set a value, 0 when the column does not exist or has another type or
+ * when the text does not fit a cell */
+int ingestSetInt(struct ingest_batch_t *batch, size_t row, size_t column,
+                 int value);
+int ingestSetText(struct ingest_batch_t *batch, size_t row, size_t column,
+                  const char *text);
+
+/* Lock free, never blocks */
+void ingestSubmit(struct ingest_batch_t *batch);
+
+/* Blocks until the batch was applied and releases it. Returns 1 when its
+ * rows were inserted, 0 otherwise */
+int ingestWait(struct ingest_batch_t *batch);
+
+/* Gives the batch up without waiting for it */
+void ingestRelease(struct ingest_batch_t *batch);
+
+#endif /* _INGEST_H */
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "insert.h"
+#include "lex.h"
+#include "logs.h"
+#include "metrics.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Copies an identifier token into 'name', names longer than the catalog
+ * allows cannot match anything */
+static int insertTokenName(struct lexer_t *lexer, char name[64]) {
+    size_t len = lexGetTokenLength(lexer);
+
+    if (!lexIsToken(lexer, RSQL_IDENTIFIER) || len > 63)
+        return 0;
+
+    memcpy(name, lexGetTokenStart(lexer), len);
+    name[len] = '\0';
+    lexNextToken(lexer);
+    return 1;
+}
+
+/* Number of parenthesized rows after VALUES, the input is only scanned
+ * for top level '(' outside of strings */
+static size_t insertCountRows(const char *p) {
+    size_t rows = 0;
+    int depth = 0;
+
+    for (; *p; p++) {
+        if (*p == '\'') {
+            p = strchr(p + 1, '\'');
+            if (!p)
+                break;
+        } else if (*p == '(') {
+            rows += depth++ == 0;
+        } else if (*p == ')') {
+            depth--;
+        } else if (*p == ';') {
+            break;
+        }
+    }
+    return rows;
+}
+
+/* Same rules as dbCellSet(), integers made of at most 9 digits are
+ * accumulated directly from the input */
+static int insertSetInt(union cell_value_t *cell, const char *text,
+                        size_t len) {
+    if (len && len <= 9) {
+        int value = 0;
+        size_t i = 0;
+
+        while (i < len && text[i] >= '0' && text[i] <= '9')
+            value = value * 10 + (text[i++] - '0');
+
+        if (i == len) {
+            cell->i = value;
+            return 1;
+        }
+    }
+
+    char buffer[32];
+    if (len >= sizeof(buffer))
+        return 0;
+
+    memcpy(buffer, text, len);
+    buffer[len] = '\0';
+
+    char *end;
+    errno = 0;
+    long value = strtol(buffer, &end, 10);
+    if (end == buffer || *end != '\0' || errno == ERANGE ||
+        value < INT_MIN || value > INT_MAX)
+        return 0;
+
+    cell->i = (int)value;
+    return 1;
+}
+
+static int insertSetCell(struct lexer_t *lexer, const struct column_t *col,
+                         union cell_value_t *cell) {
+    int type = lexGetTokenType(lexer);
+    const char *text = lexGetTokenStart(lexer);
+    size_t len = lexGetTokenLength(lexer);
+
+    if (type != RSQL_NUMERIC_LITERAL && type != RSQL_STRING_LITERAL)
+        return 0;
+
+    if (col->type == DB_TYPE_INT) {
+        if (!insertSetInt(cell, text, len))
+            return 0;
+    } else {
+        /* Longer texts are left to the planner, which rejects them */
+        size_t stored = type == RSQL_STRING_LITERAL
+                            ? lexUnescapedLength(text, len)
+                            : len;
+        if (stored > sizeof(cell->s) - 1)
+            return 0;
+
+        if (type == RSQL_STRING_LITERAL)
+            len = lexUnescape(text, len, cell->s);
+        else
+            memcpy(cell->s, text, len);
+        cell->s[len] = '\0';
+    }
+
+    lexNextToken(lexer);
+    return 1;
+}
+
+/* Parses '(v1, v2, ...)' into a new row */
+static int insertRow(struct lexer_t *lexer, struct table_t *table,
+                     const int *targets, size_t target_count) {
+    if (!lexIsToken(lexer, RSQL_LPAREN))
+        return 0;
+    lexNextToken(lexer);
+
+    struct row_t *row = dbRowNew(table);
+    if (!row)
+        return 0;
+
+    for (size_t i = 0; i < target_count; i++) {
+        if (i) {
+            if (!lexIsToken(lexer, RSQL_COMMA))
+                return 0;
+            lexNextToken(lexer);
+        }
+
+        const struct column_t *col = table->columns[targets[i]];
+        union cell_value_t cell;
+        if (!insertSetCell(lexer, col, &cell) || !dbCellPut(row, col, &cell))
+            return 0;
+    }
+
+    if (!lexIsToken(lexer, RSQL_RPAREN))
+        return 0;
+    lexNextToken(lexer);
+    return 1;
+}
+
+int insertExecute(struct database_t *db, const char *sql) {
+    struct lexer_t lexer;
+    char name[64];
+    int targets[MAX_COLUMNS_NUM];
+    size_t target_count = 0;
+
+    lexInitialize(&lexer, sql);
+    lexNextToken(&lexer);
+    if (!db || db->snapshot || !lexIsToken(&lexer, INSERT_KW))
+        return INSERT_FALLBACK;
+
+    lexNextToken(&lexer);
+    if (!lexIsToken(&lexer, INTO_KW))
+        return INSERT_FALLBACK;
+    lexNextToken(&lexer);
+
+    struct table_t *table = NULL;
+    if (insertTokenName(&lexer, name))
+        table = dbTableFind(db, name);
+    /* Partitioned and CAPPED tables cannot undo the rows of a batch that
+     * turns out not to be a plain literal one */
+    if (!table || table->partitioning || table->capped ||
+        !lexIsToken(&lexer, RSQL_LPAREN))
+        return INSERT_FALLBACK;
+
+    /* Target columns, resolved once for the whole batch */
+    do {
+        lexNextToken(&lexer);
+        if (target_count >= MAX_COLUMNS_NUM || !insertTokenName(&lexer, name))
+            return INSERT_FALLBACK;
+
+        targets[target_count] = dbColumnFind(table, name);
+        if (targets[target_count++] < 0)
+            return INSERT_FALLBACK;
+    } while (lexIsToken(&lexer, RSQL_COMMA));
+
+    if (!lexIsToken(&lexer, RSQL_RPAREN))
+        return INSERT_FALLBACK;
+    lexNextToken(&lexer);
+
+    if (!lexIsToken(&lexer, VALUES_KW))
+        return INSERT_FALLBACK;
+
+    size_t first = table->row_count;
+    size_t rows = insertCountRows(lexer.input + lexer.pos);
+    if (!dbRowReserve(table, first + rows)) {
+        LOG_ERROR("Unable to insert into table '%s'", table->name);
+        return INSERT_FAILED;
+    }
+
+    do {
+        lexNextToken(&lexer);
+        if (!insertRow(&lexer, table, targets, target_count)) {
+            dbRowTruncate(table, first);
+            return INSERT_FALLBACK;
+        }
+    } while (lexIsToken(&lexer, RSQL_COMMA));
+
+    if (lexIsToken(&lexer, RSQL_SEMICOLON))
+        lexNextToken(&lexer);
+    if (!lexIsToken(&lexer, RSQL_EOF)) {
+        dbRowTruncate(table, first);
+        return INSERT_FALLBACK;
+    }
+
+    metricsAdd(METRIC_ROWS_INSERTED, table->row_count - first);
+    LOG_INFO("%zu row(s) inserted into %s", table->row_count - first,
+             table->name);
+    return INSERT_DONE;
+}
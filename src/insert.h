@@ -0,0 +1,39 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Direct INSERT path. 'INSERT INTO t (cols) VALUES (...), (...)' with
+ *  literal values only is executed straight from the token stream: the
+ *  table and the target columns are resolved once, the row array is
+ *  reserved for the whole batch and every literal is converted into its
+ *  cell as soon as it is lexed, no AST or plan is built. Anything else is
+ *  left to the parser.
+ */
+#ifndef _INSERT_H
+#define _INSERT_H
+
+#include "db.h"
+
+#define INSERT_FALLBACK -1 /* not handled here, use the regular path */
+#define INSERT_FAILED 0
+#define INSERT_DONE 1
+
+/* Runs 'sql' against 'db' when it is a literal INSERT. A statement the
+ * fast path cannot take (syntax it does not know, a placeholder, a value
+ * that does not convert...) leaves the table untouched and returns
+ * INSERT_FALLBACK, the parser then reports the error if there is one */
+int insertExecute(struct database_t *db, const char *sql);
+
+#endif /* _INSERT_H */
@@ -14,155 +14,292 @@
  * limitations under the License.
  */
 #include "lex.h"
+#include "arena.h"
+#include "prof.h"
 
-#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static const keyword_entry_t keywords[] = {
-    {"CREATE", CREATE_KW},
-    {"DROP", DROP_KW},
-    {"DELETE", DELETE_KW},
-    {"TRUNCATE", TRUNCATE_KW},
-    {"UPDATE", UPDATE_KW},
-    {"ALTER", ALTER_KW},
-    {"SELECT", SELECT_KW},
-    {"INSERT", INSERT_KW},
-    {"DATABASE", DATABASE_KW},
-    {"TABLE", TABLE_KW},
-    {"FROM", FROM_KW},
-    {"WHERE", WHERE_KW},
-    {"AND", AND_KW},
-    {"OR", OR_KW},
-    {"NOT", NOT_KW},
-    {"BETWEEN", BETWEEN_KW},
-    {"LIKE", LIKE_KW},
-    {"IN", IN_KW},
-    {"IS", IS_KW},
-    {"NULL", NULL_KW},
-    {"INTO", INTO_KW},
-    {"VALUES", VALUES_KW},
-    {NULL, 0} /* Sentinel */
+/* Character classes, every byte of the input is classified with a single
+ * table lookup */
+#define LEX_SPACE 0x01    /* whitespace */
+#define LEX_DIGIT 0x02    /* 0-9 */
+#define LEX_ALPHA 0x04    /* identifier start: letters and '_' */
+#define LEX_IDENT 0x08    /* identifier continuation: letters, digits, '_' */
+#define LEX_OPERATOR 0x10 /* start of a comparison operator */
+
+static const unsigned char char_class[256] = {
+    [' '] = LEX_SPACE,
+    ['\t'] = LEX_SPACE,
+    ['\n'] = LEX_SPACE,
+    ['\v'] = LEX_SPACE,
+    ['\f'] = LEX_SPACE,
+    ['\r'] = LEX_SPACE,
+    ['0' ... '9'] = LEX_DIGIT | LEX_IDENT,
+    ['a' ... 'z'] = LEX_ALPHA | LEX_IDENT,
+    ['A' ... 'Z'] = LEX_ALPHA | LEX_IDENT,
+    ['_'] = LEX_ALPHA | LEX_IDENT,
+    ['='] = LEX_OPERATOR,
+    ['!'] = LEX_OPERATOR,
+    ['<'] = LEX_OPERATOR,
+    ['>'] = LEX_OPERATOR,
 };
 
-static const single_char_token_t single_char_tokens[] = {
-    {',', RSQL_COMMA, ","},  {';', RSQL_SEMICOLON, ";"},
-    {'(', RSQL_LPAREN, "("}, {')', RSQL_RPAREN, ")"},
-    {'+', RSQL_ADD_OP, "+"}, {'-', RSQL_SUB_OP, "-"},
-    {'*', RSQL_MUL_OP, "*"}, {'/', RSQL_DIV_OP, "/"},
-    {'\0', 0, NULL} /* Sentinel */
+static const unsigned short single_char_tokens[256] = {
+    [','] = RSQL_COMMA,  [';'] = RSQL_SEMICOLON, ['('] = RSQL_LPAREN,
+    [')'] = RSQL_RPAREN, ['+'] = RSQL_ADD_OP,    ['-'] = RSQL_SUB_OP,
+    ['*'] = RSQL_MUL_OP, ['/'] = RSQL_DIV_OP,    ['?'] = RSQL_PLACEHOLDER,
 };
 
-static const multi_char_op_t multi_char_ops[] = {
-    {">=", RSQL_GE_OP}, {"<=", RSQL_LE_OP}, {"!=", RSQL_NE_OP},
-    {"=", RSQL_ET_OP},  {">", RSQL_GT_OP},  {"<", RSQL_LT_OP},
-    {NULL, 0} /* Sentinel */
+/* Keyword perfect hash
+ * ====================
+ * The slot of a word is computed from its length and its first, second
+ * and last character, so a lookup costs one hash and at most one
+ * comparison. LEX_KEYWORD_SEED is the first odd multiple of 0x9e3779b1
+ * that sends every keyword to a different slot: a new keyword needs a
+ * free slot under the current seed, or a new seed and the table laid out
+ * again. */
+#define LEX_KEYWORD_SEED 0xa4f3ccb5u /* 69 * 0x9e3779b1 */
+#define LEX_KEYWORD_BITS 7           /* log2(LEX_KEYWORD_SLOTS) */
+#define LEX_UPPER(c) ((unsigned char)(c) & 0xdf)
+
+static const keyword_entry_t keyword_slots[LEX_KEYWORD_SLOTS] = {
+    [2] = {"COLUMN", COLUMN_KW},
+    [6] = {"TRUNCATE", TRUNCATE_KW},
+    [13] = {"IN", IN_KW},
+    [14] = {"USE", USE_KW},
+    [15] = {"USING", USING_KW},
+    [17] = {"ADD", ADD_KW},
+    [28] = {"INDEX", INDEX_KW},
+    [37] = {"ANALYZE", ANALYZE_KW},
+    [39] = {"ROW_FORMAT", ROW_FORMAT_KW},
+    [40] = {"INTO", INTO_KW},
+    [43] = {"WHERE", WHERE_KW},
+    [46] = {"ALTER", ALTER_KW},
+    [47] = {"UPDATE", UPDATE_KW},
+    [49] = {"EXECUTE", EXECUTE_KW},
+    [57] = {"SHOW", SHOW_KW},
+    [61] = {"SET", SET_KW},
+    [63] = {"LIKE", LIKE_KW},
+    [70] = {"DATABASE", DATABASE_KW},
+    [71] = {"BETWEEN", BETWEEN_KW},
+    [75] = {"EXPLAIN", EXPLAIN_KW},
+    [76] = {"FROM", FROM_KW},
+    [77] = {"SELECT", SELECT_KW},
+    [82] = {"DEFAULT", DEFAULT_KW},
+    [84] = {"AND", AND_KW},
+    [87] = {"CREATE", CREATE_KW},
+    [90] = {"DROP", DROP_KW},
+    [93] = {"INSERT", INSERT_KW},
+    [94] = {"TABLE", TABLE_KW},
+    [97] = {"PREPARE", PREPARE_KW},
+    [98] = {"DEALLOCATE", DEALLOCATE_KW},
+    [100] = {"NOT", NOT_KW},
+    [103] = {"NULL", NULL_KW},
+    [110] = {"IS", IS_KW},
+    [118] = {"VALUES", VALUES_KW},
+    [120] = {"DELETE", DELETE_KW},
+    [124] = {"ON", ON_KW},
+    [125] = {"OR", OR_KW},
 };
 
-void lexSkipWhiteSpace(struct lexer_t *lexer) {
-    while (isspace(lexer->input[lexer->pos])) {
-        lexer->pos++;
-    }
+static inline uint32_t lexKeywordHash(const char *text, size_t len) {
+    uint32_t key = LEX_UPPER(text[0]) | LEX_UPPER(text[len > 1]) << 8 |
+                   LEX_UPPER(text[len - 1]) << 16 | (uint32_t)len << 24;
+    return (key * LEX_KEYWORD_SEED) >> (32 - LEX_KEYWORD_BITS);
 }
 
-int lexLookupKeyword(const char *text) {
-    for (int i = 0; keywords[i].text != NULL; i++) {
-        if (strcasecmp(text, keywords[i].text) == 0) {
-            return keywords[i].type;
-        }
+/* Keywords are upper case letters only, clearing bit 5 of the input turns
+ * a lower case letter into its upper case and never makes a digit or '_'
+ * look like a letter */
+static int lexKeywordEquals(const char *text, size_t len, const char *kw) {
+    for (size_t i = 0; i < len; i++) {
+        if (LEX_UPPER(text[i]) != (unsigned char)kw[i])
+            return 0;
     }
+    return kw[len] == '\0';
+}
+
+int lexLookupKeyword(const char *text, size_t len) {
+    const keyword_entry_t *entry = &keyword_slots[lexKeywordHash(text, len)];
+
+    if (entry->text && lexKeywordEquals(text, len, entry->text))
+        return entry->type;
     return RSQL_IDENTIFIER;
 }
 
-int lexMatchOperator(struct lexer_t *lexer) {
-    /* Try multi-character operators first (longest match) */
-    for (int i = 0; multi_char_ops[i].text != NULL; i++) {
-        const char *op = multi_char_ops[i].text;
-        size_t len = strlen(op);
-
-        if (strncmp(lexer->input + lexer->pos, op, len) == 0) {
-            strncpy(lexer->current_token.text, op, len);
-            lexer->current_token.text[len] = '\0';
-            lexer->current_token.type = multi_char_ops[i].type;
-            lexer->pos += len;
-            return 1;
+/* SIMD scanning
+ * =============
+ * Runs of whitespace, identifier characters and digits are consumed 16
+ * bytes at a time with SSE2, the scalar loop on the class table handles
+ * the tail and the other targets. The input is only known to be NUL
+ * terminated, so a 16 byte load is done only when it does not cross a
+ * page boundary and therefore cannot fault. Such a read is still outside
+ * the object for AddressSanitizer, which gets the scalar loop. */
+#if defined(__SSE2__) && !defined(__SANITIZE_ADDRESS__)
+#include <emmintrin.h>
+
+#define LEX_SIMD 1
+#define LEX_CAN_LOAD16(p) (((uintptr_t)(p) & 4095) <= 4096 - 16)
+
+/* 0xff in the bytes 'lo' <= c < 'lo' + 'width' */
+static inline __m128i lexInRange(__m128i v, char lo, char width) {
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(width - 1)), d);
+}
+
+static inline unsigned lexClassMask(__m128i v, unsigned char cls) {
+    __m128i m;
+
+    switch (cls) {
+    case LEX_SPACE:
+        m = _mm_or_si128(lexInRange(v, '\t', 5),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        break;
+    case LEX_DIGIT:
+        m = lexInRange(v, '0', 10);
+        break;
+    default: /* LEX_IDENT */
+        m = lexInRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+        m = _mm_or_si128(m, lexInRange(v, '0', 10));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        break;
+    }
+    return (unsigned)_mm_movemask_epi8(m);
+}
+#endif
+
+/* Returns the position of the first character after 'pos' that is not in
+ * the class 'cls' */
+static inline size_t lexSpan(const char *input, size_t pos, unsigned char cls) {
+    for (;;) {
+#ifdef LEX_SIMD
+        if (LEX_CAN_LOAD16(input + pos)) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(input + pos));
+            unsigned miss = ~lexClassMask(v, cls) & 0xffff;
+            if (miss)
+                return pos + (size_t)__builtin_ctz(miss);
+            pos += 16;
+            continue;
         }
+#endif
+        if (!(char_class[(unsigned char)input[pos]] & cls))
+            return pos;
+        pos++;
     }
-    return 0;
 }
 
-int lexMatchSingleChar(struct lexer_t *lexer) {
-    char c = lexer->input[lexer->pos];
-
-    for (int i = 0; single_char_tokens[i].text != NULL; i++) {
-        if (c == single_char_tokens[i].ch) {
-            lexer->current_token.type = single_char_tokens[i].type;
-            strcpy(lexer->current_token.text, single_char_tokens[i].text);
-            lexer->pos++;
-            return 1;
+/* Returns the position of the next quote or of the terminating NUL */
+static inline size_t lexFindQuote(const char *input, size_t pos) {
+    for (;;) {
+#ifdef LEX_SIMD
+        if (LEX_CAN_LOAD16(input + pos)) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(input + pos));
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\'')),
+                                     _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+            unsigned hit = (unsigned)_mm_movemask_epi8(m);
+            if (hit)
+                return pos + (size_t)__builtin_ctz(hit);
+            pos += 16;
+            continue;
         }
+#endif
+        if (input[pos] == '\'' || input[pos] == '\0')
+            return pos;
+        pos++;
     }
-    return 0;
 }
 
-void lexParseIdentifier(struct lexer_t *lexer) {
-    size_t start = lexer->pos;
+void lexSkipWhiteSpace(struct lexer_t *lexer) {
+    lexer->pos = lexSpan(lexer->input, lexer->pos, LEX_SPACE);
+}
+
+static void lexSetToken(struct lexer_t *lexer, int type, size_t start,
+                        size_t length) {
+    lexer->current_token.type = type;
+    lexer->current_token.start = start;
+    lexer->current_token.length = length;
+}
 
-    while (isalnum(lexer->input[lexer->pos]) ||
-           lexer->input[lexer->pos] == '_') {
-        lexer->pos++;
+int lexMatchOperator(struct lexer_t *lexer) {
+    const char *p = lexer->input + lexer->pos;
+    int type;
+    size_t len = p[1] == '=' ? 2 : 1;
+
+    switch (p[0]) {
+    case '=':
+        type = RSQL_ET_OP;
+        len = 1;
+        break;
+    case '<':
+        type = len == 2 ? RSQL_LE_OP : RSQL_LT_OP;
+        break;
+    case '>':
+        type = len == 2 ? RSQL_GE_OP : RSQL_GT_OP;
+        break;
+    case '!':
+        if (len != 2)
+            return 0;
+        type = RSQL_NE_OP;
+        break;
+    default:
+        return 0;
     }
 
-    size_t len = lexer->pos - start;
-    if (len >= sizeof(lexer->current_token.text))
-        len = sizeof(lexer->current_token.text) - 1;
+    lexSetToken(lexer, type, lexer->pos, len);
+    lexer->pos += len;
+    return 1;
+}
 
-    strncpy(lexer->current_token.text, lexer->input + start, len);
-    lexer->current_token.text[len] = '\0';
+int lexMatchSingleChar(struct lexer_t *lexer) {
+    int type = single_char_tokens[(unsigned char)lexer->input[lexer->pos]];
 
-    /* Check if it's a keyword */
-    lexer->current_token.type = lexLookupKeyword(lexer->current_token.text);
+    if (!type)
+        return 0;
+
+    lexSetToken(lexer, type, lexer->pos, 1);
+    lexer->pos++;
+    return 1;
 }
 
-void lexParseNumber(struct lexer_t *lexer) {
+void lexParseIdentifier(struct lexer_t *lexer) {
     size_t start = lexer->pos;
-    int dot_seen = 0;
-
-    while (isdigit(lexer->input[lexer->pos]) ||
-           (!dot_seen && lexer->input[lexer->pos] == '.')) {
-        if (lexer->input[lexer->pos] == '.')
-            dot_seen = 1;
-        lexer->pos++;
-    }
 
+    lexer->pos = lexSpan(lexer->input, lexer->pos, LEX_IDENT);
     size_t len = lexer->pos - start;
-    if (len >= sizeof(lexer->current_token.text))
-        len = sizeof(lexer->current_token.text) - 1;
 
-    strncpy(lexer->current_token.text, lexer->input + start, len);
-    lexer->current_token.text[len] = '\0';
+    /* Check if it's a keyword */
+    lexSetToken(lexer, lexLookupKeyword(lexer->input + start, len), start,
+                len);
+}
+
+void lexParseNumber(struct lexer_t *lexer) {
+    size_t start = lexer->pos;
 
-    lexer->current_token.type = RSQL_NUMERIC_LITERAL;
+    lexer->pos = lexSpan(lexer->input, lexer->pos, LEX_DIGIT);
+    if (lexer->input[lexer->pos] == '.')
+        lexer->pos = lexSpan(lexer->input, lexer->pos + 1, LEX_DIGIT);
+
+    lexSetToken(lexer, RSQL_NUMERIC_LITERAL, start, lexer->pos - start);
 }
 
+/* A quote inside a string is written twice ('it''s'), the token keeps the
+ * escaped form and lexUnescape() is applied only on materialization */
 void lexParseString(struct lexer_t *lexer) {
     lexer->pos++; /* Skip initial quote */
     size_t start = lexer->pos;
 
-    while (lexer->input[lexer->pos] != '\0' &&
-           lexer->input[lexer->pos] != '\'') {
-        lexer->pos++;
+    for (;;) {
+        lexer->pos = lexFindQuote(lexer->input, lexer->pos);
+        if (lexer->input[lexer->pos] != '\'' ||
+            lexer->input[lexer->pos + 1] != '\'')
+            break;
+        lexer->pos += 2; /* Escaped quote */
     }
 
-    size_t len = lexer->pos - start;
-    if (len >= sizeof(lexer->current_token.text))
-        len = sizeof(lexer->current_token.text) - 1;
-
-    strncpy(lexer->current_token.text, lexer->input + start, len);
-    lexer->current_token.text[len] = '\0';
-
-    lexer->current_token.type = RSQL_STRING_LITERAL;
+    lexSetToken(lexer, RSQL_STRING_LITERAL, start, lexer->pos - start);
 
     if (lexer->input[lexer->pos] == '\'') {
         lexer->pos++; /* Skip closing quote */
@@ -171,24 +308,20 @@ void lexParseString(struct lexer_t *lexer) {
     }
 }
 
-void lexNextToken(struct lexer_t *lexer) {
+static void lexScanToken(struct lexer_t *lexer) {
     lexSkipWhiteSpace(lexer);
-    char c = lexer->input[lexer->pos];
+    unsigned char c = (unsigned char)lexer->input[lexer->pos];
+    unsigned char cls = char_class[c];
 
-    /* End of file */
-    if (c == '\0') {
-        lexer->current_token.type = RSQL_EOF;
-        strcpy(lexer->current_token.text, "EOF");
-        return;
-    }
-
-    /* Try to match multi-character operators */
-    if (lexMatchOperator(lexer)) {
+    /* Identifier or keyword */
+    if (cls & LEX_ALPHA) {
+        lexParseIdentifier(lexer);
         return;
     }
 
-    /* Try to match single character tokens */
-    if (lexMatchSingleChar(lexer)) {
+    /* Numeric literal */
+    if (cls & LEX_DIGIT) {
+        lexParseNumber(lexer);
         return;
     }
 
@@ -198,31 +331,83 @@ void lexNextToken(struct lexer_t *lexer) {
         return;
     }
 
-    /* Numeric literal */
-    if (isdigit(c)) {
-        lexParseNumber(lexer);
+    /* Comparison operators */
+    if ((cls & LEX_OPERATOR) && lexMatchOperator(lexer)) {
         return;
     }
 
-    /* Identifier or keyword */
-    if (isalpha(c) || c == '_') {
-        lexParseIdentifier(lexer);
+    /* Single character tokens */
+    if (lexMatchSingleChar(lexer)) {
+        return;
+    }
+
+    /* End of file */
+    if (c == '\0') {
+        lexSetToken(lexer, RSQL_EOF, lexer->pos, 0);
         return;
     }
 
     /* Unknown token */
-    lexer->current_token.type = RSQL_UNKNOWN;
-    lexer->current_token.text[0] = c;
-    lexer->current_token.text[1] = '\0';
+    lexSetToken(lexer, RSQL_UNKNOWN, lexer->pos, 1);
     lexer->pos++;
 }
 
+/* Tokens are only timed one by one for the statements being profiled */
+void lexNextToken(struct lexer_t *lexer) {
+    if (!prof_statement.tokens) {
+        lexScanToken(lexer);
+        return;
+    }
+
+    uint64_t start = profNow();
+    lexScanToken(lexer);
+    profAdd(PROF_LEX, start);
+}
+
 /* Utility function to initialize lexer */
 void lexInitialize(struct lexer_t *lexer, const char *input) {
     lexer->input = input;
     lexer->pos = 0;
-    lexer->current_token.type = RSQL_UNKNOWN;
-    lexer->current_token.text[0] = '\0';
+    lexSetToken(lexer, RSQL_UNKNOWN, 0, 0);
+}
+
+size_t lexUnescapedLength(const char *src, size_t len) {
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i++, out++) {
+        if (src[i] == '\'' && i + 1 < len && src[i + 1] == '\'')
+            i++;
+    }
+    return out;
+}
+
+size_t lexUnescape(const char *src, size_t len, char *dst) {
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        dst[out++] = src[i];
+        if (src[i] == '\'' && i + 1 < len && src[i + 1] == '\'')
+            i++;
+    }
+    return out;
+}
+
+char *lexTokenDup(struct lexer_t *lexer, struct arena_t *arena) {
+    const struct token_t *token = &lexer->current_token;
+    const char *src = lexer->input + token->start;
+
+    char *text = arenaAlloc(arena, token->length + 1);
+    if (!text)
+        return NULL;
+
+    size_t len = token->length;
+    if (token->type == RSQL_STRING_LITERAL)
+        len = lexUnescape(src, len, text);
+    else
+        memcpy(text, src, len);
+
+    text[len] = '\0';
+    return text;
 }
 
 /* Utility function to get token type name for debugging */
@@ -254,6 +439,42 @@ const char *lexGetTokenTypeName(int type) {
         return "VALUES";
     case SELECT_KW:
         return "SELECT";
+    case TABLE_KW:
+        return "TABLE";
+    case DATABASE_KW:
+        return "DATABASE";
+    case FROM_KW:
+        return "FROM";
+    case ANALYZE_KW:
+        return "ANALYZE";
+    case USE_KW:
+        return "USE";
+    case PREPARE_KW:
+        return "PREPARE";
+    case EXECUTE_KW:
+        return "EXECUTE";
+    case USING_KW:
+        return "USING";
+    case DEALLOCATE_KW:
+        return "DEALLOCATE";
+    case INDEX_KW:
+        return "INDEX";
+    case ON_KW:
+        return "ON";
+    case SET_KW:
+        return "SET";
+    case ADD_KW:
+        return "ADD";
+    case COLUMN_KW:
+        return "COLUMN";
+    case DEFAULT_KW:
+        return "DEFAULT";
+    case ROW_FORMAT_KW:
+        return "ROW_FORMAT";
+    case EXPLAIN_KW:
+        return "EXPLAIN";
+    case SHOW_KW:
+        return "SHOW";
     case RSQL_ET_OP:
         return "EQUAL";
     case RSQL_NE_OP:
@@ -278,6 +499,8 @@ const char *lexGetTokenTypeName(int type) {
         return "STRING_LITERAL";
     case RSQL_NUMERIC_LITERAL:
         return "NUMERIC_LITERAL";
+    case RSQL_PLACEHOLDER:
+        return "PLACEHOLDER";
     default:
         return "UNKNOWN_TYPE";
     }
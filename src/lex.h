@@ -63,6 +63,7 @@
 #define RSQL_TICK 0x1008 /* '  | Tick' */
 #define RSQL_STRING_LITERAL 0x1009
 #define RSQL_NUMERIC_LITERAL 0x100a
+#define RSQL_PLACEHOLDER 0x100b /* ?  | Statement parameter */
 
 /* Keywords */
 #define CREATE_KW 0x2001
@@ -87,15 +88,34 @@
 #define NULL_KW 0x2014
 #define INTO_KW 0x2015
 #define VALUES_KW 0x2016
-
-/* Maximum token text length */
-#define RSQL_MAX_TOKEN_LENGTH 64
-
+#define ANALYZE_KW 0x2017
+#define USE_KW 0x2018
+#define PREPARE_KW 0x2019
+#define EXECUTE_KW 0x201a
+#define USING_KW 0x201b
+#define DEALLOCATE_KW 0x201c
+#define INDEX_KW 0x201d
+#define ON_KW 0x201e
+#define SET_KW 0x201f
+#define ADD_KW 0x2020
+#define COLUMN_KW 0x2021
+#define DEFAULT_KW 0x2022
+#define ROW_FORMAT_KW 0x2023
+#define EXPLAIN_KW 0x2024
+#define SHOW_KW 0x2025
+
+/* A token is a view on the input, its text is never copied by the lexer.
+ * For string literals the view excludes the quotes and still contains
+ * the '' escapes, they are resolved when the value is materialized by
+ * lexTokenDup() */
 struct token_t {
-    int type; /* Token type (one of the constants above) */
-    char text[RSQL_MAX_TOKEN_LENGTH]; /* Token text content */
+    int type;      /* Token type (one of the constants above) */
+    size_t start;  /* Offset of the token text in the input */
+    size_t length; /* Length of the token text */
 };
 
+struct arena_t;
+
 struct lexer_t {
     const char *input;            /* Input string to tokenize */
     size_t pos;                   /* Current position in input */
@@ -107,16 +127,8 @@ typedef struct {
     int type;
 } keyword_entry_t;
 
-typedef struct {
-    char ch;
-    int type;
-    const char *text;
-} single_char_token_t;
-
-typedef struct {
-    const char *text;
-    int type;
-} multi_char_op_t;
+/* Size of the keyword hash table, must be a power of two */
+#define LEX_KEYWORD_SLOTS 128
 
 /* Function declarations */
 
@@ -130,9 +142,9 @@ void lexNextToken(struct lexer_t *lexer);
 void lexSkipWhiteSpace(struct lexer_t *lexer);
 
 /* Lookup a keyword in the keyword table */
-int lexLookupKeyword(const char *text);
+int lexLookupKeyword(const char *text, size_t len);
 
-/* Try to match multi-character operators */
+/* Try to match comparison operators (=, !=, <, <=, >, >=) */
 int lexMatchOperator(struct lexer_t *lexer);
 
 /* Try to match single character tokens */
@@ -141,6 +153,16 @@ int lexMatchSingleChar(struct lexer_t *lexer);
 /* Parse an identifier or keyword */
 void lexParseIdentifier(struct lexer_t *lexer);
 
+/* Copy 'len' bytes of a quoted string to 'dst' turning every '' into ',
+ * returns the number of bytes written */
+size_t lexUnescape(const char *src, size_t len, char *dst);
+
+/* Bytes lexUnescape() writes for the same string */
+size_t lexUnescapedLength(const char *src, size_t len);
+
+/* Materialize the current token text in 'arena' (NUL terminated) */
+char *lexTokenDup(struct lexer_t *lexer, struct arena_t *arena);
+
 /* Get human-readable token type name for debugging */
 const char *lexGetTokenTypeName(int type);
 
@@ -167,9 +189,14 @@ static inline int lexIsPunctuation(struct lexer_t *lexer) {
            lexer->current_token.type < 0x2000;
 }
 
-/* Get current token text */
-static inline const char *lexGetTokenText(struct lexer_t *lexer) {
-    return lexer->current_token.text;
+/* Get the first character of the current token (not NUL terminated) */
+static inline const char *lexGetTokenStart(struct lexer_t *lexer) {
+    return lexer->input + lexer->current_token.start;
+}
+
+/* Get the length of the current token text */
+static inline size_t lexGetTokenLength(struct lexer_t *lexer) {
+    return lexer->current_token.length;
 }
 
 /* Get current token type */
@@ -0,0 +1,415 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "logs.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Padding record filling the end of the ring when a record would wrap */
+#define LOG_PAD 0
+
+/* The flusher wakes up at least this often (ms) */
+#define LOG_FLUSH_INTERVAL 50
+
+/* Header of a queued record, followed by its arguments and the text of
+ * its string arguments. Sizes are multiples of 8 */
+struct log_record_t {
+    uint32_t size;
+    uint16_t level; /* LOG_LEVEL_* or LOG_PAD */
+    uint16_t argc;
+    time_t time;
+    const char *format;
+};
+
+/* Single producer (the owning thread), single consumer (whoever holds
+ * log_lock). head and tail only grow, the position is their value
+ * modulo LOG_RING_SIZE */
+struct log_ring_t {
+    _Atomic size_t head;
+    _Atomic size_t tail;
+    struct log_ring_t *next;
+    _Alignas(8) unsigned char data[LOG_RING_SIZE];
+};
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_wake = PTHREAD_COND_INITIALIZER;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+static struct log_ring_t *log_rings; /* guarded by log_lock */
+static atomic_int log_async;
+static int log_stop;
+
+static _Thread_local struct log_ring_t *log_ring;
+
+/* Timestamp cache of the consumer, rebuilt once per second */
+static time_t log_stamp_time = (time_t)-1;
+static char log_stamp[32];
+
+static size_t logAlign(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static const char *logStamp(time_t t) {
+    if (t != log_stamp_time) {
+        struct tm tm_info;
+        localtime_r(&t, &tm_info);
+        strftime(log_stamp, sizeof(log_stamp), "[%Y-%m-%d %H:%M:%S] ",
+                 &tm_info);
+        log_stamp_time = t;
+    }
+    return log_stamp;
+}
+
+/* Next unused argument, NULL once the message has used them all */
+static const struct log_arg_t *logNextArg(const struct log_arg_t *args,
+                                          size_t argc, size_t *used) {
+    return *used < argc ? &args[(*used)++] : NULL;
+}
+
+static long long logSigned(const struct log_arg_t *arg) {
+    return arg->type == LOG_ARG_DOUBLE ? (long long)arg->d : arg->i;
+}
+
+/* Formats one conversion 'spec' (from '%' to the conversion character
+ * included) with 'arg' */
+static int logConvert(char *out, size_t cap, const char *spec, size_t len,
+                      const struct log_arg_t *arg) {
+    char conv = spec[len - 1];
+    char length = len > 2 ? spec[len - 2] : 0;
+    int wide = length == 'l' || length == 'z' || length == 'j' ||
+               length == 't';
+
+    switch (conv) {
+    case 'd':
+    case 'i':
+        return wide ? snprintf(out, cap, spec, logSigned(arg))
+                    : snprintf(out, cap, spec, (int)logSigned(arg));
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+        return wide ? snprintf(out, cap, spec,
+                               (unsigned long long)logSigned(arg))
+                    : snprintf(out, cap, spec, (unsigned)logSigned(arg));
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        return snprintf(out, cap, spec,
+                        arg->type == LOG_ARG_DOUBLE ? arg->d
+                        : arg->type == LOG_ARG_UINT ? (double)arg->u
+                                                    : (double)arg->i);
+    case 's':
+        return snprintf(out, cap, spec,
+                        arg->type == LOG_ARG_TEXT && arg->s ? arg->s
+                                                            : "(null)");
+    case 'p':
+        return snprintf(out, cap, spec, arg->p);
+    }
+    return snprintf(out, cap, "%.*s", (int)len, spec);
+}
+
+/* printf() over captured arguments. Length modifiers are normalized to
+ * 'll' since every integer is stored as a long long */
+static size_t logFormat(char *out, size_t cap, const char *format,
+                        const struct log_arg_t *args, size_t argc) {
+    size_t n = 0, used = 0;
+
+    while (*format && n + 1 < cap) {
+        if (*format != '%') {
+            out[n++] = *format++;
+            continue;
+        }
+        if (format[1] == '%') {
+            out[n++] = '%';
+            format += 2;
+            continue;
+        }
+
+        /* Room is kept for 'll', the conversion and the NUL */
+        char spec[48];
+        size_t len = 0, room = sizeof(spec) - 4;
+        const char *p = format + 1;
+
+        spec[len++] = '%';
+        while (*p && strchr("-+ #0", *p) && len < room)
+            spec[len++] = *p++;
+        for (int part = 0; part < 2; part++) {
+            if (part && *p != '.')
+                break;
+            if (part) {
+                if (len < room)
+                    spec[len++] = *p;
+                p++;
+            }
+            if (*p == '*') {
+                const struct log_arg_t *arg = logNextArg(args, argc, &used);
+                int w = snprintf(spec + len, room - len + 1, "%d",
+                                 arg ? (int)logSigned(arg) : 0);
+                len += (size_t)w < room - len ? (size_t)w : room - len;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                if (len < room)
+                    spec[len++] = *p;
+                p++;
+            }
+        }
+
+        int wide = 0;
+        while (*p && strchr("hlLqjzt", *p)) {
+            wide |= *p != 'h';
+            p++;
+        }
+        if (!*p)
+            break;
+
+        if (wide && strchr("diouxX", *p)) {
+            spec[len++] = 'l';
+            spec[len++] = 'l';
+        }
+        spec[len++] = *p++;
+        spec[len] = '\0';
+        format = p;
+
+        const struct log_arg_t *arg = logNextArg(args, argc, &used);
+        if (!arg)
+            continue;
+
+        int w = logConvert(out + n, cap - n, spec, len, arg);
+        if (w > 0)
+            n += (size_t)w < cap - n ? (size_t)w : cap - n - 1;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static void logEmit(const struct log_record_t *rec) {
+    static const struct {
+        const char *tag;
+        int stamp;
+    } levels[] = {
+        [LOG_LEVEL_ERROR] = {COLOR_RED "[ERROR] " COLOR_RESET, 1},
+        [LOG_LEVEL_WARN] = {COLOR_YELLOW "[WARN] " COLOR_RESET, 1},
+        [LOG_LEVEL_INFO] = {COLOR_GREEN "[INFO] " COLOR_RESET, 0},
+        [LOG_LEVEL_DEBUG] = {COLOR_BLUE "[DEBUG] " COLOR_RESET, 1},
+    };
+    char line[1024];
+    size_t n = 0;
+
+    if (levels[rec->level].stamp) {
+        const char *stamp = logStamp(rec->time);
+        n = strlen(stamp);
+        memcpy(line, stamp, n);
+    }
+
+    size_t tag = strlen(levels[rec->level].tag);
+    memcpy(line + n, levels[rec->level].tag, tag);
+    n += tag;
+
+    n += logFormat(line + n, sizeof(line) - n - 1, rec->format,
+                   (const struct log_arg_t *)(rec + 1), rec->argc);
+    line[n++] = '\n';
+
+    fwrite(line, 1, n, rec->level == LOG_LEVEL_ERROR ? stderr : stdout);
+}
+
+/* Writes out every queued record, the caller holds log_lock */
+static void logDrain(void) {
+    for (struct log_ring_t *ring = log_rings; ring; ring = ring->next) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        while (tail != head) {
+            const struct log_record_t *rec =
+                (const void *)(ring->data + (tail & (LOG_RING_SIZE - 1)));
+            if (rec->level != LOG_PAD)
+                logEmit(rec);
+            tail += rec->size;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+void logFlush(void) {
+    pthread_mutex_lock(&log_lock);
+    logDrain();
+    pthread_mutex_unlock(&log_lock);
+}
+
+static void *logFlusher(void *data) {
+    (void)data;
+
+    pthread_mutex_lock(&log_lock);
+    while (!log_stop) {
+        logDrain();
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&log_wake, &log_lock, &deadline);
+    }
+    pthread_mutex_unlock(&log_lock);
+    return NULL;
+}
+
+/* Stops the flusher and writes out what is left, stdio is flushed by
+ * exit() after this */
+static void logShutdown(void) {
+    pthread_mutex_lock(&log_lock);
+    log_stop = 1;
+    pthread_cond_signal(&log_wake);
+    pthread_mutex_unlock(&log_lock);
+
+    if (atomic_exchange(&log_async, 0))
+        pthread_join(log_thread, NULL);
+    logFlush();
+}
+
+static void logStart(void) {
+    atexit(logShutdown);
+    if (pthread_create(&log_thread, NULL, logFlusher, NULL) == 0)
+        atomic_store(&log_async, 1);
+}
+
+/* The ring of the calling thread, created on its first message. Rings
+ * are never released: a thread logs again or exits with the process */
+static struct log_ring_t *logRing(void) {
+    if (log_ring)
+        return log_ring;
+
+    pthread_once(&log_once, logStart);
+
+    struct log_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return NULL;
+
+    pthread_mutex_lock(&log_lock);
+    ring->next = log_rings;
+    log_rings = ring;
+    pthread_mutex_unlock(&log_lock);
+
+    log_ring = ring;
+    return ring;
+}
+
+/* Reserves 'size' contiguous bytes, wrapping with a padding record when
+ * the end of the ring is too short. A full ring is drained inline */
+static unsigned char *logReserve(struct log_ring_t *ring, size_t size) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    for (;;) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t offset = head & (LOG_RING_SIZE - 1);
+        size_t pad = LOG_RING_SIZE - offset < size ? LOG_RING_SIZE - offset
+                                                   : 0;
+
+        if (LOG_RING_SIZE - (head - tail) >= pad + size) {
+            if (pad) {
+                struct log_record_t *rec = (void *)(ring->data + offset);
+                rec->size = (uint32_t)pad;
+                rec->level = LOG_PAD;
+                head += pad;
+                atomic_store_explicit(&ring->head, head,
+                                      memory_order_release);
+            }
+            return ring->data + (head & (LOG_RING_SIZE - 1));
+        }
+        logFlush();
+    }
+}
+
+void logWrite(int level, const char *format, size_t argc,
+              const struct log_arg_t *args) {
+    struct log_ring_t *ring = logRing();
+    size_t lens[LOG_MAX_ARGS];
+
+    if (argc > LOG_MAX_ARGS)
+        argc = LOG_MAX_ARGS;
+
+    size_t size = sizeof(struct log_record_t) + argc * sizeof(*args);
+    for (size_t i = 0; i < argc; i++) {
+        lens[i] = 0;
+        if (args[i].type == LOG_ARG_TEXT && args[i].s) {
+            lens[i] = strnlen(args[i].s, LOG_TEXT_MAX);
+            size += lens[i] + 1;
+        }
+    }
+    size = logAlign(size);
+
+    if (!ring) {
+        /* No memory for a ring, format on the spot */
+        _Alignas(8) unsigned char
+            buffer[sizeof(struct log_record_t) +
+                   LOG_MAX_ARGS * (sizeof(*args) + LOG_TEXT_MAX + 1)];
+        struct log_record_t *rec = (void *)buffer;
+        rec->level = (uint16_t)level;
+        rec->argc = (uint16_t)argc;
+        rec->time = time(NULL);
+        rec->format = format;
+        memcpy(rec + 1, args, argc * sizeof(*args));
+        pthread_mutex_lock(&log_lock);
+        logEmit(rec);
+        pthread_mutex_unlock(&log_lock);
+        return;
+    }
+
+    struct log_record_t *rec = (void *)logReserve(ring, size);
+    struct log_arg_t *copy = (struct log_arg_t *)(rec + 1);
+    char *text = (char *)(copy + argc);
+
+    rec->size = (uint32_t)size;
+    rec->level = (uint16_t)level;
+    rec->argc = (uint16_t)argc;
+    rec->time = time(NULL);
+    rec->format = format;
+
+    for (size_t i = 0; i < argc; i++) {
+        copy[i] = args[i];
+        if (args[i].type == LOG_ARG_TEXT && args[i].s) {
+            memcpy(text, args[i].s, lens[i]);
+            text[lens[i]] = '\0';
+            copy[i].s = text;
+            text += lens[i] + 1;
+        }
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + size, memory_order_release);
+
+    /* Without a flusher thread the record is written right away. Errors
+     * and a filling ring wake the flusher up before its next round */
+    if (!atomic_load_explicit(&log_async, memory_order_relaxed))
+        logFlush();
+    else if (level == LOG_LEVEL_ERROR ||
+             head + size - atomic_load_explicit(&ring->tail,
+                                                memory_order_relaxed) >
+                 LOG_RING_SIZE / 2)
+        pthread_cond_signal(&log_wake);
+}
@@ -12,12 +12,22 @@
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
  * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Asynchronous logger. A LOG_* call only copies its format pointer and
+ *  its arguments into a binary record of the calling thread's ring
+ *  buffer; formatting, timestamps and the actual write happen on a
+ *  background thread. Levels above LOG_LEVEL compile to nothing, their
+ *  arguments are not even evaluated.
+ *
+ *  Anything that writes to stdout directly must call logFlush() first so
+ *  that the messages of the previous statements come out before it.
  */
 #ifndef _LOGS_H
 #define _LOGS_H
 
+#include <stddef.h>
 #include <stdio.h>
-#include <time.h>
 
 #define COLOR_RESET "\033[0m"
 #define COLOR_RED "\033[1;31m"
@@ -26,38 +36,144 @@
 #define COLOR_BLUE "\033[1;34m"
 #define COLOR_CYAN "\033[1;36m"
 
-/* Timestamp */
-#define LOG_TIMESTAMP()                                                        \
-    do {                                                                       \
-        time_t t = time(NULL);                                                 \
-        struct tm *tm_info = localtime(&t);                                    \
-        char buf[20];                                                          \
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", tm_info);              \
-        printf("[%s] ", buf);                                                  \
-    } while (0)
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
 
-#define LOG_INFO(msg, ...)                                                     \
-    do {                                                                       \
-        printf(COLOR_GREEN "[INFO] " COLOR_RESET msg "\n", ##__VA_ARGS__);     \
-    } while (0)
+/* Most verbose level compiled in, override with -DLOG_LEVEL=... */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
 
-#define LOG_WARN(msg, ...)                                                     \
-    do {                                                                       \
-        LOG_TIMESTAMP();                                                       \
-        printf(COLOR_YELLOW "[WARN] " COLOR_RESET msg "\n", ##__VA_ARGS__);    \
-    } while (0)
+/* Per-thread ring size in bytes, must be a power of two */
+#define LOG_RING_SIZE (64 * 1024)
+
+/* Longer string arguments are truncated in the record */
+#define LOG_TEXT_MAX 256
+
+/* Most arguments a single message can take */
+#define LOG_MAX_ARGS 8
+
+#define LOG_ARG_INT 0x01
+#define LOG_ARG_UINT 0x02
+#define LOG_ARG_DOUBLE 0x03
+#define LOG_ARG_TEXT 0x04
+#define LOG_ARG_POINTER 0x05
+
+/* A captured argument, strings point into the record once queued */
+struct log_arg_t {
+    int type; /* LOG_ARG_* */
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const char *s;
+        const void *p;
+    };
+};
+
+void logWrite(int level, const char *format, size_t argc,
+              const struct log_arg_t *args);
 
-#define LOG_ERROR(msg, ...)                                                    \
+/* Writes out everything queued so far, from any thread */
+void logFlush(void);
+
+static inline struct log_arg_t logArgInt(long long v) {
+    return (struct log_arg_t){.type = LOG_ARG_INT, .i = v};
+}
+
+static inline struct log_arg_t logArgUint(unsigned long long v) {
+    return (struct log_arg_t){.type = LOG_ARG_UINT, .u = v};
+}
+
+static inline struct log_arg_t logArgDouble(double v) {
+    return (struct log_arg_t){.type = LOG_ARG_DOUBLE, .d = v};
+}
+
+static inline struct log_arg_t logArgText(const char *v) {
+    return (struct log_arg_t){.type = LOG_ARG_TEXT, .s = v};
+}
+
+static inline struct log_arg_t logArgPointer(const void *v) {
+    return (struct log_arg_t){.type = LOG_ARG_POINTER, .p = v};
+}
+
+#define LOG_ARG(x)                                                             \
+    _Generic((x),                                                              \
+        char: logArgInt,                                                       \
+        signed char: logArgInt,                                                \
+        short: logArgInt,                                                      \
+        int: logArgInt,                                                        \
+        long: logArgInt,                                                       \
+        long long: logArgInt,                                                  \
+        unsigned char: logArgUint,                                             \
+        unsigned short: logArgUint,                                            \
+        unsigned int: logArgUint,                                              \
+        unsigned long: logArgUint,                                             \
+        unsigned long long: logArgUint,                                        \
+        float: logArgDouble,                                                   \
+        double: logArgDouble,                                                  \
+        char *: logArgText,                                                    \
+        const char *: logArgText,                                              \
+        default: logArgPointer)(x)
+
+/* LOG_MAP(a, b, ...) expands to LOG_ARG(a), LOG_ARG(b), ... */
+#define LOG_NARGS(...) LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_MAP(...) LOG_CAT(LOG_MAP_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_MAP_1(a) LOG_ARG(a)
+#define LOG_MAP_2(a, ...) LOG_ARG(a), LOG_MAP_1(__VA_ARGS__)
+#define LOG_MAP_3(a, ...) LOG_ARG(a), LOG_MAP_2(__VA_ARGS__)
+#define LOG_MAP_4(a, ...) LOG_ARG(a), LOG_MAP_3(__VA_ARGS__)
+#define LOG_MAP_5(a, ...) LOG_ARG(a), LOG_MAP_4(__VA_ARGS__)
+#define LOG_MAP_6(a, ...) LOG_ARG(a), LOG_MAP_5(__VA_ARGS__)
+#define LOG_MAP_7(a, ...) LOG_ARG(a), LOG_MAP_6(__VA_ARGS__)
+#define LOG_MAP_8(a, ...) LOG_ARG(a), LOG_MAP_7(__VA_ARGS__)
+
+/* The dead printf() keeps the compiler's format checking. The leading
+ * dummy element lets the argument list be empty */
+#define LOG_AT(level, msg, ...)                                                \
     do {                                                                       \
-        LOG_TIMESTAMP();                                                       \
-        fprintf(stderr, COLOR_RED "[ERROR] " COLOR_RESET msg "\n",             \
-                ##__VA_ARGS__);                                                \
+        if (0)                                                                 \
+            printf(msg, ##__VA_ARGS__);                                        \
+        const struct log_arg_t log_args_[] = {                                 \
+            {0} __VA_OPT__(, LOG_MAP(__VA_ARGS__))};                           \
+        logWrite(level, msg, sizeof(log_args_) / sizeof(log_args_[0]) - 1,    \
+                 log_args_ + 1);                                               \
     } while (0)
 
-#define LOG_DEBUG(msg, ...)                                                    \
+/* A disabled level: the arguments are still type checked, never evaluated */
+#define LOG_NONE(msg, ...)                                                     \
     do {                                                                       \
-        LOG_TIMESTAMP();                                                       \
-        printf(COLOR_BLUE "[DEBUG] " COLOR_RESET msg "\n", ##__VA_ARGS__);     \
+        if (0)                                                                 \
+            printf(msg, ##__VA_ARGS__);                                        \
     } while (0)
 
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(msg, ...) LOG_AT(LOG_LEVEL_ERROR, msg, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(msg, ...) LOG_NONE(msg, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(msg, ...) LOG_AT(LOG_LEVEL_WARN, msg, ##__VA_ARGS__)
+#else
+#define LOG_WARN(msg, ...) LOG_NONE(msg, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(msg, ...) LOG_AT(LOG_LEVEL_INFO, msg, ##__VA_ARGS__)
+#else
+#define LOG_INFO(msg, ...) LOG_NONE(msg, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(msg, ...) LOG_AT(LOG_LEVEL_DEBUG, msg, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(msg, ...) LOG_NONE(msg, ##__VA_ARGS__)
+#endif
+
 #endif /* _LOGS_H */
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "metrics.h"
+#include "prof.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Quantiles exported as a Prometheus summary */
+static const double metrics_quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct metrics_shard_t *metrics_shards; /* guarded by metrics_lock */
+
+/* Shared by the threads that could not get a shard of their own, their
+ * updates may then overwrite each other */
+static struct metrics_shard_t metrics_fallback;
+
+_Thread_local struct metrics_shard_t *metrics_shard;
+
+struct metrics_shard_t *metricsShard(void) {
+    if (metrics_shard)
+        return metrics_shard;
+
+    struct metrics_shard_t *shard = calloc(1, sizeof(*shard));
+    if (!shard)
+        return &metrics_fallback;
+
+    pthread_mutex_lock(&metrics_lock);
+    shard->next = metrics_shards;
+    metrics_shards = shard;
+    pthread_mutex_unlock(&metrics_lock);
+
+    metrics_shard = shard;
+    return shard;
+}
+
+/* Values below METRICS_SUB_BUCKETS have a bucket each, then every power
+ * of two [2^e, 2^(e+1)) is split in METRICS_SUB_BUCKETS equal buckets */
+static size_t metricsBucket(uint64_t value) {
+    if (value < METRICS_SUB_BUCKETS)
+        return (size_t)value;
+
+    int e = 63 - __builtin_clzll(value);
+    if (e > METRICS_MAX_BITS)
+        return METRICS_BUCKETS - 1;
+
+    return ((size_t)(e - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS) +
+           (size_t)(value >> (e - METRICS_SUB_BITS)) - METRICS_SUB_BUCKETS;
+}
+
+/* Highest value falling in bucket 'index' */
+static uint64_t metricsBucketHigh(size_t index) {
+    size_t octave = index >> METRICS_SUB_BITS;
+    uint64_t sub = index & (METRICS_SUB_BUCKETS - 1);
+
+    if (!octave)
+        return index;
+    return ((METRICS_SUB_BUCKETS + sub + 1) << (octave - 1)) - 1;
+}
+
+void metricsStatement(int type, uint64_t ticks) {
+    struct metrics_shard_t *shard =
+        metrics_shard ? metrics_shard : metricsShard();
+    struct metrics_histogram_t *histogram = &shard->latency[type];
+
+    metricsBump(&histogram->count, 1);
+    metricsBump(&histogram->sum, ticks);
+    metricsBump(&histogram->buckets[metricsBucket(ticks)], 1);
+}
+
+static void metricsMerge(struct metrics_snapshot_t *out,
+                         const struct metrics_shard_t *shard) {
+    for (int i = 0; i < METRIC_COUNTERS; i++)
+        out->counters[i] += atomic_load_explicit(&shard->counters[i],
+                                                 memory_order_relaxed);
+
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        const struct metrics_histogram_t *histogram = &shard->latency[t];
+
+        out->count[t] +=
+            atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        out->sum[t] +=
+            atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+        for (size_t b = 0; b < METRICS_BUCKETS; b++)
+            out->buckets[t][b] += atomic_load_explicit(&histogram->buckets[b],
+                                                       memory_order_relaxed);
+    }
+}
+
+void metricsSnapshot(struct metrics_snapshot_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    pthread_mutex_lock(&metrics_lock);
+    for (const struct metrics_shard_t *shard = metrics_shards; shard;
+         shard = shard->next)
+        metricsMerge(out, shard);
+    pthread_mutex_unlock(&metrics_lock);
+
+    metricsMerge(out, &metrics_fallback);
+}
+
+uint64_t metricsQuantile(const struct metrics_snapshot_t *snapshot, int type,
+                         double q) {
+    uint64_t count = 0, seen = 0;
+
+    for (size_t b = 0; b < METRICS_BUCKETS; b++)
+        count += snapshot->buckets[type][b];
+    if (!count)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)count + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    for (size_t b = 0; b < METRICS_BUCKETS; b++) {
+        seen += snapshot->buckets[type][b];
+        if (seen >= rank)
+            return metricsBucketHigh(b);
+    }
+    return metricsBucketHigh(METRICS_BUCKETS - 1);
+}
+
+const char *metricsCounterName(int counter) {
+    static const char *names[METRIC_COUNTERS] = {
+        [METRIC_ROWS_SCANNED] = "rows_scanned",
+        [METRIC_ROWS_RETURNED] = "rows_returned",
+        [METRIC_ROWS_INSERTED] = "rows_inserted",
+        [METRIC_ROWS_UPDATED] = "rows_updated",
+        [METRIC_ROWS_DELETED] = "rows_deleted",
+        [METRIC_INDEX_SCANS] = "index_scans",
+        [METRIC_BITMAP_SCANS] = "bitmap_scans",
+        [METRIC_CACHE_HITS] = "plan_cache_hits",
+        [METRIC_CACHE_MISSES] = "plan_cache_misses",
+        [METRIC_PAGES_EVICTED] = "pages_evicted",
+        [METRIC_PAGES_FAULTED] = "pages_faulted",
+    };
+    return names[counter];
+}
+
+const char *metricsStatementName(int type) {
+    static const char *names[METRIC_STMT_TYPES] = {
+        [METRIC_STMT_SELECT] = "select", [METRIC_STMT_INSERT] = "insert",
+        [METRIC_STMT_UPDATE] = "update", [METRIC_STMT_DELETE] = "delete",
+        [METRIC_STMT_DDL] = "ddl",       [METRIC_STMT_OTHER] = "other",
+    };
+    return names[type];
+}
+
+static double metricsSeconds(uint64_t ticks) {
+    return profMicros(ticks) / 1e6;
+}
+
+static void metricsDumpMemory(const struct ctx_t *ctx, FILE *out) {
+    fprintf(out, "# HELP rsql_database_bytes Memory held by a database.\n"
+                 "# TYPE rsql_database_bytes gauge\n");
+    for (size_t d = 0; ctx && d < ctx->database_count; d++)
+        fprintf(out, "rsql_database_bytes{database=\"%s\"} %zu\n",
+                ctx->databases[d]->name, dbDatabaseBytes(ctx->databases[d]));
+
+    fprintf(out, "# HELP rsql_table_bytes Memory held by a table and its "
+                 "rows.\n# TYPE rsql_table_bytes gauge\n");
+    for (size_t d = 0; ctx && d < ctx->database_count; d++) {
+        const struct database_t *db = ctx->databases[d];
+        for (size_t t = 0; t < db->table_count; t++)
+            fprintf(out,
+                    "rsql_table_bytes{database=\"%s\",table=\"%s\"} %zu\n",
+                    db->name, db->tables[t]->name, db->tables[t]->bytes);
+    }
+
+    fprintf(out, "# HELP rsql_table_rows Rows stored in a table.\n"
+                 "# TYPE rsql_table_rows gauge\n");
+    for (size_t d = 0; ctx && d < ctx->database_count; d++) {
+        const struct database_t *db = ctx->databases[d];
+        for (size_t t = 0; t < db->table_count; t++)
+            fprintf(out, "rsql_table_rows{database=\"%s\",table=\"%s\"} %zu\n",
+                    db->name, db->tables[t]->name, db->tables[t]->row_count);
+    }
+}
+
+int metricsDump(const struct ctx_t *ctx, FILE *out) {
+    struct metrics_snapshot_t *snapshot = malloc(sizeof(*snapshot));
+    if (!snapshot)
+        return 0;
+    metricsSnapshot(snapshot);
+
+    for (int i = 0; i < METRIC_COUNTERS; i++) {
+        const char *name = metricsCounterName(i);
+        fprintf(out, "# TYPE rsql_%s_total counter\nrsql_%s_total %llu\n",
+                name, name, (unsigned long long)snapshot->counters[i]);
+    }
+
+    fprintf(out, "# HELP rsql_statement_duration_seconds Statement latency "
+                 "by type.\n"
+                 "# TYPE rsql_statement_duration_seconds summary\n");
+    for (int t = 0; t < METRIC_STMT_TYPES; t++) {
+        const char *type = metricsStatementName(t);
+
+        for (size_t q = 0; q < sizeof(metrics_quantiles) / sizeof(double);
+             q++)
+            fprintf(out,
+                    "rsql_statement_duration_seconds{type=\"%s\","
+                    "quantile=\"%g\"} %.9f\n",
+                    type, metrics_quantiles[q],
+                    metricsSeconds(
+                        metricsQuantile(snapshot, t, metrics_quantiles[q])));
+        fprintf(out,
+                "rsql_statement_duration_seconds_sum{type=\"%s\"} %.9f\n"
+                "rsql_statement_duration_seconds_count{type=\"%s\"} %llu\n",
+                type, metricsSeconds(snapshot->sum[t]), type,
+                (unsigned long long)snapshot->count[t]);
+    }
+
+    metricsDumpMemory(ctx, out);
+    free(snapshot);
+    return !ferror(out);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Metrics registry: event counters and statement latency histograms.
+ *  Every thread updates a shard of its own without locks or atomic
+ *  read-modify-write instructions; readers add the shards together. The
+ *  histograms are log-linear (HDR style): each power of two is split in
+ *  METRICS_SUB_BUCKETS buckets, a recorded value is off by at most 1/32.
+ */
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "db.h"
+
+/* Counters */
+#define METRIC_ROWS_SCANNED 0  /* rows read by table and index scans */
+#define METRIC_ROWS_RETURNED 1 /* rows sent by SELECT */
+#define METRIC_ROWS_INSERTED 2
+#define METRIC_ROWS_UPDATED 3
+#define METRIC_ROWS_DELETED 4
+#define METRIC_INDEX_SCANS 5    /* scans answered by an index */
+#define METRIC_BITMAP_SCANS 6   /* scans answered by bitmap indexes */
+#define METRIC_CACHE_HITS 7     /* statements run from a cached plan */
+#define METRIC_CACHE_MISSES 8   /* statements parsed and planned */
+#define METRIC_PAGES_EVICTED 9  /* pages written out by the buffer pool */
+#define METRIC_PAGES_FAULTED 10 /* pages read back from the spill file */
+#define METRIC_COUNTERS 11
+
+/* Statement types, each one has its latency histogram */
+#define METRIC_STMT_SELECT 0
+#define METRIC_STMT_INSERT 1
+#define METRIC_STMT_UPDATE 2
+#define METRIC_STMT_DELETE 3
+#define METRIC_STMT_DDL 4 /* CREATE, DROP, ALTER */
+#define METRIC_STMT_OTHER 5
+#define METRIC_STMT_TYPES 6
+
+/* Latencies are recorded in profNow() ticks up to 2^METRICS_MAX_BITS */
+#define METRICS_SUB_BITS 5
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_BITS 45
+#define METRICS_BUCKETS                                                        \
+    ((METRICS_MAX_BITS - METRICS_SUB_BITS + 2) * METRICS_SUB_BUCKETS)
+
+struct metrics_histogram_t {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t buckets[METRICS_BUCKETS];
+};
+
+/* Written only by the thread owning it */
+struct metrics_shard_t {
+    _Atomic uint64_t counters[METRIC_COUNTERS];
+    struct metrics_histogram_t latency[METRIC_STMT_TYPES];
+    struct metrics_shard_t *next;
+};
+
+/* Every shard added together */
+struct metrics_snapshot_t {
+    uint64_t counters[METRIC_COUNTERS];
+    uint64_t count[METRIC_STMT_TYPES];
+    uint64_t sum[METRIC_STMT_TYPES];
+    uint64_t buckets[METRIC_STMT_TYPES][METRICS_BUCKETS];
+};
+
+extern _Thread_local struct metrics_shard_t *metrics_shard;
+
+/* Shard of the calling thread, created on its first event */
+struct metrics_shard_t *metricsShard(void);
+
+/* Single writer: a plain load and store, no locked instruction */
+static inline void metricsBump(_Atomic uint64_t *value, uint64_t n) {
+    atomic_store_explicit(
+        value, atomic_load_explicit(value, memory_order_relaxed) + n,
+        memory_order_relaxed);
+}
+
+static inline void metricsAdd(int counter, uint64_t n) {
+    struct metrics_shard_t *shard =
+        metrics_shard ? metrics_shard : metricsShard();
+    metricsBump(&shard->counters[counter], n);
+}
+
+/* Record a statement of type 'type' (METRIC_STMT_*) that took 'ticks' */
+void metricsStatement(int type, uint64_t ticks);
+
+void metricsSnapshot(struct metrics_snapshot_t *out);
+
+/* Latency under which a fraction 'q' of the statements of 'type' ran,
+ * in ticks */
+uint64_t metricsQuantile(const struct metrics_snapshot_t *snapshot, int type,
+                         double q);
+
+const char *metricsCounterName(int counter);
+const char *metricsStatementName(int type);
+
+/* Prometheus text exposition of the metrics and of the memory of every
+ * database of 'ctx', returns 0 when the file cannot be written */
+int metricsDump(const struct ctx_t *ctx, FILE *out);
+
+#endif /* _METRICS_H */
@@ -14,11 +14,13 @@
  * limitations under the License.
  */
 #include "parser.h"
+#include "arena.h"
 #include "lex.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 /* prototypes */
 struct ast_node_t *parseStatement(struct parser_t *parser);
@@ -29,20 +31,32 @@ struct ast_node_t *parseExpression(struct parser_t *parser);
 struct ast_node_t *parseIndentifier(struct parser_t *parser);
 struct ast_node_t *parseCreateDatabase(struct parser_t *parser);
 struct ast_node_t *parseCreateTable(struct parser_t *parser);
+struct ast_node_t *parseCreateIndex(struct parser_t *parser);
 struct ast_node_t *parseDropTable(struct parser_t *parser);
+struct ast_node_t *parseAlterTable(struct parser_t *parser);
 struct ast_node_t *parseSelect(struct parser_t *parser);
 struct ast_node_t *parseWhereClause(struct parser_t *parser);
 struct ast_node_t *parseInsert(struct parser_t *parser);
+struct ast_node_t *parseUpdate(struct parser_t *parser);
+struct ast_node_t *parseDelete(struct parser_t *parser);
+struct ast_node_t *parseAnalyzeTable(struct parser_t *parser);
+struct ast_node_t *parseUseDatabase(struct parser_t *parser);
+struct ast_node_t *parsePrepare(struct parser_t *parser);
+struct ast_node_t *parseExecute(struct parser_t *parser);
+struct ast_node_t *parseDeallocate(struct parser_t *parser);
 static struct ast_node_t *parseValueList(struct parser_t *parser);
 
-/* Create a new Abstract Syntactical Tree node */
-struct ast_node_t *astCreateNode(enum ast_node_type_t type, const char *value) {
-    struct ast_node_t *node = malloc(sizeof(struct ast_node_t));
+/* Create a new Abstract Syntactical Tree node, the node and its value
+ * are owned by the statement arena */
+struct ast_node_t *astCreateNode(struct arena_t *arena,
+                                 enum ast_node_type_t type, const char *value) {
+    struct ast_node_t *node = arenaAlloc(arena, sizeof(struct ast_node_t));
     if (!node)
         return NULL;
 
     node->type = type;
-    node->value = value ? strdup(value) : NULL;
+    node->value = value ? arenaStrdup(arena, value) : NULL;
+    node->op = 0;
     node->children = NULL;
     node->child_count = 0;
     node->child_capacity = 0;
@@ -50,48 +64,55 @@ struct ast_node_t *astCreateNode(enum ast_node_type_t type, const char *value) {
     return node;
 }
 
+/* Create a node whose value is the text of the current token, this is the
+ * only place where the parser copies text out of the input */
+static struct ast_node_t *astCreateTokenNode(struct parser_t *parser,
+                                             enum ast_node_type_t type) {
+    struct ast_node_t *node = astCreateNode(parser->arena, type, NULL);
+    if (!node)
+        return NULL;
+
+    node->value = lexTokenDup(parser->lexer, parser->arena);
+    if (!node->value)
+        return NULL;
+    node->op = lexGetTokenType(parser->lexer);
+    return node;
+}
+
 /* Add a child to a node, this method check also the right
  * child_capacity and handle the child_count */
-void astAddChild(struct ast_node_t *restrict parent,
+void astAddChild(struct arena_t *arena, struct ast_node_t *restrict parent,
                  struct ast_node_t *restrict child) {
     if (!parent || !child)
         return;
 
-    /* In case the parent capacity is full we resize it
-     * with capacity * 2 */
+    /* In case the parent capacity is full we move the children to an
+     * array with capacity * 2, the old one stays in the arena */
     if (parent->child_count >= parent->child_capacity) {
-        parent->child_capacity =
+        size_t capacity =
             parent->child_capacity ? parent->child_capacity * 2 : 4;
-
-        parent->children =
-            realloc(parent->children,
-                    parent->child_capacity * sizeof(struct ast_node_t));
+        struct ast_node_t **children =
+            arenaAlloc(arena, capacity * sizeof(struct ast_node_t *));
+        if (!children)
+            return;
+
+        if (parent->child_count)
+            memcpy(children, parent->children,
+                   parent->child_count * sizeof(struct ast_node_t *));
+        parent->children = children;
+        parent->child_capacity = capacity;
     }
 
     parent->children[parent->child_count++] = child;
 }
 
-/* Recursively release a node and its children */
-void astFreeNode(struct ast_node_t *node) {
-    if (!node)
-        return;
-
-    free(node->value);
-
-    for (size_t i = 0; i < node->child_count; i++) {
-        astFreeNode(node->children[i]);
-    }
-
-    free(node->children);
-    free(node);
-}
-
 /* Parser Error Handling */
 void parserError(struct parser_t *parser, const char *message) {
     parser->has_error = 1;
     snprintf(parser->error_message, sizeof(parser->error_message),
-             "Parse error: %s at token '%s'", message,
-             lexGetTokenText(parser->lexer));
+             "Parse error: %s at token '%.*s'", message,
+             (int)lexGetTokenLength(parser->lexer),
+             lexGetTokenStart(parser->lexer));
 }
 
 int parserExpect(struct parser_t *parser, int expected_type) {
@@ -113,107 +134,343 @@ int parserConsume(struct parser_t *parser, int expected_type) {
     return 1;
 }
 
+/* Consumes the identifier 'word', used for the words that are keywords
+ * only in one statement and stay valid table and column names */
+static int parserWord(struct parser_t *parser, const char *word) {
+    size_t len = strlen(word);
+
+    if (!lexIsToken(parser->lexer, RSQL_IDENTIFIER) ||
+        lexGetTokenLength(parser->lexer) != len ||
+        strncasecmp(lexGetTokenStart(parser->lexer), word, len) != 0)
+        return 0;
+    lexNextToken(parser->lexer);
+    return 1;
+}
+
 struct ast_node_t *parseIndentifier(struct parser_t *parser) {
     if (!parserExpect(parser, RSQL_IDENTIFIER))
         return NULL;
 
-    struct ast_node_t *node =
-        astCreateNode(AST_IDENTIFIER, lexGetTokenText(parser->lexer));
+    struct ast_node_t *node = astCreateTokenNode(parser, AST_IDENTIFIER);
     lexNextToken(parser->lexer);
     return node;
 }
 
 struct ast_node_t *parseColumnDef(struct parser_t *parser) {
-    struct ast_node_t *col_def = astCreateNode(AST_COLUMN_DEF, NULL);
+    struct ast_node_t *col_def =
+        astCreateNode(parser->arena, AST_COLUMN_DEF, NULL);
 
     struct ast_node_t *name = parseIndentifier(parser);
     if (!name)
-        goto cleanup;
-    astAddChild(col_def, name);
+        return NULL;
+    astAddChild(parser->arena, col_def, name);
 
     if (lexIsToken(parser->lexer, RSQL_IDENTIFIER)) {
         struct ast_node_t *type = parseIndentifier(parser);
-        astAddChild(col_def, type);
+        astAddChild(parser->arena, col_def, type);
     }
 
     return col_def;
+}
+
+/* 'col_name type DEFAULT value' of CREATE TABLE, the value becomes the
+ * third child of the column definition */
+static int parseColumnDefault(struct parser_t *parser,
+                              struct ast_node_t *col_def) {
+    if (!lexIsToken(parser->lexer, DEFAULT_KW))
+        return 1;
+    if (col_def->child_count < 2) {
+        parserError(parser, "Expected a type before DEFAULT");
+        return 0;
+    }
+    lexNextToken(parser->lexer);
 
-cleanup:
-    astFreeNode(col_def);
-    return NULL;
+    struct ast_node_t *value = parseExpression(parser);
+    if (!value)
+        return 0;
+    astAddChild(parser->arena, col_def, value);
+    return 1;
 }
 
 struct ast_node_t *parseColumnList(struct parser_t *parser) {
-    struct ast_node_t *list = astCreateNode(AST_COLUMN_LIST, NULL);
+    struct ast_node_t *list =
+        astCreateNode(parser->arena, AST_COLUMN_LIST, NULL);
 
     if (!parserConsume(parser, RSQL_LPAREN))
-        goto cleanup;
+        return NULL;
 
     struct ast_node_t *col = parseColumnDef(parser);
-    if (!col)
-        goto cleanup;
-    astAddChild(list, col);
+    if (!col || !parseColumnDefault(parser, col))
+        return NULL;
+    astAddChild(parser->arena, list, col);
 
     while (lexIsToken(parser->lexer, RSQL_COMMA)) {
         lexNextToken(parser->lexer);
 
         col = parseColumnDef(parser);
-        if (!col)
-            goto cleanup;
-        astAddChild(list, col);
+        if (!col || !parseColumnDefault(parser, col))
+            return NULL;
+        astAddChild(parser->arena, list, col);
     }
 
     if (!parserConsume(parser, RSQL_RPAREN))
-        goto cleanup;
+        return NULL;
 
     return list;
+}
 
-cleanup:
-    astFreeNode(list);
-    return NULL;
+/* EXPRESSIONS
+ * ===========
+ * Expressions are parsed by precedence climbing, every infix operator
+ * has a binding power and the operand on its right is parsed with a
+ * higher one, so the tree comes out with the usual precedence:
+ *      OR < AND < NOT < comparisons, IS, LIKE, IN, BETWEEN < + - < * /
+ * e.g. 'a = 1 OR NOT b > 2 AND c < 3 + 4 * 5' is
+ *      a = 1 OR ((NOT b > 2) AND c < (3 + (4 * 5))) */
+#define PREC_NONE 0
+#define PREC_OR 1
+#define PREC_AND 2
+#define PREC_NOT 3
+#define PREC_COMPARE 4
+#define PREC_ADD 5
+#define PREC_MUL 6
+#define PREC_UNARY 7
+
+static struct ast_node_t *parseExpressionPrec(struct parser_t *parser,
+                                              int min_prec);
+
+static int parseInfixPrecedence(int type) {
+    switch (type) {
+    case OR_KW:
+        return PREC_OR;
+    case AND_KW:
+        return PREC_AND;
+    case RSQL_ET_OP:
+    case RSQL_NE_OP:
+    case RSQL_LT_OP:
+    case RSQL_LE_OP:
+    case RSQL_GT_OP:
+    case RSQL_GE_OP:
+    case IS_KW:
+    case LIKE_KW:
+    case IN_KW:
+    case BETWEEN_KW:
+    case NOT_KW: /* NOT IN, NOT LIKE, NOT BETWEEN */
+        return PREC_COMPARE;
+    case RSQL_ADD_OP:
+    case RSQL_SUB_OP:
+        return PREC_ADD;
+    case RSQL_MUL_OP:
+    case RSQL_DIV_OP:
+        return PREC_MUL;
+    default:
+        return PREC_NONE;
+    }
 }
 
-struct ast_node_t *parseExpression(struct parser_t *parser) {
-    struct ast_node_t *left = NULL;
+static struct ast_node_t *parseUnary(struct parser_t *parser, int prec) {
+    struct ast_node_t *node = astCreateTokenNode(parser, AST_UNARY_OP);
+    if (!node)
+        return NULL;
+    lexNextToken(parser->lexer);
 
-    if (lexIsToken(parser->lexer, RSQL_IDENTIFIER)) {
-        left = parseIndentifier(parser);
-    } else if (lexIsToken(parser->lexer, RSQL_STRING_LITERAL) ||
-               lexIsToken(parser->lexer, RSQL_NUMERIC_LITERAL)) {
-        left = astCreateNode(AST_LITERAL, lexGetTokenText(parser->lexer));
+    struct ast_node_t *operand = parseExpressionPrec(parser, prec);
+    if (!operand)
+        return NULL;
+    astAddChild(parser->arena, node, operand);
+    return node;
+}
+
+/* Operands: literals, NULL, columns, placeholders, parenthesized
+ * expressions and the prefix operators NOT and '-' */
+static struct ast_node_t *parsePrimary(struct parser_t *parser) {
+    struct ast_node_t *node = NULL;
+
+    switch (lexGetTokenType(parser->lexer)) {
+    case RSQL_IDENTIFIER:
+        return parseIndentifier(parser);
+
+    case RSQL_STRING_LITERAL:
+    case RSQL_NUMERIC_LITERAL:
+    case NULL_KW:
+        node = astCreateTokenNode(parser, AST_LITERAL);
         lexNextToken(parser->lexer);
-    } else {
-        parserError(parser, "Expected identifier or literal");
+        return node;
+
+    case RSQL_PLACEHOLDER: {
+        char ordinal[32];
+        snprintf(ordinal, sizeof(ordinal), "%zu", parser->param_count++);
+        node = astCreateNode(parser->arena, AST_PARAM, ordinal);
+        lexNextToken(parser->lexer);
+        return node;
+    }
+
+    case RSQL_LPAREN:
+        lexNextToken(parser->lexer);
+        node = parseExpressionPrec(parser, PREC_OR);
+        if (!node || !parserConsume(parser, RSQL_RPAREN))
+            return NULL;
+        return node;
+
+    case NOT_KW:
+        return parseUnary(parser, PREC_NOT);
+
+    case RSQL_SUB_OP:
+        return parseUnary(parser, PREC_UNARY);
+
+    default:
+        parserError(parser, "Expected identifier, literal or parameter");
         return NULL;
     }
+}
 
-    // Check for binary operator
-    if (lexIsToken(parser->lexer, RSQL_EQ_OP) ||
-        lexIsToken(parser->lexer, RSQL_NE_OP) ||
-        lexIsToken(parser->lexer, RSQL_LT_OP) ||
-        lexIsToken(parser->lexer, RSQL_GT_OP) ||
-        lexIsToken(parser->lexer, RSQL_LE_OP) ||
-        lexIsToken(parser->lexer, RSQL_GE_OP)) {
+/* Wrap 'node' in a NOT, used for the negated forms of IN, LIKE, BETWEEN
+ * and IS NULL */
+static struct ast_node_t *parseNegate(struct parser_t *parser,
+                                      struct ast_node_t *node) {
+    struct ast_node_t *not_node =
+        astCreateNode(parser->arena, AST_UNARY_OP, "NOT");
+    if (!node || !not_node)
+        return NULL;
+
+    not_node->op = NOT_KW;
+    astAddChild(parser->arena, not_node, node);
+    return not_node;
+}
 
-        const char *op = lexGetTokenText(parser->lexer);
-        enum ast_node_type_t type = AST_OPERATOR;
+/* Parse the right side of an infix operator, the current token is the
+ * operator (after an optional NOT) */
+static struct ast_node_t *parseInfix(struct parser_t *parser,
+                                     struct ast_node_t *left, int prec) {
+    struct ast_node_t *node;
+    int type = lexGetTokenType(parser->lexer);
 
-        struct ast_node_t *op_node = astCreateNode(type, op);
+    switch (type) {
+    case IS_KW: {
+        node = astCreateTokenNode(parser, AST_IS_NULL);
         lexNextToken(parser->lexer);
 
-        struct ast_node_t *right = parseExpression(parser);
-        if (!right) {
-            astFreeNode(op_node);
-            astFreeNode(left);
+        int negated = lexIsToken(parser->lexer, NOT_KW);
+        if (negated)
+            lexNextToken(parser->lexer);
+        if (!node || !parserConsume(parser, NULL_KW))
             return NULL;
+
+        astAddChild(parser->arena, node, left);
+        return negated ? parseNegate(parser, node) : node;
+    }
+
+    case BETWEEN_KW: {
+        node = astCreateTokenNode(parser, AST_BETWEEN);
+        lexNextToken(parser->lexer);
+
+        /* The bounds bind tighter than AND, which separates them */
+        struct ast_node_t *low = parseExpressionPrec(parser, PREC_ADD);
+        if (!node || !low || !parserConsume(parser, AND_KW))
+            return NULL;
+        struct ast_node_t *high = parseExpressionPrec(parser, PREC_ADD);
+        if (!high)
+            return NULL;
+
+        astAddChild(parser->arena, node, left);
+        astAddChild(parser->arena, node, low);
+        astAddChild(parser->arena, node, high);
+        return node;
+    }
+
+    case IN_KW: {
+        node = astCreateTokenNode(parser, AST_IN_LIST);
+        lexNextToken(parser->lexer);
+        if (!node || !parserConsume(parser, RSQL_LPAREN))
+            return NULL;
+
+        astAddChild(parser->arena, node, left);
+
+        /* 'IN (SELECT column FROM ...)' */
+        if (lexIsToken(parser->lexer, SELECT_KW)) {
+            lexNextToken(parser->lexer);
+            struct ast_node_t *select = parseSelect(parser);
+            if (!select || !parserConsume(parser, RSQL_RPAREN))
+                return NULL;
+
+            node->type = AST_IN_SUBQUERY;
+            astAddChild(parser->arena, node, select);
+            return node;
+        }
+
+        struct ast_node_t *value = parseExpressionPrec(parser, PREC_OR);
+        if (!value)
+            return NULL;
+        astAddChild(parser->arena, node, value);
+
+        while (lexIsToken(parser->lexer, RSQL_COMMA)) {
+            lexNextToken(parser->lexer);
+            value = parseExpressionPrec(parser, PREC_OR);
+            if (!value)
+                return NULL;
+            astAddChild(parser->arena, node, value);
+        }
+
+        if (!parserConsume(parser, RSQL_RPAREN))
+            return NULL;
+        return node;
+    }
+
+    case LIKE_KW:
+        node = astCreateTokenNode(parser, AST_LIKE);
+        break;
+
+    default:
+        node = astCreateTokenNode(parser, AST_BINARY_OP);
+        break;
+    }
+
+    if (!node)
+        return NULL;
+    lexNextToken(parser->lexer);
+
+    /* Left associative: the right operand only takes operators that
+     * bind tighter */
+    struct ast_node_t *right = parseExpressionPrec(parser, prec + 1);
+    if (!right)
+        return NULL;
+
+    astAddChild(parser->arena, node, left);
+    astAddChild(parser->arena, node, right);
+    return node;
+}
+
+static struct ast_node_t *parseExpressionPrec(struct parser_t *parser,
+                                              int min_prec) {
+    struct ast_node_t *left = parsePrimary(parser);
+    if (!left)
+        return NULL;
+
+    for (;;) {
+        int prec = parseInfixPrecedence(lexGetTokenType(parser->lexer));
+        if (prec == PREC_NONE || prec < min_prec)
+            return left;
+
+        if (lexIsToken(parser->lexer, NOT_KW)) {
+            lexNextToken(parser->lexer);
+            if (!lexIsToken(parser->lexer, IN_KW) &&
+                !lexIsToken(parser->lexer, LIKE_KW) &&
+                !lexIsToken(parser->lexer, BETWEEN_KW)) {
+                parserError(parser, "Expected IN, LIKE or BETWEEN");
+                return NULL;
+            }
+            left = parseNegate(parser, parseInfix(parser, left, prec));
+        } else {
+            left = parseInfix(parser, left, prec);
         }
 
-        astAddChild(op_node, left);
-        astAddChild(op_node, right);
-        return op_node;
+        if (!left)
+            return NULL;
     }
+}
 
-    return left;
+struct ast_node_t *parseExpression(struct parser_t *parser) {
+    return parseExpressionPrec(parser, PREC_OR);
 }
 
 /* WHERE
@@ -227,88 +484,350 @@ struct ast_node_t *parseWhereClause(struct parser_t *parser) {
     if (!lexIsToken(parser->lexer, WHERE_KW))
         return NULL;
 
-    struct ast_node_t *where_node = astCreateNode(AST_WHERE_CLAUSE, NULL);
+    struct ast_node_t *where_node =
+        astCreateNode(parser->arena, AST_WHERE_CLAUSE, NULL);
     lexNextToken(parser->lexer); /* consume WHERE */
 
     struct ast_node_t *condition = parseExpression(parser);
     if (!condition)
-        goto cleanup;
-    astAddChild(where_node, condition);
+        return NULL;
+    astAddChild(parser->arena, where_node, condition);
 
     return where_node;
-
-cleanup:
-    free(where_node);
-    return NULL;
 }
 
 /* Database creation 'CREATE DATABASE db_name;' */
 struct ast_node_t *parseCreateDatabase(struct parser_t *parser) {
-    struct ast_node_t *db_node = astCreateNode(AST_CREATE_DATABASE, NULL);
+    struct ast_node_t *db_node =
+        astCreateNode(parser->arena, AST_CREATE_DATABASE, NULL);
 
     /* consume 'DATABASE' kw */
     if (!parserConsume(parser, DATABASE_KW))
-        goto cleanup;
+        return NULL;
 
     struct ast_node_t *db_name = parseIndentifier(parser);
     if (!db_name)
-        goto cleanup;
-    astAddChild(db_node, db_name);
+        return NULL;
+    astAddChild(parser->arena, db_node, db_name);
 
     return db_node;
+}
+
+/* Table option 'ROW_FORMAT [=] name' */
+static struct ast_node_t *parseRowFormat(struct parser_t *parser) {
+    struct ast_node_t *format =
+        astCreateNode(parser->arena, AST_ROW_FORMAT, NULL);
+
+    lexNextToken(parser->lexer);
+    if (lexIsToken(parser->lexer, RSQL_ET_OP))
+        lexNextToken(parser->lexer);
+
+    struct ast_node_t *format_name = parseIndentifier(parser);
+    if (!format_name)
+        return NULL;
+    astAddChild(parser->arena, format, format_name);
+
+    return format;
+}
+
+/* Table option 'CAPPED (n ROWS | n BYTES)', CAPPED is not reserved */
+static struct ast_node_t *parseCapped(struct parser_t *parser) {
+    if (!parserConsume(parser, RSQL_LPAREN))
+        return NULL;
+
+    struct ast_node_t *limit = parseExpression(parser);
+    if (!limit)
+        return NULL;
+
+    const char *unit = parserWord(parser, "ROWS")    ? "ROWS"
+                       : parserWord(parser, "BYTES") ? "BYTES"
+                                                     : NULL;
+    if (!unit) {
+        parserError(parser, "Expected ROWS or BYTES");
+        return NULL;
+    }
+    if (!parserConsume(parser, RSQL_RPAREN))
+        return NULL;
+
+    struct ast_node_t *capped = astCreateNode(parser->arena, AST_CAPPED, unit);
+    astAddChild(parser->arena, capped, limit);
+    return capped;
+}
+
+/* A RANGE partition, 'PARTITION name VALUES LESS THAN (value)' or
+ * '... VALUES LESS THAN MAXVALUE' */
+static struct ast_node_t *parsePartition(struct parser_t *parser) {
+    struct ast_node_t *partition =
+        astCreateNode(parser->arena, AST_PARTITION, NULL);
+
+    if (!parserWord(parser, "PARTITION")) {
+        parserError(parser, "Expected PARTITION");
+        return NULL;
+    }
+
+    struct ast_node_t *name = parseIndentifier(parser);
+    if (!name || !parserConsume(parser, VALUES_KW))
+        return NULL;
+    astAddChild(parser->arena, partition, name);
+
+    if (!parserWord(parser, "LESS") || !parserWord(parser, "THAN")) {
+        parserError(parser, "Expected LESS THAN");
+        return NULL;
+    }
+    if (parserWord(parser, "MAXVALUE"))
+        return partition;
 
-cleanup:
-    astFreeNode(db_node);
-    return NULL;
+    if (!parserConsume(parser, RSQL_LPAREN))
+        return NULL;
+    struct ast_node_t *bound = parseExpression(parser);
+    if (!bound || !parserConsume(parser, RSQL_RPAREN))
+        return NULL;
+    astAddChild(parser->arena, partition, bound);
+
+    return partition;
 }
 
-/* Table creation parser e.g. 'CREATE TABLE tb_name (id INT, name TEXT);' */
+/* Table partitioning
+ * ==================
+ *      PARTITION BY RANGE (col) (PARTITION p0 VALUES LESS THAN (100),
+ *                                PARTITION p1 VALUES LESS THAN MAXVALUE)
+ *      PARTITION BY HASH (col) PARTITIONS 4
+ * The node value is the method, the children are the column followed by
+ * the partitions (RANGE) or their number (HASH). None of these words is
+ * reserved */
+static struct ast_node_t *parsePartitionBy(struct parser_t *parser) {
+    /* Word 'PARTITION' is already consumed by caller */
+    if (!parserWord(parser, "BY")) {
+        parserError(parser, "Expected BY");
+        return NULL;
+    }
+
+    const char *method = parserWord(parser, "RANGE")  ? "RANGE"
+                         : parserWord(parser, "HASH") ? "HASH"
+                                                      : NULL;
+    if (!method) {
+        parserError(parser, "Expected RANGE or HASH");
+        return NULL;
+    }
+
+    struct ast_node_t *partitioning =
+        astCreateNode(parser->arena, AST_PARTITION_BY, method);
+    if (!parserConsume(parser, RSQL_LPAREN))
+        return NULL;
+    struct ast_node_t *column = parseIndentifier(parser);
+    if (!column || !parserConsume(parser, RSQL_RPAREN))
+        return NULL;
+    astAddChild(parser->arena, partitioning, column);
+
+    if (method[0] == 'H') {
+        if (!parserWord(parser, "PARTITIONS")) {
+            parserError(parser, "Expected PARTITIONS");
+            return NULL;
+        }
+        struct ast_node_t *count = parseExpression(parser);
+        if (!count)
+            return NULL;
+        astAddChild(parser->arena, partitioning, count);
+        return partitioning;
+    }
+
+    if (!parserConsume(parser, RSQL_LPAREN))
+        return NULL;
+    do {
+        if (partitioning->child_count > 1)
+            lexNextToken(parser->lexer);
+
+        struct ast_node_t *partition = parsePartition(parser);
+        if (!partition)
+            return NULL;
+        astAddChild(parser->arena, partitioning, partition);
+    } while (lexIsToken(parser->lexer, RSQL_COMMA));
+
+    if (!parserConsume(parser, RSQL_RPAREN))
+        return NULL;
+    return partitioning;
+}
+
+/* Table creation parser e.g. 'CREATE TABLE tb_name (id INT, name TEXT);',
+ * a column may have a default: 'qty INT DEFAULT 1' */
 struct ast_node_t *parseCreateTable(struct parser_t *parser) {
-    struct ast_node_t *create_node = astCreateNode(AST_CREATE_TABLE, NULL);
+    struct ast_node_t *create_node =
+        astCreateNode(parser->arena, AST_CREATE_TABLE, NULL);
 
     /* Keyword 'CREATE' is already consumed from caller,
      * so consume the keyword 'TABLE' */
     if (!parserConsume(parser, TABLE_KW))
-        goto cleanup;
+        return NULL;
 
     /* Parse table identifier 'CREATE TABLE <identifier> ...' */
     struct ast_node_t *table_name = parseIndentifier(parser);
     if (!table_name)
-        goto cleanup;
-    astAddChild(create_node, table_name);
+        return NULL;
+    astAddChild(parser->arena, create_node, table_name);
 
     /* Parse column list 'CREATE TABLE name (id INT, name VARCHAR);' */
     struct ast_node_t *columns = parseColumnList(parser);
     if (!columns)
-        goto cleanup;
-    astAddChild(create_node, columns);
+        return NULL;
+    astAddChild(parser->arena, create_node, columns);
+
+    /* Table options '... ROW_FORMAT [=] PACKED CAPPED (1000 ROWS);' in
+     * any order */
+    for (;;) {
+        struct ast_node_t *option;
+        if (lexIsToken(parser->lexer, ROW_FORMAT_KW))
+            option = parseRowFormat(parser);
+        else if (parserWord(parser, "CAPPED"))
+            option = parseCapped(parser);
+        else
+            break;
+
+        if (!option)
+            return NULL;
+        astAddChild(parser->arena, create_node, option);
+    }
+
+    if (parserWord(parser, "PARTITION")) {
+        struct ast_node_t *partitioning = parsePartitionBy(parser);
+        if (!partitioning)
+            return NULL;
+        astAddChild(parser->arena, create_node, partitioning);
+    }
 
     return create_node;
+}
+
+/* Index creation
+ * ==============
+ *      CREATE INDEX idx_name ON tb_name (col_name) [USING type]
+ * The node children are the index, table and column names followed by
+ * the index type when it is given */
+struct ast_node_t *parseCreateIndex(struct parser_t *parser) {
+    struct ast_node_t *index_node =
+        astCreateNode(parser->arena, AST_CREATE_INDEX, NULL);
+
+    /* Keyword 'CREATE' is already consumed by caller */
+    if (!parserConsume(parser, INDEX_KW))
+        return NULL;
 
-cleanup:
-    astFreeNode(create_node);
-    return NULL;
+    struct ast_node_t *index_name = parseIndentifier(parser);
+    if (!index_name || !parserConsume(parser, ON_KW))
+        return NULL;
+    astAddChild(parser->arena, index_node, index_name);
+
+    struct ast_node_t *table_name = parseIndentifier(parser);
+    if (!table_name || !parserConsume(parser, RSQL_LPAREN))
+        return NULL;
+    astAddChild(parser->arena, index_node, table_name);
+
+    struct ast_node_t *col_name = parseIndentifier(parser);
+    if (!col_name || !parserConsume(parser, RSQL_RPAREN))
+        return NULL;
+    astAddChild(parser->arena, index_node, col_name);
+
+    if (lexIsToken(parser->lexer, USING_KW)) {
+        lexNextToken(parser->lexer);
+        struct ast_node_t *type = parseIndentifier(parser);
+        if (!type)
+            return NULL;
+        astAddChild(parser->arena, index_node, type);
+    }
+
+    return index_node;
 }
 
 /* Table deletion e.g. 'DROP TABLE animals;' */
 struct ast_node_t *parseDropTable(struct parser_t *parser) {
-    struct ast_node_t *drop_node = astCreateNode(AST_DROP_TABLE, NULL);
+    struct ast_node_t *drop_node =
+        astCreateNode(parser->arena, AST_DROP_TABLE, NULL);
 
     /* Consume keyword 'TABLE' after 'DROP' */
     if (!parserConsume(parser, TABLE_KW))
-        goto cleanup;
+        return NULL;
 
     /* Parse table name 'DROP TABLE <table_name>;' */
     struct ast_node_t *table_name = parseIndentifier(parser);
     if (!table_name)
-        goto cleanup;
-    astAddChild(drop_node, table_name);
+        return NULL;
+    astAddChild(parser->arena, drop_node, table_name);
 
     return drop_node;
+}
 
-cleanup:
-    astFreeNode(drop_node);
-    return NULL;
+/* ALTER TABLE
+ * ===========
+ * Adds or drops a single column or RANGE partition:
+ *      ALTER TABLE tb_name ADD [COLUMN] col_name type [DEFAULT value];
+ *      ALTER TABLE tb_name DROP [COLUMN] col_name;
+ *      ALTER TABLE tb_name ADD PARTITION (PARTITION p VALUES LESS THAN (n));
+ *      ALTER TABLE tb_name DROP PARTITION p;
+ *
+ * the default value is an expression without columns, it is the value
+ * of the new column in the rows already stored */
+struct ast_node_t *parseAlterTable(struct parser_t *parser) {
+    struct ast_node_t *alter_node =
+        astCreateNode(parser->arena, AST_ALTER_TABLE, NULL);
+
+    /* Keyword 'ALTER' is already consumed by caller */
+    if (!parserConsume(parser, TABLE_KW))
+        return NULL;
+
+    struct ast_node_t *table_name = parseIndentifier(parser);
+    if (!table_name)
+        return NULL;
+    astAddChild(parser->arena, alter_node, table_name);
+
+    struct ast_node_t *action;
+    if (lexIsToken(parser->lexer, ADD_KW)) {
+        lexNextToken(parser->lexer);
+        if (parserWord(parser, "PARTITION")) {
+            action = astCreateNode(parser->arena, AST_ADD_PARTITION, NULL);
+            if (!parserConsume(parser, RSQL_LPAREN))
+                return NULL;
+            struct ast_node_t *partition = parsePartition(parser);
+            if (!partition || !parserConsume(parser, RSQL_RPAREN))
+                return NULL;
+            astAddChild(parser->arena, action, partition);
+            astAddChild(parser->arena, alter_node, action);
+            return alter_node;
+        }
+        if (lexIsToken(parser->lexer, COLUMN_KW))
+            lexNextToken(parser->lexer);
+
+        action = astCreateNode(parser->arena, AST_ADD_COLUMN, NULL);
+        struct ast_node_t *col_def = parseColumnDef(parser);
+        if (!col_def)
+            return NULL;
+        astAddChild(parser->arena, action, col_def);
+
+        if (lexIsToken(parser->lexer, DEFAULT_KW)) {
+            lexNextToken(parser->lexer);
+            struct ast_node_t *value = parseExpression(parser);
+            if (!value)
+                return NULL;
+            astAddChild(parser->arena, action, value);
+        }
+    } else if (lexIsToken(parser->lexer, DROP_KW)) {
+        lexNextToken(parser->lexer);
+        if (parserWord(parser, "PARTITION")) {
+            action = astCreateNode(parser->arena, AST_DROP_PARTITION, NULL);
+        } else {
+            if (lexIsToken(parser->lexer, COLUMN_KW))
+                lexNextToken(parser->lexer);
+            action = astCreateNode(parser->arena, AST_DROP_COLUMN, NULL);
+        }
+
+        struct ast_node_t *name = parseIndentifier(parser);
+        if (!name)
+            return NULL;
+        astAddChild(parser->arena, action, name);
+    } else {
+        parserError(parser, "Expected ADD or DROP");
+        return NULL;
+    }
+
+    astAddChild(parser->arena, alter_node, action);
+    return alter_node;
 }
 
 /* Select statement
@@ -324,81 +843,79 @@ cleanup:
  *  WHERE: Keyword that imposes a condition
  *  CONDITION: an expression */
 struct ast_node_t *parseSelect(struct parser_t *parser) {
-    struct ast_node_t *select_node = astCreateNode(AST_SELECT, NULL);
+    struct ast_node_t *select_node =
+        astCreateNode(parser->arena, AST_SELECT, NULL);
 
     /* Keyword 'SELECT' is already consumed by caller so
      * we need to start with column list or wildcard * */
     if (lexIsToken(parser->lexer, RSQL_MUL_OP)) {
         /* in case of wildcard 'SELECT *' */
-        struct ast_node_t *all_cols = astCreateNode(AST_LITERAL, "*");
-        astAddChild(select_node, all_cols);
+        struct ast_node_t *all_cols =
+            astCreateNode(parser->arena, AST_LITERAL, "*");
+        astAddChild(parser->arena, select_node, all_cols);
         lexNextToken(parser->lexer);
     } else {
         /* in case 'SELECT column1, column2' parse the first column */
         struct ast_node_t *col = parseIndentifier(parser);
         if (!col)
-            goto cleanup;
-        astAddChild(select_node, col);
+            return NULL;
+        astAddChild(parser->arena, select_node, col);
 
         /* parse the additional columns */
         while (lexIsToken(parser->lexer, RSQL_COMMA)) {
             lexNextToken(parser->lexer); /* Consume comma ',' */
             col = parseIndentifier(parser);
             if (!col)
-                goto cleanup;
-            astAddChild(select_node, col);
+                return NULL;
+            astAddChild(parser->arena, select_node, col);
         }
     }
 
     /* parse the clause FROM (required) */
     if (!parserConsume(parser, FROM_KW))
-        goto cleanup;
+        return NULL;
 
     /* parse table or view name  */
     struct ast_node_t *table_name = parseIndentifier(parser);
     if (!table_name)
-        goto cleanup;
-    astAddChild(select_node, table_name);
+        return NULL;
+    astAddChild(parser->arena, select_node, table_name);
 
     /* parse the clause WHERE (optional) */
     struct ast_node_t *where_clause = parseWhereClause(parser);
     if (where_clause)
-        astAddChild(select_node, where_clause);
+        astAddChild(parser->arena, select_node, where_clause);
+    else if (parser->has_error)
+        return NULL;
 
     return select_node;
-cleanup:
-    astFreeNode(select_node);
-    return NULL;
 }
 
 /* Parse a list of literals (e.g. ('Marco', 24)) */
 static struct ast_node_t *parseValueList(struct parser_t *parser) {
-    struct ast_node_t *value_list = astCreateNode(AST_VALUE_LIST, NULL);
+    struct ast_node_t *value_list =
+        astCreateNode(parser->arena, AST_VALUE_LIST, NULL);
 
     if (!parserConsume(parser, RSQL_LPAREN))
-        goto cleanup;
+        return NULL;
 
     struct ast_node_t *value = parseExpression(parser);
     if (!value)
-        goto cleanup;
-    astAddChild(value_list, value);
+        return NULL;
+    astAddChild(parser->arena, value_list, value);
 
     while (lexIsToken(parser->lexer, RSQL_COMMA)) {
         lexNextToken(parser->lexer);
         value = parseExpression(parser);
         if (!value)
-            goto cleanup;
-        astAddChild(value_list, value);
+            return NULL;
+        astAddChild(parser->arena, value_list, value);
     }
 
     if (!parserConsume(parser, RSQL_RPAREN))
-        goto cleanup;
+        return NULL;
 
     return value_list;
-
-cleanup:
-    astFreeNode(value_list);
-    return NULL;
 }
 
 /* INSERT
@@ -413,48 +930,310 @@ cleanup:
         ("Parmalat S.p.A.","Via Traverso 15 Parma","3409988776");
  */
 struct ast_node_t *parseInsert(struct parser_t *parser) {
-    struct ast_node_t *insert_node = astCreateNode(AST_INSERT, NULL);
+    struct ast_node_t *insert_node =
+        astCreateNode(parser->arena, AST_INSERT, NULL);
 
     /* consume 'INTO' */
     if (!parserConsume(parser, INTO_KW))
-        goto cleanup;
+        return NULL;
 
     /* parse table name */
     struct ast_node_t *table_name = parseIndentifier(parser);
     if (!table_name)
-        goto cleanup;
-    astAddChild(insert_node, table_name);
+        return NULL;
+    astAddChild(parser->arena, insert_node, table_name);
 
     /* parse column list */
     struct ast_node_t *columns = parseColumnList(parser);
     if (!columns)
-        goto cleanup;
-    astAddChild(insert_node, columns);
+        return NULL;
+    astAddChild(parser->arena, insert_node, columns);
 
     /* consume VALUES keyword */
     if (!parserConsume(parser, VALUES_KW))
-        goto cleanup;
+        return NULL;
 
     /* parse first value list */
     struct ast_node_t *value_list = parseValueList(parser);
     if (!value_list)
-        goto cleanup;
-    astAddChild(insert_node, value_list);
+        return NULL;
+    astAddChild(parser->arena, insert_node, value_list);
 
     /* optionally parse more value lists (bulk insert) */
     while (lexIsToken(parser->lexer, RSQL_COMMA)) {
         lexNextToken(parser->lexer);
         value_list = parseValueList(parser);
         if (!value_list)
-            goto cleanup;
-        astAddChild(insert_node, value_list);
+            return NULL;
+        astAddChild(parser->arena, insert_node, value_list);
     }
 
     return insert_node;
+}
+
+/* UPDATE
+ * ======
+ * Changes the columns of the rows matching the optional condition:
+ *      UPDATE tb_name SET age = age + 1, city = 'Parma' WHERE id = 5;
+ *
+ * the children are the table name, one assignment per column and the
+ * WHERE clause when there is one */
+struct ast_node_t *parseUpdate(struct parser_t *parser) {
+    struct ast_node_t *update_node =
+        astCreateNode(parser->arena, AST_UPDATE, NULL);
+
+    /* Keyword 'UPDATE' is already consumed by caller */
+    struct ast_node_t *table_name = parseIndentifier(parser);
+    if (!table_name)
+        return NULL;
+    astAddChild(parser->arena, update_node, table_name);
+
+    if (!parserConsume(parser, SET_KW))
+        return NULL;
+
+    do {
+        if (update_node->child_count > 1)
+            lexNextToken(parser->lexer); /* consume comma ',' */
+
+        struct ast_node_t *assignment =
+            astCreateNode(parser->arena, AST_ASSIGNMENT, NULL);
+        struct ast_node_t *column = parseIndentifier(parser);
+        if (!column || !parserConsume(parser, RSQL_ET_OP))
+            return NULL;
 
-cleanup:
-    astFreeNode(insert_node);
-    return NULL;
+        struct ast_node_t *value = parseExpression(parser);
+        if (!value)
+            return NULL;
+        astAddChild(parser->arena, assignment, column);
+        astAddChild(parser->arena, assignment, value);
+        astAddChild(parser->arena, update_node, assignment);
+    } while (lexIsToken(parser->lexer, RSQL_COMMA));
+
+    struct ast_node_t *where_clause = parseWhereClause(parser);
+    if (where_clause)
+        astAddChild(parser->arena, update_node, where_clause);
+    else if (parser->has_error)
+        return NULL;
+
+    return update_node;
+}
+
+/* DELETE
+ * ======
+ * Removes the rows matching the optional condition (all of them without
+ * one):
+ *      DELETE FROM tb_name WHERE age < 18; */
+struct ast_node_t *parseDelete(struct parser_t *parser) {
+    struct ast_node_t *delete_node =
+        astCreateNode(parser->arena, AST_DELETE, NULL);
+
+    /* Keyword 'DELETE' is already consumed by caller */
+    if (!parserConsume(parser, FROM_KW))
+        return NULL;
+
+    struct ast_node_t *table_name = parseIndentifier(parser);
+    if (!table_name)
+        return NULL;
+    astAddChild(parser->arena, delete_node, table_name);
+
+    struct ast_node_t *where_clause = parseWhereClause(parser);
+    if (where_clause)
+        astAddChild(parser->arena, delete_node, where_clause);
+    else if (parser->has_error)
+        return NULL;
+
+    return delete_node;
+}
+
+/* ANALYZE
+ * =======
+ * Gathers the statistics used by the planner (see stats.h):
+ *      ANALYZE TABLE tb_name; */
+struct ast_node_t *parseAnalyzeTable(struct parser_t *parser) {
+    struct ast_node_t *analyze_node =
+        astCreateNode(parser->arena, AST_ANALYZE_TABLE, NULL);
+
+    /* Keyword 'ANALYZE' is already consumed by caller */
+    if (!parserConsume(parser, TABLE_KW))
+        return NULL;
+
+    struct ast_node_t *table_name = parseIndentifier(parser);
+    if (!table_name)
+        return NULL;
+    astAddChild(parser->arena, analyze_node, table_name);
+
+    return analyze_node;
+}
+
+/* Select the default database 'USE db_name;' */
+struct ast_node_t *parseUseDatabase(struct parser_t *parser) {
+    struct ast_node_t *use_node =
+        astCreateNode(parser->arena, AST_USE_DATABASE, NULL);
+
+    struct ast_node_t *db_name = parseIndentifier(parser);
+    if (!db_name)
+        return NULL;
+    astAddChild(parser->arena, use_node, db_name);
+
+    return use_node;
+}
+
+/* Prepared statements
+ * ===================
+ *      PREPARE stmt_name FROM 'SELECT * FROM users WHERE id > ?';
+ *      EXECUTE stmt_name USING 10;
+ *      DEALLOCATE PREPARE stmt_name;
+ * The statement text is a string literal, its '?' placeholders are
+ * bound in order by the values after USING */
+struct ast_node_t *parsePrepare(struct parser_t *parser) {
+    struct ast_node_t *prepare_node =
+        astCreateNode(parser->arena, AST_PREPARE, NULL);
+
+    struct ast_node_t *name = parseIndentifier(parser);
+    if (!name)
+        return NULL;
+    astAddChild(parser->arena, prepare_node, name);
+
+    if (!parserConsume(parser, FROM_KW))
+        return NULL;
+
+    struct ast_node_t *text = parseExpression(parser);
+    if (!text)
+        return NULL;
+    astAddChild(parser->arena, prepare_node, text);
+
+    return prepare_node;
+}
+
+struct ast_node_t *parseExecute(struct parser_t *parser) {
+    struct ast_node_t *execute_node =
+        astCreateNode(parser->arena, AST_EXECUTE, NULL);
+
+    struct ast_node_t *name = parseIndentifier(parser);
+    if (!name)
+        return NULL;
+    astAddChild(parser->arena, execute_node, name);
+
+    /* 'USING v1, v2, ...' is optional */
+    if (!lexIsToken(parser->lexer, USING_KW))
+        return execute_node;
+
+    do {
+        lexNextToken(parser->lexer); /* consume USING or ',' */
+        struct ast_node_t *value = parseExpression(parser);
+        if (!value)
+            return NULL;
+        astAddChild(parser->arena, execute_node, value);
+    } while (lexIsToken(parser->lexer, RSQL_COMMA));
+
+    return execute_node;
+}
+
+struct ast_node_t *parseDeallocate(struct parser_t *parser) {
+    struct ast_node_t *dealloc_node =
+        astCreateNode(parser->arena, AST_DEALLOCATE, NULL);
+
+    if (!parserConsume(parser, PREPARE_KW))
+        return NULL;
+
+    struct ast_node_t *name = parseIndentifier(parser);
+    if (!name)
+        return NULL;
+    astAddChild(parser->arena, dealloc_node, name);
+
+    return dealloc_node;
+}
+
+/* EXPLAIN
+ * =======
+ * Shows the plan chosen for a statement, ANALYZE also runs it and
+ * reports the rows and the time of each operator and stage:
+ *      EXPLAIN [ANALYZE] SELECT * FROM users WHERE id > 10; */
+struct ast_node_t *parseExplain(struct parser_t *parser) {
+    /* Keyword 'EXPLAIN' is already consumed by caller */
+    int analyze = lexIsToken(parser->lexer, ANALYZE_KW);
+    if (analyze)
+        lexNextToken(parser->lexer);
+
+    struct ast_node_t *explain_node = astCreateNode(
+        parser->arena, AST_EXPLAIN, analyze ? "ANALYZE" : NULL);
+
+    int type = lexGetTokenType(parser->lexer);
+    if (type != SELECT_KW && type != INSERT_KW && type != UPDATE_KW &&
+        type != DELETE_KW) {
+        parserError(parser, "EXPLAIN expects SELECT, INSERT, UPDATE or DELETE");
+        return NULL;
+    }
+
+    struct ast_node_t *statement = parseStatement(parser);
+    if (!statement)
+        return NULL;
+    astAddChild(parser->arena, explain_node, statement);
+
+    return explain_node;
+}
+
+/* SHOW
+ * ====
+ *      SHOW STATUS [INTO 'metrics.prom'];
+ *      SHOW TABLE STATUS;
+ * STATUS is not a reserved word */
+struct ast_node_t *parseShow(struct parser_t *parser) {
+    /* Keyword 'SHOW' is already consumed by caller */
+    int table = lexIsToken(parser->lexer, TABLE_KW);
+    if (table)
+        lexNextToken(parser->lexer);
+
+    if (!parserWord(parser, "STATUS")) {
+        parserError(parser, "Expected STATUS");
+        return NULL;
+    }
+    if (table)
+        return astCreateNode(parser->arena, AST_SHOW_TABLE_STATUS, NULL);
+
+    struct ast_node_t *show_node =
+        astCreateNode(parser->arena, AST_SHOW_STATUS, NULL);
+    if (!lexIsToken(parser->lexer, INTO_KW))
+        return show_node;
+    lexNextToken(parser->lexer);
+
+    struct ast_node_t *file = parseExpression(parser);
+    if (!file)
+        return NULL;
+    astAddChild(parser->arena, show_node, file);
+
+    return show_node;
+}
+
+/* Snapshots
+ * =========
+ *      CREATE SNAPSHOT snap_name;
+ *      BACKUP SNAPSHOT snap_name INTO 'backup.sql';
+ *      DROP SNAPSHOT snap_name;
+ * SNAPSHOT and BACKUP are not reserved words */
+struct ast_node_t *parseSnapshot(struct parser_t *parser,
+                                 enum ast_node_type_t type) {
+    /* Words up to 'SNAPSHOT' are already consumed by caller */
+    struct ast_node_t *snapshot_node =
+        astCreateNode(parser->arena, type, NULL);
+
+    struct ast_node_t *name = parseIndentifier(parser);
+    if (!name)
+        return NULL;
+    astAddChild(parser->arena, snapshot_node, name);
+
+    if (type != AST_BACKUP_SNAPSHOT)
+        return snapshot_node;
+
+    if (!parserConsume(parser, INTO_KW))
+        return NULL;
+
+    struct ast_node_t *file = parseExpression(parser);
+    if (!file)
+        return NULL;
+    astAddChild(parser->arena, snapshot_node, file);
+
+    return snapshot_node;
 }
 
 /* Parse a full SQL statement */
@@ -469,12 +1248,21 @@ struct ast_node_t *parseStatement(struct parser_t *parser) {
 
         return current_tok == DATABASE_KW ? parseCreateDatabase(parser)
                : current_tok == TABLE_KW  ? parseCreateTable(parser)
-                                          : NULL;
+               : current_tok == INDEX_KW  ? parseCreateIndex(parser)
+               : parserWord(parser, "SNAPSHOT")
+                   ? parseSnapshot(parser, AST_CREATE_SNAPSHOT)
+                   : NULL;
 
     case DROP_KW:
         lexNextToken(parser->lexer);
+        if (parserWord(parser, "SNAPSHOT"))
+            return parseSnapshot(parser, AST_DROP_SNAPSHOT);
         return parseDropTable(parser);
 
+    case ALTER_KW:
+        lexNextToken(parser->lexer);
+        return parseAlterTable(parser);
+
     case SELECT_KW:
         lexNextToken(parser->lexer);
         return parseSelect(parser);
@@ -483,31 +1271,73 @@ struct ast_node_t *parseStatement(struct parser_t *parser) {
         lexNextToken(parser->lexer);
         return parseInsert(parser);
 
+    case UPDATE_KW:
+        lexNextToken(parser->lexer);
+        return parseUpdate(parser);
+
+    case DELETE_KW:
+        lexNextToken(parser->lexer);
+        return parseDelete(parser);
+
+    case ANALYZE_KW:
+        lexNextToken(parser->lexer);
+        return parseAnalyzeTable(parser);
+
+    case USE_KW:
+        lexNextToken(parser->lexer);
+        return parseUseDatabase(parser);
+
+    case PREPARE_KW:
+        lexNextToken(parser->lexer);
+        return parsePrepare(parser);
+
+    case EXECUTE_KW:
+        lexNextToken(parser->lexer);
+        return parseExecute(parser);
+
+    case DEALLOCATE_KW:
+        lexNextToken(parser->lexer);
+        return parseDeallocate(parser);
+
+    case EXPLAIN_KW:
+        lexNextToken(parser->lexer);
+        return parseExplain(parser);
+
+    case SHOW_KW:
+        lexNextToken(parser->lexer);
+        return parseShow(parser);
+
+    case RSQL_IDENTIFIER:
+        if (parserWord(parser, "BACKUP")) {
+            if (!parserWord(parser, "SNAPSHOT")) {
+                parserError(parser, "Expected SNAPSHOT");
+                return NULL;
+            }
+            return parseSnapshot(parser, AST_BACKUP_SNAPSHOT);
+        }
+        /* fall through */
     default:
         parserError(parser, "Unexpected token");
         return parseSelect(parser);
     }
 }
 
-/* Create a new parser instance */
-struct parser_t *parserCreate(struct lexer_t *lexer) {
-    struct parser_t *parser = malloc(sizeof(struct parser_t));
+/* Create a new parser instance, the parser and every node it produces
+ * are allocated in 'arena' and released when the arena is reset */
+struct parser_t *parserCreate(struct lexer_t *lexer, struct arena_t *arena) {
+    struct parser_t *parser = arenaAlloc(arena, sizeof(struct parser_t));
     if (!parser)
         return NULL;
 
     parser->lexer = lexer;
+    parser->arena = arena;
     parser->has_error = 0;
     parser->error_message[0] = '\0';
+    parser->param_count = 0;
 
     return parser;
 }
 
-/* Release parser memory */
-void parserFree(struct parser_t *parser) {
-    if (parser)
-        free(parser);
-}
-
 /* Main function that gets the first token, parse the statement and
  * check if at the end a semicolon in present */
 struct ast_node_t *parserParse(struct parser_t *parser) {
@@ -517,10 +1347,8 @@ struct ast_node_t *parserParse(struct parser_t *parser) {
 
     if (root && !lexIsEOF(parser->lexer)) {
         /* Semicolon verification at the end of file */
-        if (!parserConsume(parser, RSQL_SEMICOLON)) {
-            astFreeNode(root);
+        if (!parserConsume(parser, RSQL_SEMICOLON))
             return NULL;
-        }
     }
 
     return root;
@@ -541,18 +1369,78 @@ void astPrintNode(struct ast_node_t *node, int indent) {
     case AST_CREATE_TABLE:
         printf("CREATE TABLE\n");
         break;
+    case AST_CREATE_INDEX:
+        printf("CREATE INDEX\n");
+        break;
     case AST_CREATE_DATABASE:
         printf("CRATE DATABASE\n");
         break;
     case AST_DROP_TABLE:
         printf("DROP TABLE\n");
         break;
+    case AST_ALTER_TABLE:
+        printf("ALTER TABLE\n");
+        break;
+    case AST_ADD_COLUMN:
+        printf("ADD COLUMN\n");
+        break;
+    case AST_DROP_COLUMN:
+        printf("DROP COLUMN\n");
+        break;
+    case AST_ADD_PARTITION:
+        printf("ADD PARTITION\n");
+        break;
+    case AST_DROP_PARTITION:
+        printf("DROP PARTITION\n");
+        break;
     case AST_SELECT:
         printf("SELECT\n");
         break;
     case AST_INSERT:
         printf("INSERT\n");
         break;
+    case AST_UPDATE:
+        printf("UPDATE\n");
+        break;
+    case AST_DELETE:
+        printf("DELETE\n");
+        break;
+    case AST_ASSIGNMENT:
+        printf("SET\n");
+        break;
+    case AST_ANALYZE_TABLE:
+        printf("ANALYZE TABLE\n");
+        break;
+    case AST_USE_DATABASE:
+        printf("USE\n");
+        break;
+    case AST_PREPARE:
+        printf("PREPARE\n");
+        break;
+    case AST_EXECUTE:
+        printf("EXECUTE\n");
+        break;
+    case AST_DEALLOCATE:
+        printf("DEALLOCATE PREPARE\n");
+        break;
+    case AST_EXPLAIN:
+        printf("EXPLAIN%s\n", node->value ? " ANALYZE" : "");
+        break;
+    case AST_SHOW_STATUS:
+        printf("SHOW STATUS\n");
+        break;
+    case AST_SHOW_TABLE_STATUS:
+        printf("SHOW TABLE STATUS\n");
+        break;
+    case AST_CREATE_SNAPSHOT:
+        printf("CREATE SNAPSHOT\n");
+        break;
+    case AST_DROP_SNAPSHOT:
+        printf("DROP SNAPSHOT\n");
+        break;
+    case AST_BACKUP_SNAPSHOT:
+        printf("BACKUP SNAPSHOT\n");
+        break;
     case AST_VALUE_LIST:
         printf("VALUE LIST\n");
         break;
@@ -565,12 +1453,44 @@ void astPrintNode(struct ast_node_t *node, int indent) {
     case AST_COLUMN_DEF:
         printf("COLUMN DEF\n");
         break;
+    case AST_ROW_FORMAT:
+        printf("ROW FORMAT\n");
+        break;
+    case AST_CAPPED:
+        printf("CAPPED %s\n", node->value);
+        break;
+    case AST_PARTITION_BY:
+        printf("PARTITION BY %s\n", node->value);
+        break;
+    case AST_PARTITION:
+        printf("PARTITION\n");
+        break;
     case AST_WHERE_CLAUSE:
         printf("WHERE CLAUSE\n");
         break;
     case AST_LITERAL:
         printf("LITERAL: %s\n", node->value ? node->value : "NULL");
         break;
+    case AST_PARAM:
+        printf("PARAM: %s\n", node->value ? node->value : "NULL");
+        break;
+    case AST_BINARY_OP:
+    case AST_UNARY_OP:
+        printf("OPERATOR: %s\n", node->value ? node->value : "NULL");
+        break;
+    case AST_BETWEEN:
+        printf("BETWEEN\n");
+        break;
+    case AST_IN_LIST:
+    case AST_IN_SUBQUERY:
+        printf("IN\n");
+        break;
+    case AST_LIKE:
+        printf("LIKE\n");
+        break;
+    case AST_IS_NULL:
+        printf("IS NULL\n");
+        break;
     default:
         printf("UNKNOWN NODE\n");
         break;
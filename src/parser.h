@@ -3,23 +3,54 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 /* AST Node Types */
 enum ast_node_type_t {
     AST_STATEMENT,
     AST_CREATE_DATABASE,
     AST_CREATE_TABLE,
+    AST_CREATE_INDEX,
     AST_DROP_TABLE,
+    AST_ALTER_TABLE,    /* children: table, one of the actions below */
+    AST_ADD_COLUMN,     /* children: column definition, default value */
+    AST_DROP_COLUMN,    /* children: column */
+    AST_ADD_PARTITION,  /* children: AST_PARTITION */
+    AST_DROP_PARTITION, /* children: partition name */
     AST_SELECT,
     AST_INSERT,
     AST_UPDATE,
     AST_DELETE,
+    AST_ANALYZE_TABLE,
+    AST_USE_DATABASE,
+    AST_PREPARE,
+    AST_EXECUTE,
+    AST_DEALLOCATE,
+    AST_EXPLAIN, /* value: "ANALYZE" or NULL, children: statement */
+    AST_SHOW_STATUS, /* children: file name when INTO is given */
+    AST_SHOW_TABLE_STATUS,
+    AST_CREATE_SNAPSHOT, /* children: snapshot */
+    AST_DROP_SNAPSHOT,   /* children: snapshot */
+    AST_BACKUP_SNAPSHOT, /* children: snapshot, file name */
     AST_IDENTIFIER,
     AST_COLUMN_LIST,
-    AST_COLUMN_DEF,
+    AST_COLUMN_DEF, /* children: name, type, default value */
+    AST_ROW_FORMAT,   /* children: format name */
+    AST_CAPPED,       /* value: "ROWS" or "BYTES", children: limit */
+    AST_PARTITION_BY, /* value: method, children: column, partitions... */
+    AST_PARTITION,    /* children: name, bound (none for MAXVALUE) */
     AST_WHERE_CLAUSE,
     AST_EXPRESSION,
-    AST_BINARY_OP,
+    AST_BINARY_OP,   /* children: left, right */
+    AST_UNARY_OP,    /* NOT or '-', children: operand */
+    AST_BETWEEN,     /* children: expr, low, high */
+    AST_IN_LIST,     /* children: expr, value... */
+    AST_IN_SUBQUERY, /* children: expr, select */
+    AST_LIKE,        /* children: expr, pattern */
+    AST_IS_NULL,     /* children: expr */
+    AST_ASSIGNMENT,  /* SET column = value, children: column, value */
     AST_LITERAL,
+    AST_PARAM,
     AST_TABLE_REF,
     AST_VALUE_LIST,
     AST_OPERATOR,
@@ -37,6 +68,10 @@ struct ast_node_t {
      * rapresented in string */
     char *value;
 
+    /* Token type of the operator for expression nodes (AND_KW,
+     * RSQL_ET_OP...) and of the literal for AST_LITERAL, 0 otherwise */
+    int op;
+
     /* Children are all the nodes after the triggered value
      * for example if we get "CREATE TABLE tb_name;":
      * CREATE TABLE                 (root node)
@@ -52,11 +87,19 @@ struct ast_node_t {
 
 struct parser_t {
     struct lexer_t *lexer;
+    struct arena_t *arena; /* owns the parser and the AST */
     int has_error;
     char error_message[256];
+
+    /* Number of '?' placeholders seen so far, each AST_PARAM node
+     * stores its own ordinal as value */
+    size_t param_count;
 };
 
-void astFreeNode(struct ast_node_t *node);
+struct ast_node_t *astCreateNode(struct arena_t *arena,
+                                 enum ast_node_type_t type, const char *value);
+void astAddChild(struct arena_t *arena, struct ast_node_t *restrict parent,
+                 struct ast_node_t *restrict child);
 
 struct ast_node_t *parseStatement(struct parser_t *parser);
 struct ast_node_t *parseIndentifier(struct parser_t *parser);
@@ -65,13 +108,24 @@ struct ast_node_t *parseColumnDef(struct parser_t *parser);
 struct ast_node_t *parseExpression(struct parser_t *parser);
 struct ast_node_t *parseIndentifier(struct parser_t *parser);
 struct ast_node_t *parseCreateTable(struct parser_t *parser);
+struct ast_node_t *parseCreateIndex(struct parser_t *parser);
 struct ast_node_t *parseDropTable(struct parser_t *parser);
 struct ast_node_t *parseSelect(struct parser_t *parser);
 struct ast_node_t *parseWhereClause(struct parser_t *parser);
 struct ast_node_t *parseInsert(struct parser_t *parser);
+struct ast_node_t *parseUpdate(struct parser_t *parser);
+struct ast_node_t *parseDelete(struct parser_t *parser);
+struct ast_node_t *parseAnalyzeTable(struct parser_t *parser);
+struct ast_node_t *parseUseDatabase(struct parser_t *parser);
+struct ast_node_t *parsePrepare(struct parser_t *parser);
+struct ast_node_t *parseExecute(struct parser_t *parser);
+struct ast_node_t *parseDeallocate(struct parser_t *parser);
+struct ast_node_t *parseExplain(struct parser_t *parser);
+struct ast_node_t *parseShow(struct parser_t *parser);
+struct ast_node_t *parseSnapshot(struct parser_t *parser,
+                                 enum ast_node_type_t type);
 
-struct parser_t *parserCreate(struct lexer_t *lexer);
-void parserFree(struct parser_t *parser);
+struct parser_t *parserCreate(struct lexer_t *lexer, struct arena_t *arena);
 struct ast_node_t *parserParse(struct parser_t *parser);
 const char *parserGetError(struct parser_t *parser);
 void astPrintNode(struct ast_node_t *node, int indent);
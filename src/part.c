@@ -0,0 +1,360 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "part.h"
+#include "expr.h"
+#include "lex.h"
+#include "logs.h"
+#include "plan.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+int partCreate(struct table_t *table, int method, int column) {
+    if (column < 0 || (size_t)column >= table->column_count ||
+        table->columns[column]->type != DB_TYPE_INT) {
+        LOG_ERROR("The partitioning column of '%s' must be an INT",
+                  table->name);
+        return 0;
+    }
+
+    struct part_t *part = calloc(1, sizeof(struct part_t));
+    if (!part) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+
+    part->method = method;
+    part->column = column;
+    table->partitioning = part;
+    dbCatalogChanged();
+    return 1;
+}
+
+static int partFind(const struct part_t *part, const char *name) {
+    for (size_t i = 0; i < part->count; i++) {
+        if (strcmp(part->tables[i]->name, name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+struct table_t *partAdd(struct table_t *table, const char *name,
+                        int64_t bound) {
+    struct part_t *part = table->partitioning;
+
+    if (part->count >= PART_MAX) {
+        LOG_ERROR("Table '%s' can't have more than %d partitions",
+                  table->name, PART_MAX);
+        return NULL;
+    }
+    if (partFind(part, name) >= 0) {
+        LOG_ERROR("Duplicate partition name '%s'", name);
+        return NULL;
+    }
+    if (part->method == PART_RANGE && part->count &&
+        bound <= part->bounds[part->count - 1]) {
+        LOG_ERROR("VALUES LESS THAN of partition '%s' must be above the "
+                  "bound of the previous partition",
+                  name);
+        return NULL;
+    }
+
+    struct table_t *partition = dbTableClone(table, name);
+    if (!partition) {
+        LOG_ERROR("Out of memory");
+        return NULL;
+    }
+
+    part->bounds[part->count] = bound;
+    part->tables[part->count++] = partition;
+    dbCatalogChanged();
+    return partition;
+}
+
+/* The rows of the partition are released with it, nothing else is read.
+ * Values it held are taken by the next partition from now on */
+int partDrop(struct table_t *table, const char *name) {
+    struct part_t *part = table->partitioning;
+    int idx = partFind(part, name);
+
+    if (idx < 0) {
+        LOG_ERROR("Unknown partition '%s' in table '%s'", name, table->name);
+        return 0;
+    }
+    if (part->method != PART_RANGE) {
+        LOG_ERROR("DROP PARTITION can only be used on RANGE partitions");
+        return 0;
+    }
+    if (part->count == 1) {
+        LOG_ERROR("Can't drop the only partition of '%s', use DROP TABLE",
+                  table->name);
+        return 0;
+    }
+    if (part->tables[idx]->frozen) {
+        LOG_ERROR("Partition '%s' is held by a snapshot", name);
+        return 0;
+    }
+
+    dbTableFree(part->tables[idx]);
+    for (size_t i = (size_t)idx; i + 1 < part->count; i++) {
+        part->tables[i] = part->tables[i + 1];
+        part->bounds[i] = part->bounds[i + 1];
+    }
+    part->tables[--part->count] = NULL;
+    dbCatalogChanged();
+    return 1;
+}
+
+void partRelease(struct table_t *table) {
+    struct part_t *part = table->partitioning;
+    if (!part)
+        return;
+
+    for (size_t i = 0; i < part->count; i++)
+        dbTableFree(part->tables[i]);
+    free(part);
+    table->partitioning = NULL;
+}
+
+static size_t partHash(const struct part_t *part, int64_t value) {
+    int64_t count = (int64_t)part->count;
+    return (size_t)((value % count + count) % count);
+}
+
+struct table_t *partRoute(const struct table_t *table, int value) {
+    const struct part_t *part = table->partitioning;
+
+    if (part->method == PART_HASH)
+        return part->tables[partHash(part, value)];
+
+    /* First partition whose bound is above the value */
+    size_t low = 0, high = part->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (part->bounds[mid] > value)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low < part->count ? part->tables[low] : NULL;
+}
+
+/* Operand that does not read the row: constants, parameters and
+ * arithmetic on them */
+static int partConstant(const struct expr_t *expr) {
+    if (expr->kind == EXPR_CONST || expr->kind == EXPR_PARAM)
+        return 1;
+    if (expr->kind != EXPR_NEG && expr->kind != EXPR_ARITH)
+        return 0;
+
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        if (!partConstant(expr->args[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Value of the operand 'expr' compared with the partitioning column */
+static int partValue(const struct plan_t *plan, const struct expr_t *expr,
+                     int64_t *out) {
+    const struct column_t *col =
+        plan->table->columns[plan->table->partitioning->column];
+    struct expr_value_t value;
+    union cell_value_t cell;
+
+    if (!partConstant(expr))
+        return 0;
+
+    exprEval(expr, NULL, plan->bound, &value);
+    if (!exprToCell(&value, col, &cell))
+        return 0;
+    *out = cell.i;
+    return 1;
+}
+
+static int partIsColumn(const struct plan_t *plan, const struct expr_t *expr) {
+    return expr->kind == EXPR_COLUMN &&
+           expr->column == plan->table->partitioning->column;
+}
+
+/* Narrows [low, high] to the values of the partitioning column 'cond'
+ * lets through, conditions on other columns leave it as is */
+static void partRestrict(const struct plan_t *plan, const struct expr_t *cond,
+                         int64_t *low, int64_t *high) {
+    int64_t a, b;
+
+    if (cond->kind == EXPR_BETWEEN && partIsColumn(plan, cond->args[0]) &&
+        partValue(plan, cond->args[1], &a) &&
+        partValue(plan, cond->args[2], &b)) {
+        *low = a > *low ? a : *low;
+        *high = b < *high ? b : *high;
+        return;
+    }
+
+    /* IN list, the range between the smallest and largest candidate */
+    if (cond->kind == EXPR_IN && !(cond->in && cond->in->table) &&
+        partIsColumn(plan, cond->args[0]) && cond->arg_count > 1) {
+        int64_t min = INT64_MAX, max = INT64_MIN;
+        for (size_t i = 1; i < cond->arg_count; i++) {
+            if (!partValue(plan, cond->args[i], &a))
+                return;
+            min = a < min ? a : min;
+            max = a > max ? a : max;
+        }
+        *low = min > *low ? min : *low;
+        *high = max < *high ? max : *high;
+        return;
+    }
+
+    if (cond->kind != EXPR_COMPARE)
+        return;
+
+    /* 'value < column' is 'column > value' */
+    const struct expr_t *column = cond->args[0], *operand = cond->args[1];
+    int op = cond->op;
+    if (!partIsColumn(plan, column)) {
+        column = cond->args[1];
+        operand = cond->args[0];
+        op = op == RSQL_LT_OP   ? RSQL_GT_OP
+             : op == RSQL_LE_OP ? RSQL_GE_OP
+             : op == RSQL_GT_OP ? RSQL_LT_OP
+             : op == RSQL_GE_OP ? RSQL_LE_OP
+                                : op;
+    }
+    if (!partIsColumn(plan, column) || !partValue(plan, operand, &a))
+        return;
+
+    if (op == RSQL_ET_OP || op == RSQL_GT_OP || op == RSQL_GE_OP) {
+        b = op == RSQL_GT_OP ? a + 1 : a;
+        *low = b > *low ? b : *low;
+    }
+    if (op == RSQL_ET_OP || op == RSQL_LT_OP || op == RSQL_LE_OP) {
+        b = op == RSQL_LT_OP ? a - 1 : a;
+        *high = b < *high ? b : *high;
+    }
+}
+
+/* Only the top level AND chain of the WHERE condition is looked at: the
+ * range of values it allows for the partitioning column keeps the RANGE
+ * partitions it overlaps, and the HASH partitions of its values when
+ * there are fewer of them than partitions */
+size_t partPrune(const struct plan_t *plan, unsigned char keep[PART_MAX]) {
+    const struct part_t *part = plan->table->partitioning;
+    struct expr_t *conds[PLAN_MAX_CONJUNCTS];
+    int64_t low = INT64_MIN, high = INT64_MAX;
+    size_t kept = 0;
+
+    size_t n = plan->where ? exprConjuncts(plan->where, conds,
+                                           PLAN_MAX_CONJUNCTS)
+                           : 0;
+    for (size_t i = 0; i < n && i < PLAN_MAX_CONJUNCTS; i++)
+        partRestrict(plan, conds[i], &low, &high);
+
+    memset(keep, 0, PART_MAX);
+    if (low > high)
+        return 0;
+
+    if (part->method == PART_HASH &&
+        (uint64_t)high - (uint64_t)low < part->count) {
+        for (int64_t v = low;; v++) {
+            keep[partHash(part, v)] = 1;
+            if (v == high)
+                break;
+        }
+    } else {
+        for (size_t i = 0; i < part->count; i++) {
+            int64_t first = i && part->method == PART_RANGE
+                                ? part->bounds[i - 1]
+                                : INT64_MIN;
+            keep[i] = part->method == PART_HASH ||
+                      (low < part->bounds[i] && high >= first);
+        }
+    }
+
+    for (size_t i = 0; i < part->count; i++)
+        kept += keep[i];
+    return kept;
+}
+
+struct column_t *partColumnCreate(struct table_t *table, const char *name,
+                                  int type,
+                                  const union cell_value_t *default_value) {
+    struct part_t *part = table->partitioning;
+    size_t slot_count = table->slot_count;
+    size_t done = 0;
+
+    struct column_t *col =
+        dbColumnCreate(table, name, type, NULL, default_value);
+    while (col && done < part->count &&
+           dbColumnCreate(part->tables[done], name, type, NULL,
+                          default_value))
+        done++;
+    if (!col || done == part->count)
+        return col;
+
+    /* Undone everywhere, the next column must get the same slot in the
+     * parent and in the partitions */
+    while (done--) {
+        struct table_t *partition = part->tables[done];
+        dbColumnDelete(partition,
+                       partition->columns[partition->column_count - 1]);
+        partition->slot_count = slot_count;
+    }
+    dbColumnDelete(table, col);
+    table->slot_count = slot_count;
+    return NULL;
+}
+
+int partColumnDelete(struct table_t *table, int column) {
+    struct part_t *part = table->partitioning;
+
+    if (column == part->column) {
+        LOG_ERROR("Can't drop the partitioning column '%s'",
+                  table->columns[column]->name);
+        return 0;
+    }
+
+    for (size_t i = 0; i < part->count; i++) {
+        struct table_t *partition = part->tables[i];
+        if (!dbColumnDelete(partition, partition->columns[column]))
+            return 0;
+    }
+    dbColumnDelete(table, table->columns[column]);
+    if (column < part->column)
+        part->column--;
+    return 1;
+}
+
+size_t partRows(const struct table_t *table) {
+    const struct part_t *part = table->partitioning;
+    size_t rows = table->row_count;
+
+    for (size_t i = 0; part && i < part->count; i++)
+        rows += part->tables[i]->row_count;
+    return rows;
+}
+
+size_t partBytes(const struct table_t *table) {
+    const struct part_t *part = table->partitioning;
+    size_t bytes = table->bytes;
+
+    if (part)
+        bytes += malloc_usable_size((void *)part);
+    for (size_t i = 0; part && i < part->count; i++)
+        bytes += part->tables[i]->bytes;
+    return bytes;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Table partitioning. The rows of a table created with 'PARTITION BY' are
+ *  stored in its partitions, each a table of its own built with
+ *  dbTableClone() so that the column definitions of the parent read the
+ *  cells of any partition. The parent keeps the columns and no rows.
+ *
+ *      PARTITION BY RANGE (col) (PARTITION p0 VALUES LESS THAN (100),
+ *                                PARTITION p1 VALUES LESS THAN MAXVALUE)
+ *      PARTITION BY HASH (col) PARTITIONS 4
+ *
+ *  A row goes to the first RANGE partition whose bound is above its value
+ *  or to partition 'value MOD count' with HASH. Statements only scan the
+ *  partitions the WHERE condition may match, see partPrune(), and a RANGE
+ *  partition is dropped without reading the others.
+ */
+#ifndef _PART_H
+#define _PART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "db.h"
+
+struct plan_t; /* see plan.h */
+
+#define PART_RANGE 0x01
+#define PART_HASH 0x02
+
+/* Partitions of a table */
+#define PART_MAX 64
+
+/* Bound of the 'VALUES LESS THAN MAXVALUE' partition */
+#define PART_MAXVALUE INT64_MAX
+
+struct part_t {
+    int method;               /* PART_RANGE or PART_HASH */
+    int column;               /* index of the INT partitioning column */
+    size_t count;
+    int64_t bounds[PART_MAX]; /* RANGE: values below it, in order */
+    struct table_t *tables[PART_MAX];
+};
+
+/* Makes 'table' partitioned by 'column', it has no partition yet. The
+ * table must be empty and the column an INT */
+int partCreate(struct table_t *table, int method, int column);
+
+/* Adds partition 'name' holding the values below 'bound' (RANGE, after
+ * the last partition) or a share of the hash values (HASH, only while
+ * the table is being created) */
+struct table_t *partAdd(struct table_t *table, const char *name,
+                        int64_t bound);
+
+/* Drops a RANGE partition with all its rows */
+int partDrop(struct table_t *table, const char *name);
+
+/* Releases the partitions of 'table', called with the table itself */
+void partRelease(struct table_t *table);
+
+/* Partition a row whose partitioning column holds 'value' belongs to,
+ * NULL when no RANGE partition takes it */
+struct table_t *partRoute(const struct table_t *table, int value);
+
+/* Flags in 'keep' the partitions of the plan table the WHERE condition
+ * may match with the parameters bound to the plan, returns how many */
+size_t partPrune(const struct plan_t *plan, unsigned char keep[PART_MAX]);
+
+/* ALTER TABLE on a partitioned table, the column is added to or dropped
+ * from the parent and every partition */
+struct column_t *partColumnCreate(struct table_t *table, const char *name,
+                                  int type,
+                                  const union cell_value_t *default_value);
+int partColumnDelete(struct table_t *table, int column);
+
+/* Rows and heap bytes of a table, summed over its partitions */
+size_t partRows(const struct table_t *table);
+size_t partBytes(const struct table_t *table);
+
+#endif /* _PART_H */
@@ -0,0 +1,1021 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "plan.h"
+#include "buffer.h"
+#include "lex.h"
+#include "logs.h"
+#include "part.h"
+#include "stats.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 'literal <op> column' is rewritten as 'column <op> literal' */
+static int planMirrorOperator(int op) {
+    switch (op) {
+    case RSQL_LT_OP:
+        return RSQL_GT_OP;
+    case RSQL_LE_OP:
+        return RSQL_GE_OP;
+    case RSQL_GT_OP:
+        return RSQL_LT_OP;
+    case RSQL_GE_OP:
+        return RSQL_LE_OP;
+    default:
+        return op;
+    }
+}
+
+/* Whether 'expr' reads a column of the row it is evaluated on */
+static int planReadsRow(const struct expr_t *expr) {
+    if (expr->kind == EXPR_COLUMN)
+        return 1;
+
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        if (planReadsRow(expr->args[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/* Resolve the value of column 'col' in an INSERT or UPDATE: a literal, a
+ * '?' placeholder or an expression over them (e.g. -?) evaluated for
+ * every execution. UPDATE values may also read the columns of the row
+ * and subqueries of 'db' */
+static int planResolveValue(struct plan_t *plan, struct database_t *db,
+                            int col, struct ast_node_t *node,
+                            struct plan_value_t *value) {
+    const struct column_t *column = plan->table->columns[col];
+    const struct table_t *table =
+        plan->kind == PLAN_UPDATE ? plan->table : NULL;
+
+    value->expr = NULL;
+    value->reads_row = 0;
+    if (node->type == AST_PARAM) {
+        value->param = atoi(node->value);
+        if ((size_t)value->param >= plan->param_count)
+            plan->param_count = (size_t)value->param + 1;
+        return 1;
+    }
+
+    value->param = -1;
+    if (node->type == AST_LITERAL && node->op != NULL_KW) {
+        if (dbCellSet(column, &value->cell, node->value))
+            return 1;
+    } else {
+        struct expr_t *expr =
+            exprCompile(&plan->arena, db, table, node, &plan->param_count);
+        if (!expr)
+            return 0;
+        if (expr->kind != EXPR_CONST) {
+            value->expr = expr;
+            value->reads_row = planReadsRow(expr);
+            return 1;
+        }
+        if (exprToCell(&expr->value, column, &value->cell))
+            return 1;
+    }
+
+    LOG_ERROR("Invalid value '%s' for column '%s'",
+              node->value ? node->value : "NULL", column->name);
+    return 0;
+}
+
+/* Whether 'expr' is a 'column <op> value' condition that an access path
+ * can use, the value being a constant or a parameter */
+static int planSargable(const struct plan_t *plan, const struct expr_t *expr,
+                        struct plan_pred_t *pred) {
+    if (expr->kind != EXPR_COMPARE)
+        return 0;
+
+    const struct expr_t *column = expr->args[0];
+    const struct expr_t *value = expr->args[1];
+    int op = expr->op;
+
+    if (column->kind != EXPR_COLUMN) {
+        column = expr->args[1];
+        value = expr->args[0];
+        op = planMirrorOperator(op);
+    }
+
+    if (column->kind != EXPR_COLUMN)
+        return 0;
+
+    pred->column = column->column;
+    pred->op = op;
+    pred->value.expr = NULL;
+
+    if (value->kind == EXPR_PARAM) {
+        pred->value.param = (int)value->param;
+        return 1;
+    }
+
+    pred->value.param = -1;
+    return value->kind == EXPR_CONST &&
+           exprToCell(&value->value, plan->table->columns[column->column],
+                      &pred->value.cell);
+}
+
+/* Whether 'expr' is a 'column LIKE pattern' condition on an indexed TEXT
+ * column, it stays in the filter since indexes only find candidates */
+static int planLikeIndexable(const struct plan_t *plan,
+                             const struct expr_t *expr) {
+    if (expr->kind != EXPR_LIKE || expr->args[0]->kind != EXPR_COLUMN ||
+        expr->args[0]->type != EXPR_TYPE_TEXT)
+        return 0;
+
+    const struct expr_t *pattern = expr->args[1];
+    if (pattern->kind != EXPR_PARAM &&
+        (pattern->kind != EXPR_CONST || pattern->type != EXPR_TYPE_TEXT))
+        return 0;
+
+    int column = expr->args[0]->column;
+    return indexFindColumn(plan->table, column, INDEX_SORTED) ||
+           indexFindColumn(plan->table, column, INDEX_TRIGRAM) ||
+           indexFindColumn(plan->table, column, INDEX_ART);
+}
+
+/* Among the top level AND conditions the most selective sargable one
+ * becomes the access predicate, the others form the residual filter */
+static int planPushdown(struct plan_t *plan, struct expr_t *where) {
+    struct expr_t *conds[PLAN_MAX_CONJUNCTS];
+    size_t n = exprConjuncts(where, conds, PLAN_MAX_CONJUNCTS);
+    size_t best = n;
+    double best_selectivity = 2.0;
+
+    if (n > PLAN_MAX_CONJUNCTS) {
+        plan->filter = where;
+        return 1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        struct plan_pred_t pred;
+        if (!planSargable(plan, conds[i], &pred))
+            continue;
+
+        double selectivity = statsSelectivity(
+            plan->table, pred.column, pred.op,
+            pred.value.param < 0 ? &pred.value.cell : NULL);
+        if (selectivity < best_selectivity) {
+            best = i;
+            best_selectivity = selectivity;
+            plan->pred = pred;
+            plan->pred.cond = conds[i];
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (!plan->like && planLikeIndexable(plan, conds[i]))
+            plan->like = conds[i];
+
+        if (i == best)
+            continue;
+        plan->filter = plan->filter
+                           ? exprAnd(&plan->arena, plan->filter, conds[i])
+                           : conds[i];
+        if (!plan->filter)
+            return 0;
+    }
+    return 1;
+}
+
+/* Room for the values of the parameters, filled by planBind() */
+static int planAllocBound(struct plan_t *plan) {
+    if (!plan->param_count)
+        return 1;
+
+    plan->bound = arenaAlloc(&plan->arena,
+                             plan->param_count * sizeof(struct expr_value_t));
+    plan->bound_text = arenaAlloc(
+        &plan->arena, plan->param_count * sizeof(struct plan_text_t));
+    if (!plan->bound || !plan->bound_text)
+        return 0;
+
+    /* NULL values until the first bind */
+    memset(plan->bound, 0, plan->param_count * sizeof(struct expr_value_t));
+    memset(plan->bound_text, 0,
+           plan->param_count * sizeof(struct plan_text_t));
+    return 1;
+}
+
+/* Text of the LIKE pattern, NULL while it is an unbound parameter */
+static const char *planLikePattern(const struct plan_t *plan) {
+    const struct expr_t *pattern = plan->like->args[1];
+    const struct expr_value_t *value = pattern->kind == EXPR_CONST
+                                           ? &pattern->value
+                                           : &plan->bound[pattern->param];
+    return value->type == EXPR_TYPE_TEXT ? value->s : NULL;
+}
+
+/* Use 'index' for the probe when it beats the current access path, the
+ * index tells exactly how many candidates it would return */
+static void planConsiderIndex(struct plan_t *plan, struct index_t *index,
+                              const struct index_probe_t *probe) {
+    if (!index)
+        return;
+
+    size_t candidates = indexEstimate(index, probe);
+    if (candidates == SIZE_MAX)
+        return;
+
+    double cost = PLAN_INDEX_COST * log2((double)plan->table->row_count + 1) +
+                  (double)candidates * PLAN_ROW_COST;
+    if (cost < plan->cost) {
+        plan->access = PLAN_INDEX_SCAN;
+        plan->cost = cost;
+        plan->index = index;
+        plan->probe = *probe;
+    }
+}
+
+/* Indexes on the predicate column answer its range (bitmaps only an
+ * equality), indexes on the LIKE column its literal prefix (sorted, radix
+ * tree) or its trigrams */
+static void planChooseIndex(struct plan_t *plan,
+                            const union cell_value_t *value) {
+    static const int pred_types[] = {INDEX_SORTED, INDEX_BITMAP, INDEX_ART};
+    static const int like_types[] = {INDEX_SORTED, INDEX_TRIGRAM, INDEX_ART};
+    struct index_probe_t probe;
+
+    if (value && plan->pred.column >= 0) {
+        probe.op = plan->pred.op;
+        probe.operand = *value;
+        for (size_t i = 0; i < sizeof(pred_types) / sizeof(int); i++)
+            planConsiderIndex(plan,
+                              indexFindColumn(plan->table, plan->pred.column,
+                                              pred_types[i]),
+                              &probe);
+    }
+
+    const char *pattern = plan->like ? planLikePattern(plan) : NULL;
+    if (!pattern)
+        return;
+
+    int column = plan->like->args[0]->column;
+    probe.op = RSQL_LIKE_OP;
+    strncpy(probe.operand.s, pattern, sizeof(probe.operand.s) - 1);
+    probe.operand.s[sizeof(probe.operand.s) - 1] = '\0';
+
+    for (size_t i = 0; i < sizeof(like_types) / sizeof(int); i++)
+        planConsiderIndex(
+            plan, indexFindColumn(plan->table, column, like_types[i]), &probe);
+}
+
+/* Compare the available access paths and keep the cheapest one, 'value'
+ * is the WHERE value or NULL while it is an unbound parameter */
+static void planChooseAccess(struct plan_t *plan,
+                             const union cell_value_t *value) {
+    struct table_t *table = plan->table;
+    double rows = (double)table->row_count;
+
+    /* Partitions have no index nor statistics of their own, the executor
+     * skips the ones partPrune() rules out and scans the others */
+    if (table->partitioning) {
+        unsigned char keep[PART_MAX];
+        size_t kept = 0;
+
+        partPrune(plan, keep);
+        for (size_t i = 0; i < table->partitioning->count; i++)
+            kept += keep[i] ? table->partitioning->tables[i]->row_count : 0;
+        rows = (double)kept;
+    }
+
+    plan->access = PLAN_FULL_SCAN;
+    plan->cost = rows * PLAN_ROW_COST;
+    plan->index = NULL;
+
+    if (table->partitioning) {
+        plan->est_rows = rows;
+        return;
+    }
+
+    if (plan->pred.column < 0) {
+        plan->est_rows = rows;
+        planChooseIndex(plan, NULL);
+        return;
+    }
+
+    plan->est_rows =
+        rows * statsSelectivity(table, plan->pred.column, plan->pred.op, value);
+    planChooseIndex(plan, value);
+    if (!value)
+        return;
+
+    /* Zone maps are exact, so count the zones a scan would really visit */
+    size_t zones = statsUsableZones(table);
+    if (!zones)
+        return;
+
+    size_t candidates = 0;
+    for (size_t z = 0; z < zones; z++) {
+        candidates += statsZoneMayMatch(table, plan->pred.column, z,
+                                        plan->pred.op, value);
+    }
+
+    double tail = rows - (double)(zones * STATS_ZONE_ROWS);
+    double zone_cost = zones * PLAN_ZONE_COST +
+                       (candidates * STATS_ZONE_ROWS + tail) * PLAN_ROW_COST;
+
+    if (zone_cost < plan->cost) {
+        plan->access = PLAN_ZONE_MAP_SCAN;
+        plan->cost = zone_cost;
+        plan->index = NULL;
+    }
+}
+
+/* Rows of the table, 'all' standing for every one of them */
+struct plan_rows_t {
+    struct bitmap_t rows;
+    int all;
+};
+
+/* Rows where a condition may be TRUE and rows where it may be FALSE,
+ * tracked apart so that NOT stays right when NULLs are involved */
+struct plan_truth_t {
+    struct plan_rows_t t;
+    struct plan_rows_t f;
+};
+
+static void planTruthRelease(struct plan_truth_t *truth) {
+    bitmapRelease(&truth->t.rows);
+    bitmapRelease(&truth->f.rows);
+}
+
+static int planRowsAnd(const struct plan_rows_t *a,
+                       const struct plan_rows_t *b, struct plan_rows_t *out) {
+    out->all = a->all && b->all;
+    if (a->all)
+        return bitmapCopy(&b->rows, &out->rows);
+    if (b->all)
+        return bitmapCopy(&a->rows, &out->rows);
+    return bitmapAnd(&a->rows, &b->rows, &out->rows);
+}
+
+static int planRowsOr(const struct plan_rows_t *a,
+                      const struct plan_rows_t *b, struct plan_rows_t *out) {
+    out->all = a->all || b->all;
+    if (out->all) {
+        bitmapRelease(&out->rows);
+        return 1;
+    }
+    return bitmapOr(&a->rows, &b->rows, &out->rows);
+}
+
+/* Add 'rows' to 'acc' */
+static int planRowsAdd(struct bitmap_t *acc, const struct bitmap_t *rows) {
+    struct bitmap_t sum = {0};
+
+    if (!bitmapOr(acc, rows, &sum)) {
+        bitmapRelease(&sum);
+        return 0;
+    }
+    bitmapRelease(acc);
+    *acc = sum;
+    return 1;
+}
+
+/* The column 'expr' reads in '*column' (-1 for none), 0 when it reads
+ * more than one */
+static int planSingleColumn(const struct expr_t *expr, int *column) {
+    if (expr->kind == EXPR_COLUMN) {
+        if (*column >= 0 && *column != expr->column)
+            return 0;
+        *column = expr->column;
+    }
+
+    for (size_t i = 0; i < expr->arg_count; i++) {
+        if (!planSingleColumn(expr->args[i], column))
+            return 0;
+    }
+    return 1;
+}
+
+/* 'column = value' answered by a single bitmap, returns -1 when 'expr'
+ * is not such an equality */
+static int planBitmapEquality(const struct plan_t *plan,
+                              const struct index_t *index,
+                              const struct expr_t *expr,
+                              struct plan_truth_t *out) {
+    struct plan_pred_t pred;
+    union cell_value_t cell;
+
+    if (!planSargable(plan, expr, &pred) || pred.op != RSQL_ET_OP)
+        return -1;
+
+    if (pred.value.param < 0)
+        cell = pred.value.cell;
+    else if (!exprToCell(&plan->bound[pred.value.param],
+                         plan->table->columns[pred.column], &cell))
+        return -1;
+
+    const struct bitmap_t *rows = indexBitmap(index, &cell);
+    if (rows && !bitmapCopy(rows, &out->t.rows))
+        return 0;
+
+    /* Cells are never NULL, every other row is FALSE */
+    return bitmapNot(&out->t.rows, (uint32_t)plan->table->row_count,
+                     &out->f.rows);
+}
+
+/* A condition on a single bitmap indexed column is evaluated once per
+ * distinct value, the rows of that value share its result */
+static int planBitmapLeaf(const struct plan_t *plan, const struct expr_t *expr,
+                          int column, struct plan_truth_t *out) {
+    struct expr_value_t result;
+
+    if (column < 0) {
+        exprEval(expr, NULL, plan->bound, &result);
+        out->t.all = result.type != EXPR_TYPE_NULL && result.i;
+        out->f.all = result.type != EXPR_TYPE_NULL && !result.i;
+        return 1;
+    }
+
+    struct index_t *index =
+        indexFindColumn(plan->table, column, INDEX_BITMAP);
+    if (!index || !indexSync(index)) {
+        out->t.all = out->f.all = 1;
+        return 1;
+    }
+
+    int done = planBitmapEquality(plan, index, expr, out);
+    if (done >= 0)
+        return done;
+
+    if (index->value_count > PLAN_BITMAP_MAX_VALUES) {
+        out->t.all = out->f.all = 1;
+        return 1;
+    }
+
+    for (size_t i = 0; i < index->value_slots; i++) {
+        const struct index_value_t *value = &index->values[i];
+        if (!value->rows.count)
+            continue;
+
+        exprEval(expr, bufferRow(plan->table, value->row), plan->bound,
+                 &result);
+        if (result.type == EXPR_TYPE_NULL)
+            continue;
+        if (!planRowsAdd(result.i ? &out->t.rows : &out->f.rows,
+                         &value->rows))
+            return 0;
+    }
+    return 1;
+}
+
+/* Rows where 'expr' may be TRUE or FALSE, combining the bitmaps of its
+ * AND/OR/NOT operands. Conditions no bitmap answers may be anything */
+static int planBitmapEval(const struct plan_t *plan, const struct expr_t *expr,
+                          struct plan_truth_t *out) {
+    memset(out, 0, sizeof(struct plan_truth_t));
+
+    if (expr->kind == EXPR_NOT) {
+        if (!planBitmapEval(plan, expr->args[0], out))
+            return 0;
+        struct plan_rows_t t = out->t;
+        out->t = out->f;
+        out->f = t;
+        return 1;
+    }
+
+    if (expr->kind == EXPR_AND || expr->kind == EXPR_OR) {
+        struct plan_truth_t a, b;
+        memset(&b, 0, sizeof(b));
+        int ok = planBitmapEval(plan, expr->args[0], &a) &&
+                 planBitmapEval(plan, expr->args[1], &b);
+
+        if (ok && expr->kind == EXPR_AND)
+            ok = planRowsAnd(&a.t, &b.t, &out->t) &&
+                 planRowsOr(&a.f, &b.f, &out->f);
+        else if (ok)
+            ok = planRowsOr(&a.t, &b.t, &out->t) &&
+                 planRowsAnd(&a.f, &b.f, &out->f);
+
+        planTruthRelease(&a);
+        planTruthRelease(&b);
+        return ok;
+    }
+
+    int column = -1;
+    if (!planSingleColumn(expr, &column)) {
+        out->t.all = out->f.all = 1;
+        return 1;
+    }
+    return planBitmapLeaf(plan, expr, column, out);
+}
+
+/* Resolve the WHERE condition through the bitmap indexes and scan the
+ * rows left when that beats the access path chosen so far */
+static int planChooseBitmap(struct plan_t *plan) {
+    struct plan_truth_t truth;
+
+    bitmapRelease(&plan->bitmap);
+    if (!plan->where)
+        return 1;
+
+    struct index_t *index = plan->table->indexes;
+    while (index && index->type != INDEX_BITMAP)
+        index = index->next;
+    if (!index)
+        return 1;
+
+    if (!planBitmapEval(plan, plan->where, &truth)) {
+        planTruthRelease(&truth);
+        return 0;
+    }
+
+    bitmapRelease(&truth.f.rows);
+    if (truth.t.all)
+        return 1;
+
+    size_t candidates = bitmapCardinality(&truth.t.rows);
+    double cost = (double)plan->table->row_count / 64 * PLAN_BITMAP_COST +
+                  (double)candidates * PLAN_ROW_COST;
+    if (cost >= plan->cost) {
+        bitmapRelease(&truth.t.rows);
+        return 1;
+    }
+
+    plan->access = PLAN_BITMAP_SCAN;
+    plan->cost = cost;
+    plan->index = NULL;
+    plan->bitmap = truth.t.rows;
+    return 1;
+}
+
+static struct table_t *planFindTable(struct database_t *db,
+                                     const struct ast_node_t *name) {
+    struct table_t *table = dbTableFind(db, name->value);
+    if (!table)
+        LOG_ERROR("Table '%s' doesn't exist", name->value);
+    return table;
+}
+
+static struct plan_t *planNew(enum plan_kind_t kind, struct table_t *table) {
+    struct plan_t *plan = malloc(sizeof(struct plan_t));
+    if (!plan)
+        return NULL;
+
+    memset(plan, 0, sizeof(struct plan_t));
+    plan->kind = kind;
+    plan->table = table;
+    plan->catalog_version = dbCatalogVersion();
+    plan->pred.column = -1;
+    return plan;
+}
+
+/* Compile the optional WHERE clause, split it between the access
+ * predicate and the filter, and pick the access path. The parameters
+ * must all be known by then */
+static int planWhere(struct plan_t *plan, struct database_t *db,
+                     struct ast_node_t *where) {
+    if (where) {
+        struct expr_t *cond =
+            where->child_count == 1
+                ? exprCompile(&plan->arena, db, plan->table,
+                              where->children[0], &plan->param_count)
+                : NULL;
+        if (!cond || !planPushdown(plan, cond))
+            return 0;
+        plan->where = cond;
+
+        /* A condition folded to TRUE filters nothing */
+        if (plan->filter && plan->filter->kind == EXPR_CONST &&
+            plan->filter->type != EXPR_TYPE_NULL &&
+            plan->filter->value.i)
+            plan->filter = NULL;
+        plan->residual = plan->filter;
+    }
+
+    if (!planAllocBound(plan))
+        return 0;
+
+    planChooseAccess(plan, plan->pred.value.param < 0 ? &plan->pred.value.cell
+                                                      : NULL);
+    return 1;
+}
+
+/* Build the plan of a SELECT node, whose children are the projection
+ * (identifiers or '*'), the table name and an optional WHERE clause */
+struct plan_t *planSelect(struct database_t *db, struct ast_node_t *node) {
+    if (!db || !node || node->type != AST_SELECT || node->child_count < 2)
+        return NULL;
+
+    size_t n = node->child_count;
+    struct ast_node_t *where = NULL;
+    if (node->children[n - 1]->type == AST_WHERE_CLAUSE)
+        where = node->children[--n];
+
+    struct table_t *table = planFindTable(db, node->children[n - 1]);
+    struct plan_t *plan = table ? planNew(PLAN_SELECT, table) : NULL;
+    if (!plan)
+        return NULL;
+
+    for (size_t i = 0; i + 1 < n; i++) {
+        struct ast_node_t *col = node->children[i];
+
+        if (col->type == AST_LITERAL && strcmp(col->value, "*") == 0) {
+            for (size_t c = 0; c < table->column_count; c++)
+                plan->projection[plan->projection_count++] = c;
+            continue;
+        }
+
+        int idx = dbColumnFind(table, col->value);
+        if (idx < 0 || plan->projection_count >= MAX_COLUMNS_NUM) {
+            LOG_ERROR("Unknown column '%s'", col->value);
+            goto cleanup;
+        }
+        plan->projection[plan->projection_count++] = (size_t)idx;
+    }
+
+    if (!planWhere(plan, db, where))
+        goto cleanup;
+    return plan;
+
+cleanup:
+    planFree(plan);
+    return NULL;
+}
+
+/* Build the plan of an INSERT node, whose children are the table name,
+ * the column list and one value list per row */
+struct plan_t *planInsert(struct database_t *db, struct ast_node_t *node) {
+    if (!db || !node || node->type != AST_INSERT || node->child_count < 3)
+        return NULL;
+
+    struct table_t *table = planFindTable(db, node->children[0]);
+    struct plan_t *plan = table ? planNew(PLAN_INSERT, table) : NULL;
+    if (!plan)
+        return NULL;
+
+    struct ast_node_t *columns = node->children[1];
+    for (size_t i = 0; i < columns->child_count; i++) {
+        const char *col_name = columns->children[i]->children[0]->value;
+        plan->targets[i] = dbColumnFind(table, col_name);
+        if (plan->targets[i] < 0) {
+            LOG_ERROR("Unknown column '%s'", col_name);
+            goto cleanup;
+        }
+    }
+    plan->target_count = columns->child_count;
+    plan->value_rows = node->child_count - 2;
+    plan->est_rows = (double)plan->value_rows;
+    plan->cost = plan->est_rows * PLAN_ROW_COST;
+
+    plan->values = calloc(plan->value_rows * plan->target_count,
+                          sizeof(struct plan_value_t));
+    if (!plan->values)
+        goto cleanup;
+
+    for (size_t r = 0; r < plan->value_rows; r++) {
+        struct ast_node_t *row = node->children[r + 2];
+        if (row->child_count != plan->target_count) {
+            LOG_ERROR("Column count doesn't match value count at row %zu",
+                      r + 1);
+            goto cleanup;
+        }
+
+        for (size_t i = 0; i < plan->target_count; i++) {
+            struct plan_value_t *value =
+                &plan->values[r * plan->target_count + i];
+            if (!planResolveValue(plan, NULL, plan->targets[i],
+                                  row->children[i], value))
+                goto cleanup;
+        }
+    }
+
+    if (!planAllocBound(plan))
+        goto cleanup;
+    return plan;
+
+cleanup:
+    planFree(plan);
+    return NULL;
+}
+
+/* Build the plan of an UPDATE node, whose children are the table name,
+ * one assignment per column and an optional WHERE clause */
+struct plan_t *planUpdate(struct database_t *db, struct ast_node_t *node) {
+    if (!db || !node || node->type != AST_UPDATE || node->child_count < 2)
+        return NULL;
+
+    size_t n = node->child_count;
+    struct ast_node_t *where = NULL;
+    if (node->children[n - 1]->type == AST_WHERE_CLAUSE)
+        where = node->children[--n];
+
+    struct table_t *table = planFindTable(db, node->children[0]);
+    struct plan_t *plan = table ? planNew(PLAN_UPDATE, table) : NULL;
+    if (!plan)
+        return NULL;
+
+    plan->value_rows = 1;
+    plan->values = calloc(n - 1, sizeof(struct plan_value_t));
+    if (!plan->values)
+        goto cleanup;
+
+    for (size_t i = 1; i < n; i++) {
+        struct ast_node_t *assignment = node->children[i];
+        const char *col_name = assignment->children[0]->value;
+        int col = dbColumnFind(table, col_name);
+        if (col < 0) {
+            LOG_ERROR("Unknown column '%s'", col_name);
+            goto cleanup;
+        }
+
+        for (size_t t = 0; t < plan->target_count; t++) {
+            if (plan->targets[t] == col) {
+                LOG_ERROR("Column '%s' assigned twice", col_name);
+                goto cleanup;
+            }
+        }
+
+        /* Rows never move between partitions */
+        if (table->partitioning && table->partitioning->column == col) {
+            LOG_ERROR("Can't update the partitioning column '%s'", col_name);
+            goto cleanup;
+        }
+
+        plan->targets[plan->target_count] = col;
+        if (!planResolveValue(plan, db, col, assignment->children[1],
+                              &plan->values[plan->target_count]))
+            goto cleanup;
+        plan->target_count++;
+    }
+
+    if (!planWhere(plan, db, where))
+        goto cleanup;
+    return plan;
+
+cleanup:
+    planFree(plan);
+    return NULL;
+}
+
+/* Build the plan of a DELETE node, whose children are the table name and
+ * an optional WHERE clause */
+struct plan_t *planDelete(struct database_t *db, struct ast_node_t *node) {
+    if (!db || !node || node->type != AST_DELETE || node->child_count < 1)
+        return NULL;
+
+    struct ast_node_t *where = NULL;
+    if (node->child_count > 1)
+        where = node->children[1];
+
+    struct table_t *table = planFindTable(db, node->children[0]);
+    if (table && table->capped) {
+        LOG_ERROR("Rows of capped table '%s' can't be deleted, new rows "
+                  "overwrite the oldest ones",
+                  table->name);
+        return NULL;
+    }
+
+    struct plan_t *plan = table ? planNew(PLAN_DELETE, table) : NULL;
+    if (!plan)
+        return NULL;
+
+    if (!planWhere(plan, db, where)) {
+        planFree(plan);
+        return NULL;
+    }
+    return plan;
+}
+
+struct plan_t *planCreate(struct database_t *db, struct ast_node_t *node) {
+    if (!node)
+        return NULL;
+
+    if (db && db->snapshot && node->type != AST_SELECT) {
+        LOG_ERROR("Snapshot '%s' is read only", db->name);
+        return NULL;
+    }
+
+    switch (node->type) {
+    case AST_SELECT:
+        return planSelect(db, node);
+    case AST_INSERT:
+        return planInsert(db, node);
+    case AST_UPDATE:
+        return planUpdate(db, node);
+    case AST_DELETE:
+        return planDelete(db, node);
+    default:
+        return NULL;
+    }
+}
+
+/* Convert an operand into a cell of column 'col', UPDATE values reading
+ * the row are computed from 'row'. Parameters are taken as they are when
+ * their type matches the column, so integers never go through a textual
+ * representation */
+int planSetCell(const struct plan_t *plan, const struct column_t *col,
+                const struct plan_value_t *value,
+                const struct plan_param_t *params, const struct row_t *row,
+                union cell_value_t *cell) {
+    if (value->expr) {
+        struct expr_value_t result;
+        exprEval(value->expr, row, plan->bound, &result);
+        return exprToCell(&result, col, cell);
+    }
+
+    if (value->param < 0) {
+        if (col->type == DB_TYPE_INT)
+            cell->i = value->cell.i;
+        else
+            memcpy(cell->s, value->cell.s, strlen(value->cell.s) + 1);
+        return 1;
+    }
+
+    const struct plan_param_t *param = &params[value->param];
+
+    switch (param->type) {
+    case PLAN_PARAM_INT:
+        if (col->type == DB_TYPE_INT)
+            cell->i = param->i;
+        else
+            snprintf(cell->s, sizeof(cell->s), "%d", param->i);
+        return 1;
+
+    case PLAN_PARAM_TEXT: {
+        size_t len = param->len;
+        if (col->type == DB_TYPE_INT) {
+            char text[32];
+            if (param->len >= sizeof(text))
+                return 0;
+            memcpy(text, param->s, param->len);
+            text[param->len] = '\0';
+            return dbCellSet(col, cell, text);
+        }
+        if ((param->escaped ? lexUnescapedLength(param->s, len) : len) >
+            sizeof(cell->s) - 1)
+            return 0;
+        if (param->escaped)
+            len = lexUnescape(param->s, len, cell->s);
+        else
+            memcpy(cell->s, param->s, len);
+        cell->s[len] = '\0';
+        return 1;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+/* Collect the IN candidates of every expression of the plan */
+static int planBindSets(struct plan_t *plan) {
+    if (plan->filter && !exprBind(plan->filter, plan->bound))
+        return 0;
+
+    size_t value_count = plan->values ? plan->value_rows * plan->target_count
+                                      : 0;
+    for (size_t i = 0; i < value_count; i++) {
+        struct expr_t *expr = plan->values[i].expr;
+        if (expr && !exprBind(expr, plan->bound))
+            return 0;
+    }
+    return 1;
+}
+
+/* Attach the parameters of one execution to the plan. The WHERE value is
+ * converted here and the access path is costed again with it (and with
+ * the LIKE pattern), insert values are converted straight into the rows
+ * by the evaluator */
+int planBind(struct plan_t *plan, const struct plan_param_t *params,
+             size_t param_count) {
+    if (param_count < plan->param_count) {
+        LOG_ERROR("Statement expects %zu parameter(s), %zu given",
+                  plan->param_count, param_count);
+        return 0;
+    }
+
+    for (size_t i = 0; i < plan->param_count; i++) {
+        if (params[i].type == PLAN_PARAM_UNBOUND) {
+            LOG_ERROR("Parameter %zu is not bound", i + 1);
+            return 0;
+        }
+    }
+
+    /* Expressions read the parameters as typed values, TEXT ones are
+     * unescaped once here */
+    for (size_t i = 0; i < plan->param_count; i++) {
+        struct expr_value_t *value = &plan->bound[i];
+
+        value->type = params[i].type;
+        value->i = params[i].i;
+        value->s = NULL;
+        if (params[i].type != PLAN_PARAM_TEXT)
+            continue;
+
+        /* The buffer of a parameter only grows, so executing a cached
+         * plan again does not take more of the arena */
+        struct plan_text_t *text = &plan->bound_text[i];
+        size_t len = params[i].len;
+        if (len + 1 > text->capacity) {
+            size_t capacity = text->capacity * 2 > len + 1
+                                  ? text->capacity * 2
+                                  : len + 1;
+            if (!(text->s = arenaAlloc(&plan->arena, capacity))) {
+                text->capacity = 0;
+                LOG_ERROR("Out of memory");
+                return 0;
+            }
+            text->capacity = capacity;
+        }
+        if (params[i].escaped)
+            len = lexUnescape(params[i].s, len, text->s);
+        else
+            memcpy(text->s, params[i].s, len);
+        text->s[len] = '\0';
+        value->s = text->s;
+    }
+
+    /* A value that does not fit the column, as 3000000000 for an INT or
+     * a text longer than a cell, can't be looked up: the whole WHERE
+     * condition is checked on every row instead, for this execution */
+    int pred_param = 0;
+    if (plan->pred.cond) {
+        if (plan->pred.column < 0)
+            planSargable(plan, plan->pred.cond, &plan->pred);
+        pred_param = plan->pred.value.param >= 0;
+    }
+    if (pred_param) {
+        const struct column_t *col = plan->table->columns[plan->pred.column];
+        plan->filter = plan->residual;
+        if (!planSetCell(plan, col, &plan->pred.value, params, NULL,
+                         &plan->pred.value.cell)) {
+            plan->filter = plan->where;
+            plan->pred.column = -1;
+        }
+    }
+
+    if (!planBindSets(plan)) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+
+    if (plan->kind == PLAN_INSERT ||
+        (!pred_param && !plan->like && !plan->table->indexes &&
+         !plan->table->partitioning))
+        return 1;
+
+    /* The access path depends on the parameters, and index ranges and
+     * partitions on the rows inserted since the plan was built */
+    planChooseAccess(plan, plan->pred.column >= 0 ? &plan->pred.value.cell
+                                                  : NULL);
+    if (!planChooseBitmap(plan)) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+    return 1;
+}
+
+void planFree(struct plan_t *plan) {
+    if (!plan)
+        return;
+
+    if (plan->filter)
+        exprRelease(plan->filter);
+
+    size_t value_count = plan->values ? plan->value_rows * plan->target_count
+                                      : 0;
+    for (size_t i = 0; i < value_count; i++) {
+        if (plan->values[i].expr)
+            exprRelease(plan->values[i].expr);
+    }
+
+    bitmapRelease(&plan->bitmap);
+    free(plan->values);
+    arenaRelease(&plan->arena);
+    free(plan);
+}
+
+const char *planAccessName(enum plan_access_t access) {
+    switch (access) {
+    case PLAN_FULL_SCAN:
+        return "FULL SCAN";
+    case PLAN_ZONE_MAP_SCAN:
+        return "ZONE MAP SCAN";
+    case PLAN_INDEX_SCAN:
+        return "INDEX SCAN";
+    case PLAN_BITMAP_SCAN:
+        return "BITMAP SCAN";
+    default:
+        return "UNKNOWN";
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Cost based planner sitting between the parser and the evaluator. A plan
+ *  is the resolved form of a statement: names are turned into table and
+ *  column references, literals are converted to cells and the cheapest
+ *  access path is picked using the statistics from 'ANALYZE TABLE'.
+ */
+#ifndef _PLAN_H
+#define _PLAN_H
+
+#include "arena.h"
+#include "bitmap.h"
+#include "db.h"
+#include "expr.h"
+#include "index.h"
+#include "parser.h"
+#include "prof.h"
+
+/* Cost units: reading a row and testing the predicate against it */
+#define PLAN_ROW_COST 1.0
+/* Checking one zone map entry */
+#define PLAN_ZONE_COST 2.0
+/* One step of an index search */
+#define PLAN_INDEX_COST 1.0
+/* Combining 64 rows worth of bitmap index words */
+#define PLAN_BITMAP_COST 1.0
+
+/* Distinct values a bitmap index condition is evaluated on, beyond them
+ * only equalities are answered through the index */
+#define PLAN_BITMAP_MAX_VALUES 1024
+
+/* WHERE conditions considered for the access predicate */
+#define PLAN_MAX_CONJUNCTS 16
+
+/* Parameter types, UNBOUND marks a '?' that still has no value */
+#define PLAN_PARAM_UNBOUND 0x00
+#define PLAN_PARAM_INT DB_TYPE_INT
+#define PLAN_PARAM_TEXT DB_TYPE_TEXT
+
+enum plan_kind_t {
+    PLAN_SELECT,
+    PLAN_INSERT,
+    PLAN_UPDATE,
+    PLAN_DELETE,
+};
+
+enum plan_access_t {
+    PLAN_FULL_SCAN,     /* visit every row */
+    PLAN_ZONE_MAP_SCAN, /* skip zones whose min/max exclude the predicate */
+    PLAN_INDEX_SCAN,    /* visit the candidate rows returned by an index */
+    PLAN_BITMAP_SCAN,   /* visit the rows left by combining bitmap indexes */
+};
+
+/* A statement parameter, text values point into the statement buffer
+ * and are not NUL terminated. Literals taken from the statement keep
+ * their '' quote escapes until they are copied into a cell */
+struct plan_param_t {
+    int type;
+    int i;
+    const char *s;
+    size_t len;
+    int escaped;
+};
+
+/* Unescaped text of a TEXT parameter, whole whatever its length: it is
+ * compared to cells but never stored in one */
+struct plan_text_t {
+    char *s;
+    size_t capacity;
+};
+
+/* Operand of a plan: either a constant resolved at planning time or a
+ * reference to a parameter supplied at execution time */
+struct plan_value_t {
+    int param; /* parameter index, -1 for a constant */
+    union cell_value_t cell;
+    struct expr_t *expr; /* computed value (e.g. -?), NULL otherwise */
+    int reads_row;       /* UPDATE, 'expr' reads columns of the row */
+};
+
+struct plan_pred_t {
+    int column; /* column index, -1 when there is no WHERE clause */
+    int op;     /* RSQL_*_OP comparison operator */
+    struct plan_value_t value;
+    struct expr_t *cond; /* the condition of the WHERE clause it is */
+};
+
+struct plan_t {
+    enum plan_kind_t kind;
+    struct table_t *table;
+    size_t catalog_version; /* dbCatalogVersion() when planned */
+    size_t param_count;     /* parameters the plan expects */
+
+    /* Expression trees and parameter values of the plan */
+    struct arena_t arena;
+    struct expr_value_t *bound;     /* parameters of the current execution */
+    struct plan_text_t *bound_text; /* storage of the TEXT parameters */
+
+    /* SELECT, UPDATE and DELETE, the WHERE condition is split in the
+     * access predicate and the residual filter evaluated on the rows it
+     * selects */
+    enum plan_access_t access;
+    size_t projection[MAX_COLUMNS_NUM];
+    size_t projection_count;
+    struct plan_pred_t pred;
+    struct expr_t *filter;   /* NULL when there is nothing left to check */
+    struct expr_t *residual; /* the filter as planned, see planBind() */
+    double est_rows;       /* rows expected to satisfy the predicate */
+    double cost;           /* cost of the chosen access path */
+
+    /* 'column LIKE pattern' condition of the filter an index may answer,
+     * and the index and probe of PLAN_INDEX_SCAN */
+    struct expr_t *like;
+    struct index_t *index;
+    struct index_probe_t probe;
+
+    /* The whole WHERE condition and the candidate rows of
+     * PLAN_BITMAP_SCAN, found from it before the scan */
+    struct expr_t *where;
+    struct bitmap_t bitmap;
+
+    /* INSERT, values holds value_rows * target_count operands. UPDATE,
+     * a single row of values assigned to the targets */
+    int targets[MAX_COLUMNS_NUM];
+    size_t target_count;
+    struct plan_value_t *values;
+    size_t value_rows;
+
+    /* Operator counters while the plan runs under EXPLAIN ANALYZE */
+    struct prof_plan_t *profile;
+};
+
+struct plan_t *planCreate(struct database_t *db, struct ast_node_t *node);
+struct plan_t *planSelect(struct database_t *db, struct ast_node_t *node);
+struct plan_t *planInsert(struct database_t *db, struct ast_node_t *node);
+struct plan_t *planUpdate(struct database_t *db, struct ast_node_t *node);
+struct plan_t *planDelete(struct database_t *db, struct ast_node_t *node);
+int planBind(struct plan_t *plan, const struct plan_param_t *params,
+             size_t param_count);
+int planSetCell(const struct plan_t *plan, const struct column_t *col,
+                const struct plan_value_t *value,
+                const struct plan_param_t *params, const struct row_t *row,
+                union cell_value_t *cell);
+void planFree(struct plan_t *plan);
+const char *planAccessName(enum plan_access_t access);
+
+#endif /* _PLAN_H */
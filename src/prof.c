@@ -0,0 +1,53 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "prof.h"
+
+#include <string.h>
+#include <time.h>
+
+/* Length of the calibration of the tick rate against the clock */
+#define PROF_CALIBRATION_NS 2000000
+
+struct prof_t prof_statement;
+
+void profReset(int tokens) {
+    memset(&prof_statement, 0, sizeof(prof_statement));
+    prof_statement.tokens = tokens;
+}
+
+static uint64_t profClock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+double profMicros(uint64_t ticks) {
+    static double ticks_per_us;
+
+    if (!ticks_per_us) {
+#if defined(__x86_64__) || defined(__i386__)
+        uint64_t start = profClock(), elapsed;
+        uint64_t tsc = profNow();
+
+        while ((elapsed = profClock() - start) < PROF_CALIBRATION_NS)
+            ;
+        ticks_per_us = (double)(profNow() - tsc) * 1000.0 / (double)elapsed;
+#else
+        ticks_per_us = 1000.0; /* profNow() already counts nanoseconds */
+#endif
+    }
+    return (double)ticks / ticks_per_us;
+}
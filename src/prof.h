@@ -0,0 +1,85 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Statement profiling for EXPLAIN ANALYZE. Times are taken from the time
+ *  stamp counter where there is one (a few cycles per reading) and only
+ *  converted to microseconds when a report is printed.
+ */
+#ifndef _PROF_H
+#define _PROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Stages of a statement */
+#define PROF_LEX 0
+#define PROF_PARSE 1
+#define PROF_PLAN 2
+#define PROF_EXECUTE 3
+#define PROF_STAGES 4
+
+/* Time spent by the current statement in each stage, in ticks */
+struct prof_t {
+    int tokens; /* time every token, set for the statements reported on */
+    uint64_t stage[PROF_STAGES];
+};
+
+/* Counters of one operator of a plan run under EXPLAIN ANALYZE */
+struct prof_op_t {
+    uint64_t ticks;
+    size_t rows_in;
+    size_t rows_out;
+    size_t batches;
+    size_t bytes;
+};
+
+/* Operators of a plan: the access path with its filter, and what is done
+ * with the rows it returns (projection, update, delete or insert) */
+struct prof_plan_t {
+    struct prof_op_t scan;
+    struct prof_op_t output;
+};
+
+extern struct prof_t prof_statement;
+
+static inline uint64_t profNow(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Charge the ticks elapsed since 'start' to a stage */
+static inline void profAdd(int stage, uint64_t start) {
+    prof_statement.stage[stage] += profNow() - start;
+}
+
+/* Start profiling a new statement, 'tokens' enables the lexer timing */
+void profReset(int tokens);
+
+/* Convert ticks to microseconds, calibrated on the first call */
+double profMicros(uint64_t ticks);
+
+#endif /* _PROF_H */
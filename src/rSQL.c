@@ -14,79 +14,83 @@
  * limitations under the License.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "buffer.h"
 #include "eval.h"
+#include "logs.h"
+#include "script.h"
+
+static void rSQL_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [-f script.sql] [-m memory_limit[K|M|G]] "
+            "[-s spill_file]\n",
+            program);
+}
 
-/* Runs main CLI getting the line buffer */
-static void rSQL_runConsole(void) {
-    char buffer[100];
-
-    printf("%s", ">> ");
-    if (fgets(buffer, sizeof(buffer), stdin)) {
-        buffer[strcspn(buffer, "\n")] = 0;
+/* Parses '512M' and the like, returns 0 when invalid */
+static size_t rSQL_size(const char *text) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+
+    switch (*end) {
+    case 'G':
+    case 'g':
+        value <<= 10;
+        /* fall through */
+    case 'M':
+    case 'm':
+        value <<= 10;
+        /* fall through */
+    case 'K':
+    case 'k':
+        value <<= 10;
+        end++;
+        break;
     }
-
-    evaluator_t *eval = evCreateEvaluator(buffer);
-    evEvaluateNode(eval->current_node);
-    printf("\n");
+    return end == text || *end ? 0 : (size_t)value;
 }
 
-int main(int argc, char **argv) {
-
-    /*
-    struct lexer_t lexer;
-    const char *test_input =
-        "CREATE TABLE users (id >= 10 AND name != 'test');";
-
-    lexInitialize(&lexer, test_input);
-
-    printf("Tokenizing: %s\n\n", test_input);
-
-    do {
-        lexNextToken(&lexer);
-        printf("Token: %-15s Type: %s\n", lexer.current_token.text,
-               lexGetTokenTypeName(lexer.current_token.type));
-    } while (lexer.current_token.type != RSQL_EOF);
-
-    const char *test_queries[] = {
-        "CREATE TABLE users (id INT, name VARCHAR);",
-        "DROP TABLE users;",
-        "SELECT * FROM users;",
-        "SELECT id, name FROM users WHERE id;",
-        "INSERT INTO users (name, age) VALUES ('Enrico', 13);",
-        "INSERT INTO guys (name, age) VALUES ('Marco', 23), ('Davide', '25');",
-        "CREATE DATABASE saldi;",
-        NULL};
+/* Runs the statements of a script file, of a pipe or of the console */
+static int rSQL_run(const char *path) {
+    if (!path)
+        return scriptRun(stdin, isatty(fileno(stdin)));
 
-    for (int i = 0; test_queries[i]; i++) {
-        printf("=== Parsing: %s ===\n", test_queries[i]);
-
-        struct lexer_t lexer;
-        lexInitialize(&lexer, test_queries[i]);
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        LOG_ERROR("Unable to open '%s'", path);
+        return 0;
+    }
 
-        struct parser_t *parser = parserCreate(&lexer);
-        struct ast_node_t *ast = parserParse(parser);
+    int ok = scriptRun(in, 0);
+    fclose(in);
+    return ok;
+}
 
-        if (ast) {
-            printf("✓ Parse successful!\n");
-            astPrintNode(ast, 0);
-            astFreeNode(ast);
+int main(int argc, char **argv) {
+    const char *path = NULL, *spill = NULL;
+    size_t memory_limit = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc &&
+                   (memory_limit = rSQL_size(argv[i + 1]))) {
+            i++;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            spill = argv[++i];
         } else {
-            printf("✗ Parse failed: %s\n", parserGetError(parser));
+            rSQL_usage(argv[0]);
+            return 1;
         }
-
-        parserFree(parser);
-        printf("\n");
     }
 
-    return 0;
-
-    */
-
-    while (1) {
-        rSQL_runConsole();
-    }
+    /* Pages of PACKED tables beyond the limit are spilled to disk */
+    if ((memory_limit || spill) &&
+        !bufferConfigure(memory_limit ? memory_limit : SIZE_MAX, spill))
+        return 1;
 
-    return 0;
+    return rSQL_run(path) ? 0 : 1;
 }
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "script.h"
+#include "eval.h"
+#include "logs.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct script_t {
+    FILE *in;
+    int interactive;
+    int line_start; /* the last read ended a line, prompt again */
+
+    char *buffer; /* always NUL terminated at 'len' */
+    size_t len;
+    size_t cap;
+
+    size_t start;  /* first byte of the pending statement */
+    size_t scan;   /* first byte not scanned for a terminator yet */
+    int in_string; /* 'scan' is inside a string literal */
+};
+
+static int scriptIsBlank(const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!isspace((unsigned char)text[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Executes the statement buffer[start..end], the byte after it is
+ * replaced by a NUL for the time of the execution. Empty statements
+ * (';;') are skipped */
+static void scriptExecute(struct script_t *script, size_t end) {
+    char *text = script->buffer + script->start;
+    size_t len = end - script->start;
+    size_t body = len && text[len - 1] == ';' ? len - 1 : len;
+
+    if (!scriptIsBlank(text, body)) {
+        char saved = text[len];
+        text[len] = '\0';
+        evExecute(text);
+        text[len] = saved;
+
+        if (script->interactive) {
+            logFlush();
+            printf("\n");
+        }
+    }
+    script->start = end;
+}
+
+/* Runs every complete statement in the buffer. Quotes toggle the string
+ * state, an escaped quote ('') toggles it twice and changes nothing */
+static void scriptSplit(struct script_t *script) {
+    while (script->scan < script->len) {
+        char *p = script->buffer + script->scan;
+        size_t n = strcspn(p, script->in_string ? "'" : "';");
+
+        script->scan += n;
+        if (script->scan >= script->len)
+            break;
+
+        if (p[n] == '\0') {
+            script->scan++; /* NUL byte in the input, not a terminator */
+            continue;
+        }
+
+        if (p[n] == '\'') {
+            script->in_string = !script->in_string;
+            script->scan++;
+            continue;
+        }
+
+        script->scan++; /* keep the ';' in the statement */
+        scriptExecute(script, script->scan);
+    }
+}
+
+/* Moves the pending statement to the front of the buffer and makes sure
+ * at least half of the buffer is free for the next read */
+static int scriptMakeRoom(struct script_t *script) {
+    if (script->start) {
+        size_t pending = script->len - script->start;
+        memmove(script->buffer, script->buffer + script->start, pending + 1);
+        script->scan -= script->start;
+        script->len = pending;
+        script->start = 0;
+    }
+
+    if (script->cap - script->len - 1 >= script->cap / 2)
+        return 1;
+
+    size_t cap = script->cap * 2;
+    char *buffer = realloc(script->buffer, cap);
+    if (!buffer)
+        return 0;
+
+    script->buffer = buffer;
+    script->cap = cap;
+    return 1;
+}
+
+static size_t scriptRead(struct script_t *script) {
+    char *dst = script->buffer + script->len;
+    size_t room = script->cap - script->len - 1;
+
+    if (!script->interactive)
+        return fread(dst, 1, room, script->in);
+
+    if (script->line_start) {
+        int pending = !scriptIsBlank(script->buffer, script->len);
+        printf("%s", pending ? "-> " : ">> ");
+        fflush(stdout);
+    }
+
+    if (!fgets(dst, (int)(room < 65536 ? room + 1 : 65536), script->in))
+        return 0;
+
+    size_t n = strlen(dst);
+    script->line_start = n && dst[n - 1] == '\n';
+    return n;
+}
+
+int scriptRun(FILE *in, int interactive) {
+    struct script_t script = {0};
+
+    script.in = in;
+    script.interactive = interactive;
+    script.line_start = 1;
+    script.cap = SCRIPT_BUFFER_SIZE;
+    script.buffer = malloc(script.cap);
+    if (!script.buffer) {
+        LOG_ERROR("Out of memory");
+        return 0;
+    }
+    script.buffer[0] = '\0';
+
+    int ok = 1;
+    for (;;) {
+        if (!scriptMakeRoom(&script)) {
+            LOG_ERROR("Out of memory");
+            ok = 0;
+            break;
+        }
+
+        size_t n = scriptRead(&script);
+        if (n == 0)
+            break;
+
+        script.len += n;
+        script.buffer[script.len] = '\0';
+        scriptSplit(&script);
+    }
+
+    if (ferror(in)) {
+        LOG_ERROR("Unable to read the input");
+        ok = 0;
+    }
+
+    /* The last statement may have no terminator */
+    scriptExecute(&script, script.len);
+
+    free(script.buffer);
+    return ok;
+}
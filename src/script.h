@@ -0,0 +1,35 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Statement stream: reads SQL from a file or from the terminal into a
+ *  large buffer, splits it on the ';' that are not inside a string and
+ *  executes every statement as soon as its terminator has been read. A
+ *  statement may span any number of reads, the buffer grows to hold it.
+ */
+#ifndef _SCRIPT_H
+#define _SCRIPT_H
+
+#include <stdio.h>
+
+/* Initial size of the read buffer */
+#define SCRIPT_BUFFER_SIZE (1024 * 1024)
+
+/* Executes every statement read from 'in' until end of file. In
+ * interactive mode input is read a line at a time after a prompt.
+ * Returns 0 on a read or allocation error */
+int scriptRun(FILE *in, int interactive);
+
+#endif /* _SCRIPT_H */
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "set.h"
+#include "db.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Smallest hash table, at most half of the slots are ever used */
+#define SET_MIN_SLOTS 64
+
+static size_t setHashInt(int value) {
+    uint32_t h = (uint32_t)value * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+/* FNV-1a */
+static size_t setHashText(const char *value) {
+    uint32_t h = 2166136261u;
+    for (; *value; value++) {
+        h ^= (unsigned char)*value;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Slot holding 'value' or the empty slot where it belongs */
+static size_t setSlotInt(const struct set_t *set, int value) {
+    size_t mask = set->slot_count - 1;
+    size_t slot = setHashInt(value) & mask;
+
+    while (set->used[slot] && set->ints[slot] != value)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static size_t setSlotText(const struct set_t *set, const char *value) {
+    size_t mask = set->slot_count - 1;
+    size_t slot = setHashText(value) & mask;
+
+    while (set->used[slot] && strcmp(set->texts[slot], value) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static void setInsertSlot(struct set_t *set, const void *value) {
+    size_t slot;
+
+    if (set->type == DB_TYPE_INT) {
+        slot = setSlotInt(set, *(const int *)value);
+        set->ints[slot] = *(const int *)value;
+    } else {
+        slot = setSlotText(set, value);
+        set->texts[slot] = value;
+    }
+
+    if (!set->used[slot]) {
+        set->used[slot] = 1;
+        set->count++;
+    }
+}
+
+/* Move the values into a hash table of 'slots' entries (a power of two) */
+static int setResize(struct set_t *set, size_t slots) {
+    struct set_t grown = {0};
+
+    grown.type = set->type;
+    grown.slot_count = slots;
+    grown.capacity = slots;
+    grown.used = calloc(slots, 1);
+    if (set->type == DB_TYPE_INT)
+        grown.ints = malloc(slots * sizeof(int));
+    else
+        grown.texts = malloc(slots * sizeof(const char *));
+
+    if (!grown.used || (!grown.ints && !grown.texts)) {
+        setRelease(&grown);
+        return 0;
+    }
+
+    if (!set->slot_count) {
+        for (size_t i = 0; i < set->count; i++)
+            setInsertSlot(&grown, &set->ints[i]);
+    } else {
+        for (size_t i = 0; i < set->slot_count; i++) {
+            if (!set->used[i])
+                continue;
+            if (set->type == DB_TYPE_INT)
+                setInsertSlot(&grown, &set->ints[i]);
+            else
+                setInsertSlot(&grown, set->texts[i]);
+        }
+    }
+
+    setRelease(set);
+    *set = grown;
+    return 1;
+}
+
+void setInit(struct set_t *set, int type) {
+    memset(set, 0, sizeof(struct set_t));
+    set->type = type;
+}
+
+void setClear(struct set_t *set) {
+    set->count = 0;
+    if (set->slot_count)
+        memset(set->used, 0, set->slot_count);
+}
+
+void setRelease(struct set_t *set) {
+    free(set->ints);
+    free(set->texts);
+    free(set->used);
+    set->ints = NULL;
+    set->texts = NULL;
+    set->used = NULL;
+    set->count = set->slot_count = set->capacity = 0;
+}
+
+int setReserve(struct set_t *set, size_t count) {
+    if (set->type == DB_TYPE_INT && count <= SET_LINEAR_MAX &&
+        !set->slot_count) {
+        if (set->capacity)
+            return 1;
+        set->ints = malloc(SET_LINEAR_MAX * sizeof(int));
+        set->capacity = set->ints ? SET_LINEAR_MAX : 0;
+        return set->ints != NULL;
+    }
+
+    size_t slots = SET_MIN_SLOTS;
+    while (slots < count * 2)
+        slots *= 2;
+    return slots <= set->slot_count || setResize(set, slots);
+}
+
+int setAddInt(struct set_t *set, int value) {
+    if (!set->slot_count) {
+        if (setHasInt(set, value))
+            return 1;
+
+        if (set->count < SET_LINEAR_MAX) {
+            if (!setReserve(set, set->count + 1))
+                return 0;
+
+            /* Pad the last group of four with a value already in the set
+             * so that the scan never needs a scalar tail */
+            set->ints[set->count++] = value;
+            for (size_t i = set->count; i % 4; i++)
+                set->ints[i] = set->ints[0];
+            return 1;
+        }
+
+        if (!setResize(set, SET_MIN_SLOTS))
+            return 0;
+    }
+
+    if ((set->count + 1) * 2 > set->slot_count &&
+        !setResize(set, set->slot_count * 2))
+        return 0;
+
+    setInsertSlot(set, &value);
+    return 1;
+}
+
+int setAddText(struct set_t *set, const char *value) {
+    if ((set->count + 1) * 2 > set->slot_count &&
+        !setResize(set, set->slot_count ? set->slot_count * 2
+                                        : SET_MIN_SLOTS))
+        return 0;
+
+    setInsertSlot(set, value);
+    return 1;
+}
+
+int setHasInt(const struct set_t *set, int value) {
+    if (set->slot_count)
+        return set->used[setSlotInt(set, value)];
+
+#if defined(__SSE2__)
+    __m128i key = _mm_set1_epi32(value);
+    for (size_t i = 0; i < set->count; i += 4) {
+        __m128i group = _mm_loadu_si128((const __m128i *)(set->ints + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(group, key)))
+            return 1;
+    }
+#else
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->ints[i] == value)
+            return 1;
+    }
+#endif
+    return 0;
+}
+
+int setHasText(const struct set_t *set, const char *value) {
+    return set->slot_count && set->used[setSlotText(set, value)];
+}
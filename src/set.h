@@ -0,0 +1,58 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Sets of INT or TEXT values built once and probed for every row, used
+ *  by 'IN (...)'. A few integers are kept in a flat array compared four
+ *  at a time, anything larger goes into an open addressing hash table.
+ *  TEXT values are not copied, the caller keeps them alive.
+ */
+#ifndef _SET_H
+#define _SET_H
+
+#include <stddef.h>
+
+/* Up to this many integers are scanned instead of hashed */
+#define SET_LINEAR_MAX 16
+
+struct set_t {
+    int type;  /* DB_TYPE_INT or DB_TYPE_TEXT */
+    size_t count;
+
+    /* Slots of the hash table, 0 while the values are a flat array (INT
+     * sets with at most SET_LINEAR_MAX values) */
+    size_t slot_count;
+    size_t capacity; /* allocated entries of ints/texts */
+    int *ints;
+    const char **texts;
+    unsigned char *used; /* occupied slots */
+};
+
+/* A zero initialized set is empty but has no type, use setInit() */
+void setInit(struct set_t *set, int type);
+void setClear(struct set_t *set);
+void setRelease(struct set_t *set);
+
+/* Size the set for 'count' values, adding more is still possible */
+int setReserve(struct set_t *set, size_t count);
+
+/* Add a value, duplicates are ignored. Return 0 when out of memory */
+int setAddInt(struct set_t *set, int value);
+int setAddText(struct set_t *set, const char *value);
+
+int setHasInt(const struct set_t *set, int value);
+int setHasText(const struct set_t *set, const char *value);
+
+#endif /* _SET_H */
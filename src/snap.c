@@ -0,0 +1,394 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "snap.h"
+#include "buffer.h"
+#include "eval.h"
+#include "index.h"
+#include "logs.h"
+#include "part.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every snapshot, the dropped ones too until their last backup is done.
+ * Guarded by the storage latch */
+static struct snap_t *snapshots = NULL;
+
+static struct snap_t *snapFind(const char *name) {
+    for (struct snap_t *snap = snapshots; snap; snap = snap->next) {
+        if (!snap->dropped && strcmp(snap->db->name, name) == 0)
+            return snap;
+    }
+    return NULL;
+}
+
+/* Releases a table of a snapshot, its partitions are frozen tables too */
+static void snapFreeTable(struct table_t *frozen) {
+    struct part_t *part = frozen->partitioning;
+
+    for (size_t i = 0; part && i < part->count; i++)
+        snapFreeTable(part->tables[i]);
+    free(part);
+    dbTableFreeFrozen(frozen);
+}
+
+static struct table_t *snapFreezeTable(struct table_t *table,
+                                       uint32_t generation) {
+    const struct part_t *part = table->partitioning;
+    struct table_t *frozen = dbTableFreeze(table, generation);
+    if (!frozen || !part)
+        return frozen;
+
+    frozen->partitioning = malloc(sizeof(struct part_t));
+    if (!frozen->partitioning) {
+        snapFreeTable(frozen);
+        return NULL;
+    }
+    *frozen->partitioning = *part;
+    frozen->partitioning->count = 0;
+
+    for (size_t i = 0; i < part->count; i++) {
+        struct table_t *partition =
+            snapFreezeTable(part->tables[i], generation);
+        if (!partition) {
+            snapFreeTable(frozen);
+            return NULL;
+        }
+        frozen->partitioning->tables[frozen->partitioning->count++] = partition;
+    }
+    return frozen;
+}
+
+static void snapUnfreezeTable(struct table_t *table,
+                              const uint32_t *generations, size_t count) {
+    const struct part_t *part = table->partitioning;
+
+    dbTableUnfreeze(table, generations, count);
+    for (size_t i = 0; part && i < part->count; i++)
+        snapUnfreezeTable(part->tables[i], generations, count);
+}
+
+/* Takes the database of a snapshot out of the context, it is released
+ * with the snapshot */
+static void snapUnregister(struct database_t *db) {
+    struct ctx_t *ctx = evGetContext();
+
+    for (size_t i = 0; i < ctx->database_count; i++) {
+        if (ctx->databases[i] != db)
+            continue;
+
+        memmove(&ctx->databases[i], &ctx->databases[i + 1],
+                (ctx->database_count - i - 1) * sizeof(ctx->databases[0]));
+        ctx->databases[--ctx->database_count] = NULL;
+        break;
+    }
+    evForgetDatabase(db);
+    dbCatalogChanged();
+}
+
+/* Releases a snapshot out of the context, the live tables free what was
+ * only kept for it */
+static void snapFree(struct snap_t *snap) {
+    uint32_t generations[MAX_DB_NUM];
+    size_t count = 0;
+    struct snap_t **link = &snapshots;
+
+    while (*link != snap)
+        link = &(*link)->next;
+    *link = snap->next;
+
+    for (const struct snap_t *other = snapshots; other; other = other->next) {
+        if (other->source == snap->source)
+            generations[count++] = other->generation;
+    }
+
+    for (size_t i = 0; i < snap->db->table_count; i++)
+        snapFreeTable(snap->db->tables[i]);
+    for (size_t i = 0; i < snap->source->table_count; i++)
+        snapUnfreezeTable(snap->source->tables[i], generations, count);
+
+    free(snap->indexes);
+    free(snap->db);
+    free(snap);
+}
+
+static size_t snapCount(void) {
+    size_t count = 0;
+
+    for (const struct snap_t *snap = snapshots; snap; snap = snap->next)
+        count++;
+    return count;
+}
+
+/* Records the indexes of the live table at position 'table', oldest
+ * first as the table lists the newest first */
+static int snapKeepIndexes(struct snap_t *snap, const struct table_t *live,
+                           size_t table) {
+    size_t first = snap->index_count;
+
+    for (const struct index_t *index = live->indexes; index;
+         index = index->next) {
+        struct snap_index_t *grown =
+            realloc(snap->indexes,
+                    (snap->index_count + 1) * sizeof(struct snap_index_t));
+        if (!grown)
+            return 0;
+        snap->indexes = grown;
+
+        struct snap_index_t *kept = &snap->indexes[snap->index_count++];
+        memcpy(kept->name, index->name, sizeof(kept->name));
+        kept->type = index->type;
+        kept->table = table;
+        kept->column = index->column;
+    }
+
+    for (size_t i = first, j = snap->index_count; i + 1 < j; i++, j--) {
+        struct snap_index_t swap = snap->indexes[i];
+        snap->indexes[i] = snap->indexes[j - 1];
+        snap->indexes[j - 1] = swap;
+    }
+    return 1;
+}
+
+struct database_t *snapCreate(const char *database, const char *name) {
+    struct ctx_t *ctx = evGetContext();
+
+    evLock();
+    struct database_t *source =
+        database ? dbFind(ctx, database) : evGetDatabase();
+    struct snap_t *snap = NULL;
+
+    if (!source) {
+        if (database)
+            LOG_ERROR("Unknown database '%s'", database);
+    } else if (source->snapshot) {
+        LOG_ERROR("Can't take a snapshot of the snapshot '%s'", source->name);
+    } else if (buffer_enabled) {
+        LOG_ERROR("Snapshots are not available with a memory budget (-m)");
+    } else if (dbFind(ctx, name)) {
+        LOG_ERROR("Database '%s' already exists", name);
+    } else if (snapCount() >= MAX_DB_NUM) {
+        LOG_ERROR("Too many snapshots");
+    } else if (!(snap = calloc(1, sizeof(struct snap_t))) ||
+               !(snap->db = dbCreateNew(ctx, name))) {
+        LOG_ERROR("Unable to create snapshot '%s'", name);
+        free(snap);
+        snap = NULL;
+    }
+
+    if (!snap) {
+        evUnlock();
+        return NULL;
+    }
+
+    snap->source = source;
+    snap->generation = dbGenerationNext();
+    snap->db->snapshot = snap;
+    snap->next = snapshots;
+    snapshots = snap;
+
+    for (size_t i = 0; i < source->table_count; i++) {
+        struct table_t *frozen =
+            snapFreezeTable(source->tables[i], snap->generation);
+        if (frozen)
+            snap->db->tables[snap->db->table_count++] = frozen;
+        if (!frozen || !snapKeepIndexes(snap, source->tables[i], i)) {
+            LOG_ERROR("Out of memory");
+            snapUnregister(snap->db);
+            snapFree(snap);
+            evUnlock();
+            return NULL;
+        }
+    }
+
+    struct database_t *db = snap->db;
+    evUnlock();
+    return db;
+}
+
+int snapDrop(const char *name) {
+    evLock();
+
+    struct snap_t *snap = snapFind(name);
+    if (!snap) {
+        LOG_ERROR("Unknown snapshot '%s'", name);
+        evUnlock();
+        return 0;
+    }
+
+    snapUnregister(snap->db);
+    snap->dropped = 1;
+    if (!snap->users)
+        snapFree(snap);
+
+    evUnlock();
+    return 1;
+}
+
+/* A string literal, quotes are written twice */
+static void snapWriteText(const char *text, FILE *out) {
+    fputc('\'', out);
+    for (; *text; text++) {
+        if (*text == '\'')
+            fputc('\'', out);
+        fputc(*text, out);
+    }
+    fputc('\'', out);
+}
+
+static void snapWriteColumns(const struct table_t *table, FILE *out) {
+    for (size_t i = 0; i < table->column_count; i++)
+        fprintf(out, "%s%s", i ? ", " : "", table->columns[i]->name);
+}
+
+/* The rows of 'table' into table 'name', oldest first for CAPPED tables.
+ * The tables of a snapshot are never paged, see snapCreate() */
+static void snapWriteRows(const char *name, const struct table_t *table,
+                          FILE *out) {
+    for (size_t k = 0; k < table->row_count; k++) {
+        const struct row_t *row =
+            table->rows[(table->ring_head + k) % table->row_count];
+
+        if (k % SNAP_BACKUP_ROWS == 0) {
+            fprintf(out, "INSERT INTO %s (", name);
+            snapWriteColumns(table, out);
+            fputs(") VALUES\n(", out);
+        } else {
+            fputs(",\n(", out);
+        }
+
+        for (size_t i = 0; i < table->column_count; i++) {
+            const struct column_t *col = table->columns[i];
+            if (i)
+                fputs(", ", out);
+            if (col->type == DB_TYPE_INT)
+                fprintf(out, "%d", dbCellInt(row, col));
+            else
+                snapWriteText(dbCellText(row, col), out);
+        }
+        fputc(')', out);
+
+        if (k % SNAP_BACKUP_ROWS == SNAP_BACKUP_ROWS - 1 ||
+            k + 1 == table->row_count)
+            fputs(";\n", out);
+    }
+}
+
+/* A column of CREATE TABLE, with its DEFAULT unless it is 0 or '' */
+static void snapWriteColumn(const struct column_t *col, FILE *out) {
+    if (col->type == DB_TYPE_INT) {
+        fprintf(out, "%s INT", col->name);
+        if (col->default_value.i)
+            fprintf(out, " DEFAULT %d", col->default_value.i);
+        return;
+    }
+
+    fprintf(out, "%s TEXT", col->name);
+    if (col->default_value.s[0]) {
+        fputs(" DEFAULT ", out);
+        snapWriteText(col->default_value.s, out);
+    }
+}
+
+static void snapWriteTable(const struct snap_t *snap, size_t position,
+                           FILE *out) {
+    const struct table_t *table = snap->db->tables[position];
+    const struct part_t *part = table->partitioning;
+
+    fprintf(out, "CREATE TABLE %s (", table->name);
+    for (size_t i = 0; i < table->column_count; i++) {
+        if (i)
+            fputs(", ", out);
+        snapWriteColumn(table->columns[i], out);
+    }
+    fputc(')', out);
+
+    if (table->row_format == DB_ROW_PACKED)
+        fputs(" ROW_FORMAT = PACKED", out);
+    if (table->capped)
+        fprintf(out, " CAPPED (%zu ROWS)", table->capped);
+
+    if (part && part->method == PART_HASH) {
+        fprintf(out, " PARTITION BY HASH (%s) PARTITIONS %zu",
+                table->columns[part->column]->name, part->count);
+    } else if (part) {
+        fprintf(out, " PARTITION BY RANGE (%s) (",
+                table->columns[part->column]->name);
+        for (size_t p = 0; p < part->count; p++) {
+            fprintf(out, "%sPARTITION %s VALUES LESS THAN ", p ? ", " : "",
+                    part->tables[p]->name);
+            if (part->bounds[p] == PART_MAXVALUE)
+                fputs("MAXVALUE", out);
+            else
+                fprintf(out, "(%lld)", (long long)part->bounds[p]);
+        }
+        fputc(')', out);
+    }
+    fputs(";\n", out);
+
+    for (size_t p = 0; part && p < part->count; p++)
+        snapWriteRows(table->name, part->tables[p], out);
+    if (!part)
+        snapWriteRows(table->name, table, out);
+
+    /* Indexes are built once the rows are in */
+    for (size_t i = 0; i < snap->index_count; i++) {
+        const struct snap_index_t *index = &snap->indexes[i];
+        if (index->table == position)
+            fprintf(out, "CREATE INDEX %s ON %s (%s) USING %s;\n",
+                    index->name, table->name,
+                    table->columns[index->column]->name,
+                    indexTypeName(index->type));
+    }
+}
+
+/* Nothing the snapshot holds changes, it is read without the latch */
+static int snapWrite(const struct snap_t *snap, FILE *out) {
+    const struct database_t *db = snap->db;
+
+    fprintf(out, "CREATE DATABASE %s;\nUSE %s;\n", snap->source->name,
+            snap->source->name);
+    for (size_t i = 0; i < db->table_count; i++)
+        snapWriteTable(snap, i, out);
+    return !ferror(out);
+}
+
+int snapBackup(const char *name, const char *path) {
+    evLock();
+    struct snap_t *snap = snapFind(name);
+    if (snap)
+        snap->users++;
+    else
+        LOG_ERROR("Unknown snapshot '%s'", name);
+    evUnlock();
+
+    if (!snap)
+        return 0;
+
+    FILE *out = fopen(path, "w");
+    int ok = out && snapWrite(snap, out);
+    if (out && fclose(out) != 0)
+        ok = 0;
+    if (!ok)
+        LOG_ERROR("Unable to write '%s'", path);
+
+    evLock();
+    if (--snap->users == 0 && snap->dropped)
+        snapFree(snap);
+    evUnlock();
+    return ok;
+}
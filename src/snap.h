@@ -0,0 +1,75 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Snapshots, a read only database holding the tables of another one as
+ *  they were when the snapshot was taken. Taking one copies the row
+ *  pointers of every table and nothing else: rows and pages are shared
+ *  with the live tables, which copy the ones they are about to write
+ *  (see dbTableFreeze()) and keep the originals as long as a snapshot
+ *  may read them.
+ *
+ *      CREATE SNAPSHOT nightly;
+ *      USE nightly;
+ *      SELECT * FROM orders WHERE total > 100;
+ *      BACKUP SNAPSHOT nightly INTO 'orders.sql';
+ *      DROP SNAPSHOT nightly;
+ *
+ *  A backup is a script that creates the database again, column
+ *  defaults and indexes included (build/rsql -f).
+ *  snapBackup() only takes the storage latch to start and to finish, so
+ *  threads writing the live tables are not held while the file is
+ *  written. Snapshots cannot be taken with a buffer pool budget (-m).
+ */
+#ifndef _SNAP_H
+#define _SNAP_H
+
+#include <stdint.h>
+
+#include "db.h"
+
+/* Rows per INSERT statement of a backup */
+#define SNAP_BACKUP_ROWS 1000
+
+/* An index of a live table when the snapshot was taken, the tables of a
+ * snapshot have none but backups create them again */
+struct snap_index_t {
+    char name[64];
+    int type;
+    size_t table; /* position in the database of the snapshot */
+    int column;
+};
+
+struct snap_t {
+    struct database_t *db;     /* named after the snapshot */
+    struct database_t *source; /* the live database */
+    uint32_t generation;       /* see dbGenerationNext() */
+    struct snap_index_t *indexes;
+    size_t index_count;
+    int users;                 /* backups being written */
+    int dropped;               /* freed by the last user */
+    struct snap_t *next;
+};
+
+/* Snapshot 'name' of 'database', the current database when NULL */
+struct database_t *snapCreate(const char *database, const char *name);
+
+/* The snapshot goes away once the backups being written are done */
+int snapDrop(const char *name);
+
+/* Writes the snapshot as a SQL script to 'path', 0 on failure */
+int snapBackup(const char *name, const char *path);
+
+#endif /* _SNAP_H */
@@ -0,0 +1,417 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "stats.h"
+#include "buffer.h"
+#include "lex.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Default selectivities used when a table was never analyzed,
+ * the classic System R guesses */
+#define STATS_DEFAULT_EQ 0.1
+#define STATS_DEFAULT_RANGE (1.0 / 3.0)
+
+/* FNV-1a followed by a 64 bit finalizer, HyperLogLog needs well
+ * distributed high bits */
+static uint64_t statsHash(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static void statsHllAdd(unsigned char *registers, uint64_t hash) {
+    size_t idx = hash >> (64 - STATS_HLL_BITS);
+    uint64_t rest = hash << STATS_HLL_BITS;
+    unsigned char rank = 1;
+
+    while (rank <= 64 - STATS_HLL_BITS && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
+    }
+
+    if (rank > registers[idx])
+        registers[idx] = rank;
+}
+
+static size_t statsHllEstimate(const unsigned char *registers) {
+    const double m = STATS_HLL_REGISTERS;
+    double sum = 0.0;
+    size_t zeros = 0;
+
+    for (size_t i = 0; i < STATS_HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -registers[i]);
+        if (!registers[i])
+            zeros++;
+    }
+
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+
+    /* Small range correction (linear counting) */
+    if (estimate <= 2.5 * m && zeros)
+        estimate = m * log(m / (double)zeros);
+
+    return (size_t)(estimate + 0.5);
+}
+
+static int statsCompareInt(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int statsCompareText(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void statsAnalyzeIntColumn(struct table_t *table, size_t c,
+                                  struct table_stats_t *stats, int *values) {
+    const struct column_t *def = table->columns[c];
+    struct column_stats_t *col = &stats->columns[c];
+    unsigned char registers[STATS_HLL_REGISTERS] = {0};
+    size_t n = table->row_count;
+
+    for (size_t r = 0; r < n; r++) {
+        int v = dbCellInt(bufferRowScan(table, r), def);
+        values[r] = v;
+        statsHllAdd(registers, statsHash(&v, sizeof(v)));
+
+        size_t z = r / STATS_ZONE_ROWS;
+        if (z >= stats->zone_count)
+            continue;
+        if (r % STATS_ZONE_ROWS == 0 || v < col->zone_min[z])
+            col->zone_min[z] = v;
+        if (r % STATS_ZONE_ROWS == 0 || v > col->zone_max[z])
+            col->zone_max[z] = v;
+    }
+
+    col->distinct = statsHllEstimate(registers);
+    qsort(values, n, sizeof(int), statsCompareInt);
+
+    col->bucket_count = STATS_HIST_BUCKETS;
+    for (size_t b = 0; b <= STATS_HIST_BUCKETS; b++)
+        col->bounds[b].i = values[b * (n - 1) / STATS_HIST_BUCKETS];
+}
+
+static void statsAnalyzeTextColumn(struct table_t *table, size_t c,
+                                   struct table_stats_t *stats,
+                                   const char **values) {
+    const struct column_t *def = table->columns[c];
+    struct column_stats_t *col = &stats->columns[c];
+    unsigned char registers[STATS_HLL_REGISTERS] = {0};
+    size_t n = table->row_count;
+
+    for (size_t r = 0; r < n; r++) {
+        const char *v = dbCellText(bufferRowScan(table, r), def);
+        values[r] = v;
+        statsHllAdd(registers, statsHash(v, strlen(v)));
+    }
+
+    col->distinct = statsHllEstimate(registers);
+    qsort(values, n, sizeof(char *), statsCompareText);
+
+    col->bucket_count = STATS_HIST_BUCKETS;
+    for (size_t b = 0; b <= STATS_HIST_BUCKETS; b++) {
+        strncpy(col->bounds[b].s, values[b * (n - 1) / STATS_HIST_BUCKETS],
+                STATS_TEXT_PREFIX - 1);
+        col->bounds[b].s[STATS_TEXT_PREFIX - 1] = '\0';
+    }
+}
+
+int statsAnalyzeTable(struct table_t *table) {
+    if (!table)
+        return 0;
+
+    /* A single allocation, released with free() by the db module */
+    size_t zone_count = table->row_count / STATS_ZONE_ROWS;
+    size_t zone_bytes = zone_count * sizeof(int);
+    size_t size = sizeof(struct table_stats_t) +
+                  2 * table->column_count * zone_bytes;
+
+    struct table_stats_t *stats = malloc(size);
+    if (!stats)
+        return 0;
+
+    memset(stats, 0, size);
+    stats->row_count = table->row_count;
+    stats->zone_count = zone_count;
+    stats->rewrite_count = table->rewrite_count;
+
+    int *zones = (int *)(stats + 1);
+    for (size_t c = 0; c < table->column_count; c++) {
+        stats->columns[c].zone_min = zones + 2 * c * zone_count;
+        stats->columns[c].zone_max = zones + (2 * c + 1) * zone_count;
+    }
+
+    /* Scratch space big enough for either column type */
+    void *values = malloc(table->row_count * sizeof(char *) + 1);
+    if (!values) {
+        free(stats);
+        return 0;
+    }
+
+    for (size_t c = 0; c < table->column_count && table->row_count; c++) {
+        if (table->columns[c]->type == DB_TYPE_INT)
+            statsAnalyzeIntColumn(table, c, stats, values);
+        else
+            statsAnalyzeTextColumn(table, c, stats, values);
+    }
+
+    free(values);
+    free(table->stats);
+    table->stats = stats;
+    dbCatalogChanged();
+    return 1;
+}
+
+void statsColumnDeleted(struct table_t *table, int column) {
+    struct table_stats_t *stats = table->stats;
+    if (!stats)
+        return;
+
+    memmove(&stats->columns[column], &stats->columns[column + 1],
+            (MAX_COLUMNS_NUM - column - 1) * sizeof(struct column_stats_t));
+    memset(&stats->columns[MAX_COLUMNS_NUM - 1], 0,
+           sizeof(struct column_stats_t));
+}
+
+void statsRowsDeleted(struct table_t *table, const uint32_t *rows,
+                      size_t count) {
+    struct table_stats_t *stats = table->stats;
+    if (!stats || stats->rewrite_count != table->rewrite_count)
+        return;
+
+    /* New zone z covers the rows left in old zones [from, to], which are
+     * never before z: the zones are rewritten in place in order */
+    size_t analyzed = stats->zone_count * STATS_ZONE_ROWS, d = 0, zones = 0;
+    for (size_t z = 0; z < stats->zone_count; z++) {
+        size_t first = z * STATS_ZONE_ROWS;
+        while (d < count && rows[d] <= first + d)
+            d++;
+        size_t from = (first + d) / STATS_ZONE_ROWS;
+
+        size_t last = first + STATS_ZONE_ROWS - 1;
+        while (d < count && rows[d] <= last + d)
+            d++;
+        if (last + d >= analyzed)
+            break;
+        size_t to = (last + d) / STATS_ZONE_ROWS;
+
+        for (size_t c = 0; c < table->column_count; c++) {
+            struct column_stats_t *col = &stats->columns[c];
+            if (!col->zone_min)
+                continue;
+
+            int min = col->zone_min[from], max = col->zone_max[from];
+            for (size_t old = from + 1; old <= to; old++) {
+                if (col->zone_min[old] < min)
+                    min = col->zone_min[old];
+                if (col->zone_max[old] > max)
+                    max = col->zone_max[old];
+            }
+            col->zone_min[z] = min;
+            col->zone_max[z] = max;
+        }
+        zones++;
+    }
+    stats->zone_count = zones;
+}
+
+void statsRowsUpdated(struct table_t *table, int column, const uint32_t *rows,
+                      size_t count) {
+    struct table_stats_t *stats = table->stats;
+    if (!stats || stats->rewrite_count != table->rewrite_count)
+        return;
+
+    const struct column_t *def = table->columns[column];
+    struct column_stats_t *col = &stats->columns[column];
+    if (def->type != DB_TYPE_INT || !col->zone_min)
+        return;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t z = rows[i] / STATS_ZONE_ROWS;
+        if (z >= stats->zone_count)
+            break;
+
+        int v = dbCellInt(bufferRow(table, rows[i]), def);
+        if (v < col->zone_min[z])
+            col->zone_min[z] = v;
+        if (v > col->zone_max[z])
+            col->zone_max[z] = v;
+    }
+}
+
+/* Estimated fraction of values strictly below 'value', interpolating
+ * linearly inside the bucket that contains it */
+static double statsFractionBelow(const struct column_t *column,
+                                 const struct column_stats_t *col,
+                                 const union cell_value_t *value) {
+    const size_t buckets = col->bucket_count;
+
+    if (column->type == DB_TYPE_INT) {
+        int v = value->i;
+        if (v <= col->bounds[0].i)
+            return 0.0;
+        if (v > col->bounds[buckets].i)
+            return 1.0;
+
+        size_t b = 0;
+        while (b + 1 < buckets && v > col->bounds[b + 1].i)
+            b++;
+
+        double lo = col->bounds[b].i, hi = col->bounds[b + 1].i;
+        double within = hi > lo ? (v - lo) / (hi - lo) : 0.5;
+        return (b + within) / buckets;
+    }
+
+    /* TEXT bounds are prefixes, so assume half of the bucket matches */
+    char prefix[STATS_TEXT_PREFIX];
+    strncpy(prefix, value->s, STATS_TEXT_PREFIX - 1);
+    prefix[STATS_TEXT_PREFIX - 1] = '\0';
+
+    if (strcmp(prefix, col->bounds[0].s) <= 0)
+        return 0.0;
+    if (strcmp(prefix, col->bounds[buckets].s) > 0)
+        return 1.0;
+
+    size_t b = 0;
+    while (b + 1 < buckets && strcmp(prefix, col->bounds[b + 1].s) > 0)
+        b++;
+    return (b + 0.5) / buckets;
+}
+
+/* Estimated fraction of rows equal to 'value'. A value that spans
+ * several histogram bounds is a frequent one and gets the share of the
+ * buckets it fills instead of the uniform 1/distinct guess */
+static double statsFractionEqual(const struct column_t *column,
+                                 const struct column_stats_t *col,
+                                 const union cell_value_t *value) {
+    size_t hits = 0;
+
+    for (size_t b = 0; b <= col->bucket_count; b++) {
+        int same = column->type == DB_TYPE_INT
+                       ? col->bounds[b].i == value->i
+                       : strncmp(col->bounds[b].s, value->s,
+                                 STATS_TEXT_PREFIX - 1) == 0;
+        if (same)
+            hits++;
+    }
+
+    double uniform = col->distinct ? 1.0 / col->distinct : 1.0;
+    double skewed = hits > 1 ? (double)(hits - 1) / col->bucket_count : 0.0;
+    return skewed > uniform ? skewed : uniform;
+}
+
+double statsSelectivity(const struct table_t *table, int column, int op,
+                        const union cell_value_t *value) {
+    const struct table_stats_t *stats = table->stats;
+
+    if (!stats || !stats->row_count || column < 0 || !value ||
+        !stats->columns[column].bucket_count) {
+        switch (op) {
+        case RSQL_ET_OP:
+            return STATS_DEFAULT_EQ;
+        case RSQL_NE_OP:
+            return 1.0 - STATS_DEFAULT_EQ;
+        default:
+            return STATS_DEFAULT_RANGE;
+        }
+    }
+
+    const struct column_t *def = table->columns[column];
+    const struct column_stats_t *col = &stats->columns[column];
+    double below = statsFractionBelow(def, col, value);
+    double equal = statsFractionEqual(def, col, value);
+    double sel;
+
+    switch (op) {
+    case RSQL_ET_OP:
+        sel = equal;
+        break;
+    case RSQL_NE_OP:
+        sel = 1.0 - equal;
+        break;
+    case RSQL_LT_OP:
+        sel = below;
+        break;
+    case RSQL_LE_OP:
+        sel = below + equal;
+        break;
+    case RSQL_GT_OP:
+        sel = 1.0 - below - equal;
+        break;
+    case RSQL_GE_OP:
+        sel = 1.0 - below;
+        break;
+    default:
+        sel = STATS_DEFAULT_RANGE;
+        break;
+    }
+
+    return sel < 0.0 ? 0.0 : sel > 1.0 ? 1.0 : sel;
+}
+
+size_t statsUsableZones(const struct table_t *table) {
+    const struct table_stats_t *stats = table->stats;
+
+    /* Rows recycled by a CAPPED table break the zone bounds */
+    if (!stats || stats->rewrite_count != table->rewrite_count)
+        return 0;
+    return stats->zone_count;
+}
+
+int statsZoneMayMatch(const struct table_t *table, int column, size_t zone,
+                      int op, const union cell_value_t *value) {
+    if (table->columns[column]->type != DB_TYPE_INT)
+        return 1;
+
+    /* Columns added after ANALYZE have no zone map */
+    const struct column_stats_t *col = &table->stats->columns[column];
+    if (!col->zone_min)
+        return 1;
+
+    int min = col->zone_min[zone], max = col->zone_max[zone];
+    int v = value->i;
+
+    switch (op) {
+    case RSQL_ET_OP:
+        return min <= v && v <= max;
+    case RSQL_NE_OP:
+        return !(min == v && max == v);
+    case RSQL_LT_OP:
+        return min < v;
+    case RSQL_LE_OP:
+        return min <= v;
+    case RSQL_GT_OP:
+        return max > v;
+    case RSQL_GE_OP:
+        return max >= v;
+    default:
+        return 1;
+    }
+}
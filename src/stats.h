@@ -0,0 +1,95 @@
+/*
+ * Copyright 2025 Davide Usberti <usbertibox@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ---------------------------------------------------------------------------
+ *  Per-column statistics gathered by 'ANALYZE TABLE'. They are a snapshot:
+ *  rows inserted afterwards are not reflected until the next ANALYZE, and
+ *  the planner only uses them as estimates (zone maps excepted, which are
+ *  exact for the rows they cover and are discarded once rows shift).
+ */
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "db.h"
+
+/* Number of equi-depth histogram buckets kept per column */
+#define STATS_HIST_BUCKETS 16
+
+/* HyperLogLog registers used to estimate distinct values (2^bits) */
+#define STATS_HLL_BITS 8
+#define STATS_HLL_REGISTERS (1 << STATS_HLL_BITS)
+
+/* Rows summarised by a single zone map entry, only full zones are
+ * recorded so that later appends never land in an analyzed zone */
+#define STATS_ZONE_ROWS 64
+
+/* Bytes of a TEXT value kept in a histogram bound */
+#define STATS_TEXT_PREFIX 16
+
+struct hist_bound_t {
+    int i;
+    char s[STATS_TEXT_PREFIX];
+};
+
+struct column_stats_t {
+    size_t distinct; /* estimated number of distinct values */
+
+    /* bounds[0] is the minimum and bounds[bucket_count] the maximum,
+     * every bucket holds roughly the same number of rows */
+    struct hist_bound_t bounds[STATS_HIST_BUCKETS + 1];
+    size_t bucket_count;
+
+    /* min/max per zone, INT columns only, both arrays have zone_count
+     * entries and live in the same allocation as the table_stats_t */
+    int *zone_min;
+    int *zone_max;
+};
+
+struct table_stats_t {
+    size_t row_count;    /* rows when the table was analyzed */
+    size_t zone_count;   /* zones covering the first rows of the table */
+    size_t rewrite_count; /* table->rewrite_count when analyzed */
+    struct column_stats_t columns[MAX_COLUMNS_NUM];
+};
+
+/* Gather statistics for every column, replacing the previous ones */
+int statsAnalyzeTable(struct table_t *table);
+
+/* Forget the statistics of column 'column' when it is dropped, the
+ * columns after it move down by one */
+void statsColumnDeleted(struct table_t *table, int column);
+
+/* Keep the zone maps in line with the rows after the rows at the
+ * positions 'rows' (ascending) were deleted: a zone takes the bounds of
+ * the zones its rows came from. An update widens the bounds of the
+ * zones of its rows to their new values */
+void statsRowsDeleted(struct table_t *table, const uint32_t *rows,
+                      size_t count);
+void statsRowsUpdated(struct table_t *table, int column, const uint32_t *rows,
+                      size_t count);
+
+/* Estimated fraction of rows for which 'column <op> value' holds, a NULL
+ * value (not known yet) gets the default guess for the operator */
+double statsSelectivity(const struct table_t *table, int column, int op,
+                        const union cell_value_t *value);
+
+/* Number of zone maps that are still aligned with the table rows */
+size_t statsUsableZones(const struct table_t *table);
+
+/* Whether zone 'zone' may contain a row matching 'column <op> value' */
+int statsZoneMayMatch(const struct table_t *table, int column, size_t zone,
+                      int op, const union cell_value_t *value);
+
+#endif /* _STATS_H */